@@ -94,6 +94,47 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * runs the active expire cycle every 1000/hz ms, the cycle uses at most 'expire-cycle-cpu-percent' of the period
+     * as cpu time, the thread waits for the rest of the period after a cycle.
+     */
+    class ExpireThread: public Thread
+    {
+        private:
+            uint32 worker;
+            uint32 workers;
+            uint32 shard_cursor;
+            bool running;
+            ThreadMutexLock wait_lock;
+            void Run()
+            {
+                while (running)
+                {
+                    uint64 period_micros = 1000000 / g_db->GetConf().hz;
+                    uint64 cpu_budget_micros = period_micros * g_db->GetConf().expire_cycle_cpu_percent / 100;
+                    uint64 start = get_current_epoch_micros();
+                    g_db->ActiveExpireCycle(worker, workers, cpu_budget_micros, shard_cursor);
+                    uint64 cost = get_current_epoch_micros() - start;
+                    LockGuard<ThreadMutexLock> guard(wait_lock);
+                    if (running)
+                    {
+                        wait_lock.Wait(cost + 1000 < period_micros ? (period_micros - cost) / 1000 : 1);
+                    }
+                }
+            }
+        public:
+            ExpireThread(uint32 id, uint32 num)
+                    : worker(id), workers(num), shard_cursor(0), running(true)
+            {
+            }
+            void Shutdown()
+            {
+                LockGuard<ThreadMutexLock> guard(wait_lock);
+                running = false;
+                wait_lock.Notify();
+            }
+    };
+
     int Ardb::AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key)
     {
     	KeyPrefix k;
@@ -107,10 +148,24 @@ OP_NAMESPACE_BEGIN
     {
     	NEW(g_background, BackGroundThread);
     	g_background->Start();
+    	uint32 expire_threads = GetConf().expire_cycle_threads;
+    	for (uint32 i = 0; i < expire_threads; i++)
+    	{
+    		ExpireThread* expire_thread = new ExpireThread(i, expire_threads);
+    		expire_thread->Start();
+    		m_expire_threads.push_back(expire_thread);
+    	}
     	return 0;
     }
     int Ardb::StopBackGroundThread()
     {
+    	for (size_t i = 0; i < m_expire_threads.size(); i++)
+    	{
+    		m_expire_threads[i]->Shutdown();
+    		m_expire_threads[i]->Join();
+    		DELETE(m_expire_threads[i]);
+    	}
+    	m_expire_threads.clear();
     	if(NULL != g_background)
     	{
     		g_background->Shutdown();
@@ -56,6 +56,14 @@ OP_NAMESPACE_BEGIN
         DELETE(c);
     }
 
+    void Ardb::BlockTimeoutCallback(void* data)
+    {
+        Context* ctx = (Context*) data;
+        RedisReply empty_multi_bulk;
+        empty_multi_bulk.ReserveMember(-1);
+        g_db->UnblockKeys(*ctx, true, &empty_multi_bulk);
+    }
+
     int Ardb::UnblockKeys(Context& ctx, bool sync, RedisReply* reply)
     {
         if (ctx.keyslocked)
@@ -106,7 +114,11 @@ OP_NAMESPACE_BEGIN
         }
         if (mstimeout > 0)
         {
-            ctx.GetBPop().timeout = (uint64) mstimeout * 1000 + get_current_epoch_micros();
+            BlockingState& bpop = ctx.GetBPop();
+            bpop.timeout = (uint64) mstimeout * 1000 + get_current_epoch_micros();
+            bpop.deadline.cb = BlockTimeoutCallback;
+            bpop.deadline.data = &ctx;
+            ctx.client->client->GetService().GetTimingWheel().Schedule(bpop.deadline, mstimeout);
         }
         ctx.GetBPop().block_keytype = ktype;
         ctx.client->client->BlockRead();
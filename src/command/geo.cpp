@@ -245,7 +245,7 @@ namespace ardb
         members.push_back(member2);
         ValueObjectArray vs;
         ErrCodeArray errs;
-        m_engine->MultiGet(ctx, members, vs, errs);
+        MultiGetElements(ctx, members, vs, errs);
         if (errs[0] != 0 || errs[1] != 0)
         {
             reply.Clear();
@@ -276,7 +276,7 @@ namespace ardb
         }
         ValueObjectArray vs;
         ErrCodeArray errs;
-        m_engine->MultiGet(ctx, members, vs, errs);
+        MultiGetElements(ctx, members, vs, errs);
         for (size_t i = 0; i < vs.size(); i++)
         {
             RedisReply& r = reply.AddMember();
@@ -337,7 +337,7 @@ namespace ardb
         }
         ValueObjectArray vs;
         ErrCodeArray errs;
-        m_engine->MultiGet(ctx, members, vs, errs);
+        MultiGetElements(ctx, members, vs, errs);
         for (size_t i = 0; i < vs.size(); i++)
         {
             RedisReply& r = reply.AddMember();
@@ -424,9 +424,12 @@ namespace ardb
         {
             KeyObject member(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
             member.SetZSetMember(cmd.GetArguments()[1]);
-            ValueObject score_val;
-            int err = m_engine->Get(ctx, member, score_val);
-            double score = score_val.GetZSetScore();
+            KeyObjectArray members(1, member);
+            ValueObjectArray score_vals;
+            ErrCodeArray errs;
+            MultiGetElements(ctx, members, score_vals, errs);
+            int err = errs[0];
+            double score = score_vals[0].GetZSetScore();
             if (0 != err || !GeoHashHelper::GetXYByHash(GEO_WGS84_TYPE, GEO_STEP_MAX, (uint64) score, x, y))
             {
                 reply.SetErrorReason("could not decode requested zset member");
@@ -521,6 +524,9 @@ namespace ardb
         GeoPointArray points;
         std::vector<ZRangeSpec>::iterator hit = range_array.begin();
         Iterator* iter = NULL;
+        KeyObject meta_key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+        ValueObject meta;
+        m_engine->Get(ctx, meta_key, meta);
         //printf("###%d \n", range_array.size());
         while (hit != range_array.end())
         {
@@ -529,7 +535,7 @@ namespace ardb
             zmember.SetZSetScore(range.min.GetFloat64());
             if (NULL == iter)
             {
-                iter = m_engine->Find(ctx, zmember);
+                iter = FindElements(ctx, zmember, meta);
             }
             else
             {
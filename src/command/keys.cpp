@@ -84,6 +84,23 @@ OP_NAMESPACE_BEGIN
         }
         KeyType ele_type = element_type((KeyType) meta.GetType());
         KeyObject start_element(ctx.ns, ele_type, key.GetKey());
+        if (meta.IsCompact())
+        {
+            /*
+             * compact elements are sorted, min/max are taken from them without touching the meta key
+             */
+            iter = FindElements(ctx, start_element, meta);
+            if (!iter->Valid())
+            {
+                DELETE(iter);
+                return -1;
+            }
+            meta.SetMinData(iter->Key(false).GetElement(0), true);
+            iter->JumpToLast();
+            meta.SetMaxData(iter->Key(false).GetElement(0), true);
+            iter->JumpToFirst();
+            return 0;
+        }
         start_element.SetMember(meta.GetMin(), 0);
         if (meta.GetMax().IsNil())
         {
@@ -287,7 +304,18 @@ OP_NAMESPACE_BEGIN
         uint32 scan_count_limit = limit * 10;
         uint32 scan_count = 0;
         int64_t result_count = 0;
-        Iterator* iter = m_engine->Find(ctx, startkey);
+        Iterator* iter = NULL;
+        if (cmd.GetType() != REDIS_CMD_SCAN)
+        {
+            KeyObject meta_key(ctx.ns, KEY_META, startkey.GetKey());
+            ValueObject meta;
+            m_engine->Get(ctx, meta_key, meta);
+            iter = FindElements(ctx, startkey, meta);
+        }
+        else
+        {
+            iter = m_engine->Find(ctx, startkey);
+        }
         if (iter->Valid() && skip_first)
         {
             iter->Next();
@@ -521,6 +549,11 @@ OP_NAMESPACE_BEGIN
             k.SetNameSpace(dstdb);
             k.SetKey(dstkey);
             SetKeyValue(ctx, k, iter->Value());
+            if (k.GetType() == KEY_META && iter->Value().GetTTL() > 0)
+            {
+                SaveTTL(ctx, srcdb, srckey, iter->Value().GetTTL(), 0);
+                SaveTTL(ctx, dstdb, dstkey, 0, iter->Value().GetTTL());
+            }
             iter->Del();
             iter->Next();
             moved++;
@@ -709,6 +742,10 @@ OP_NAMESPACE_BEGIN
             Data merge_data;
             merge_data.SetInt64(mills);
             err = MergeKeyValue(ctx, key, REDIS_CMD_PEXPIREAT, DataArray(1, merge_data));
+            if (0 == err)
+            {
+                SaveTTL(ctx, ctx.ns, cmd.GetArguments()[0], 0, mills);
+            }
         }
         else
         {
@@ -728,14 +765,7 @@ OP_NAMESPACE_BEGIN
                     reply.SetInteger(1);
                     err = 0;
                     SetKeyValue(ctx, key, meta_value);
-                    /*
-                     * if the storage engine underly do NOT support custom compact filter,
-                     * ttl key/value pair must be stored for the later expire scan worker.
-                     */
-                    if (!m_engine->GetFeatureSet().support_compactfilter)
-                    {
-                        SaveTTL(ctx, ctx.ns, cmd.GetArguments()[0], old_ttl, mills);
-                    }
+                    SaveTTL(ctx, ctx.ns, cmd.GetArguments()[0], old_ttl, mills);
                 }
             }
         }
@@ -802,7 +832,7 @@ OP_NAMESPACE_BEGIN
             {
                 if (GetConf().master_host.empty())
                 {
-                    if (val.GetType() == KEY_STRING)
+                    if (val.GetType() == KEY_STRING && !val.IsStringSegmented())
                     {
                         RemoveKey(ctx, key);
                     }
@@ -838,12 +868,14 @@ OP_NAMESPACE_BEGIN
         RedisReply& reply = ctx.GetReply();
         const std::string& keystr = cmd.GetArguments()[0];
         KeyObject key(ctx.ns, KEY_META, keystr);
-        ValueObject val;
-        bool existed = m_engine->Exists(ctx, key,val);
+        ValueObject meta;
+        const int* errs = NULL;
+        ValueObject* batched = GetBatchedValues(ctx, 1, errs);
+        bool existed = NULL != batched ? 0 == errs[0] : m_engine->Exists(ctx, key, meta);
         if(existed)
         {
         	bool expired;
-        	CheckMeta(ctx, key, KEY_UNKNOWN, val, false, &expired);
+        	CheckMeta(ctx, key, KEY_UNKNOWN, NULL != batched ? batched[0] : meta, false, &expired);
         	if(expired)
         	{
         		existed = false;
@@ -872,23 +904,11 @@ OP_NAMESPACE_BEGIN
         ValueObject meta_obj;
         if (0 == m_engine->Get(ctx, meta_key, meta_obj))
         {
-            /*
-             * need delete ttl sort key with ttl value
-             */
-            if (m_engine->GetFeatureSet().support_compactfilter)
+            if (meta_obj.GetTTL() > 0)
             {
-                int64 ttl = meta_obj.GetTTL();
-                if (ttl > 0)
-                {
-                    Data tll_ns(TTL_DB_NSMAESPACE, false);
-                    KeyObject new_ttl_key(tll_ns, KEY_TTL_SORT, "");
-                    new_ttl_key.SetTTL(ttl);
-                    new_ttl_key.SetTTLKeyNamespace(meta_key.GetNameSpace());
-                    new_ttl_key.SetTTLKey(meta_key.GetKey().AsString());
-                    m_engine->Del(ctx, new_ttl_key);
-                }
+                m_expire_index.Remove(meta_key.GetNameSpace(), meta_key.GetKey());
             }
-            if (meta_obj.GetType() == KEY_STRING)
+            if ((meta_obj.GetType() == KEY_STRING && !meta_obj.IsStringSegmented()) || meta_obj.IsCompact())
             {
                 int err = RemoveKey(ctx, meta_key);
                 return err == 0 ? 1 : 0;
@@ -83,6 +83,19 @@ OP_NAMESPACE_BEGIN
     {
         ctx.flags.create_if_notexist = 1;
         ObjectBuffer obuffer(cmd.GetArguments()[0]);
+        /*
+         * RestoreChunk <chunk> [key format], chunk without key format is in legacy format
+         */
+        if (cmd.GetArguments().size() > 1)
+        {
+            uint8 key_format;
+            if (!parse_key_encode_format(cmd.GetArguments()[1], key_format))
+            {
+                ctx.GetReply().SetErrorReason("Unsupported key format");
+                return 0;
+            }
+            obuffer.SetArdbKeyFormat(key_format);
+        }
         if (obuffer.ArdbLoad(ctx))
         {
             ctx.dirty++;
@@ -217,7 +230,19 @@ OP_NAMESPACE_BEGIN
             {
                 ttl = iter->Value().GetTTL();
             }
-            obuffer.ArdbSaveRawKeyValue(iter->RawKey(), iter->RawValue(), buffer, ttl);
+            if (get_key_encode_format() == KEY_FORMAT_LEGACY)
+            {
+                obuffer.ArdbSaveRawKeyValue(iter->RawKey(), iter->RawValue(), buffer, ttl);
+            }
+            else
+            {
+                /*
+                 * chunks are always sent in legacy key format, so that older versions could restore them
+                 */
+                Buffer keybuf;
+                Slice legacy_key = k.EncodeAs(KEY_FORMAT_LEGACY, keybuf, false, false);
+                obuffer.ArdbSaveRawKeyValue(legacy_key, iter->RawValue(), buffer, ttl);
+            }
             iter->Next();
             /*
              * if uncompressed chunk size greater than 512KB or last uncompressed chunk, generate 'RestoreChunk <chunk>' to target host
@@ -28,9 +28,144 @@
  */
 
 #include "db/db.hpp"
+#include "util/murmur3.h"
+#include "util/atomic.hpp"
 
 namespace ardb
 {
+    /*
+     * RESP encoded once per PUBLISH and shared by all the receivers, the last one frees it
+     */
+    struct PubSubMessage
+    {
+            volatile uint32_t refcount;
+            Buffer content;
+            PubSubMessage()
+                    : refcount(1)
+            {
+            }
+            void Retain()
+            {
+                atomic_add_uint32(&refcount, 1);
+            }
+            void Release()
+            {
+                if (0 == atomic_sub_uint32(&refcount, 1))
+                {
+                    delete this;
+                }
+            }
+    };
+
+    /*
+     * messages for the receivers served by the same io thread, posted as one task
+     */
+    struct PubSubDelivery
+    {
+            ChannelService* serv;
+            std::vector<std::pair<PubSubMessage*, uint32> > items;
+    };
+    typedef std::vector<PubSubDelivery*> PubSubDeliveryArray;
+
+    static void encode_bulk(Buffer& buf, const std::string& str)
+    {
+        buf.Printf("$%llu\r\n", (unsigned long long) str.size());
+        buf.Write(str.data(), str.size());
+        buf.Write("\r\n", 2);
+    }
+
+    static PubSubMessage* encode_message(const std::string* pattern, const std::string& channel,
+            const std::string& message)
+    {
+        PubSubMessage* msg = new PubSubMessage;
+        msg->content.EnsureWritableBytes(channel.size() + message.size() + (NULL != pattern ? pattern->size() : 0) + 64);
+        if (NULL != pattern)
+        {
+            static const char pheader[] = "*4\r\n$8\r\npmessage\r\n";
+            msg->content.Write(pheader, sizeof(pheader) - 1);
+            encode_bulk(msg->content, *pattern);
+        }
+        else
+        {
+            static const char header[] = "*3\r\n$7\r\nmessage\r\n";
+            msg->content.Write(header, sizeof(header) - 1);
+        }
+        encode_bulk(msg->content, channel);
+        encode_bulk(msg->content, message);
+        return msg;
+    }
+
+    static int add_receivers(PubSubDeliveryArray& deliveries, PubSubMessage* msg, const ContextSet& ctxs)
+    {
+        int receiver = 0;
+        ContextSet::const_iterator cit = ctxs.begin();
+        while (cit != ctxs.end())
+        {
+            Context* cc = *cit;
+            cit++;
+            if (NULL == cc || NULL == cc->client || NULL == cc->client->client)
+            {
+                continue;
+            }
+            Channel* ch = cc->client->client;
+            ChannelService* serv = &(ch->GetService());
+            PubSubDelivery* delivery = NULL;
+            for (size_t i = 0; i < deliveries.size(); i++)
+            {
+                if (deliveries[i]->serv == serv)
+                {
+                    delivery = deliveries[i];
+                    break;
+                }
+            }
+            if (NULL == delivery)
+            {
+                delivery = new PubSubDelivery;
+                delivery->serv = serv;
+                deliveries.push_back(delivery);
+            }
+            msg->Retain();
+            delivery->items.push_back(std::make_pair(msg, ch->GetID()));
+            receiver++;
+        }
+        return receiver;
+    }
+
+    static void deliver_messages_callback(Channel*, void* data)
+    {
+        PubSubDelivery* delivery = (PubSubDelivery*) data;
+        for (size_t i = 0; i < delivery->items.size(); i++)
+        {
+            PubSubMessage* msg = delivery->items[i].first;
+            Channel* ch = delivery->serv->GetChannel(delivery->items[i].second);
+            if (NULL != ch)
+            {
+                ch->GetOutputBuffer().Write(msg->content.GetRawReadBuffer(), msg->content.ReadableBytes());
+                ch->EnableWriting();
+            }
+            msg->Release();
+        }
+        delete delivery;
+    }
+
+    Ardb::PubSubShard& Ardb::GetPubSubShard(const std::string& channel)
+    {
+        uint32 hash = 0;
+        MurmurHash3_x86_32(channel.data(), channel.size(), 0, &hash);
+        return m_pubsub_shards[hash & (PUBSUB_SHARD_COUNT - 1)];
+    }
+
+    size_t Ardb::PubSubChannelsCount()
+    {
+        size_t count = 0;
+        for (uint32 i = 0; i < PUBSUB_SHARD_COUNT; i++)
+        {
+            ReadLockGuard<SpinRWLock> guard(m_pubsub_shards[i].lock);
+            count += m_pubsub_shards[i].channels.size();
+        }
+        return count;
+    }
+
     int Ardb::SubscribeChannel(Context& ctx, const std::string& channel, bool is_pattern)
     {
         if (is_pattern)
@@ -41,17 +176,21 @@ namespace ardb
         {
             ctx.GetPubsub().pubsub_channels.insert(channel);
         }
+        if (is_pattern)
         {
             WriteLockGuard<SpinRWLock> guard(m_pubsub_lock);
-            if (is_pattern)
-            {
-                m_pubsub_patterns[channel].insert(&ctx);
-            }
-            else
+            ContextSet& ctxs = m_pubsub_patterns[channel];
+            if (ctxs.empty())
             {
-                m_pubsub_channels[channel].insert(&ctx);
+                m_pubsub_pattern_index.Insert(channel);
             }
-
+            ctxs.insert(&ctx);
+        }
+        else
+        {
+            PubSubShard& shard = GetPubSubShard(channel);
+            WriteLockGuard<SpinRWLock> guard(shard.lock);
+            shard.channels[channel].insert(&ctx);
         }
         ctx.flags.pubsub = 1;
         RedisReply r;
@@ -71,27 +210,37 @@ namespace ardb
             return 0;
         }
         PubSubChannelTable* tables = NULL;
+        SpinRWLock* lock = NULL;
         if (is_pattern)
         {
             ctx.GetPubsub().pubsub_patterns.erase(channel);
             tables = &m_pubsub_patterns;
+            lock = &m_pubsub_lock;
         }
         else
         {
             ctx.GetPubsub().pubsub_channels.erase(channel);
-            tables = &m_pubsub_channels;
+            PubSubShard& shard = GetPubSubShard(channel);
+            tables = &shard.channels;
+            lock = &shard.lock;
         }
-        WriteLockGuard<SpinRWLock> guard(m_pubsub_lock);
-        PubSubChannelTable::iterator it = tables->find(channel);
         int ret = 0;
-        if (it != tables->end())
         {
-            it->second.erase(&ctx);
-            if (it->second.empty())
+            WriteLockGuard<SpinRWLock> guard(*lock);
+            PubSubChannelTable::iterator it = tables->find(channel);
+            if (it != tables->end())
             {
-                tables->erase(it);
+                it->second.erase(&ctx);
+                if (it->second.empty())
+                {
+                    tables->erase(it);
+                    if (is_pattern)
+                    {
+                        m_pubsub_pattern_index.Remove(channel);
+                    }
+                }
+                ret = 1;
             }
-            ret = 1;
         }
         if (notify)
         {
@@ -212,61 +361,44 @@ namespace ardb
 
     int Ardb::PublishMessage(Context& ctx, const std::string& channel, const std::string& message)
     {
-        ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
-        PubSubChannelTable::iterator fit = m_pubsub_channels.find(channel);
-
+        PubSubDeliveryArray deliveries;
         int receiver = 0;
-        if (fit != m_pubsub_channels.end())
         {
-            ContextSet::iterator cit = fit->second.begin();
-            while (cit != fit->second.end())
+            PubSubShard& shard = GetPubSubShard(channel);
+            ReadLockGuard<SpinRWLock> guard(shard.lock);
+            PubSubChannelTable::iterator fit = shard.channels.find(channel);
+            if (fit != shard.channels.end())
             {
-                Context* cc = *cit;
-                if (NULL != cc && cc->client != NULL)
-                {
-                    RedisReply* r = NULL;
-                    NEW(r, RedisReply);
-                    RedisReply& r1 = r->AddMember();
-                    RedisReply& r2 = r->AddMember();
-                    RedisReply& r3 = r->AddMember();
-                    r1.SetString("message");
-                    r2.SetString(channel);
-                    r3.SetString(message);
-                    WriteReply(*cc, r, true);
-                    receiver++;
-                }
-                cit++;
+                PubSubMessage* msg = encode_message(NULL, channel, message);
+                receiver += add_receivers(deliveries, msg, fit->second);
+                msg->Release();
             }
         }
-        PubSubChannelTable::iterator pit = m_pubsub_patterns.begin();
-        while (pit != m_pubsub_patterns.end())
         {
-            const std::string& pattern = pit->first;
-            if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0))
+            ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
+            if (m_pubsub_pattern_index.Size() > 0)
             {
-                ContextSet::iterator cit = pit->second.begin();
-                while (cit != pit->second.end())
+                uint64 start = get_current_epoch_micros();
+                std::vector<const std::string*> matched;
+                m_pubsub_pattern_index.Match(channel.data(), channel.size(), matched);
+                atomic_add_uint64(&m_pubsub_pattern_match_usecs, get_current_epoch_micros() - start);
+                atomic_add_uint64(&m_pubsub_pattern_match_calls, 1);
+                for (size_t i = 0; i < matched.size(); i++)
                 {
-                    Context* cc = *cit;
-                    if (NULL != cc && cc->client != NULL)
+                    const std::string& pattern = *(matched[i]);
+                    PubSubChannelTable::iterator pit = m_pubsub_patterns.find(pattern);
+                    if (pit != m_pubsub_patterns.end())
                     {
-                        RedisReply* r = NULL;
-                        NEW(r, RedisReply);
-                        RedisReply& r1 = r->AddMember();
-                        RedisReply& r2 = r->AddMember();
-                        RedisReply& r3 = r->AddMember();
-                        RedisReply& r4 = r->AddMember();
-                        r1.SetString("pmessage");
-                        r2.SetString(pattern);
-                        r3.SetString(channel);
-                        r4.SetString(message);
-                        WriteReply(*cc, r, true);
-                        receiver++;
+                        PubSubMessage* msg = encode_message(&pattern, channel, message);
+                        receiver += add_receivers(deliveries, msg, pit->second);
+                        msg->Release();
                     }
-                    cit++;
                 }
             }
-            pit++;
+        }
+        for (size_t i = 0; i < deliveries.size(); i++)
+        {
+            deliveries[i]->serv->AsyncIO(0, deliver_messages_callback, deliveries[i]);
         }
         return receiver;
     }
@@ -287,37 +419,48 @@ namespace ardb
         const std::string& subcommand = cmd.GetArguments()[0];
         if (!strcasecmp(subcommand.c_str(), "channels") && (cmd.GetArguments().size() == 1 || cmd.GetArguments().size() == 2))
         {
-            ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
             reply.ReserveMember(0);
-            PubSubChannelTable::iterator fit = m_pubsub_channels.begin();
-            while (fit != m_pubsub_channels.end())
+            StringTreeSet channels;
+            for (uint32 i = 0; i < PUBSUB_SHARD_COUNT; i++)
             {
-                const std::string& channel = fit->first;
-                if (cmd.GetArguments().size() == 2)
+                ReadLockGuard<SpinRWLock> guard(m_pubsub_shards[i].lock);
+                PubSubChannelTable::iterator fit = m_pubsub_shards[i].channels.begin();
+                while (fit != m_pubsub_shards[i].channels.end())
                 {
-                    const std::string& pattern = cmd.GetArguments()[1];
-                    if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0) != 1)
+                    const std::string& channel = fit->first;
+                    if (cmd.GetArguments().size() == 2)
                     {
-                        fit++;
-                        continue;
+                        const std::string& pattern = cmd.GetArguments()[1];
+                        if (stringmatchlen(pattern.c_str(), pattern.size(), channel.c_str(), channel.size(), 0) != 1)
+                        {
+                            fit++;
+                            continue;
+                        }
                     }
+                    channels.insert(channel);
+                    fit++;
                 }
+            }
+            StringTreeSet::iterator cit = channels.begin();
+            while (cit != channels.end())
+            {
                 RedisReply& rr = reply.AddMember();
-                rr.SetString(channel);
-                fit++;
+                rr.SetString(*cit);
+                cit++;
             }
         }
         else if (!strcasecmp(subcommand.c_str(), "numsub") && (cmd.GetArguments().size() >= 1))
         {
-            ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
             reply.ReserveMember(0);
             for(size_t i = 1; i < cmd.GetArguments().size(); i++)
             {
                 RedisReply& r1 = reply.AddMember();
                 RedisReply& r2 = reply.AddMember();
                 r1.SetString(cmd.GetArguments()[i]);
-                PubSubChannelTable::iterator found = m_pubsub_channels.find(cmd.GetArguments()[i]);
-                r2.SetInteger(found == m_pubsub_channels.end()? 0 : found->second.size());
+                PubSubShard& shard = GetPubSubShard(cmd.GetArguments()[i]);
+                ReadLockGuard<SpinRWLock> guard(shard.lock);
+                PubSubChannelTable::iterator found = shard.channels.find(cmd.GetArguments()[i]);
+                r2.SetInteger(found == shard.channels.end()? 0 : found->second.size());
             }
         }
         else if (!strcasecmp(subcommand.c_str(), "numpat") && (cmd.GetArguments().size() == 1))
@@ -32,7 +32,9 @@
 #include "util/socket_address.hpp"
 #include "util/lru.hpp"
 #include "util/system_helper.hpp"
+#include "util/bit_helper.hpp"
 #include "statistics.hpp"
+#include "rate_limiter.hpp"
 #include <sstream>
 #include <sys/utsname.h>
 #include <sys/time.h>
@@ -200,6 +202,7 @@ namespace ardb
 #endif
                     );
             info.append("gcc_version:").append(tmp).append("\r\n");
+            info.append("bitops_kernel:").append(bit_kernel_name(bit_kernel_current())).append("\r\n");
             info.append("process_id:").append(stringfromll(getpid())).append("\r\n");
 
             if (!g_repl->GetReplLog().GetReplKey().empty())
@@ -328,6 +331,7 @@ namespace ardb
                     }
                     info.append("slave_repl_offset:").append(stringfromll(g_repl->GetSlave().SyncOffset())).append("\r\n");
                     info.append("slave_sync_queue_size:").append(stringfromll(g_repl->GetSlave().SyncQueueSize())).append("\r\n");
+                    g_repl->GetSlave().PrintSyncWorkers(info);
                     if (!g_repl->GetSlave().IsConnected())
                     {
                         info.append("master_link_down_since_seconds:").append(stringfromll(time(NULL) - g_repl->GetSlave().GetMasterLinkDownTime())).append(
@@ -379,15 +383,24 @@ namespace ardb
             info.append("sync_full:").append(stringfromll(g_repl->GetMaster().FullSyncCount())).append("\r\n");
             info.append("sync_partial_ok:").append(stringfromll(g_repl->GetMaster().ParitialSyncOKCount())).append("\r\n");
             info.append("sync_partial_err:").append(stringfromll(g_repl->GetMaster().ParitialSyncErrCount())).append("\r\n");
+            info.append("pubsub_channels:").append(stringfromll(PubSubChannelsCount())).append("\r\n");
             {
                 ReadLockGuard<SpinRWLock> guard(m_pubsub_lock);
-                info.append("pubsub_channels:").append(stringfromll(m_pubsub_channels.size())).append("\r\n");
                 info.append("pubsub_patterns:").append(stringfromll(m_pubsub_patterns.size())).append("\r\n");
             }
             {
-                LockGuard<SpinMutexLock> guard(m_expires_lock);
-                info.append("expire_scan_keys:").append(stringfromll(m_expires.size())).append("\r\n");
+                uint64 calls = m_pubsub_pattern_match_calls;
+                uint64 usecs = m_pubsub_pattern_match_usecs;
+                info.append("pubsub_pattern_match_calls:").append(stringfromll(calls)).append("\r\n");
+                info.append("pubsub_pattern_match_usec:").append(stringfromll(usecs)).append("\r\n");
+                char tmp[64];
+                sprintf(tmp, "%.2f", calls > 0 ? (float) usecs / calls : 0.0f);
+                info.append("pubsub_pattern_match_usec_per_call:").append(tmp).append("\r\n");
             }
+            info.append("log_dropped_lines:").append(stringfromll(ArdbLogger::GetDroppedLines())).append("\r\n");
+            info.append("expire_index_keys:").append(stringfromll(m_expire_index.Size())).append("\r\n");
+            info.append("expire_scan_keys:").append(stringfromll(m_expire_index.PendingSize())).append("\r\n");
+            info.append("expire_lag_ms:").append(stringfromll(m_expire_index.Lag(get_current_epoch_millis()))).append("\r\n");
             info.append("\r\n");
         }
 
@@ -467,11 +480,22 @@ namespace ardb
             ch->Close();
         }
     }
-    static void channel_pause_callback(Channel* ch, void*)
+    static void channel_resume_callback(void* data)
+    {
+        ClientContext* client = (ClientContext*) data;
+        client->resume_ustime = -1;
+        client->client->AttachFD();
+    }
+    static void channel_pause_callback(Channel* ch, void* data)
     {
         if (NULL != ch)
         {
+            ClientContext* client = (ClientContext*) data;
+            int64 wait = client->resume_ustime - (int64) get_current_epoch_micros();
             ch->DetachFD();
+            client->pause_timer.cb = channel_resume_callback;
+            client->pause_timer.data = client;
+            ch->GetService().GetTimingWheel().Schedule(client->pause_timer, wait > 0 ? wait / 1000 : 0);
         }
     }
 
@@ -561,8 +585,8 @@ namespace ardb
                 if (NULL != client->client && NULL != client->client->client)
                 {
                     SocketChannel* conn = (SocketChannel*) (client->client->client);
-                    conn->GetService().AsyncIO(conn->GetID(), channel_pause_callback, NULL);
-                    client->client->resume_ustime = get_current_epoch_micros() + timeout * 1000;
+                    client->client->resume_ustime = get_current_epoch_micros() + (int64) timeout * 1000;
+                    conn->GetService().AsyncIO(conn->GetID(), channel_pause_callback, client->client);
                 }
                 it++;
             }
@@ -714,6 +738,24 @@ namespace ardb
             }
             reply.SetStatusCode(STATUS_OK);
         }
+        else if (subcmd == "throttle")
+        {
+            /*
+             * token bucket state of the hosts limited by 'qps-limit-per-host'
+             */
+            if (cmd.GetArguments().size() > 2)
+            {
+                reply.SetErrCode(ERR_INVALID_SYNTAX);
+                return 0;
+            }
+            std::string info;
+            if (GetConf().qps_limit_per_host > 0)
+            {
+                std::string pattern = cmd.GetArguments().size() == 2 ? cmd.GetArguments()[1] : "";
+                HostRateLimiter::GetSingleton().Dump(info, pattern, get_current_epoch_micros(), GetConf().qps_limit_per_host);
+            }
+            reply.SetString(info);
+        }
         else if (subcmd == "list")
         {
             std::string info;
@@ -972,7 +1014,7 @@ namespace ardb
             }
             else if (!strcasecmp(cmd.GetArguments()[i].c_str(), "capa"))
             {
-                //do nothing
+                g_repl->GetMaster().SetSlaveCapa(ctx.client->client, cmd.GetArguments()[i + 1]);
             }
             else if (!strcasecmp(cmd.GetArguments()[i].c_str(), "getack"))
             {
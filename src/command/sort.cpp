@@ -168,7 +168,16 @@ namespace ardb
             {
                 return -1;
             }
-            if (vv.GetType() > 0)
+            if (vv.IsStringSegmented())
+            {
+                std::string str;
+                if (0 != StringSegmentsRead(ctx, skey, vv, 0, vv.GetObjectLen() - 1, str))
+                {
+                    return -1;
+                }
+                value.SetString(str, false);
+            }
+            else if (vv.GetType() > 0)
             {
                 value = vv.GetStringValue();
             }
@@ -181,6 +190,20 @@ namespace ardb
             keystr = keystr.substr(0, pos);
             KeyObject hfield(ctx.ns, KEY_HASH_FIELD, keystr);
             hfield.SetHashField(field);
+            KeyObject hkey(ctx.ns, KEY_META, keystr);
+            ValueObject hmeta;
+            if (0 == m_engine->Get(ctx, hkey, hmeta) && hmeta.GetType() == KEY_HASH && hmeta.IsCompact())
+            {
+                DataArray elements;
+                bool found = false;
+                hmeta.GetCompactElements(elements);
+                size_t idx = CompactLocate(KEY_HASH, elements, hfield.GetHashField(), found);
+                if (found)
+                {
+                    value = elements[idx + 1];
+                }
+                return 0;
+            }
             ValueObject hvalue;
             int err = m_engine->Get(ctx, hfield, hvalue);
             if (0 == err)
@@ -222,8 +245,9 @@ namespace ardb
                 reply.SetErrorReason("Invalid SORT command or invalid state for SORT.");
                 return 0;
             }
-            KeyObject startkey(ctx.ns, (KeyType) element_type((KeyType) meta.GetType()), key.GetKey());
-            Iterator* iter = m_engine->Find(ctx, startkey);
+            KeyType ele_type = meta.IsListChunked() ? KEY_LIST_CHUNK : element_type((KeyType) meta.GetType());
+            KeyObject startkey(ctx.ns, ele_type, key.GetKey());
+            Iterator* iter = FindElements(ctx, startkey, meta);
             while (iter->Valid())
             {
                 KeyObject& k = iter->Key(true);
@@ -251,6 +275,20 @@ namespace ardb
                         item.value = iter->Value().GetListElement();
                         break;
                     }
+                    case KEY_LIST_CHUNK:
+                    {
+                        DataArray& elements = iter->Value().GetListChunkElements();
+                        for (size_t i = 0; i + 1 < elements.size(); i++)
+                        {
+                            item.value = elements[i];
+                            sortvals.push_back(item);
+                        }
+                        if (!elements.empty())
+                        {
+                            item.value = elements[elements.size() - 1];
+                        }
+                        break;
+                    }
                     default:
                     {
                         break;
@@ -28,56 +28,9 @@
  */
 
 #include "db/db.hpp"
+#include "util/bit_helper.hpp"
 
 OP_NAMESPACE_BEGIN
-    static const unsigned long BITOP_AND = 0;
-    static const unsigned long BITOP_OR = 1;
-    static const unsigned long BITOP_XOR = 2;
-    static const unsigned long BITOP_NOT = 3;
-
-    //copy from redis
-    static long popcount(const void *s, long count)
-    {
-        long bits = 0;
-        unsigned char *p;
-        const uint32_t* p4 = (const uint32_t*) s;
-        static const unsigned char bitsinbyte[256] =
-        { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3,
-                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5,
-                5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
-
-        /* Count bits 16 bytes at a time */
-        while (count >= 16)
-        {
-            uint32_t aux1, aux2, aux3, aux4;
-
-            aux1 = *p4++;
-            aux2 = *p4++;
-            aux3 = *p4++;
-            aux4 = *p4++;
-            count -= 16;
-
-            aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
-            aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
-            aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
-            aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
-            aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
-            aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
-            aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
-            aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
-            bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
-                    + ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
-        }
-        /* Count the remaining bytes */
-        p = (unsigned char*) p4;
-        while (count--)
-            bits += bitsinbyte[*p++];
-        return bits;
-    }
-
 //    static long popcount_bitval(const std::string& val, int32 offset, int32 limit)
 //    {
 //        if (limit < 0)
@@ -119,44 +72,18 @@ OP_NAMESPACE_BEGIN
      * not a single set bit in the bitmap. In this special case -1 is returned. */
     static long bitpos(void *s, unsigned long count, int bit)
     {
-        unsigned long *l;
         unsigned char *c;
-        unsigned long skipval, word = 0, one;
+        unsigned long word = 0, one;
         long pos = 0; /* Position of bit, to return to the caller. */
         unsigned long j;
 
-        /* Process whole words first, seeking for first word that is not
-         * all ones or all zeros respectively if we are lookig for zeros
-         * or ones. This is much faster with large strings having contiguous
-         * blocks of 1 or 0 bits compared to the vanilla bit per bit processing.
-         *
-         * Note that if we start from an address that is not aligned
-         * to sizeof(unsigned long) we consume it byte by byte until it is
-         * aligned. */
-
-        /* Skip initial bits not aligned to sizeof(unsigned long) byte by byte. */
-        skipval = bit ? 0 : UCHAR_MAX;
-        c = (unsigned char*) s;
-        while ((unsigned long) c & (sizeof(*l) - 1) && count)
-        {
-            if (*c != skipval)
-                break;
-            c++;
-            count--;
-            pos += 8;
-        }
-
-        /* Skip bits with full word step. */
-        skipval = bit ? 0 : ULONG_MAX;
-        l = (unsigned long*) c;
-        while (count >= sizeof(*l))
-        {
-            if (*l != skipval)
-                break;
-            l++;
-            count -= sizeof(*l);
-            pos += sizeof(*l) * 8;
-        }
+        /* Skip whole bytes that are all zeros or all ones respectively if we
+         * are looking for ones or zeros with the widest kernel available.
+         * This is much faster with large strings having contiguous blocks of
+         * 1 or 0 bits compared to the vanilla bit per bit processing. */
+        size_t skipped = bit_skip_bytes(s, count, bit ? 0 : UCHAR_MAX);
+        count -= skipped;
+        pos += skipped * 8;
 
         /* Load bytes into "word" considering the first byte as the most significant
          * (we basically consider it as written in big endian, since we consider the
@@ -165,8 +92,8 @@ OP_NAMESPACE_BEGIN
          *
          * Note that the loading is designed to work even when the bytes left
          * (count) are less than a full word. We pad it with zero on the right. */
-        c = (unsigned char*) l;
-        for (j = 0; j < sizeof(*l); j++)
+        c = (unsigned char*) s + skipped;
+        for (j = 0; j < sizeof(word); j++)
         {
             word <<= 8;
             if (count)
@@ -207,12 +134,243 @@ OP_NAMESPACE_BEGIN
         return 0; /* Just to avoid warnings. */
     }
 
+    /*
+     * max number of segments loaded by one MultiGet when a segmented string is scanned
+     */
+    static const int64_t kStringSegmentBatch = 64;
+
+    int Ardb::StringSegmentsLoad(Context& ctx, const KeyObject& key, int64_t from, int64_t to,
+            StringSegmentTable& segments)
+    {
+        KeyObjectArray ks;
+        std::vector<int64_t> ids;
+        for (int64_t id = from; id <= to; id++)
+        {
+            if (segments.find(id) != segments.end())
+            {
+                continue;
+            }
+            KeyObject segment_key(key.GetNameSpace(), KEY_STRING_SEGMENT, key.GetKey());
+            segment_key.SetStringSegmentId(id);
+            ks.push_back(segment_key);
+            ids.push_back(id);
+        }
+        if (ks.empty())
+        {
+            return 0;
+        }
+        ValueObjectArray vs;
+        ErrCodeArray errs;
+        int err = m_engine->MultiGet(ctx, ks, vs, errs);
+        if (0 != err)
+        {
+            return err;
+        }
+        for (size_t i = 0; i < ks.size(); i++)
+        {
+            if (0 != errs[i] && ERR_ENTRY_NOT_EXIST != errs[i])
+            {
+                return errs[i];
+            }
+            ValueObject& segment = segments[ids[i]];
+            if (0 == errs[i])
+            {
+                segment = vs[i];
+            }
+            segment.SetType(KEY_STRING_SEGMENT);
+        }
+        return 0;
+    }
+
+    /*
+     * write back loaded segments, segments never written are skipped
+     */
+    int Ardb::StringSegmentsSave(Context& ctx, const KeyObject& key, StringSegmentTable& segments)
+    {
+        StringSegmentTable::iterator it = segments.begin();
+        while (it != segments.end())
+        {
+            if (it->second.GetStringSegment().StringLength() > 0)
+            {
+                KeyObject segment_key(key.GetNameSpace(), KEY_STRING_SEGMENT, key.GetKey());
+                segment_key.SetStringSegmentId(it->first);
+                int err = SetKeyValue(ctx, segment_key, it->second);
+                if (0 != err)
+                {
+                    return err;
+                }
+            }
+            it++;
+        }
+        return 0;
+    }
+
+    /*
+     * read bytes [start, end] of segmented string, caller should limit 'end' to the string length
+     */
+    int Ardb::StringSegmentsRead(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t start, int64_t end,
+            std::string& str)
+    {
+        str.clear();
+        if (start > end)
+        {
+            return 0;
+        }
+        int64_t segment_size = meta.GetStringSegmentSize();
+        str.resize(end - start + 1);
+        for (int64_t id = start / segment_size; id <= end / segment_size; id += kStringSegmentBatch)
+        {
+            StringSegmentTable segments;
+            int err = StringSegmentsLoad(ctx, key, id, std::min(id + kStringSegmentBatch - 1, end / segment_size),
+                    segments);
+            if (0 != err)
+            {
+                return err;
+            }
+            StringSegmentTable::iterator it = segments.begin();
+            while (it != segments.end())
+            {
+                int64_t segment_start = it->first * segment_size;
+                Data& bytes = it->second.GetStringSegment();
+                int64_t from = std::max(start, segment_start);
+                int64_t to = std::min(end, segment_start + (int64_t) bytes.StringLength() - 1);
+                if (from <= to)
+                {
+                    memcpy(&str[from - start], bytes.ToMutableStr() + (from - segment_start), to - from + 1);
+                }
+                it++;
+            }
+        }
+        return 0;
+    }
+
+    /*
+     * overwrite segmented string from 'offset' with 'range', popcount of touched segments is adjusted by the
+     * replaced bytes only. meta is written back if the string grows.
+     */
+    int Ardb::StringSegmentsWrite(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t offset,
+            const std::string& range)
+    {
+        if (range.empty())
+        {
+            return 0;
+        }
+        int64_t segment_size = meta.GetStringSegmentSize();
+        int64_t end = offset + range.size() - 1;
+        StringSegmentTable segments;
+        int err = StringSegmentsLoad(ctx, key, offset / segment_size, end / segment_size, segments);
+        if (0 != err)
+        {
+            return err;
+        }
+        StringSegmentTable::iterator it = segments.begin();
+        while (it != segments.end())
+        {
+            ValueObject& segment = it->second;
+            int64_t segment_start = it->first * segment_size;
+            int64_t from = std::max(offset, segment_start);
+            int64_t to = std::min(end, segment_start + segment_size - 1);
+            char* bytes = (char*) segment.GetStringSegment().ReserveStringSpace(to - segment_start + 1);
+            char* dst = bytes + (from - segment_start);
+            const char* src = range.data() + (from - offset);
+            long count = to - from + 1;
+            int64_t bits = segment.GetStringSegmentBits() - (int64_t) bit_popcount(dst, count) + (int64_t) bit_popcount(src, count);
+            memcpy(dst, src, count);
+            segment.SetStringSegmentBits(bits);
+            it++;
+        }
+        err = StringSegmentsSave(ctx, key, segments);
+        if (0 == err && end >= meta.GetObjectLen())
+        {
+            meta.SetObjectLen(end + 1);
+            err = SetKeyValue(ctx, key, meta);
+        }
+        return err;
+    }
+
+    /*
+     * split string stored in meta value into segments once it would grow beyond 'string-segment-size'
+     */
+    int Ardb::StringSegmentsConvert(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t new_len)
+    {
+        int64_t segment_size = GetConf().string_segment_size;
+        if (segment_size <= 0 || meta.IsStringSegmented())
+        {
+            return 0;
+        }
+        std::string str;
+        if (meta.GetType() == KEY_STRING)
+        {
+            meta.GetStringValue().ToString(str);
+        }
+        if (std::max(new_len, (int64_t) str.size()) <= segment_size)
+        {
+            return 0;
+        }
+        /*
+         * drop segments left by a value overwritten in non redis compatible mode
+         */
+        int err = StringSegmentsClear(ctx, key, meta);
+        if (0 != err)
+        {
+            return err;
+        }
+        meta.SetType(KEY_STRING);
+        meta.GetStringValue().Clear();
+        meta.SetStringSegmentSize(segment_size);
+        meta.SetObjectLen(0);
+        if (str.empty())
+        {
+            return SetKeyValue(ctx, key, meta);
+        }
+        return StringSegmentsWrite(ctx, key, meta, 0, str);
+    }
+
+    /*
+     * remove all segments of the key, and reset meta to a string stored in meta value
+     */
+    int Ardb::StringSegmentsClear(Context& ctx, const KeyObject& key, ValueObject& meta)
+    {
+        KeyObject start(key.GetNameSpace(), KEY_STRING_SEGMENT, key.GetKey());
+        start.SetStringSegmentId(0);
+        if (meta.IsStringSegmented() && m_engine->GetFeatureSet().support_delete_range
+                && meta.GetObjectLen() >= meta.GetStringSegmentSize() * GetConf().range_delete_min_size)
+        {
+            KeyObject end(key.GetNameSpace(), KEY_STRING_SEGMENT, key.GetKey());
+            end.SetStringSegmentId((meta.GetObjectLen() - 1) / meta.GetStringSegmentSize() + 1);
+            m_engine->DelRange(ctx, start, end);
+        }
+        else
+        {
+            Iterator* iter = m_engine->Find(ctx, start);
+            while (NULL != iter && iter->Valid())
+            {
+                KeyObject& k = iter->Key();
+                if (k.GetType() != KEY_STRING_SEGMENT || k.GetNameSpace() != key.GetNameSpace()
+                        || k.GetKey() != key.GetKey())
+                {
+                    break;
+                }
+                IteratorDel(ctx, k, iter);
+                iter->Next();
+            }
+            DELETE(iter);
+        }
+        meta.SetStringSegmentSize(0);
+        meta.SetObjectLen(-1);
+        return 0;
+    }
+
     int Ardb::MergeSetBit(Context& ctx, const KeyObject& key, ValueObject& meta, int64 offset, uint8 on, uint8* oldbit)
     {
         if (meta.GetType() > 0 && meta.GetType() != KEY_STRING)
         {
             return ERR_WRONG_TYPE;
         }
+        if (meta.IsStringSegmented())
+        {
+            return ERR_WRONG_TYPE;
+        }
         meta.SetType(KEY_STRING);
         int byte = offset >> 3;
         Data& data = meta.GetStringValue();
@@ -255,7 +413,8 @@ OP_NAMESPACE_BEGIN
         /*
          * merge setbit
          */
-        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge)
+        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge
+                && GetConf().string_segment_size <= 0)
         {
             DataArray args(2);
             args[0].SetInt64(offset);
@@ -277,10 +436,52 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         uint8 oldbit = 0;
-        err = MergeSetBit(ctx, key, v, offset, bit, &oldbit);
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            int64 byte = offset >> 3;
+            err = StringSegmentsConvert(ctx, key, v, byte + 1);
+            if (0 == err && v.IsStringSegmented())
+            {
+                /*
+                 * only the segment holding the bit is loaded & written
+                 */
+                int64 segment_size = v.GetStringSegmentSize();
+                int64 id = byte / segment_size;
+                StringSegmentTable segments;
+                err = StringSegmentsLoad(ctx, key, id, id, segments);
+                if (0 == err)
+                {
+                    ValueObject& segment = segments[id];
+                    char* bytes = (char*) segment.GetStringSegment().ReserveStringSpace(byte % segment_size + 1);
+                    char* p = bytes + byte % segment_size;
+                    int bitmask = 1 << (7 - (offset & 0x7));
+                    oldbit = (*p & bitmask) ? 1 : 0;
+                    *p = bit ? (*p | bitmask) : (*p & ~bitmask);
+                    segment.SetStringSegmentBits(segment.GetStringSegmentBits() + bit - oldbit);
+                    err = StringSegmentsSave(ctx, key, segments);
+                }
+                if (0 == err && byte >= v.GetObjectLen())
+                {
+                    v.SetObjectLen(byte + 1);
+                    err = SetKeyValue(ctx, key, v);
+                }
+            }
+            else if (0 == err)
+            {
+                err = MergeSetBit(ctx, key, v, offset, bit, &oldbit);
+                if (0 == err)
+                {
+                    err = SetKeyValue(ctx, key, v);
+                }
+            }
+            if (0 != err)
+            {
+                batch.MarkFailed(err);
+            }
+        }
         if (0 == err)
         {
-            err = SetKeyValue(ctx, key, v);
+            err = ctx.transc_err;
         }
         if (err < 0)
         {
@@ -306,8 +507,9 @@ OP_NAMESPACE_BEGIN
         size_t byte = bitoffset >> 3;
         size_t bit = 7 - (bitoffset & 0x7);
         reply.SetInteger(0); //default response
+        KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v))
+        if (!CheckMeta(ctx, key, KEY_STRING, v))
         {
             return 0;
         }
@@ -315,6 +517,28 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        if (v.IsStringSegmented())
+        {
+            if ((int64) byte >= v.GetObjectLen())
+            {
+                return 0;
+            }
+            int64 segment_size = v.GetStringSegmentSize();
+            StringSegmentTable segments;
+            int err = StringSegmentsLoad(ctx, key, byte / segment_size, byte / segment_size, segments);
+            if (0 != err)
+            {
+                reply.SetErrCode(err);
+                return 0;
+            }
+            Data& bytes = segments.begin()->second.GetStringSegment();
+            if (bytes.StringLength() > byte % segment_size)
+            {
+                int bitval = (bytes.ToMutableStr())[byte % segment_size] & (1 << bit);
+                reply.SetInteger(bitval ? 1 : 0);
+            }
+            return 0;
+        }
         Data& str = v.GetStringValue();
         if (str.IsString())
         {
@@ -346,8 +570,9 @@ OP_NAMESPACE_BEGIN
         std::string strbuf;
         RedisReply& reply = ctx.GetReply();
         reply.SetInteger(0); //default response
+        KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v) || v.GetType() == 0)
+        if (!CheckMeta(ctx, key, KEY_STRING, v) || v.GetType() == 0)
         {
             return 0;
         }
@@ -356,7 +581,11 @@ OP_NAMESPACE_BEGIN
 
         /* Set the 'p' pointer to the string, that can be just a stack allocated
          * array if our string was integer encoded. */
-        if (!str.IsString())
+        if (v.IsStringSegmented())
+        {
+            strlen = v.GetObjectLen();
+        }
+        else if (!str.IsString())
         {
             str.ToString(strbuf);
             p = (const unsigned char*) (&strbuf[0]);
@@ -400,10 +629,48 @@ OP_NAMESPACE_BEGIN
         }
         /* Precondition: end >= 0 && end < strlen, so the only condition where
          * zero can be returned is: start > end. */
-        if (start <= end)
+        if (start <= end && v.IsStringSegmented())
+        {
+            /*
+             * segments covered by the range as a whole are counted by the cached popcount
+             */
+            int64 segment_size = v.GetStringSegmentSize();
+            int64 bits = 0;
+            for (int64 id = start / segment_size; id <= end / segment_size; id += kStringSegmentBatch)
+            {
+                StringSegmentTable segments;
+                int err = StringSegmentsLoad(ctx, key, id, std::min(id + kStringSegmentBatch - 1, end / segment_size),
+                        segments);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                StringSegmentTable::iterator it = segments.begin();
+                while (it != segments.end())
+                {
+                    int64 segment_start = it->first * segment_size;
+                    Data& bytes = it->second.GetStringSegment();
+                    int64 segment_end = segment_start + bytes.StringLength() - 1;
+                    int64 from = std::max(start, segment_start);
+                    int64 to = std::min(end, segment_end);
+                    if (from == segment_start && to == segment_end)
+                    {
+                        bits += it->second.GetStringSegmentBits();
+                    }
+                    else if (from <= to)
+                    {
+                        bits += bit_popcount(bytes.ToMutableStr() + (from - segment_start), to - from + 1);
+                    }
+                    it++;
+                }
+            }
+            reply.SetInteger(bits);
+        }
+        else if (start <= end)
         {
             long bytes = end - start + 1;
-            reply.SetInteger(popcount(p + start, bytes));
+            reply.SetInteger(bit_popcount(p + start, bytes));
         }
         return 0;
     }
@@ -425,8 +692,9 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
 
+        KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
         ValueObject v;
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_STRING, v) || v.GetType() == 0)
+        if (!CheckMeta(ctx, key, KEY_STRING, v) || v.GetType() == 0)
         {
             return 0;
         }
@@ -439,7 +707,11 @@ OP_NAMESPACE_BEGIN
         Data& str = v.GetStringValue();
         /* Set the 'p' pointer to the string, that can be just a stack allocated
          * array if our string was integer encoded. */
-        if (!str.IsString())
+        if (v.IsStringSegmented())
+        {
+            strlen = v.GetObjectLen();
+        }
+        else if (!str.IsString())
         {
             str.ToString(strbuf);
             p = (const unsigned char *) &strbuf[0];
@@ -497,6 +769,56 @@ OP_NAMESPACE_BEGIN
         {
             reply.SetInteger(-1);
         }
+        else if (v.IsStringSegmented())
+        {
+            /*
+             * scan segments in order, segments without the searched bit are skipped by the cached popcount,
+             * bytes not stored in a segment are zero.
+             */
+            int64 segment_size = v.GetStringSegmentSize();
+            int64 pos = -1;
+            for (int64 id = start / segment_size; pos < 0 && id <= end / segment_size; id += kStringSegmentBatch)
+            {
+                StringSegmentTable segments;
+                int err = StringSegmentsLoad(ctx, key, id, std::min(id + kStringSegmentBatch - 1, end / segment_size),
+                        segments);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                StringSegmentTable::iterator it = segments.begin();
+                while (pos < 0 && it != segments.end())
+                {
+                    int64 segment_start = it->first * segment_size;
+                    Data& bytes = it->second.GetStringSegment();
+                    int64 stored = bytes.StringLength();
+                    int64 bits = it->second.GetStringSegmentBits();
+                    int64 from = std::max(start, segment_start);
+                    int64 to = std::min(end, segment_start + segment_size - 1);
+                    int64 stored_to = std::min(to, segment_start + stored - 1);
+                    if (from <= stored_to && !(bit == 1 && bits == 0) && !(bit == 0 && bits == stored * 8))
+                    {
+                        long count = stored_to - from + 1;
+                        long found = bitpos(bytes.ToMutableStr() + (from - segment_start), count, bit);
+                        if (found >= 0 && found < count * 8)
+                        {
+                            pos = from * 8 + found;
+                        }
+                    }
+                    if (pos < 0 && bit == 0 && to > stored_to)
+                    {
+                        pos = std::max(from, stored_to + 1) * 8;
+                    }
+                    it++;
+                }
+            }
+            if (pos < 0 && bit == 0 && !end_given)
+            {
+                pos = (end + 1) * 8;
+            }
+            reply.SetInteger(pos);
+        }
         else
         {
             long bytes = end - start + 1;
@@ -538,21 +860,19 @@ OP_NAMESPACE_BEGIN
             targetkey = cmd.GetArguments()[1];
             destkey_count = 1;
         }
-        unsigned long op;
-        unsigned long maxlen = 0; /* Array of length of src strings,
-         and max len. */
-        unsigned long minlen = 0; /* Min len among the input keys. */
+        int op;
+        unsigned long maxlen = 0; /* Max len among the input keys. */
         std::string res; /* Resulting string. */
 
         /* Parse the operation name. */
         if ((opname[0] == 'a' || opname[0] == 'A') && !strcasecmp(opname.c_str(), "and"))
-            op = BITOP_AND;
+            op = BIT_OP_AND;
         else if ((opname[0] == 'o' || opname[0] == 'O') && !strcasecmp(opname.c_str(), "or"))
-            op = BITOP_OR;
+            op = BIT_OP_OR;
         else if ((opname[0] == 'x' || opname[0] == 'X') && !strcasecmp(opname.c_str(), "xor"))
-            op = BITOP_XOR;
+            op = BIT_OP_XOR;
         else if ((opname[0] == 'n' || opname[0] == 'N') && !strcasecmp(opname.c_str(), "not"))
-            op = BITOP_NOT;
+            op = BIT_OP_NOT;
         else
         {
             reply.SetErrCode(ERR_INVALID_SYNTAX);
@@ -560,7 +880,7 @@ OP_NAMESPACE_BEGIN
         }
 
         /* Sanity check: NOT accepts only a single key argument. */
-        if (op == BITOP_NOT && cmd.GetArguments().size() != (size_t)(2 + destkey_count))
+        if (op == BIT_OP_NOT && cmd.GetArguments().size() != (size_t)(2 + destkey_count))
         {
             reply.SetErrorReason("BITOP NOT must be called with a single source key.");
             return 0;
@@ -593,7 +913,6 @@ OP_NAMESPACE_BEGIN
             /* Handle non-existing keys as empty strings. */
             if (vals[j].GetType() == 0)
             {
-                minlen = 0;
                 continue;
             }
             /* Return an error if one of the keys is not a string. */
@@ -602,151 +921,94 @@ OP_NAMESPACE_BEGIN
                 reply.SetErrCode(ERR_WRONG_TYPE);
                 return 0;
             }
+            if (vals[j].IsStringSegmented())
+            {
+                std::string str;
+                int err = StringSegmentsRead(ctx, keys[j], vals[j], 0, vals[j].GetObjectLen() - 1, str);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                vals[j].GetStringValue().SetString(str, false);
+            }
             vals[j].GetStringValue().ToMutableStr();
             size_t slen = vals[j].GetStringValue().StringLength();
             if (slen > maxlen)
                 maxlen = slen;
-            if (j == 0 || slen < minlen)
-                minlen = slen;
         }
 
-        /* Compute the bit operation, if at least one string is not empty. */
+        /* Compute the bit operation, if at least one string is not empty.
+         * Missing keys and the tail of shorter strings are zero padded, so the
+         * first source is copied into 'res' and the others are folded into it
+         * by the widest bit kernel the cpu supports. */
         if (maxlen)
         {
-            res.resize(maxlen);
-            unsigned char output, byte;
-            unsigned long i;
-
-            /* Fast path: as far as we have data for all the input bitmaps we
-             * can take a fast path that performs much better than the
-             * vanilla algorithm. */
-            size_t j = 0;
-            if (minlen >= sizeof(unsigned long) * 4 && numkeys <= 16)
+            res.assign(maxlen, 0);
+            for (size_t k = 0; k < numkeys; k++)
             {
-                unsigned long *lp[16];
-                unsigned long *lres = (unsigned long*) (&res[0]);
-
-                /* Note: sds pointer is always aligned to 8 byte boundary. */
-                for (size_t k = 0; k < numkeys; k++)
-                {
-                    lp[k] = (unsigned long*) (vals[k + destkey_count].GetStringValue().CStr());
-                }
-                memcpy(&res[0], vals[destkey_count].GetStringValue().CStr(), minlen);
-
-                /* Different branches per different operations for speed (sorry). */
-                if (op == BITOP_AND)
+                ValueObject& src = vals[k + destkey_count];
+                size_t slen = src.GetType() == KEY_STRING ? src.GetStringValue().StringLength() : 0;
+                const char* sp = slen > 0 ? src.GetStringValue().CStr() : NULL;
+                if (k == 0)
                 {
-                    while (minlen >= sizeof(unsigned long) * 4)
+                    if (slen > 0)
                     {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] &= lp[i][0];
-                            lres[1] &= lp[i][1];
-                            lres[2] &= lp[i][2];
-                            lres[3] &= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
+                        memcpy(&res[0], sp, slen);
                     }
-                }
-                else if (op == BITOP_OR)
-                {
-                    while (minlen >= sizeof(unsigned long) * 4)
+                    if (op == BIT_OP_NOT)
                     {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] |= lp[i][0];
-                            lres[1] |= lp[i][1];
-                            lres[2] |= lp[i][2];
-                            lres[3] |= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
+                        bit_operate(BIT_OP_NOT, &res[0], NULL, maxlen);
                     }
+                    continue;
                 }
-                else if (op == BITOP_XOR)
+                if (slen > 0)
                 {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        for (i = 1; i < numkeys; i++)
-                        {
-                            lres[0] ^= lp[i][0];
-                            lres[1] ^= lp[i][1];
-                            lres[2] ^= lp[i][2];
-                            lres[3] ^= lp[i][3];
-                            lp[i] += 4;
-                        }
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
+                    bit_operate(op, &res[0], sp, slen);
                 }
-                else if (op == BITOP_NOT)
+                if (op == BIT_OP_AND && slen < maxlen)
                 {
-                    while (minlen >= sizeof(unsigned long) * 4)
-                    {
-                        lres[0] = ~lres[0];
-                        lres[1] = ~lres[1];
-                        lres[2] = ~lres[2];
-                        lres[3] = ~lres[3];
-                        lres += 4;
-                        j += sizeof(unsigned long) * 4;
-                        minlen -= sizeof(unsigned long) * 4;
-                    }
-                }
-            }
-
-            /* j is set to the next byte to process by the previous loop. */
-            for (; j < maxlen; j++)
-            {
-                Data& first = vals[destkey_count].GetStringValue();
-                output = (first.StringLength() <= j) ? 0 : first.CStr()[j];
-                if (op == BITOP_NOT)
-                    output = ~output;
-                for (i = 1; i < numkeys; i++)
-                {
-                    byte = (vals[i + destkey_count].GetStringValue().StringLength() <= j) ? 0 : vals[destkey_count + 1].GetStringValue().CStr()[j];
-                    switch (op)
-                    {
-                        case BITOP_AND:
-                            output &= byte;
-                            break;
-                        case BITOP_OR:
-                            output |= byte;
-                            break;
-                        case BITOP_XOR:
-                            output ^= byte;
-                            break;
-                    }
+                    memset(&res[slen], 0, maxlen - slen);
                 }
-                res[j] = output;
             }
         }
 
         /* Store the computed value into the target key */
         int err = 0;
-        if (maxlen)
+        if (maxlen && cmd.GetType() != REDIS_CMD_BITOP)
         {
-            if (cmd.GetType() == REDIS_CMD_BITOP)
-            {
-                vals[0].SetType(KEY_STRING);
-                vals[0].GetStringValue().SetString(res, false);
-                err = SetKeyValue(ctx, keys[0], vals[0]);
-            }
-            else
-            {
-                maxlen = popcount(res.c_str(), res.size());
-            }
+            maxlen = bit_popcount(res.data(), res.size());
         }
         else
         {
-            if (vals[0].GetType() > 0)
             {
-                err = RemoveKey(ctx, keys[0]);
+                WriteBatchGuard batch(ctx, m_engine);
+                if (vals[0].IsStringSegmented())
+                {
+                    err = StringSegmentsClear(ctx, keys[0], vals[0]);
+                }
+                if (0 == err && maxlen)
+                {
+                    vals[0].SetType(KEY_STRING);
+                    vals[0].GetStringValue().SetString(res, false);
+                    err = StringSegmentsConvert(ctx, keys[0], vals[0], res.size());
+                    if (0 == err && !vals[0].IsStringSegmented())
+                    {
+                        err = SetKeyValue(ctx, keys[0], vals[0]);
+                    }
+                }
+                else if (0 == err && vals[0].GetType() > 0)
+                {
+                    err = RemoveKey(ctx, keys[0]);
+                }
+                if (0 != err)
+                {
+                    batch.MarkFailed(err);
+                }
+            }
+            if (0 == err)
+            {
+                err = ctx.transc_err;
             }
         }
         if (0 != err)
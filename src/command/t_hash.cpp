@@ -104,6 +104,23 @@ OP_NAMESPACE_BEGIN
                 {
                     return 0;
                 }
+                if (meta.GetType() == 0 || meta.IsCompact())
+                {
+                    int err = HSetCompact(ctx, cmd, key, meta, NULL);
+                    if (0 != err)
+                    {
+                        reply.SetErrCode(err);
+                    }
+                    else
+                    {
+                        reply.SetStatusCode(STATUS_OK);
+                    }
+                    return 0;
+                }
+            }
+            else
+            {
+                CompactExpand(ctx, key);
             }
             meta.SetType(KEY_HASH);
             meta.SetObjectLen(-1);
@@ -131,6 +148,55 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    /*
+     * set fields of a new or compact hash, 'inserted' tells whether the first field is new.
+     */
+    int Ardb::HSetCompact(Context& ctx, RedisCommandFrame& cmd, const KeyObject& key, ValueObject& meta,
+            bool* inserted)
+    {
+        DataArray elements;
+        if (!meta.GetCompactElements(elements))
+        {
+            return ERR_CORRUPTED_VALUE;
+        }
+        bool nx = (cmd.GetType() == REDIS_CMD_HSETNX || cmd.GetType() == REDIS_CMD_HSETNX2);
+        bool changed = false;
+        for (size_t i = 1; i + 1 < cmd.GetArguments().size(); i += 2)
+        {
+            Data field, value;
+            field.SetString(cmd.GetArguments()[i], true);
+            value.SetString(cmd.GetArguments()[i + 1], true);
+            bool found = false;
+            size_t pos = CompactLocate(KEY_HASH, elements, field, found);
+            if (NULL != inserted && i == 1)
+            {
+                *inserted = !found;
+            }
+            if (found)
+            {
+                if (nx || elements[pos + 1] == value)
+                {
+                    continue;
+                }
+                elements[pos + 1] = value;
+            }
+            else
+            {
+                elements.insert(elements.begin() + pos, value);
+                elements.insert(elements.begin() + pos, field);
+            }
+            changed = true;
+        }
+        if (!changed)
+        {
+            return 0;
+        }
+        meta.SetType(KEY_HASH);
+        WriteBatchGuard batch(ctx, m_engine);
+        CompactSave(ctx, key, meta, elements);
+        return ctx.transc_err;
+    }
+
     /*
      *  hset2 would overwrite META key and write fields, which may overwrite exist key with other type(string/list/set/zset)
      */
@@ -149,6 +215,7 @@ OP_NAMESPACE_BEGIN
         int err = 0;
         if (!ctx.flags.redis_compatible)
         {
+            CompactExpand(ctx, key);
             {
                 WriteBatchGuard batch(ctx, m_engine);
                 for (size_t i = 1; i < cmd.GetArguments().size(); i += 2)
@@ -202,6 +269,24 @@ OP_NAMESPACE_BEGIN
             reply.SetErrCode(errs[0]);
             return 0;
         }
+        if (!CheckMeta(ctx, keys[0], KEY_HASH, vals[0], false))
+        {
+            return 0;
+        }
+        if (vals[0].GetType() == 0 || vals[0].IsCompact())
+        {
+            bool inserted = false;
+            err = HSetCompact(ctx, cmd, keys[0], vals[0], &inserted);
+            if (0 != err)
+            {
+                reply.SetErrCode(err);
+            }
+            else
+            {
+                reply.SetInteger(inserted ? 1 : 0);
+            }
+            return 0;
+        }
 
         Data meta_size;
         meta_size.SetInt64(1);
@@ -259,51 +344,58 @@ OP_NAMESPACE_BEGIN
         const std::string& keystr = cmd.GetArguments()[0];
         KeyObject key(ctx.ns, KEY_META, keystr);
         Iterator* iter = m_engine->Find(ctx, key);
-
-        bool checked_meta = false;
-        while (iter->Valid())
+        if (!iter->Valid() || iter->Key().GetType() != KEY_META || iter->Key().GetKey() != key.GetKey())
         {
-            KeyObject& field = iter->Key();
-            if (!checked_meta)
+            DELETE(iter);
+            return 0;
+        }
+        ValueObject& meta = iter->Value();
+        if (!CheckMeta(ctx, key, KEY_HASH, meta) || meta.GetType() == 0)
+        {
+            DELETE(iter);
+            return 0;
+        }
+        bool with_fields = cmd.GetType() == REDIS_CMD_HKEYS || cmd.GetType() == REDIS_CMD_HGETALL;
+        bool with_values = cmd.GetType() == REDIS_CMD_HVALS || cmd.GetType() == REDIS_CMD_HGETALL;
+        int64 per_field = with_fields && with_values ? 2 : 1;
+        RedisReplyWriter writer(reply, ctx.reply_buffer);
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            meta.GetCompactElements(elements);
+            DELETE(iter);
+            writer.BeginArray((int64) (elements.size() / 2) * per_field);
+            for (size_t i = 0; i + 1 < elements.size(); i += 2)
             {
-                if (field.GetType() == KEY_META && field.GetKey() == key.GetKey())
+                if (with_fields)
                 {
-                    ValueObject& meta = iter->Value();
-                    if (!CheckMeta(ctx, key, KEY_HASH, meta))
-                    {
-                    	DELETE(iter);
-                        return 0;
-                    }
-                    if (meta.GetType() == 0)
-                    {
-                    	DELETE(iter);
-                        return 0;
-                    }
-                    checked_meta = true;
-                    iter->Next();
-                    continue;
+                    writer.AddString(elements[i]);
                 }
-                else
+                if (with_values)
                 {
-                    break;
+                    writer.AddString(elements[i + 1]);
                 }
             }
+            return 0;
+        }
+        writer.BeginArray(meta.GetObjectLen() >= 0 ? meta.GetObjectLen() * per_field : -1);
+        iter->Next();
+        while (iter->Valid())
+        {
+            KeyObject& field = iter->Key();
             if (field.GetType() != KEY_HASH_FIELD || field.GetNameSpace() != key.GetNameSpace()
                     || field.GetKey() != key.GetKey())
             {
                 break;
             }
 
-            if (cmd.GetType() == REDIS_CMD_HKEYS || cmd.GetType() == REDIS_CMD_HGETALL)
+            if (with_fields)
             {
-                RedisReply& r = reply.AddMember();
-                r.SetString(field.GetHashField());
+                writer.AddString(field.GetHashField());
             }
-            if (cmd.GetType() == REDIS_CMD_HVALS || cmd.GetType() == REDIS_CMD_HGETALL)
+            if (with_values)
             {
-                ValueObject& fv = iter->Value();
-                RedisReply& r = reply.AddMember();
-                r.SetString(fv.GetHashValue());
+                writer.AddString(iter->Value().GetHashValue());
             }
             iter->Next();
         }
@@ -360,6 +452,25 @@ OP_NAMESPACE_BEGIN
                 return 0;
             }
         }
+        if (vals[0].IsCompact())
+        {
+            DataArray elements;
+            vals[0].GetCompactElements(elements);
+            for (size_t i = 1; i < keys.size(); i++)
+            {
+                bool found = false;
+                size_t pos = CompactLocate(KEY_HASH, elements, keys[i].GetHashField(), found);
+                if (found)
+                {
+                    reply.MemberAt(i - 1).SetString(elements[pos + 1]);
+                }
+                else
+                {
+                    reply.MemberAt(i - 1).Clear();
+                }
+            }
+            return 0;
+        }
 
         for (size_t i = 1; i < errs.size(); i++)
         {
@@ -462,6 +573,7 @@ OP_NAMESPACE_BEGIN
         int err = 0;
         if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge)
         {
+            CompactExpand(ctx, meta_key);
             Data arg;
             if (inc_float)
             {
@@ -509,6 +621,24 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
 
+        DataArray compact_elements;
+        size_t compact_pos = 0;
+        bool compact = vals[0].GetType() == 0 || vals[0].IsCompact();
+        if (compact)
+        {
+            bool found = false;
+            if (!vals[0].GetCompactElements(compact_elements))
+            {
+                reply.SetErrCode(ERR_CORRUPTED_VALUE);
+                return 0;
+            }
+            compact_pos = CompactLocate(KEY_HASH, compact_elements, field_key.GetHashField(), found);
+            if (found)
+            {
+                vals[1].SetType(KEY_HASH_FIELD);
+                vals[1].SetHashValue(compact_elements[compact_pos + 1]);
+            }
+        }
         if (vals[0].GetType() == 0)
         {
             vals[0].SetType(KEY_HASH);
@@ -566,11 +696,27 @@ OP_NAMESPACE_BEGIN
         if (0 == err)
         {
             WriteBatchGuard batch(ctx, m_engine);
-            if (meta_change)
+            if (compact)
+            {
+                if (compact_pos < compact_elements.size() && compact_elements[compact_pos] == field_key.GetHashField())
+                {
+                    compact_elements[compact_pos + 1] = vals[1].GetHashValue();
+                }
+                else
+                {
+                    compact_elements.insert(compact_elements.begin() + compact_pos, vals[1].GetHashValue());
+                    compact_elements.insert(compact_elements.begin() + compact_pos, field_key.GetHashField());
+                }
+                CompactSave(ctx, keys[0], vals[0], compact_elements);
+            }
+            else
             {
-                SetKeyValue(ctx, keys[0], vals[0]);
+                if (meta_change)
+                {
+                    SetKeyValue(ctx, keys[0], vals[0]);
+                }
+                SetKeyValue(ctx, keys[1], vals[1]);
             }
-            SetKeyValue(ctx, keys[1], vals[1]);
         }
         if (0 == err)
         {
@@ -599,15 +745,38 @@ OP_NAMESPACE_BEGIN
     {
         RedisReply& reply = ctx.GetReply();
         const std::string& keystr = cmd.GetArguments()[0];
-        KeyObject meta_key(ctx.ns, KEY_META, keystr);
         KeyObject key(ctx.ns, KEY_HASH_FIELD, keystr);
         key.SetHashField(cmd.GetArguments()[1]);
-        KeyObjectArray keys;
-        keys.push_back(meta_key);
-        keys.push_back(key);
-        ValueObjectArray vals;
-        ErrCodeArray errs;
-        m_engine->MultiGet(ctx, keys, vals, errs);
+        ValueObjectArray fetched_vals;
+        ErrCodeArray fetched_errs;
+        const int* errs = NULL;
+        ValueObject* vals = GetBatchedValues(ctx, 2, errs);
+        if (NULL == vals)
+        {
+            KeyObject meta_key(ctx.ns, KEY_META, keystr);
+            KeyObjectArray keys;
+            keys.push_back(meta_key);
+            keys.push_back(key);
+            m_engine->MultiGet(ctx, keys, fetched_vals, fetched_errs);
+            vals = &fetched_vals[0];
+            errs = &fetched_errs[0];
+        }
+        if (0 == errs[0] && vals[0].GetType() == KEY_HASH && vals[0].IsCompact())
+        {
+            DataArray elements;
+            bool found = false;
+            vals[0].GetCompactElements(elements);
+            size_t pos = CompactLocate(KEY_HASH, elements, key.GetHashField(), found);
+            if (found)
+            {
+                reply.SetString(elements[pos + 1]);
+            }
+            else
+            {
+                reply.Clear();
+            }
+            return 0;
+        }
         if (errs[0] != 0 || errs[1] != 0)
         {
             int err = errs[0] != 0 ? errs[0] : errs[1];
@@ -634,7 +803,8 @@ OP_NAMESPACE_BEGIN
 
     int Ardb::HExists(Context& ctx, RedisCommandFrame& cmd)
     {
-        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_HASH))
+        ValueObject meta;
+        if (!CheckMeta(ctx, cmd.GetArguments()[0], KEY_HASH, meta))
         {
             return 0;
         }
@@ -642,6 +812,15 @@ OP_NAMESPACE_BEGIN
         const std::string& keystr = cmd.GetArguments()[0];
         KeyObject key(ctx.ns, KEY_HASH_FIELD, keystr);
         key.SetHashField(cmd.GetArguments()[1]);
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            bool found = false;
+            meta.GetCompactElements(elements);
+            CompactLocate(KEY_HASH, elements, key.GetHashField(), found);
+            reply.SetInteger(found ? 1 : 0);
+            return 0;
+        }
         ValueObject tmp;
         bool existed = m_engine->Exists(ctx, key,tmp);
         reply.SetInteger(existed ? 1 : 0);
@@ -657,6 +836,7 @@ OP_NAMESPACE_BEGIN
         int err = 0;
         if (!ctx.flags.redis_compatible)
         {
+            CompactExpand(ctx, key);
             {
                 WriteBatchGuard batch(ctx, m_engine);
                 meta.SetType(KEY_HASH);
@@ -698,6 +878,33 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         int64_t del_num = 0;
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            if (!meta.GetCompactElements(elements))
+            {
+                reply.SetErrCode(ERR_CORRUPTED_VALUE);
+                return 0;
+            }
+            for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+            {
+                Data field;
+                field.SetString(cmd.GetArguments()[i], true);
+                bool found = false;
+                size_t pos = CompactLocate(KEY_HASH, elements, field, found);
+                if (found)
+                {
+                    elements.erase(elements.begin() + pos, elements.begin() + pos + 2);
+                    del_num++;
+                }
+            }
+            if (del_num > 0)
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                CompactSave(ctx, key, meta, elements);
+            }
+        }
+        else
         {
             WriteBatchGuard batch(ctx, m_engine);
             for (size_t i = 1; i < cmd.GetArguments().size(); i++)
@@ -33,6 +33,265 @@
 
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Chunked list stores elements in 'KEY_LIST_CHUNK' values with consecutive chunk ids in list order. Only the
+     * first and the last chunk may be partially filled, so the meta keeps the chunk size, the first chunk id and its
+     * size: an element is located by arithmetic, and a push/pop only rewrites one end chunk besides the meta.
+     */
+
+    /*
+     * lists already chunked keep the default chunk size after 'list-chunk-max-size' is disabled
+     */
+    static int64_t list_chunk_max_size(int64_t conf_size)
+    {
+        return conf_size > 0 ? conf_size : 128;
+    }
+
+    static DataArray& list_chunk_create(std::map<int64_t, ValueObject>& chunks, int64_t id)
+    {
+        ValueObject& chunk = chunks[id];
+        chunk.SetType(KEY_LIST_CHUNK);
+        return chunk.GetListChunkElements();
+    }
+
+    int Ardb::ListChunkLoad(Context& ctx, const KeyObject& key, ListChunkTable& chunks, int64_t id,
+            DataArray*& elements)
+    {
+        ListChunkTable::iterator found = chunks.find(id);
+        if (found != chunks.end())
+        {
+            elements = &(found->second.GetListChunkElements());
+            return 0;
+        }
+        KeyObject chunk_key(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+        chunk_key.SetListChunkId(id);
+        ValueObject& chunk = chunks[id];
+        int err = m_engine->Get(ctx, chunk_key, chunk);
+        if (0 != err)
+        {
+            chunks.erase(id);
+            return err;
+        }
+        elements = &(chunk.GetListChunkElements());
+        return 0;
+    }
+
+    /*
+     * write back a loaded chunk, empty chunk would be removed
+     */
+    int Ardb::ListChunkSave(Context& ctx, const KeyObject& key, ListChunkTable& chunks, int64_t id)
+    {
+        ListChunkTable::iterator found = chunks.find(id);
+        if (found == chunks.end())
+        {
+            return 0;
+        }
+        KeyObject chunk_key(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+        chunk_key.SetListChunkId(id);
+        if (found->second.GetListChunkElements().empty())
+        {
+            return RemoveKey(ctx, chunk_key);
+        }
+        found->second.SetType(KEY_LIST_CHUNK);
+        return SetKeyValue(ctx, chunk_key, found->second);
+    }
+
+    /*
+     * returns the id of chunk which contains the element, and set 'index' to the offset in chunk.
+     */
+    int64_t Ardb::ListChunkLocate(ValueObject& meta, int64_t& index)
+    {
+        MetaObject& list = meta.GetMetaObject();
+        if (index < list.list_head_size)
+        {
+            return list.list_head_chunk;
+        }
+        int64_t rest = index - list.list_head_size;
+        index = rest % list.list_chunk_size;
+        return list.list_head_chunk + 1 + rest / list.list_chunk_size;
+    }
+
+    /*
+     * remove chunks of id range [from, to) which hold 'elements' elements
+     */
+    int Ardb::ListChunkRemove(Context& ctx, const KeyObject& key, int64_t from, int64_t to, int64_t elements)
+    {
+        if (from >= to)
+        {
+            return 0;
+        }
+        if (to - from > 1 && m_engine->GetFeatureSet().support_delete_range
+                && elements >= GetConf().range_delete_min_size)
+        {
+            KeyObject start(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+            start.SetListChunkId(from);
+            KeyObject end(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+            end.SetListChunkId(to);
+            return m_engine->DelRange(ctx, start, end);
+        }
+        for (int64_t id = from; id < to; id++)
+        {
+            KeyObject chunk_key(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+            chunk_key.SetListChunkId(id);
+            RemoveKey(ctx, chunk_key);
+        }
+        return 0;
+    }
+
+    /*
+     * insert an element at 'offset' of chunk 'id', an overflowed chunk passes one element chunk by chunk towards
+     * the nearer list end, until a chunk has room or a new end chunk is created. Touched chunks are appended to
+     * 'modified', the object length and the first chunk of meta are updated.
+     */
+    int Ardb::ListChunkInsert(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks,
+            int64_t id, int64_t offset, const Data& element, std::vector<int64_t>& modified)
+    {
+        MetaObject& list = meta.GetMetaObject();
+        int64_t last = meta.GetObjectLen() - 1;
+        int64_t tail = last >= 0 ? ListChunkLocate(meta, last) : list.list_head_chunk;
+        DataArray* elements = NULL;
+        if (meta.GetObjectLen() == 0)
+        {
+            elements = &list_chunk_create(chunks, id);
+        }
+        else
+        {
+            int err = ListChunkLoad(ctx, key, chunks, id, elements);
+            if (0 != err)
+            {
+                return err;
+            }
+        }
+        elements->insert(elements->begin() + offset, element);
+        modified.push_back(id);
+        bool backward = id - list.list_head_chunk < tail - id
+                || (id - list.list_head_chunk == tail - id && offset * 2 < (int64_t) elements->size());
+        while ((int64_t) elements->size() > list.list_chunk_size)
+        {
+            Data carry;
+            if (backward)
+            {
+                carry = elements->front();
+                elements->erase(elements->begin());
+                if (id == list.list_head_chunk)
+                {
+                    list.list_head_chunk--;
+                    list_chunk_create(chunks, id - 1);
+                }
+                id--;
+            }
+            else
+            {
+                carry = elements->back();
+                elements->pop_back();
+                if (id == tail)
+                {
+                    tail++;
+                    list_chunk_create(chunks, tail);
+                }
+                id++;
+            }
+            int err = ListChunkLoad(ctx, key, chunks, id, elements);
+            if (0 != err)
+            {
+                return err;
+            }
+            elements->insert(backward ? elements->end() : elements->begin(), carry);
+            modified.push_back(id);
+        }
+        meta.SetObjectLen(meta.GetObjectLen() + 1);
+        ListChunkTable::iterator head = chunks.find(list.list_head_chunk);
+        if (head != chunks.end())
+        {
+            list.list_head_size = head->second.GetListChunkElements().size();
+        }
+        return 0;
+    }
+
+    /*
+     * rewrite loaded chunks of id range [from, last] after elements were removed from them, every chunk except the
+     * first and the last of list is filled again. 'last' is the last chunk before the removal, the object length
+     * must be updated before.
+     */
+    int Ardb::ListChunkRepack(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks,
+            int64_t from, int64_t last)
+    {
+        MetaObject& list = meta.GetMetaObject();
+        DataArray rest;
+        for (int64_t id = from; id <= last; id++)
+        {
+            DataArray* elements = NULL;
+            int err = ListChunkLoad(ctx, key, chunks, id, elements);
+            if (0 != err)
+            {
+                return err;
+            }
+            rest.insert(rest.end(), elements->begin(), elements->end());
+        }
+        size_t fill = list.list_chunk_size;
+        if (from == list.list_head_chunk)
+        {
+            size_t head_size = chunks[from].GetListChunkElements().size();
+            fill = std::min(head_size > 0 ? head_size : rest.size(), (size_t) list.list_chunk_size);
+            list.list_head_size = std::min(fill, rest.size());
+        }
+        size_t cursor = 0;
+        for (int64_t id = from; id <= last; id++)
+        {
+            DataArray& elements = chunks[id].GetListChunkElements();
+            size_t n = std::min(fill, rest.size() - cursor);
+            elements.assign(rest.begin() + cursor, rest.begin() + cursor + n);
+            cursor += n;
+            fill = list.list_chunk_size;
+            ListChunkSave(ctx, key, chunks, id);
+        }
+        return 0;
+    }
+
+    /*
+     * convert a list stored as one key per element into chunks, all chunks are kept in 'chunks'.
+     */
+    int Ardb::ListChunkConvert(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks)
+    {
+        MetaObject& list = meta.GetMetaObject();
+        int64_t chunk_size = list_chunk_max_size(GetConf().list_chunk_max_size);
+        int64_t count = 0;
+        KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, key.GetKey());
+        ele_key.SetListIndex(meta.GetMin());
+        WriteBatchGuard batch(ctx, m_engine);
+        Iterator* iter = m_engine->Find(ctx, ele_key);
+        while (NULL != iter && iter->Valid())
+        {
+            KeyObject& field = iter->Key();
+            if (field.GetType() != KEY_LIST_ELEMENT || field.GetNameSpace() != key.GetNameSpace()
+                    || field.GetKey() != key.GetKey())
+            {
+                break;
+            }
+            list_chunk_create(chunks, count / chunk_size).push_back(iter->Value(true).GetListElement());
+            count++;
+            IteratorDel(ctx, key, iter);
+            iter->Next();
+        }
+        DELETE(iter);
+        ListChunkTable::iterator it = chunks.begin();
+        while (it != chunks.end())
+        {
+            ListChunkSave(ctx, key, chunks, it->first);
+            it++;
+        }
+        meta.ClearMinMaxData();
+        list.list_sequential = true;
+        if (count > 0)
+        {
+            list.list_chunk_size = chunk_size;
+            list.list_head_chunk = 0;
+            list.list_head_size = std::min(count, chunk_size);
+            SetKeyValue(ctx, key, meta);
+        }
+        return ctx.transc_err;
+    }
+
     int Ardb::LIndex(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -64,7 +323,26 @@ OP_NAMESPACE_BEGIN
             reply.Clear();
             return 0;
         }
-        if (v.GetMetaObject().list_sequential)
+        if (v.IsListChunked())
+        {
+            int64_t id = ListChunkLocate(v, index);
+            ListChunkTable chunks;
+            DataArray* elements = NULL;
+            err = ListChunkLoad(ctx, k, chunks, id, elements);
+            if (0 != err)
+            {
+                reply.SetErrCode(err);
+            }
+            else if (index < (int64) elements->size())
+            {
+                reply.SetString(elements->at(index));
+            }
+            else
+            {
+                reply.Clear();
+            }
+        }
+        else if (v.GetMetaObject().list_sequential)
         {
             KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
             ele.SetListIndex(v.GetListMinIdx() + index);
@@ -136,7 +414,48 @@ OP_NAMESPACE_BEGIN
         {
             WriteBatchGuard batch(ctx, m_engine);
 
-            if (meta.GetMetaObject().list_sequential)
+            if (meta.IsListChunked())
+            {
+                MetaObject& list = meta.GetMetaObject();
+                int64_t last = meta.GetObjectLen() - 1;
+                int64_t id = is_lpop ? list.list_head_chunk : ListChunkLocate(meta, last);
+                ListChunkTable chunks;
+                DataArray* elements = NULL;
+                err = ListChunkLoad(ctx, key, chunks, id, elements);
+                if (0 == err && elements->empty())
+                {
+                    err = ERR_ENTRY_NOT_EXIST;
+                }
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                if (is_lpop)
+                {
+                    reply.SetString(elements->front());
+                    elements->erase(elements->begin());
+                }
+                else
+                {
+                    reply.SetString(elements->back());
+                    elements->pop_back();
+                }
+                ListChunkSave(ctx, key, chunks, id);
+                if (id == list.list_head_chunk)
+                {
+                    list.list_head_size--;
+                    if (list.list_head_size == 0)
+                    {
+                        /*
+                         * the next chunk is full or the last chunk
+                         */
+                        list.list_head_chunk++;
+                        list.list_head_size = std::min(meta.GetObjectLen() - 1, list.list_chunk_size);
+                    }
+                }
+            }
+            else if (meta.GetMetaObject().list_sequential)
             {
                 KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, keystr);
                 ValueObject ele_value;
@@ -272,6 +591,74 @@ OP_NAMESPACE_BEGIN
         reply.SetInteger(-1); //default response
         Data match;
         match.SetString(cmd.GetArguments()[2], true);
+        ListChunkTable chunks;
+        if (!meta.IsListChunked() && GetConf().list_chunk_max_size > 0)
+        {
+            if (0 != ListChunkConvert(ctx, key, meta, chunks))
+            {
+                reply.SetErrCode(ctx.transc_err);
+                return 0;
+            }
+        }
+        if (meta.IsListChunked())
+        {
+            int64_t last = meta.GetObjectLen() - 1;
+            int64_t tail = ListChunkLocate(meta, last);
+            DataArray* elements = NULL;
+            int64_t id = 0;
+            size_t idx = 0;
+            bool found = false;
+            for (id = meta.GetMetaObject().list_head_chunk; id <= tail && !found; id++)
+            {
+                int err = ListChunkLoad(ctx, key, chunks, id, elements);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                for (idx = 0; idx < elements->size(); idx++)
+                {
+                    if (0 == elements->at(idx).Compare(match))
+                    {
+                        found = true;
+                        break;
+                    }
+                }
+            }
+            if (!found)
+            {
+                return 0;
+            }
+            id--;
+            Data insert_ele;
+            insert_ele.SetString(cmd.GetArguments()[3], true);
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                std::vector<int64_t> modified;
+                int err = ListChunkInsert(ctx, key, meta, chunks, id, head ? idx : idx + 1, insert_ele, modified);
+                if (0 != err)
+                {
+                    batch.MarkFailed(err);
+                }
+                else
+                {
+                    for (size_t i = 0; i < modified.size(); i++)
+                    {
+                        ListChunkSave(ctx, key, chunks, modified[i]);
+                    }
+                    SetKeyValue(ctx, key, meta);
+                }
+            }
+            if (0 != ctx.transc_err)
+            {
+                reply.SetErrCode(ctx.transc_err);
+            }
+            else
+            {
+                reply.SetInteger(meta.GetObjectLen());
+            }
+            return 0;
+        }
         KeyObject elekey(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
         elekey.SetListIndex(meta.GetMin());
         Iterator* iter = m_engine->Find(ctx, elekey);
@@ -372,6 +759,7 @@ OP_NAMESPACE_BEGIN
                 reply.SetInteger(0);
                 return 0;
             }
+            bool chunked = meta.IsListChunked();
             if (meta.GetType() == 0)
             {
                 meta.SetType(KEY_LIST);
@@ -379,46 +767,86 @@ OP_NAMESPACE_BEGIN
                 meta.SetListMaxIdx(0);
                 meta.SetListMinIdx(0);
                 meta.GetMetaObject().list_sequential = true;
+                chunked = GetConf().list_chunk_max_size > 0;
             }
             {
                 WriteBatchGuard batch(ctx, m_engine);
-                for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+                if (chunked)
                 {
-                    KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, keystr);
-                    ValueObject ele_value;
-                    ele_value.SetType(KEY_LIST_ELEMENT);
-                    ele_value.SetListElement(cmd.GetArguments()[i]);
-                    int64 idx = 0;
-                    if (meta.GetObjectLen() > 0)
+                    MetaObject& list = meta.GetMetaObject();
+                    if (!meta.IsListChunked())
                     {
-                        if (left_push)
+                        list.list_chunk_size = list_chunk_max_size(GetConf().list_chunk_max_size);
+                        list.list_head_chunk = 0;
+                        list.list_head_size = 0;
+                    }
+                    ListChunkTable chunks;
+                    std::vector<int64_t> modified;
+                    for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+                    {
+                        int64_t id = list.list_head_chunk, offset = 0;
+                        if (!left_push && meta.GetObjectLen() > 0)
                         {
-                            if (meta.GetMin().IsInteger())
-                            {
-                                idx = meta.GetListMinIdx() - 1;
-                            }
-                            else
-                            {
-                                idx = (int64_t) (meta.GetMin().GetFloat64()) - 1;
-                            }
-                            meta.SetListMinIdx(idx);
+                            offset = meta.GetObjectLen() - 1;
+                            id = ListChunkLocate(meta, offset);
+                            offset++;
                         }
-                        else
+                        Data ele;
+                        ele.SetString(cmd.GetArguments()[i], true);
+                        int push_err = ListChunkInsert(ctx, key, meta, chunks, id, offset, ele, modified);
+                        if (0 != push_err)
+                        {
+                            batch.MarkFailed(push_err);
+                            break;
+                        }
+                    }
+                    ListChunkTable::iterator it = chunks.begin();
+                    while (it != chunks.end())
+                    {
+                        ListChunkSave(ctx, key, chunks, it->first);
+                        it++;
+                    }
+                }
+                else
+                {
+                    for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+                    {
+                        KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, keystr);
+                        ValueObject ele_value;
+                        ele_value.SetType(KEY_LIST_ELEMENT);
+                        ele_value.SetListElement(cmd.GetArguments()[i]);
+                        int64 idx = 0;
+                        if (meta.GetObjectLen() > 0)
                         {
-                            if (meta.GetMax().IsInteger())
+                            if (left_push)
                             {
-                                idx = meta.GetListMaxIdx() + 1;
+                                if (meta.GetMin().IsInteger())
+                                {
+                                    idx = meta.GetListMinIdx() - 1;
+                                }
+                                else
+                                {
+                                    idx = (int64_t) (meta.GetMin().GetFloat64()) - 1;
+                                }
+                                meta.SetListMinIdx(idx);
                             }
                             else
                             {
-                                idx = (int64_t) (meta.GetMax().GetFloat64()) + 1;
+                                if (meta.GetMax().IsInteger())
+                                {
+                                    idx = meta.GetListMaxIdx() + 1;
+                                }
+                                else
+                                {
+                                    idx = (int64_t) (meta.GetMax().GetFloat64()) + 1;
+                                }
+                                meta.SetListMaxIdx(idx);
                             }
-                            meta.SetListMaxIdx(idx);
                         }
+                        ele.SetListIndex(idx);
+                        SetKeyValue(ctx, ele, ele_value);
+                        meta.SetObjectLen(meta.GetObjectLen() + 1);
                     }
-                    ele.SetListIndex(idx);
-                    SetKeyValue(ctx, ele, ele_value);
-                    meta.SetObjectLen(meta.GetObjectLen() + 1);
                 }
                 //meta.SetTTL(0); //clear ttl setting
                 SetKeyValue(ctx, key, meta);
@@ -474,8 +902,36 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         if (end >= meta.GetObjectLen()) end = meta.GetObjectLen() - 1;
-        //int64_t rangelen = (end - start) + 1;
-        reply.ReserveMember(0);
+        RedisReplyWriter writer(reply, ctx.reply_buffer);
+        writer.BeginArray(end - start + 1);
+        if (meta.IsListChunked())
+        {
+            int64_t offset = start, end_offset = end;
+            int64_t first = ListChunkLocate(meta, offset);
+            int64_t last = ListChunkLocate(meta, end_offset);
+            KeyObjectArray chunk_keys;
+            for (int64_t id = first; id <= last; id++)
+            {
+                KeyObject chunk_key(ctx.ns, KEY_LIST_CHUNK, key.GetKey());
+                chunk_key.SetListChunkId(id);
+                chunk_keys.push_back(chunk_key);
+            }
+            ValueObjectArray chunks;
+            ErrCodeArray errs;
+            m_engine->MultiGet(ctx, chunk_keys, chunks, errs);
+            int64_t remaining = end - start + 1;
+            for (size_t i = 0; i < chunks.size() && remaining > 0; i++)
+            {
+                DataArray& elements = chunks[i].GetListChunkElements();
+                for (size_t j = offset; j < elements.size() && remaining > 0; j++)
+                {
+                    writer.AddString(elements[j]);
+                    remaining--;
+                }
+                offset = 0;
+            }
+            return 0;
+        }
 
         KeyObject ele_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
         int64 cursor = 0;
@@ -501,8 +957,7 @@ OP_NAMESPACE_BEGIN
             }
             if (cursor >= start)
             {
-                RedisReply& r = reply.AddMember();
-                r.SetString(iter->Value().GetListElement());
+                writer.AddString(iter->Value().GetListElement());
             }
             if (cursor == end)
             {
@@ -536,6 +991,98 @@ OP_NAMESPACE_BEGIN
             reply.SetInteger(0);
             return 0;
         }
+        ListChunkTable chunks;
+        if (!meta.IsListChunked() && GetConf().list_chunk_max_size > 0)
+        {
+            if (0 != ListChunkConvert(ctx, key, meta, chunks))
+            {
+                reply.SetErrCode(ctx.transc_err);
+                return 0;
+            }
+        }
+        if (meta.IsListChunked())
+        {
+            Data rem_data;
+            rem_data.SetString(cmd.GetArguments()[2], true);
+            int64_t head = meta.GetMetaObject().list_head_chunk;
+            int64_t last = meta.GetObjectLen() - 1;
+            int64_t tail = ListChunkLocate(meta, last);
+            int64 limit = count == 0 ? meta.GetObjectLen() : std::abs(count);
+            int64 removed = 0;
+            int64_t first_modified = tail + 1;
+            for (int64_t n = 0; n <= tail - head && removed < limit; n++)
+            {
+                int64_t id = count < 0 ? tail - n : head + n;
+                DataArray* elements = NULL;
+                int err = ListChunkLoad(ctx, key, chunks, id, elements);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+                size_t chunk_size = elements->size();
+                if (count < 0)
+                {
+                    for (size_t i = elements->size(); i > 0 && removed < limit; i--)
+                    {
+                        if (elements->at(i - 1) == rem_data)
+                        {
+                            elements->erase(elements->begin() + i - 1);
+                            removed++;
+                        }
+                    }
+                }
+                else
+                {
+                    for (size_t i = 0; i < elements->size() && removed < limit;)
+                    {
+                        if (elements->at(i) == rem_data)
+                        {
+                            elements->erase(elements->begin() + i);
+                            removed++;
+                        }
+                        else
+                        {
+                            i++;
+                        }
+                    }
+                }
+                if (elements->size() != chunk_size && id < first_modified)
+                {
+                    first_modified = id;
+                }
+            }
+            if (removed > 0)
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                meta.SetObjectLen(meta.GetObjectLen() - removed);
+                /*
+                 * chunks after the first modified one are filled again
+                 */
+                int err = ListChunkRepack(ctx, key, meta, chunks, first_modified, tail);
+                if (0 != err)
+                {
+                    batch.MarkFailed(err);
+                }
+                else if (meta.GetObjectLen() == 0)
+                {
+                    RemoveKey(ctx, key);
+                }
+                else
+                {
+                    SetKeyValue(ctx, key, meta);
+                }
+            }
+            if (ctx.transc_err != 0)
+            {
+                reply.SetErrCode(ctx.transc_err);
+            }
+            else
+            {
+                reply.SetInteger(removed);
+            }
+            return 0;
+        }
         Iterator* iter = NULL;
         // bookkeeping element key min/max index
         KeyObject min_key(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
@@ -674,7 +1221,39 @@ OP_NAMESPACE_BEGIN
             reply.SetErrCode(ERR_OUTOFRANGE);
             return 0;
         }
-        if (v.GetMetaObject().list_sequential)
+        ListChunkTable chunks;
+        if (!v.IsListChunked() && !v.GetMetaObject().list_sequential && GetConf().list_chunk_max_size > 0)
+        {
+            if (0 != ListChunkConvert(ctx, k, v, chunks))
+            {
+                reply.SetErrCode(ctx.transc_err);
+                return 0;
+            }
+        }
+        if (v.IsListChunked())
+        {
+            int64_t id = ListChunkLocate(v, index);
+            DataArray* elements = NULL;
+            err = ListChunkLoad(ctx, k, chunks, id, elements);
+            if (0 == err && index >= (int64) elements->size())
+            {
+                err = ERR_OUTOFRANGE;
+            }
+            if (0 == err)
+            {
+                elements->at(index).SetString(cmd.GetArguments()[2], true);
+                err = ListChunkSave(ctx, k, chunks, id);
+            }
+            if (0 == err)
+            {
+                reply.SetStatusCode(STATUS_OK);
+            }
+            else
+            {
+                reply.SetErrCode(err);
+            }
+        }
+        else if (v.GetMetaObject().list_sequential)
         {
             KeyObject ele(ctx.ns, KEY_LIST_ELEMENT, cmd.GetArguments()[0]);
             ele.SetListIndex((int64_t) (v.GetListMinIdx() + index));
@@ -773,9 +1352,57 @@ OP_NAMESPACE_BEGIN
             ltrim = start;
             rtrim = end;
         }
+        ListChunkTable chunks;
+        if (!meta.IsListChunked() && !meta.GetMetaObject().list_sequential && GetConf().list_chunk_max_size > 0)
+        {
+            if (0 != ListChunkConvert(ctx, key, meta, chunks))
+            {
+                reply.SetErrCode(ctx.transc_err);
+                return 0;
+            }
+        }
         int64_t trimed_count = 0;
         WriteBatchGuard batch(ctx, m_engine);
-        if (meta.GetMetaObject().list_sequential)
+        if (meta.IsListChunked())
+        {
+            MetaObject& list = meta.GetMetaObject();
+            int64_t head = list.list_head_chunk;
+            int64_t last = llen - 1;
+            int64_t tail = ListChunkLocate(meta, last);
+            if (ltrim >= llen)
+            {
+                ListChunkRemove(ctx, key, head, tail + 1, llen);
+                trimed_count = llen;
+            }
+            else
+            {
+                int64_t first_offset = ltrim, last_offset = rtrim;
+                int64_t first = ListChunkLocate(meta, first_offset);
+                int64_t last_id = ListChunkLocate(meta, last_offset);
+                int64_t first_size = first == head ? list.list_head_size : list.list_chunk_size;
+                trimed_count = ltrim + llen - 1 - rtrim;
+                /*
+                 * remove whole chunks first, then trim the boundary chunks
+                 */
+                ListChunkRemove(ctx, key, head, first, ltrim);
+                ListChunkRemove(ctx, key, last_id + 1, tail + 1, llen - 1 - rtrim);
+                DataArray* elements = NULL;
+                if (rtrim < llen - 1 && 0 == ListChunkLoad(ctx, key, chunks, last_id, elements)
+                        && (int64_t) elements->size() > last_offset + 1)
+                {
+                    elements->resize(last_offset + 1);
+                    ListChunkSave(ctx, key, chunks, last_id);
+                }
+                if (first_offset > 0 && 0 == ListChunkLoad(ctx, key, chunks, first, elements))
+                {
+                    elements->erase(elements->begin(), elements->begin() + first_offset);
+                    ListChunkSave(ctx, key, chunks, first);
+                }
+                list.list_head_chunk = first;
+                list.list_head_size = first == last_id ? rtrim - ltrim + 1 : first_size - first_offset;
+            }
+        }
+        else if (meta.GetMetaObject().list_sequential)
         {
             for (int64_t i = 0; i < ltrim; i++)
             {
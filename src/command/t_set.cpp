@@ -47,9 +47,51 @@ OP_NAMESPACE_BEGIN
             {
                 return 0;
             }
+            if (meta.GetType() == 0 || meta.IsCompact())
+            {
+                DataArray elements;
+                if (!meta.GetCompactElements(elements))
+                {
+                    reply.SetErrCode(ERR_CORRUPTED_VALUE);
+                    return 0;
+                }
+                int64_t added_count = 0;
+                for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+                {
+                    Data member;
+                    member.SetString(cmd.GetArguments()[i], true);
+                    bool found = false;
+                    size_t pos = CompactLocate(KEY_SET, elements, member, found);
+                    if (!found)
+                    {
+                        elements.insert(elements.begin() + pos, member);
+                        added_count++;
+                    }
+                }
+                int err = 0;
+                if (added_count > 0)
+                {
+                    meta.SetType(KEY_SET);
+                    {
+                        WriteBatchGuard batch(ctx, m_engine);
+                        CompactSave(ctx, key, meta, elements);
+                    }
+                    err = ctx.transc_err;
+                }
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                }
+                else
+                {
+                    reply.SetInteger(added_count);
+                }
+                return 0;
+            }
         }
         else
         {
+            CompactExpand(ctx, key);
             meta.SetType(KEY_SET);
             meta.SetObjectLen(-1);
         }
@@ -129,8 +171,11 @@ OP_NAMESPACE_BEGIN
         KeyObject member(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
         member.SetSetMember(cmd.GetArguments()[1]);
         RedisReply& reply = ctx.GetReply();
-        ValueObject tmp;
-        reply.SetInteger(m_engine->Exists(ctx, member, tmp) ? 1 : 0);
+        KeyObjectArray members(1, member);
+        ValueObjectArray vals;
+        ErrCodeArray errs;
+        MultiGetElements(ctx, members, vals, errs);
+        reply.SetInteger(0 == errs[0] ? 1 : 0);
         return 0;
     }
 
@@ -142,50 +187,71 @@ OP_NAMESPACE_BEGIN
         KeyObject key(ctx.ns, KEY_META, keystr);
         KeyLockGuard guard(ctx, key);
         Iterator* iter = m_engine->Find(ctx, key);
-        bool checked_meta = false;
-        bool need_set_minmax = false;
-        ValueObject new_meta;
-        while (NULL != iter && iter->Valid())
+        if (NULL == iter || !iter->Valid() || iter->Key().GetType() != KEY_META
+                || iter->Key().GetKey() != key.GetKey())
         {
-            KeyObject& field = iter->Key();
-            if (!checked_meta)
+            DELETE(iter);
+            return 0;
+        }
+        ValueObject& meta = iter->Value();
+        if (meta.GetType() != KEY_SET)
+        {
+            reply.SetErrCode(ERR_WRONG_TYPE);
+            DELETE(iter);
+            return 0;
+        }
+        RedisReplyWriter writer(reply, ctx.reply_buffer);
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            meta.GetCompactElements(elements);
+            DELETE(iter);
+            writer.BeginArray(elements.size());
+            for (size_t i = 0; i < elements.size(); i++)
             {
-                if (field.GetType() == KEY_META && field.GetKey() == key.GetKey())
-                {
-                    ValueObject& meta = iter->Value();
-                    if (meta.GetType() != KEY_SET)
-                    {
-                        reply.SetErrCode(ERR_WRONG_TYPE);
-                        break;
-                    }
-                    checked_meta = true;
-                    if (meta.GetMin().IsNil() && meta.GetMax().IsNil())
-                    {
-                        need_set_minmax = true;
-                        new_meta = meta;
-                    }
-                    iter->Next();
-                    continue;
-                }
-                else
-                {
-                    break;
-                }
+                writer.AddString(elements[i]);
             }
+            return 0;
+        }
+        bool need_set_minmax = meta.GetMin().IsNil() && meta.GetMax().IsNil();
+        ValueObject new_meta;
+        if (need_set_minmax)
+        {
+            new_meta = meta;
+        }
+        writer.BeginArray(meta.GetObjectLen() >= 0 ? meta.GetObjectLen() : -1);
+        int64 count = 0;
+        std::string first, last;
+        iter->Next();
+        while (iter->Valid())
+        {
+            KeyObject& field = iter->Key();
             if (field.GetType() != KEY_SET_MEMBER || field.GetNameSpace() != key.GetNameSpace() || field.GetKey() != key.GetKey())
             {
                 break;
             }
-            RedisReply& r = reply.AddMember();
-            r.SetString(field.GetSetMember());
+            writer.AddString(field.GetSetMember());
+            if (need_set_minmax)
+            {
+                if (0 == count)
+                {
+                    field.GetSetMember().ToString(first);
+                }
+                field.GetSetMember().ToString(last);
+            }
+            count++;
             iter->Next();
         }
         DELETE(iter);
-        if (need_set_minmax && reply.MemberSize() > 0)
+        writer.EndArray();
+        /*
+         * min/max are only filled in while holding the key exclusively
+         */
+        if (need_set_minmax && count > 0 && !ctx.keyslocked_shared)
         {
-            new_meta.SetObjectLen(reply.MemberSize());
-            new_meta.GetMin().SetString(reply.MemberAt(0).str, true);
-            new_meta.GetMax().SetString(reply.MemberAt(reply.MemberSize() - 1).str, true);
+            new_meta.SetObjectLen(count);
+            new_meta.GetMin().SetString(first, true);
+            new_meta.GetMax().SetString(last, true);
             SetKeyValue(ctx, key, new_meta);
         }
         return 0;
@@ -224,6 +290,10 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        if (vs[0].IsCompact() || vs[1].IsCompact() || vs[1].GetType() == 0)
+        {
+            return SMoveCompact(ctx, ks, vs);
+        }
         if (vs[2].GetType() == KEY_SET_MEMBER)
         {
             WriteBatchGuard batch(ctx, m_engine);
@@ -278,6 +348,123 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    /*
+     * smove while source or destination set is compact, keys/values are the meta & member pairs loaded by SMove.
+     */
+    int Ardb::SMoveCompact(Context& ctx, KeyObjectArray& ks, ValueObjectArray& vs)
+    {
+        RedisReply& reply = ctx.GetReply();
+        DataArray src_elements, dst_elements;
+        if (!vs[0].GetCompactElements(src_elements) || !vs[1].GetCompactElements(dst_elements))
+        {
+            reply.SetErrCode(ERR_CORRUPTED_VALUE);
+            return 0;
+        }
+        const Data& member = ks[2].GetSetMember();
+        bool src_found = false, dst_found = false;
+        size_t src_pos = CompactLocate(KEY_SET, src_elements, member, src_found);
+        size_t dst_pos = CompactLocate(KEY_SET, dst_elements, member, dst_found);
+        if (!vs[0].IsCompact())
+        {
+            src_found = vs[2].GetType() == KEY_SET_MEMBER;
+        }
+        if (!vs[1].IsCompact() && vs[1].GetType() > 0)
+        {
+            dst_found = vs[3].GetType() > 0;
+        }
+        if (!src_found)
+        {
+            return 0;
+        }
+        if (ks[0].GetKey() == ks[1].GetKey())
+        {
+            reply.SetInteger(1);
+            return 0;
+        }
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            if (vs[0].IsCompact())
+            {
+                src_elements.erase(src_elements.begin() + src_pos);
+                CompactSave(ctx, ks[0], vs[0], src_elements);
+            }
+            else
+            {
+                RemoveKey(ctx, ks[2]);
+                if (vs[0].GetObjectLen() > 0)
+                {
+                    vs[0].SetObjectLen(vs[0].GetObjectLen() - 1);
+                    if (vs[0].GetObjectLen() == 0)
+                    {
+                        RemoveKey(ctx, ks[0]);
+                    }
+                    else
+                    {
+                        SetKeyValue(ctx, ks[0], vs[0]);
+                    }
+                }
+            }
+            if (!dst_found)
+            {
+                if (vs[1].GetType() == 0 || vs[1].IsCompact())
+                {
+                    vs[1].SetType(KEY_SET);
+                    dst_elements.insert(dst_elements.begin() + dst_pos, member);
+                    CompactSave(ctx, ks[1], vs[1], dst_elements);
+                }
+                else
+                {
+                    ValueObject empty;
+                    empty.SetType(KEY_SET_MEMBER);
+                    SetKeyValue(ctx, ks[3], empty);
+                    vs[1].SetMinMaxData(member);
+                    if (vs[1].GetObjectLen() > 0)
+                    {
+                        vs[1].SetObjectLen(vs[1].GetObjectLen() + 1);
+                    }
+                    SetKeyValue(ctx, ks[1], vs[1]);
+                }
+            }
+        }
+        if (0 != ctx.transc_err)
+        {
+            reply.SetErrCode(ctx.transc_err);
+        }
+        else
+        {
+            reply.SetInteger(1);
+        }
+        return 0;
+    }
+
+    /*
+     * store members as the content of destination set, the set is compact while it fits.
+     */
+    int Ardb::SStoreMembers(Context& ctx, const KeyObject& key, const DataSet& members)
+    {
+        ValueObject dest_meta;
+        dest_meta.SetType(KEY_SET);
+        dest_meta.SetObjectLen(members.size());
+        DataArray elements(members.begin(), members.end());
+        if (CompactFits(ctx, KEY_SET, elements))
+        {
+            return CompactSave(ctx, key, dest_meta, elements);
+        }
+        DataSet::const_iterator it = members.begin();
+        while (it != members.end())
+        {
+            KeyObject element(ctx.ns, KEY_SET_MEMBER, key.GetKey());
+            element.SetSetMember(*it);
+            ValueObject empty;
+            empty.SetType(KEY_SET_MEMBER);
+            SetKeyValue(ctx, element, empty);
+            it++;
+        }
+        dest_meta.SetMinData(*(members.begin()));
+        dest_meta.SetMaxData(*(members.rbegin()));
+        return SetKeyValue(ctx, key, dest_meta);
+    }
+
     int Ardb::SPop(Context& ctx, RedisCommandFrame& cmd)
     {
         RedisReply& reply = ctx.GetReply();
@@ -306,6 +493,33 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            if (!meta.GetCompactElements(elements))
+            {
+                reply.SetErrCode(ERR_CORRUPTED_VALUE);
+                return 0;
+            }
+            removed = std::min(count, (int64) elements.size());
+            for (int64 i = 0; i < removed; i++)
+            {
+                if (with_count)
+                {
+                    reply.AddMember().SetString(elements[i]);
+                }
+                else
+                {
+                    reply.SetString(elements[i]);
+                }
+            }
+            if (removed > 0)
+            {
+                elements.erase(elements.begin(), elements.begin() + removed);
+                CompactSave(ctx, meta_key, meta, elements);
+            }
+            return 0;
+        }
         bool remove_key = false;
         KeyObject key(ctx.ns, KEY_SET_MEMBER, keystr);
         key.SetSetMember(meta.GetMin());
@@ -393,7 +607,7 @@ OP_NAMESPACE_BEGIN
 
         const std::string& keystr = cmd.GetArguments()[0];
         KeyObject key(ctx.ns, KEY_SET_MEMBER, keystr);
-        Iterator* iter = m_engine->Find(ctx, key);
+        Iterator* iter = FindElements(ctx, key, meta);
         while (NULL != iter && iter->Valid() && fetched < std::abs(count))
         {
             KeyObject& field = iter->Key();
@@ -439,6 +653,7 @@ OP_NAMESPACE_BEGIN
         KeyLockGuard guard(ctx, key);
         if (!ctx.flags.redis_compatible)
         {
+            CompactExpand(ctx, key);
             {
                 WriteBatchGuard batch(ctx, m_engine);
                 for (size_t i = 1; i < cmd.GetArguments().size(); i++)
@@ -472,6 +687,33 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         int64_t remove_count = 0;
+        if (meta.IsCompact())
+        {
+            DataArray elements;
+            if (!meta.GetCompactElements(elements))
+            {
+                reply.SetErrCode(ERR_CORRUPTED_VALUE);
+                return 0;
+            }
+            for (size_t i = 1; i < cmd.GetArguments().size(); i++)
+            {
+                Data member;
+                member.SetString(cmd.GetArguments()[i], true);
+                bool found = false;
+                size_t pos = CompactLocate(KEY_SET, elements, member, found);
+                if (found)
+                {
+                    elements.erase(elements.begin() + pos);
+                    remove_count++;
+                }
+            }
+            if (remove_count > 0)
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                CompactSave(ctx, key, meta, elements);
+            }
+        }
+        else
         {
             WriteBatchGuard batch(ctx, m_engine);
             bool meta_changed = false;
@@ -614,22 +856,7 @@ OP_NAMESPACE_BEGIN
             }
             if (!diff_result.empty())
             {
-                DataSet::iterator it = diff_result.begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(diff_result.size());
-                while (it != diff_result.end())
-                {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
-                }
-                dest_meta.SetMinData(*(diff_result.begin()));
-                dest_meta.SetMaxData(*(diff_result.rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
+                SStoreMembers(ctx, keys[0], diff_result);
             }
             reply.SetInteger(diff_result.size());
         }
@@ -764,22 +991,7 @@ OP_NAMESPACE_BEGIN
                     DelKey(ctx, keys[0], iter);
                     DELETE(iter);
                 }
-                DataSet::iterator it = inter_result[inter_result_cursor].begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(inter_result[inter_result_cursor].size());
-                while (it != inter_result[inter_result_cursor].end())
-                {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
-                }
-                dest_meta.SetMinData(*(inter_result[inter_result_cursor].begin()));
-                dest_meta.SetMaxData(*(inter_result[inter_result_cursor].rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
+                SStoreMembers(ctx, keys[0], inter_result[inter_result_cursor]);
             }
             reply.SetInteger(inter_result[inter_result_cursor].size());
         }
@@ -850,6 +1062,13 @@ OP_NAMESPACE_BEGIN
             {
                 continue;
             }
+            if (metas[i].IsCompact())
+            {
+                DataArray elements;
+                metas[i].GetCompactElements(elements);
+                union_result.insert(elements.begin(), elements.end());
+                continue;
+            }
             KeyObject ele(ctx.ns, KEY_SET_MEMBER, keys[i].GetKey());
             ele.SetSetMember(metas[i].GetMin());
             if (NULL != iter)
@@ -883,22 +1102,7 @@ OP_NAMESPACE_BEGIN
 
             if (!union_result.empty())
             {
-                DataSet::iterator it = union_result.begin();
-                ValueObject dest_meta;
-                dest_meta.SetType(KEY_SET);
-                dest_meta.SetObjectLen(union_result.size());
-                while (it != union_result.end())
-                {
-                    KeyObject element(ctx.ns, KEY_SET_MEMBER, cmd.GetArguments()[0]);
-                    element.SetSetMember(*it);
-                    ValueObject empty;
-                    empty.SetType(KEY_SET_MEMBER);
-                    SetKeyValue(ctx, element, empty);
-                    it++;
-                }
-                dest_meta.SetMinData(*(union_result.begin()));
-                dest_meta.SetMaxData(*(union_result.rbegin()));
-                SetKeyValue(ctx, keys[0], dest_meta);
+                SStoreMembers(ctx, keys[0], union_result);
                 reply.SetInteger(union_result.size());
             }
 
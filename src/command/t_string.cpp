@@ -34,8 +34,16 @@ OP_NAMESPACE_BEGIN
     {
         RedisReply& reply = ctx.GetReply();
         KeyObject keyobj(ctx.ns, KEY_META, Data::WrapCStr(cmd.GetArguments()[0]));
-        ValueObject v;
-        if (!CheckMeta(ctx, keyobj, KEY_STRING, v))
+        ValueObject meta;
+        const int* errs = NULL;
+        ValueObject* batched = GetBatchedValues(ctx, 1, errs);
+        if (NULL != batched && errs[0] != 0 && errs[0] != ERR_ENTRY_NOT_EXIST)
+        {
+            reply.SetErrCode(errs[0]);
+            return 0;
+        }
+        ValueObject& v = NULL != batched ? batched[0] : meta;
+        if (!CheckMeta(ctx, keyobj, KEY_STRING, v, NULL == batched))
         {
             return 0;
         }
@@ -44,6 +52,19 @@ OP_NAMESPACE_BEGIN
             //return nil if not exist
             reply.Clear();
         }
+        else if (v.IsStringSegmented())
+        {
+            std::string str;
+            int err = StringSegmentsRead(ctx, keyobj, v, 0, v.GetObjectLen() - 1, str);
+            if (0 != err)
+            {
+                reply.SetErrCode(err);
+            }
+            else
+            {
+                reply.SetString(str);
+            }
+        }
         else
         {
             reply.SetString(v.GetStringValue());
@@ -75,6 +96,18 @@ OP_NAMESPACE_BEGIN
             {
                 r.Clear();
             }
+            else if (vs[i].IsStringSegmented())
+            {
+                std::string str;
+                if (0 != StringSegmentsRead(ctx, ks[i], vs[i], 0, vs[i].GetObjectLen() - 1, str))
+                {
+                    r.Clear();
+                }
+                else
+                {
+                    r.SetString(str);
+                }
+            }
             else
             {
                 r.SetString(vs[i].GetStringValue());
@@ -85,7 +118,7 @@ OP_NAMESPACE_BEGIN
 
     int Ardb::MergeAppend(Context& ctx, const KeyObject& key, ValueObject& val, const std::string& append)
     {
-        if (val.GetType() != 0 && val.GetType() != KEY_STRING)
+        if ((val.GetType() != 0 && val.GetType() != KEY_STRING) || val.IsStringSegmented())
         {
             return ERR_WRONG_TYPE;
         }
@@ -108,7 +141,8 @@ OP_NAMESPACE_BEGIN
         /*
          * merge append
          */
-        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge)
+        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge
+                && GetConf().string_segment_size <= 0)
         {
             Data merge_data;
             merge_data.SetString(append, false);
@@ -127,15 +161,35 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
-        MergeAppend(ctx, key, v, append);
-        err = SetKeyValue(ctx, key, v);
+        {
+            WriteBatchGuard batch(ctx, m_engine);
+            int64 len = v.IsStringSegmented() ? v.GetObjectLen() : v.GetStringValue().StringLength();
+            err = StringSegmentsConvert(ctx, key, v, len + append.size());
+            if (0 == err && v.IsStringSegmented())
+            {
+                err = StringSegmentsWrite(ctx, key, v, v.GetObjectLen(), append);
+            }
+            else if (0 == err)
+            {
+                MergeAppend(ctx, key, v, append);
+                err = SetKeyValue(ctx, key, v);
+            }
+            if (0 != err)
+            {
+                batch.MarkFailed(err);
+            }
+        }
+        if (0 == err)
+        {
+            err = ctx.transc_err;
+        }
         if (err < 0)
         {
             reply.SetErrCode(err);
         }
         else
         {
-            reply.SetInteger(v.GetStringValue().StringLength());
+            reply.SetInteger(v.IsStringSegmented() ? v.GetObjectLen() : v.GetStringValue().StringLength());
         }
         return 0;
     }
@@ -182,7 +236,7 @@ OP_NAMESPACE_BEGIN
             for (uint32 i = 0; i < cmd.GetArguments().size(); i += 2)
             {
                 KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[i]);
-                if (!ctx.flags.redis_compatible)
+                if (!ctx.flags.redis_compatible && GetConf().string_segment_size <= 0)
                 {
                     if (cmd.GetType() == REDIS_CMD_MSETNX || cmd.GetType() == REDIS_CMD_MSETNX2)
                     {
@@ -217,6 +271,10 @@ OP_NAMESPACE_BEGIN
                             break;
                         }
                     }
+                    if (valueobj.IsStringSegmented())
+                    {
+                        StringSegmentsClear(ctx, key, valueobj);
+                    }
                     ValueObject value;
                     value.SetType(KEY_STRING);
                     value.GetStringValue().SetString(cmd.GetArguments()[i + 1], true, false);
@@ -244,7 +302,7 @@ OP_NAMESPACE_BEGIN
     {
         if (val.GetType() > 0)
         {
-            if (val.GetType() != KEY_STRING ||
+            if (val.GetType() != KEY_STRING || val.IsStringSegmented() ||
 				(!val.GetStringValue().IsInteger() && !val.GetStringValue().IsFloat()))
             {
                 return ERR_WRONG_TYPE;
@@ -311,7 +369,7 @@ OP_NAMESPACE_BEGIN
     {
         if (val.GetType() > 0)
         {
-            if (val.GetType() != KEY_STRING || !val.GetStringValue().IsInteger())
+            if (val.GetType() != KEY_STRING || val.IsStringSegmented() || !val.GetStringValue().IsInteger())
             {
                 return ERR_WRONG_TYPE;
             }
@@ -430,11 +488,29 @@ OP_NAMESPACE_BEGIN
                 reply.SetErrCode(ERR_WRONG_TYPE);
                 return 0;
             }
-            reply.SetString(value.GetStringValue());
-            value.GetStringValue().SetString(cmd.GetArguments()[1], true);
-            err = SetKeyValue(ctx, keyobj, value);
+            WriteBatchGuard batch(ctx, m_engine);
+            if (value.IsStringSegmented())
+            {
+                std::string str;
+                err = StringSegmentsRead(ctx, keyobj, value, 0, value.GetObjectLen() - 1, str);
+                if (0 == err)
+                {
+                    reply.SetString(str);
+                    err = StringSegmentsClear(ctx, keyobj, value);
+                }
+            }
+            else
+            {
+                reply.SetString(value.GetStringValue());
+            }
+            if (0 == err)
+            {
+                value.GetStringValue().SetString(cmd.GetArguments()[1], true, false);
+                err = SetKeyValue(ctx, keyobj, value);
+            }
             if (0 != err)
             {
+                batch.MarkFailed(err);
                 reply.SetErrCode(err);
             }
         }
@@ -471,8 +547,11 @@ OP_NAMESPACE_BEGIN
                 return 0;
             }
             std::string str;
-            value.GetStringValue().ToString(str);
-            size_t strlen = str.size();
+            if (!value.IsStringSegmented())
+            {
+                value.GetStringValue().ToString(str);
+            }
+            size_t strlen = value.IsStringSegmented() ? value.GetObjectLen() : str.size();
             /* Convert negative indexes */
             if (start < 0)
                 start = strlen + start;
@@ -491,6 +570,18 @@ OP_NAMESPACE_BEGIN
             {
                 str.clear();
             }
+            else if (value.IsStringSegmented())
+            {
+                /*
+                 * only segments covered by the range are loaded
+                 */
+                err = StringSegmentsRead(ctx, keyobj, value, start, end, str);
+                if (0 != err)
+                {
+                    reply.SetErrCode(err);
+                    return 0;
+                }
+            }
             else
             {
                 str = str.substr(start, end - start + 1);
@@ -522,6 +613,14 @@ OP_NAMESPACE_BEGIN
                 return ERR_NOTPERFORMED;
             }
         }
+        if (val.IsStringSegmented())
+        {
+            /*
+             * segments could not be removed in merge, compatible mode clears them before
+             */
+            val.SetStringSegmentSize(0);
+            val.SetObjectLen(-1);
+        }
         val.SetType(KEY_STRING);
         val.GetStringValue().Clone(data);
         if (ttl > 0)
@@ -555,6 +654,13 @@ OP_NAMESPACE_BEGIN
         {
             redis_compatible = true;
         }
+        /*
+         * a segmented value could only be overwritten after its segments are removed, which needs the meta loaded
+         */
+        if (GetConf().string_segment_size > 0)
+        {
+            redis_compatible = true;
+        }
         if (redis_compatible)
         {
             if (!CheckMeta(ctx, key, KEY_STRING, valueobj))
@@ -562,8 +668,13 @@ OP_NAMESPACE_BEGIN
                 return ctx.GetReply().ErrCode();
             }
             Data merge;
-            merge.SetString(value, true);
+            merge.SetString(value, true, false);
             int64 oldttl = valueobj.GetTTL();
+            WriteBatchGuard batch(ctx, m_engine);
+            if (valueobj.IsStringSegmented() && op != REDIS_CMD_SETNX)
+            {
+                StringSegmentsClear(ctx, keyobj, valueobj);
+            }
             err = MergeSet(ctx, keyobj, valueobj, op, merge, ttl);
             if (0 == err)
             {
@@ -587,7 +698,7 @@ OP_NAMESPACE_BEGIN
             {
                 DataArray merge_data;
                 Data merge;
-                merge.SetString(value, true);
+                merge.SetString(value, true, false);
                 merge_data.push_back(merge);
                 if (ttl > 0)
                 {
@@ -601,6 +712,10 @@ OP_NAMESPACE_BEGIN
                 }
                 err = MergeKeyValue(ctx, keyobj, op, merge_data);
             }
+            if (0 == err && ttl > 0)
+            {
+                SaveTTL(ctx, keyobj.GetNameSpace(), key, 0, ttl);
+            }
         }
         return err;
     }
@@ -713,7 +828,7 @@ OP_NAMESPACE_BEGIN
         uint8 val_type = val.GetType();
         if (val_type > 0)
         {
-            if (val_type != KEY_STRING)
+            if (val_type != KEY_STRING || val.IsStringSegmented())
             {
                 return ERR_WRONG_TYPE;
             }
@@ -755,7 +870,8 @@ OP_NAMESPACE_BEGIN
         /*
          * merge setrange
          */
-        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge)
+        if (!ctx.flags.redis_compatible && m_engine->GetFeatureSet().support_merge
+                && GetConf().string_segment_size <= 0)
         {
             DataArray args(2);
             args[0].SetInt64(offset);
@@ -784,10 +900,40 @@ OP_NAMESPACE_BEGIN
                 reply.SetErrCode(err);
                 return 0;
             }
-            err = MergeSetRange(ctx, keyobj, valueobj, offset, cmd.GetArguments()[2]);
+            const std::string& range = cmd.GetArguments()[2];
+            if (valueobj.GetType() > 0 && valueobj.GetType() != KEY_STRING)
+            {
+                reply.SetErrCode(ERR_WRONG_TYPE);
+                return 0;
+            }
+            if (offset + range.size() > 512 * 1024 * 1024)
+            {
+                reply.SetErrCode(ERR_STRING_EXCEED_LIMIT);
+                return 0;
+            }
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                err = StringSegmentsConvert(ctx, keyobj, valueobj, range.empty() ? 0 : offset + range.size());
+                if (0 == err && valueobj.IsStringSegmented())
+                {
+                    err = StringSegmentsWrite(ctx, keyobj, valueobj, offset, range);
+                }
+                else if (0 == err)
+                {
+                    err = MergeSetRange(ctx, keyobj, valueobj, offset, range);
+                    if (0 == err)
+                    {
+                        err = SetKeyValue(ctx, keyobj, valueobj);
+                    }
+                }
+                if (0 != err)
+                {
+                    batch.MarkFailed(err);
+                }
+            }
             if (0 == err)
             {
-                err = SetKeyValue(ctx, keyobj, valueobj);
+                err = ctx.transc_err;
             }
             if (0 != err)
             {
@@ -795,7 +941,8 @@ OP_NAMESPACE_BEGIN
             }
             else
             {
-                reply.SetInteger(valueobj.GetStringValue().StringLength());
+                reply.SetInteger(valueobj.IsStringSegmented() ? valueobj.GetObjectLen() :
+                        valueobj.GetStringValue().StringLength());
             }
         }
         return 0;
@@ -809,7 +956,7 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
-        reply.SetInteger(value.GetStringValue().StringLength());
+        reply.SetInteger(value.IsStringSegmented() ? value.GetObjectLen() : value.GetStringValue().StringLength());
         return 0;
     }
 
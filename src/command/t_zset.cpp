@@ -43,6 +43,612 @@
 
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Rank index of sorted set.
+     * Sort keys are grouped into blocks on kZSetRankLevels levels. Node 'KEY_ZSET_RANK [level, score, member]'
+     * marks the first position of a block and stores the number of elements in the block. Every level begins
+     * with a head node at (-inf, nil), and every block begins at a block of the level below, so an element
+     * belongs to exactly one block per level. A block of level N is kept between 1/4 and 2 times of
+     * kZSetRankFanout^N elements: an update costs one read-modify-write per level, and a rank lookup descends
+     * from the top level summing the blocks before the target, then scans the elements of one bottom block.
+     */
+    static const int kZSetRankLevels = 3;
+    static const int64 kZSetRankFanout = 64;
+
+    typedef std::pair<double, Data> ZSetRankPos;
+    struct ZSetRankNode
+    {
+            int64 count;
+            bool exists; //stored before current update
+            bool removed;
+            bool dirty;
+            bool has_next;
+            ZSetRankPos next; //next stored node of same level
+            ZSetRankNode()
+                    : count(0), exists(false), removed(false), dirty(false), has_next(false)
+            {
+            }
+    };
+    typedef TreeMap<ZSetRankPos, ZSetRankNode>::Type ZSetRankNodes;
+
+    static int64 zset_rank_capacity(int level)
+    {
+        int64 capacity = 1;
+        for (int i = 0; i < level; i++)
+        {
+            capacity *= kZSetRankFanout;
+        }
+        return capacity;
+    }
+
+    /*
+     * positions are kept after the iterator moved, string content is always copied
+     */
+    static ZSetRankPos zset_rank_pos(double score, const Data& member)
+    {
+        ZSetRankPos pos;
+        pos.first = score;
+        if (member.IsCStr())
+        {
+            pos.second.SetString(member.CStr(), member.StringLength(), true);
+        }
+        else
+        {
+            pos.second.Clone(member);
+        }
+        return pos;
+    }
+
+    static ZSetRankPos zset_rank_head()
+    {
+        return zset_rank_pos(-HUGE_VAL, Data());
+    }
+
+    static bool zset_rank_node_match(KeyObject& node, const KeyObject& key, int64 level)
+    {
+        return node.GetType() == KEY_ZSET_RANK && node.GetNameSpace() == key.GetNameSpace()
+                && node.GetKey() == key.GetKey() && node.GetZSetRankLevel() == level;
+    }
+
+    static ZSetRankPos zset_rank_node_pos(KeyObject& node)
+    {
+        return zset_rank_pos(node.GetZSetRankScore(), node.GetZSetRankMember());
+    }
+
+    static bool zset_sort_key_match(KeyObject& field, const KeyObject& key)
+    {
+        return field.GetType() == KEY_ZSET_SORT && field.GetNameSpace() == key.GetNameSpace()
+                && field.GetKey() == key.GetKey();
+    }
+
+    static ZSetRankPos zset_sort_key_pos(KeyObject& field)
+    {
+        return zset_rank_pos(field.GetZSetScore(), field.GetZSetMember());
+    }
+
+    /*
+     * moves the iterator to the last node of given level which is not after pos, returns false if there is none
+     */
+    static bool zset_rank_locate(Engine* engine, Context& ctx, const KeyObject& key, Iterator*& iter, int level,
+            const ZSetRankPos& pos)
+    {
+        KeyObject start(ctx.ns, KEY_ZSET_RANK, key.GetKey());
+        start.SetZSetRankNode(level, pos.first, pos.second);
+        if (NULL == iter)
+        {
+            iter = engine->Find(ctx, start);
+        }
+        else
+        {
+            iter->Jump(start);
+        }
+        if (!iter->Valid())
+        {
+            iter->JumpToLast();
+        }
+        else if (!zset_rank_node_match(iter->Key(), key, level) || pos < zset_rank_node_pos(iter->Key()))
+        {
+            iter->Prev();
+        }
+        return iter->Valid() && zset_rank_node_match(iter->Key(), key, level);
+    }
+
+    /*
+     * loads the node at the iterator and the position of its next node into the node table
+     */
+    static ZSetRankNode& zset_rank_load_node(const KeyObject& key, Iterator* iter, int level, ZSetRankNodes& nodes)
+    {
+        ZSetRankPos pos = zset_rank_node_pos(iter->Key());
+        ZSetRankNodes::iterator found = nodes.find(pos);
+        if (found != nodes.end())
+        {
+            return found->second;
+        }
+        ZSetRankNode node;
+        node.exists = true;
+        node.count = iter->Value().GetZSetRankCount();
+        iter->Next();
+        if (iter->Valid() && zset_rank_node_match(iter->Key(), key, level))
+        {
+            node.has_next = true;
+            node.next = zset_rank_node_pos(iter->Key());
+        }
+        return nodes.insert(std::make_pair(pos, node)).first->second;
+    }
+
+    /*
+     * splits a stored block into blocks of at least the level's capacity, cut positions are the stored
+     * blocks of the level below(sort keys for level 1), so it only sees data written before current batch.
+     */
+    static void zset_rank_split(Engine* engine, Context& ctx, const KeyObject& key, int level, const ZSetRankPos& fence,
+            ZSetRankNodes& nodes)
+    {
+        int64 total = nodes[fence].count;
+        bool has_next = nodes[fence].has_next;
+        ZSetRankPos next = nodes[fence].next;
+        int64 capacity = zset_rank_capacity(level);
+        Iterator* iter = NULL;
+        if (1 == level)
+        {
+            KeyObject start(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+            start.SetZSetScore(fence.first);
+            start.SetZSetMember(fence.second);
+            iter = engine->Find(ctx, start);
+        }
+        else
+        {
+            KeyObject start(ctx.ns, KEY_ZSET_RANK, key.GetKey());
+            start.SetZSetRankNode(level - 1, fence.first, fence.second);
+            iter = engine->Find(ctx, start);
+        }
+        std::vector<std::pair<ZSetRankPos, int64> > blocks;
+        ZSetRankPos cut = fence;
+        int64 acc = 0, consumed = 0;
+        while (iter->Valid() && consumed < total)
+        {
+            KeyObject& k = iter->Key();
+            ZSetRankPos pos;
+            int64 n = 1;
+            if (1 == level)
+            {
+                if (!zset_sort_key_match(k, key))
+                {
+                    break;
+                }
+                pos = zset_sort_key_pos(k);
+            }
+            else
+            {
+                if (!zset_rank_node_match(k, key, level - 1))
+                {
+                    break;
+                }
+                pos = zset_rank_node_pos(k);
+                n = iter->Value().GetZSetRankCount();
+            }
+            if (has_next && !(pos < next))
+            {
+                break;
+            }
+            if (acc >= capacity && total - consumed >= capacity)
+            {
+                blocks.push_back(std::make_pair(cut, acc));
+                cut = pos;
+                acc = 0;
+            }
+            acc += n;
+            consumed += n;
+            iter->Next();
+        }
+        DELETE(iter);
+        if (blocks.empty())
+        {
+            return;
+        }
+        int64 rest = total;
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            rest -= blocks[i].second;
+        }
+        blocks.push_back(std::make_pair(cut, rest));
+        for (size_t i = 0; i < blocks.size(); i++)
+        {
+            ZSetRankNode& node = nodes[blocks[i].first];
+            node.count = blocks[i].second;
+            node.dirty = true;
+            node.has_next = i + 1 < blocks.size() ? true : has_next;
+            node.next = i + 1 < blocks.size() ? blocks[i + 1].first : next;
+        }
+    }
+
+    /*
+     * finds the last live block of given level before pos, blocks split in current batch are only in the node table
+     */
+    static bool zset_rank_prev(Engine* engine, Context& ctx, const KeyObject& key, Iterator*& iter, int level,
+            const ZSetRankPos& pos, ZSetRankNodes& nodes, ZSetRankPos& prev)
+    {
+        bool found = false;
+        ZSetRankNodes::iterator it = nodes.lower_bound(pos);
+        while (it != nodes.begin())
+        {
+            it--;
+            if (!it->second.removed)
+            {
+                prev = it->first;
+                found = true;
+                break;
+            }
+        }
+        if (!zset_rank_locate(engine, ctx, key, iter, level, pos))
+        {
+            return found;
+        }
+        while (true)
+        {
+            iter->Prev();
+            if (!iter->Valid() || !zset_rank_node_match(iter->Key(), key, level))
+            {
+                return found;
+            }
+            ZSetRankPos stored = zset_rank_node_pos(iter->Key());
+            ZSetRankNodes::iterator loaded = nodes.find(stored);
+            if (loaded != nodes.end() && loaded->second.removed)
+            {
+                continue;
+            }
+            if (!found || prev < stored)
+            {
+                prev = stored;
+                found = true;
+                if (loaded == nodes.end())
+                {
+                    ZSetRankNode node;
+                    node.exists = true;
+                    node.count = iter->Value().GetZSetRankCount();
+                    nodes.insert(std::make_pair(stored, node));
+                }
+            }
+            return true;
+        }
+    }
+
+    bool Ardb::ZSetRankIndexNeeded(ValueObject& meta, int64_t size)
+    {
+        if (meta.GetMetaObject().zset_rank_indexed || meta.IsCompact() || GetConf().zset_rank_index_min_size <= 0)
+        {
+            return false;
+        }
+        return size >= GetConf().zset_rank_index_min_size;
+    }
+
+    void Ardb::ZSetRankUpdate(ZSetRankDeltas& deltas, double score, const Data& member, int64_t delta)
+    {
+        deltas[zset_rank_pos(score, member)] += delta;
+    }
+
+    /*
+     * collects all elements as deltas, the index is created from them by next flush
+     */
+    int Ardb::ZSetRankBuild(Context& ctx, const KeyObject& key, ZSetRankDeltas& deltas)
+    {
+        KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+        Iterator* iter = m_engine->Find(ctx, sort_key);
+        while (iter->Valid())
+        {
+            KeyObject& field = iter->Key();
+            if (!zset_sort_key_match(field, key))
+            {
+                break;
+            }
+            ZSetRankUpdate(deltas, field.GetZSetScore(), field.GetZSetMember(), 1);
+            iter->Next();
+        }
+        DELETE(iter);
+        return 0;
+    }
+
+    /*
+     * apply the element deltas collected by current command to the rank nodes, every touched node is read and
+     * written once. Oversized blocks are split before the deltas are applied, underflowed blocks are merged
+     * into their previous blocks afterwards.
+     */
+    int Ardb::ZSetRankFlush(Context& ctx, const KeyObject& key, ZSetRankDeltas& deltas)
+    {
+        ctx.flags.iterate_total_order = 1;
+        ZSetRankNodes nodes[kZSetRankLevels + 1];
+        Iterator* iter = NULL;
+        bool indexed = true;
+        ZSetRankDeltas::iterator it;
+        for (int level = 1; level <= kZSetRankLevels && indexed; level++)
+        {
+            ZSetRankNode* current = NULL;
+            for (it = deltas.begin(); it != deltas.end(); it++)
+            {
+                if (0 == it->second)
+                {
+                    continue;
+                }
+                if (NULL != current && (!current->has_next || it->first < current->next))
+                {
+                    continue;
+                }
+                if (!zset_rank_locate(m_engine, ctx, key, iter, level, it->first))
+                {
+                    indexed = false;
+                    break;
+                }
+                current = &zset_rank_load_node(key, iter, level, nodes[level]);
+            }
+        }
+        DELETE(iter);
+        if (!indexed && !nodes[1].empty())
+        {
+            WARN_LOG("Broken rank index for zset:%s", key.GetKey().AsString().c_str());
+            deltas.clear();
+            return ERR_CORRUPTED_VALUE;
+        }
+        if (!indexed)
+        {
+            /*
+             * no rank node yet, the deltas are all elements of the sorted set
+             */
+            ZSetRankPos fences[kZSetRankLevels + 1];
+            int64 counts[kZSetRankLevels + 1];
+            for (int level = 1; level <= kZSetRankLevels; level++)
+            {
+                fences[level] = zset_rank_head();
+                counts[level] = 0;
+            }
+            for (it = deltas.begin(); it != deltas.end(); it++)
+            {
+                if (it->second <= 0)
+                {
+                    continue;
+                }
+                int cut = 0;
+                for (int level = kZSetRankLevels; level >= 1 && 0 == cut; level--)
+                {
+                    if (counts[level] >= zset_rank_capacity(level))
+                    {
+                        cut = level;
+                    }
+                }
+                for (int level = 1; level <= cut; level++)
+                {
+                    nodes[level][fences[level]].count = counts[level];
+                    fences[level] = it->first;
+                    counts[level] = 0;
+                }
+                for (int level = 1; level <= kZSetRankLevels; level++)
+                {
+                    counts[level]++;
+                }
+            }
+            for (int level = 1; level <= kZSetRankLevels; level++)
+            {
+                nodes[level][fences[level]].count = counts[level];
+                ZSetRankNodes::iterator node = nodes[level].begin();
+                while (node != nodes[level].end())
+                {
+                    node->second.dirty = true;
+                    node++;
+                }
+            }
+        }
+        else
+        {
+            for (int level = kZSetRankLevels; level >= 1; level--)
+            {
+                std::vector<ZSetRankPos> oversized;
+                ZSetRankNodes::iterator node = nodes[level].begin();
+                while (node != nodes[level].end())
+                {
+                    if (node->second.exists && node->second.count > 2 * zset_rank_capacity(level))
+                    {
+                        oversized.push_back(node->first);
+                    }
+                    node++;
+                }
+                for (size_t i = 0; i < oversized.size(); i++)
+                {
+                    zset_rank_split(m_engine, ctx, key, level, oversized[i], nodes[level]);
+                }
+            }
+            for (int level = 1; level <= kZSetRankLevels; level++)
+            {
+                for (it = deltas.begin(); it != deltas.end(); it++)
+                {
+                    if (0 != it->second)
+                    {
+                        ZSetRankNodes::iterator node = nodes[level].upper_bound(it->first);
+                        node--;
+                        node->second.count += it->second;
+                        node->second.dirty = true;
+                    }
+                }
+            }
+            ZSetRankPos head = zset_rank_head();
+            for (int level = 1; level <= kZSetRankLevels; level++)
+            {
+                std::vector<ZSetRankPos> underflowed;
+                ZSetRankNodes::iterator node = nodes[level].begin();
+                while (node != nodes[level].end())
+                {
+                    /*
+                     * a block which is also a block of upper level could not be merged
+                     */
+                    if (node->second.dirty && node->second.count < zset_rank_capacity(level) / 4 && node->first != head
+                            && (level == kZSetRankLevels || nodes[level + 1].count(node->first) == 0))
+                    {
+                        underflowed.push_back(node->first);
+                    }
+                    node++;
+                }
+                for (size_t i = 0; i < underflowed.size(); i++)
+                {
+                    ZSetRankPos prev;
+                    if (zset_rank_prev(m_engine, ctx, key, iter, level, underflowed[i], nodes[level], prev))
+                    {
+                        ZSetRankNode& block = nodes[level][underflowed[i]];
+                        ZSetRankNode& prev_block = nodes[level][prev];
+                        prev_block.count += block.count;
+                        prev_block.dirty = true;
+                        block.count = 0;
+                        block.removed = true;
+                    }
+                }
+            }
+            DELETE(iter);
+        }
+        for (int level = 1; level <= kZSetRankLevels; level++)
+        {
+            ZSetRankNodes::iterator node = nodes[level].begin();
+            while (node != nodes[level].end())
+            {
+                if (node->second.dirty)
+                {
+                    KeyObject rank_key(ctx.ns, KEY_ZSET_RANK, key.GetKey());
+                    rank_key.SetZSetRankNode(level, node->first.first, node->first.second);
+                    if (node->second.removed)
+                    {
+                        if (node->second.exists)
+                        {
+                            RemoveKey(ctx, rank_key);
+                        }
+                    }
+                    else
+                    {
+                        ValueObject count;
+                        count.SetType(KEY_ZSET_RANK);
+                        count.SetZSetRankCount(node->second.count);
+                        SetKeyValue(ctx, rank_key, count);
+                    }
+                }
+                node++;
+            }
+        }
+        deltas.clear();
+        return 0;
+    }
+
+    /*
+     * returns the number of elements ordered before (score, member)
+     */
+    int64_t Ardb::ZSetRankCountLess(Context& ctx, const KeyObject& key, double score, const Data& member)
+    {
+        ctx.flags.iterate_total_order = 1;
+        ZSetRankPos pos = zset_rank_pos(score, member);
+        ZSetRankPos fence = zset_rank_head();
+        int64_t count = 0;
+        Iterator* iter = NULL;
+        for (int level = kZSetRankLevels; level >= 1; level--)
+        {
+            if (!zset_rank_locate(m_engine, ctx, key, iter, level, fence) || zset_rank_node_pos(iter->Key()) != fence)
+            {
+                WARN_LOG("Broken rank index for zset:%s", key.GetKey().AsString().c_str());
+                break;
+            }
+            int64_t n = iter->Value().GetZSetRankCount();
+            iter->Next();
+            while (iter->Valid() && zset_rank_node_match(iter->Key(), key, level))
+            {
+                ZSetRankPos next = zset_rank_node_pos(iter->Key());
+                if (pos < next)
+                {
+                    break;
+                }
+                count += n;
+                fence = next;
+                n = iter->Value().GetZSetRankCount();
+                iter->Next();
+            }
+        }
+        DELETE(iter);
+        KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+        sort_key.SetZSetScore(fence.first);
+        sort_key.SetZSetMember(fence.second);
+        iter = m_engine->Find(ctx, sort_key);
+        while (iter->Valid() && zset_sort_key_match(iter->Key(), key) && zset_sort_key_pos(iter->Key()) < pos)
+        {
+            count++;
+            iter->Next();
+        }
+        DELETE(iter);
+        return count;
+    }
+
+    /*
+     * returns the number of elements whose score is less than(or equal to if 'inclusive') the given score
+     */
+    int64_t Ardb::ZSetRankCountScore(Context& ctx, const KeyObject& key, ValueObject& meta, double score,
+            bool inclusive)
+    {
+        if (inclusive)
+        {
+            if (score == HUGE_VAL)
+            {
+                return meta.GetObjectLen();
+            }
+            score = nextafter(score, HUGE_VAL);
+        }
+        return ZSetRankCountLess(ctx, key, score, Data());
+    }
+
+    int64_t Ardb::ZSetRankOf(Context& ctx, const KeyObject& key, double score, const Data& member)
+    {
+        return ZSetRankCountLess(ctx, key, score, member);
+    }
+
+    /*
+     * returns an iterator positioned at the sort key of given rank, or NULL if the rank index is broken
+     */
+    Iterator* Ardb::ZSetRankSeek(Context& ctx, const KeyObject& key, int64_t rank)
+    {
+        bool total_order = ctx.flags.iterate_total_order;
+        ctx.flags.iterate_total_order = 1;
+        ZSetRankPos fence = zset_rank_head();
+        Iterator* iter = NULL;
+        for (int level = kZSetRankLevels; level >= 1; level--)
+        {
+            bool found = zset_rank_locate(m_engine, ctx, key, iter, level, fence)
+                    && zset_rank_node_pos(iter->Key()) == fence;
+            while (found)
+            {
+                int64_t count = iter->Value().GetZSetRankCount();
+                if (rank < count)
+                {
+                    break;
+                }
+                rank -= count;
+                iter->Next();
+                found = iter->Valid() && zset_rank_node_match(iter->Key(), key, level);
+                if (found)
+                {
+                    fence = zset_rank_node_pos(iter->Key());
+                }
+            }
+            if (!found)
+            {
+                DELETE(iter);
+                ctx.flags.iterate_total_order = total_order;
+                WARN_LOG("Broken rank index for zset:%s", key.GetKey().AsString().c_str());
+                return NULL;
+            }
+        }
+        DELETE(iter);
+        ctx.flags.iterate_total_order = total_order;
+        KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+        sort_key.SetZSetScore(fence.first);
+        sort_key.SetZSetMember(fence.second);
+        iter = m_engine->Find(ctx, sort_key);
+        while (rank > 0 && iter->Valid())
+        {
+            iter->Next();
+            rank--;
+        }
+        return iter;
+    }
+
     int Ardb::ZAdd(Context& ctx, RedisCommandFrame& cmd)
     {
         ctx.flags.create_if_notexist = 1;
@@ -108,8 +714,22 @@ OP_NAMESPACE_BEGIN
                 return 0;
             }
 
+            bool compact = meta.IsCompact();
             if (meta.GetType() == 0)
             {
+                /*
+                 * a new key only starts compact if the added elements fit, or it would be expanded right after saving
+                 */
+                DataArray candidates;
+                for (size_t i = 0; i < elements; i++)
+                {
+                    Data member, score_data;
+                    member.SetString(cmd.GetArguments()[scoreidx + i * 2 + 1], false);
+                    score_data.SetFloat64(scores[i]);
+                    candidates.push_back(member);
+                    candidates.push_back(score_data);
+                }
+                compact = CompactFits(ctx, KEY_ZSET, candidates);
                 if (xx)
                 {
                     return 0;
@@ -121,22 +741,29 @@ OP_NAMESPACE_BEGIN
                 }
             }
             double score = 0;
+            if (compact)
             {
                 WriteBatchGuard batch(ctx, m_engine);
+                DataArray zelements;
+                if (!meta.GetCompactElements(zelements))
+                {
+                    batch.MarkFailed(ERR_CORRUPTED_VALUE);
+                    elements = 0;
+                }
                 for (size_t i = 0; i < elements; i++)
                 {
-                    KeyObject ele(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
-                    ele.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
+                    Data member;
+                    member.SetString(cmd.GetArguments()[scoreidx + i * 2 + 1], false);
                     score = scores[i];
-                    double current_score = 0;
-                    ValueObject ele_value;
-                    if (0 == m_engine->Get(ctx, ele, ele_value))
+                    bool found = false;
+                    size_t pos = CompactLocate(KEY_ZSET, zelements, member, found);
+                    if (found)
                     {
                         if (nx)
                         {
                             continue;
                         }
-                        current_score = ele_value.GetZSetScore();
+                        double current_score = zelements[pos + 1].GetFloat64();
                         if (incr)
                         {
                             score += current_score;
@@ -149,16 +776,9 @@ OP_NAMESPACE_BEGIN
                         processed++;
                         if (score != current_score)
                         {
-                            KeyObject old_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
-                            old_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
-                            old_sort_key.SetZSetScore(current_score);
-                            RemoveKey(ctx, old_sort_key);
+                            zelements[pos + 1].SetFloat64(score);
                             updated++;
                         }
-                        else
-                        {
-                            continue;
-                        }
                     }
                     else
                     {
@@ -166,22 +786,102 @@ OP_NAMESPACE_BEGIN
                         {
                             continue;
                         }
+                        Data score_data;
+                        score_data.SetFloat64(score);
+                        zelements.insert(zelements.begin() + pos, score_data);
+                        zelements.insert(zelements.begin() + pos, member);
                         added++;
                         processed++;
                     }
-                    KeyObject new_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
-                    new_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
-                    new_sort_key.SetZSetScore(score);
-                    ValueObject empty;
-                    empty.SetType(KEY_ZSET_SORT);
-                    SetKeyValue(ctx, new_sort_key, empty);
-                    ele_value.SetType(KEY_ZSET_SCORE);
-                    ele_value.SetZSetScore(score);
-                    SetKeyValue(ctx, ele, ele_value);
-                    meta.SetMinMaxData(new_sort_key.GetZSetMember());
-                }
-                meta.SetObjectLen(meta.GetObjectLen() + added);
-                SetKeyValue(ctx, key, meta);
+                }
+                if (0 == batch.err && (added > 0 || updated > 0))
+                {
+                    CompactSave(ctx, key, meta, zelements);
+                }
+            }
+            else
+            {
+                ZSetRankDeltas rank_deltas;
+                if (ZSetRankIndexNeeded(meta, meta.GetObjectLen() + elements))
+                {
+                    ZSetRankBuild(ctx, key, rank_deltas);
+                    meta.GetMetaObject().zset_rank_indexed = true;
+                }
+                bool rank_indexed = meta.GetMetaObject().zset_rank_indexed;
+                {
+                    WriteBatchGuard batch(ctx, m_engine);
+                    for (size_t i = 0; i < elements; i++)
+                    {
+                        KeyObject ele(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
+                        ele.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
+                        score = scores[i];
+                        double current_score = 0;
+                        ValueObject ele_value;
+                        if (0 == m_engine->Get(ctx, ele, ele_value))
+                        {
+                            if (nx)
+                            {
+                                continue;
+                            }
+                            current_score = ele_value.GetZSetScore();
+                            if (incr)
+                            {
+                                score += current_score;
+                                if (std::isnan(score))
+                                {
+                                    batch.MarkFailed(ERR_SCORE_NAN);
+                                    break;
+                                }
+                            }
+                            processed++;
+                            if (score != current_score)
+                            {
+                                KeyObject old_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                                old_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
+                                old_sort_key.SetZSetScore(current_score);
+                                RemoveKey(ctx, old_sort_key);
+                                if (rank_indexed)
+                                {
+                                    ZSetRankUpdate(rank_deltas, current_score, old_sort_key.GetZSetMember(), -1);
+                                }
+                                updated++;
+                            }
+                            else
+                            {
+                                continue;
+                            }
+                        }
+                        else
+                        {
+                            if (xx)
+                            {
+                                continue;
+                            }
+                            added++;
+                            processed++;
+                        }
+                        KeyObject new_sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
+                        new_sort_key.SetZSetMember(cmd.GetArguments()[scoreidx + i * 2 + 1]);
+                        new_sort_key.SetZSetScore(score);
+                        ValueObject empty;
+                        empty.SetType(KEY_ZSET_SORT);
+                        SetKeyValue(ctx, new_sort_key, empty);
+                        ele_value.SetType(KEY_ZSET_SCORE);
+                        ele_value.SetZSetScore(score);
+                        SetKeyValue(ctx, ele, ele_value);
+                        meta.SetMinMaxData(new_sort_key.GetZSetMember());
+                        if (rank_indexed)
+                        {
+                            ZSetRankUpdate(rank_deltas, score, new_sort_key.GetZSetMember(), 1);
+                        }
+                    }
+                    if (rank_indexed)
+                    {
+                        ZSetRankFlush(ctx, key, rank_deltas);
+                    }
+                    meta.SetObjectLen(meta.GetObjectLen() + added);
+                    SetKeyValue(ctx, key, meta);
+                }
             }
 
             if (ctx.transc_err != 0)
@@ -278,17 +978,37 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         if (end >= meta.GetObjectLen()) end = meta.GetObjectLen() - 1;
+        RedisReplyWriter writer(reply, toremove ? NULL : ctx.reply_buffer);
+        if (!toremove)
+        {
+            writer.BeginArray((end - start + 1) * (withscores ? 2 : 1));
+        }
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
         if (reverse)
         {
             ctx.flags.iterate_total_order = 1;
         }
-        Iterator* iter = m_engine->Find(ctx, sort_key);
-        if (reverse)
+        bool rank_indexed = meta.GetMetaObject().zset_rank_indexed;
+        ZSetRankDeltas rank_deltas;
+        DataSet compact_removed;
+        int64_t rank = 0;
+        Iterator* iter = NULL;
+        if (rank_indexed && start > 0)
         {
-            iter->JumpToLast();
+            iter = ZSetRankSeek(ctx, key, reverse ? meta.GetObjectLen() - 1 - start : start);
+            if (NULL != iter)
+            {
+                rank = start;
+            }
+        }
+        if (NULL == iter)
+        {
+            iter = FindElements(ctx, sort_key, meta);
+            if (reverse)
+            {
+                iter->JumpToLast();
+            }
         }
-        int64_t rank = 0;
         while (iter->Valid())
         {
             KeyObject& field = iter->Key();
@@ -305,21 +1025,30 @@ OP_NAMESPACE_BEGIN
             {
                 if (toremove)
                 {
-                    KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
-                    score_key.SetZSetMember(field.GetZSetMember());
-                    //RemoveKey(ctx, field);
-                    RemoveKey(ctx, score_key);
-                    iter->Del();
+                    if (meta.IsCompact())
+                    {
+                        compact_removed.insert(field.GetZSetMember());
+                    }
+                    else
+                    {
+                        KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
+                        score_key.SetZSetMember(field.GetZSetMember());
+                        //RemoveKey(ctx, field);
+                        RemoveKey(ctx, score_key);
+                        if (rank_indexed)
+                        {
+                            ZSetRankUpdate(rank_deltas, field.GetZSetScore(), field.GetZSetMember(), -1);
+                        }
+                        iter->Del();
+                    }
                     removed++;
                 }
                 else
                 {
-                    RedisReply& r1 = reply.AddMember();
-                    r1.SetString(field.GetZSetMember());
+                    writer.AddString(field.GetZSetMember());
                     if (withscores)
                     {
-                        RedisReply& r2 = reply.AddMember();
-                        r2.SetDouble(field.GetZSetScore());
+                        writer.AddDouble(field.GetZSetScore());
                     }
                 }
             }
@@ -340,6 +1069,14 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                if (rank_indexed)
+                {
+                    ZSetRankFlush(ctx, key, rank_deltas);
+                }
+                if (meta.IsCompact())
+                {
+                    CompactErase(meta, compact_removed);
+                }
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -434,19 +1171,57 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        bool rank_indexed = meta.GetMetaObject().zset_rank_indexed;
+        ZSetRankDeltas rank_deltas;
+        DataSet compact_removed;
+        int64_t range_cursor = 0;
+        int64_t range_count = 0;
+        Iterator* iter = NULL;
+        if (rank_indexed && (countrange || (with_limit && limit_offset > 0 && !toremove)))
+        {
+            int64_t lower = ZSetRankCountScore(ctx, key, meta, range.min.GetFloat64(), !range.contain_min);
+            int64_t upper = ZSetRankCountScore(ctx, key, meta, range.max.GetFloat64(), range.contain_max);
+            if (countrange)
+            {
+                reply.SetInteger(upper > lower ? upper - lower : 0);
+                return 0;
+            }
+            if (lower + limit_offset >= upper)
+            {
+                return 0;
+            }
+            if (reverse)
+            {
+                ctx.flags.iterate_total_order = 1;
+            }
+            iter = ZSetRankSeek(ctx, key, reverse ? upper - 1 - limit_offset : lower + limit_offset);
+            if (NULL != iter)
+            {
+                range_cursor = limit_offset;
+            }
+        }
+        RedisReplyWriter writer(reply, toremove || countrange ? NULL : ctx.reply_buffer);
+        if (!toremove && !countrange)
+        {
+            writer.BeginArray();
+        }
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
-        sort_key.SetZSetScore(reverse ? range.max.GetFloat64() : range.min.GetFloat64());
+        /*
+         * reverse iteration starts after all elements with max score
+         */
+        sort_key.SetZSetScore(reverse ? nextafter(range.max.GetFloat64(), HUGE_VAL) : range.min.GetFloat64());
         if (reverse)
         {
             ctx.flags.iterate_total_order = 1;
         }
-        Iterator* iter = m_engine->Find(ctx, sort_key);
-        if (reverse && !iter->Valid())
+        if (NULL == iter)
         {
-            iter->JumpToLast();
+            iter = FindElements(ctx, sort_key, meta);
+            if (reverse && !iter->Valid())
+            {
+                iter->JumpToLast();
+            }
         }
-        int64_t range_cursor = 0;
-        int64_t range_count = 0;
         bool first_iter = true;
         while (iter->Valid())
         {
@@ -484,21 +1259,30 @@ OP_NAMESPACE_BEGIN
                 {
                     if (toremove)
                     {
-                        KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
-                        score_key.SetZSetMember(field.GetZSetMember());
-                        //RemoveKey(ctx, field);
-                        RemoveKey(ctx, score_key);
-                        iter->Del();
+                        if (meta.IsCompact())
+                        {
+                            compact_removed.insert(field.GetZSetMember());
+                        }
+                        else
+                        {
+                            KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
+                            score_key.SetZSetMember(field.GetZSetMember());
+                            //RemoveKey(ctx, field);
+                            RemoveKey(ctx, score_key);
+                            if (rank_indexed)
+                            {
+                                ZSetRankUpdate(rank_deltas, field.GetZSetScore(), field.GetZSetMember(), -1);
+                            }
+                            iter->Del();
+                        }
                         removed++;
                     }
                     else if (!countrange)
                     {
-                        RedisReply& r1 = reply.AddMember();
-                        r1.SetString(field.GetZSetMember());
+                        writer.AddString(field.GetZSetMember());
                         if (withscores)
                         {
-                            RedisReply& r2 = reply.AddMember();
-                            r2.SetDouble(field.GetZSetScore());
+                            writer.AddDouble(field.GetZSetScore());
                         }
                     }
                     range_count++;
@@ -523,6 +1307,14 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                if (rank_indexed)
+                {
+                    ZSetRankFlush(ctx, key, rank_deltas);
+                }
+                if (meta.IsCompact())
+                {
+                    CompactErase(meta, compact_removed);
+                }
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -568,15 +1360,28 @@ OP_NAMESPACE_BEGIN
         ZScore(ctx, cmd);
         if (reply.type == REDIS_REPLY_DOUBLE)
         {
-            //double score = reply.GetDouble();
+            double score = reply.GetDouble();
             Data member;
             member.SetString(cmd.GetArguments()[1], false);
+            KeyObject key(ctx.ns, KEY_META, cmd.GetArguments()[0]);
+            ValueObject meta;
+            if (0 == m_engine->Get(ctx, key, meta) && meta.GetType() == KEY_ZSET
+                    && meta.GetMetaObject().zset_rank_indexed)
+            {
+                int64_t rank = ZSetRankOf(ctx, key, score, member);
+                if (cmd.GetType() == REDIS_CMD_ZREVRANK)
+                {
+                    rank = meta.GetObjectLen() - 1 - rank;
+                }
+                reply.SetInteger(rank);
+                return 0;
+            }
             KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
             if (cmd.GetType() == REDIS_CMD_ZREVRANK)
             {
                 ctx.flags.iterate_total_order = 1;
             }
-            Iterator* iter = m_engine->Find(ctx, sort_key);
+            Iterator* iter = FindElements(ctx, sort_key, meta);
             if (cmd.GetType() == REDIS_CMD_ZREVRANK)
             {
                 iter->JumpToLast();
@@ -650,22 +1455,64 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         int64_t removed = 0;
+        if (vs[0].IsCompact())
+        {
+            DataSet members;
+            for (size_t i = 1; i < keys.size(); i++)
+            {
+                members.insert(keys[i].GetZSetMember());
+            }
+            removed = CompactErase(vs[0], members);
+            if (removed > 0)
+            {
+                WriteBatchGuard batch(ctx, m_engine);
+                vs[0].SetObjectLen(vs[0].GetObjectLen() - removed);
+                if (vs[0].GetObjectLen() == 0)
+                {
+                    RemoveKey(ctx, keys[0]);
+                }
+                else
+                {
+                    SetKeyValue(ctx, keys[0], vs[0]);
+                }
+            }
+            if (0 != ctx.transc_err)
+            {
+                reply.SetErrCode(ctx.transc_err);
+            }
+            else
+            {
+                reply.SetInteger(removed);
+            }
+            return 0;
+        }
+        bool rank_indexed = vs[0].GetMetaObject().zset_rank_indexed;
+        ZSetRankDeltas rank_deltas;
+        StringTreeSet removed_members;
         {
             WriteBatchGuard batch(ctx, m_engine);
             for (size_t i = 1; i < vs.size(); i++)
             {
-                if (vs[i].GetType() == KEY_ZSET_SCORE)
+                if (vs[i].GetType() == KEY_ZSET_SCORE && removed_members.insert(cmd.GetArguments()[i]).second)
                 {
                     KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, cmd.GetArguments()[0]);
                     sort_key.SetZSetMember(keys[i].GetZSetMember());
                     sort_key.SetZSetScore(vs[i].GetZSetScore());
                     RemoveKey(ctx, sort_key);
                     RemoveKey(ctx, keys[i]);
+                    if (rank_indexed)
+                    {
+                        ZSetRankUpdate(rank_deltas, vs[i].GetZSetScore(), keys[i].GetZSetMember(), -1);
+                    }
                     removed++;
                 }
             }
             if (removed > 0)
             {
+                if (rank_indexed)
+                {
+                    ZSetRankFlush(ctx, keys[0], rank_deltas);
+                }
                 vs[0].SetObjectLen(vs[0].GetObjectLen() - removed);
                 SetKeyValue(ctx, keys[0], vs[0]);
             }
@@ -685,9 +1532,13 @@ OP_NAMESPACE_BEGIN
     {
         KeyObject score_key(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
         score_key.SetZSetMember(cmd.GetArguments()[1]);
-        ValueObject score;
+        KeyObjectArray keys(1, score_key);
+        ValueObjectArray vals;
+        ErrCodeArray errs;
         RedisReply& reply = ctx.GetReply();
-        int err = m_engine->Get(ctx, score_key, score);
+        MultiGetElements(ctx, keys, vals, errs);
+        int err = errs[0];
+        ValueObject& score = vals[0];
         if (0 != err)
         {
             if (err != ERR_ENTRY_NOT_EXIST)
@@ -767,13 +1618,16 @@ OP_NAMESPACE_BEGIN
         {
             return 0;
         }
+        bool rank_indexed = meta.GetMetaObject().zset_rank_indexed;
+        ZSetRankDeltas rank_deltas;
+        DataSet compact_removed;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SCORE, key.GetKey());
         sort_key.SetZSetMember(reverse ? range.max : range.min);
         if (reverse)
         {
             ctx.flags.iterate_total_order = 1;
         }
-        Iterator* iter = m_engine->Find(ctx, sort_key);
+        Iterator* iter = FindElements(ctx, sort_key, meta);
         if (reverse && !iter->Valid())
         {
             iter->JumpToLast();
@@ -811,11 +1665,22 @@ OP_NAMESPACE_BEGIN
                 {
                     if (toremove)
                     {
-                        KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
-                        sort_key.SetZSetMember(field.GetZSetMember());
-                        sort_key.SetZSetScore(iter->Value().GetZSetScore());
-                        RemoveKey(ctx, sort_key);
-                        iter->Del();
+                        if (meta.IsCompact())
+                        {
+                            compact_removed.insert(field.GetZSetMember());
+                        }
+                        else
+                        {
+                            KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, key.GetKey());
+                            sort_key.SetZSetMember(field.GetZSetMember());
+                            sort_key.SetZSetScore(iter->Value().GetZSetScore());
+                            RemoveKey(ctx, sort_key);
+                            if (rank_indexed)
+                            {
+                                ZSetRankUpdate(rank_deltas, sort_key.GetZSetScore(), sort_key.GetZSetMember(), -1);
+                            }
+                            iter->Del();
+                        }
                         removed++;
                     }
                     else if (!countrange)
@@ -845,6 +1710,14 @@ OP_NAMESPACE_BEGIN
         {
             if (removed > 0)
             {
+                if (rank_indexed)
+                {
+                    ZSetRankFlush(ctx, key, rank_deltas);
+                }
+                if (meta.IsCompact())
+                {
+                    CompactErase(meta, compact_removed);
+                }
                 meta.SetObjectLen(meta.GetObjectLen() - removed);
                 if (meta.GetObjectLen() == 0)
                 {
@@ -1099,7 +1972,12 @@ OP_NAMESPACE_BEGIN
                     continue;
                 }
                 KeyObject ele(ctx.ns, (KeyType) element_type((KeyType) vs[i].GetType()), keys[i].GetKey());
-                if (NULL != iter)
+                Iterator* compact_iter = NULL;
+                if (vs[i].IsCompact())
+                {
+                    compact_iter = FindElements(ctx, ele, vs[i]);
+                }
+                else if (NULL != iter)
                 {
                     iter->Jump(ele);
                 }
@@ -1107,9 +1985,10 @@ OP_NAMESPACE_BEGIN
                 {
                     iter = m_engine->Find(ctx, ele);
                 }
-                while (NULL != iter && iter->Valid())
+                Iterator* cursor = NULL != compact_iter ? compact_iter : iter;
+                while (NULL != cursor && cursor->Valid())
                 {
-                    KeyObject& k = iter->Key(true);
+                    KeyObject& k = cursor->Key(true);
                     if (k.GetType() != ele.GetType() || k.GetKey() != keys[i].GetKey()
                             || k.GetNameSpace() != keys[i].GetNameSpace())
                     {
@@ -1118,7 +1997,7 @@ OP_NAMESPACE_BEGIN
                     double score = 1.0;
                     if (k.GetType() == KEY_ZSET_SCORE)
                     {
-                        score = iter->Value().GetZSetScore();
+                        score = cursor->Value().GetZSetScore();
                     }
                     score = weights[i] * score;
                     DataScoreMap& result_map = inter_union_result[result_cursor];
@@ -1129,8 +2008,9 @@ OP_NAMESPACE_BEGIN
                         zunionInterAggregate(&score, ret.first->second, aggregate);
                         ret.first->second = score;
                     }
-                    iter->Next();
+                    cursor->Next();
                 }
+                DELETE(compact_iter);
             }
             DELETE(iter);
         }
@@ -1139,12 +2019,40 @@ OP_NAMESPACE_BEGIN
             DelKey(ctx, destkey);
         }
 
+        if (!inter_union_result[result_cursor].empty()
+                && (size_t) inter_union_result[result_cursor].size() <= (size_t) GetConf().zset_max_compact_entries)
+        {
+            DataArray zelements;
+            DataScoreMap::iterator it = inter_union_result[result_cursor].begin();
+            while (it != inter_union_result[result_cursor].end())
+            {
+                Data member, score;
+                member.SetString(it->first.AsString(), false);
+                score.SetFloat64(it->second);
+                bool found = false;
+                size_t pos = CompactLocate(KEY_ZSET, zelements, member, found);
+                zelements.insert(zelements.begin() + pos, score);
+                zelements.insert(zelements.begin() + pos, member);
+                it++;
+            }
+            if (CompactFits(ctx, KEY_ZSET, zelements))
+            {
+                ValueObject dest_meta;
+                dest_meta.SetType(KEY_ZSET);
+                CompactSave(ctx, destkey, dest_meta, zelements);
+                reply.SetInteger(inter_union_result[result_cursor].size());
+                return 0;
+            }
+        }
         if (!inter_union_result[result_cursor].empty())
         {
             DataScoreMap::iterator it = inter_union_result[result_cursor].begin();
             ValueObject dest_meta;
             dest_meta.SetType(KEY_ZSET);
             dest_meta.SetObjectLen(inter_union_result[result_cursor].size());
+            bool rank_indexed = ZSetRankIndexNeeded(dest_meta, dest_meta.GetObjectLen());
+            dest_meta.GetMetaObject().zset_rank_indexed = rank_indexed;
+            ZSetRankDeltas rank_deltas;
             while (it != inter_union_result[result_cursor].end())
             {
                 KeyObject element(ctx.ns, KEY_ZSET_SCORE, cmd.GetArguments()[0]);
@@ -1159,8 +2067,16 @@ OP_NAMESPACE_BEGIN
                 ValueObject sort_value;
                 sort_value.SetType(KEY_ZSET_SORT);
                 SetKeyValue(ctx, sort, sort_value);
+                if (rank_indexed)
+                {
+                    ZSetRankUpdate(rank_deltas, it->second, it->first, 1);
+                }
                 it++;
             }
+            if (rank_indexed)
+            {
+                ZSetRankFlush(ctx, destkey, rank_deltas);
+            }
             dest_meta.SetMinData(inter_union_result[result_cursor].begin()->first);
             dest_meta.SetMaxData(inter_union_result[result_cursor].rbegin()->first);
             SetKeyValue(ctx, destkey, dest_meta);
@@ -1206,12 +2122,14 @@ OP_NAMESPACE_BEGIN
         ctx.flags.iterate_total_order = 1;
         KeyObject sort_key(ctx.ns, KEY_ZSET_SORT, keystr);
         sort_key.SetZSetScore(reverse ? DBL_MAX : -DBL_MAX);
-        Iterator* iter = m_engine->Find(ctx, sort_key);
+        Iterator* iter = FindElements(ctx, sort_key, *meta);
         if (reverse && !iter->Valid())
         {
             iter->JumpToLast();
         }
         bool first_iter = true;
+        ZSetRankDeltas rank_deltas;
+        DataSet compact_removed;
         WriteBatchGuard batch(ctx, m_engine);
         while (iter->Valid() && count > 0)
         {
@@ -1234,10 +2152,21 @@ OP_NAMESPACE_BEGIN
             RedisReply& r2 = reply.AddMember();
             r2.SetString(field.GetZSetMember());
 
-            KeyObject sk(ctx.ns, KEY_ZSET_SCORE, keystr);
-            sk.SetZSetMember(field.GetZSetMember());
-            m_engine->Del(ctx, sk);
-            iter->Del();
+            if (meta->IsCompact())
+            {
+                compact_removed.insert(field.GetZSetMember());
+            }
+            else
+            {
+                KeyObject sk(ctx.ns, KEY_ZSET_SCORE, keystr);
+                sk.SetZSetMember(field.GetZSetMember());
+                m_engine->Del(ctx, sk);
+                if (meta->GetMetaObject().zset_rank_indexed)
+                {
+                    ZSetRankUpdate(rank_deltas, field.GetZSetScore(), field.GetZSetMember(), -1);
+                }
+                iter->Del();
+            }
             meta->SetObjectLen(meta->GetObjectLen() - 1);
             if (reverse)
             {
@@ -1249,7 +2178,15 @@ OP_NAMESPACE_BEGIN
             }
         }
         DELETE(iter);
+        if (meta->IsCompact())
+        {
+            CompactErase(*meta, compact_removed);
+        }
         KeyObject mk(ctx.ns, KEY_META, keystr);
+        if (meta->GetMetaObject().zset_rank_indexed)
+        {
+            ZSetRankFlush(ctx, mk, rank_deltas);
+        }
         if (0 == meta->GetObjectLen())
         {
             m_engine->Del(ctx, mk);
@@ -55,6 +55,7 @@
 #include "channel/codec/int_header_frame_decoder.hpp"
 #include "channel/codec/delimiter_frame_decoder.hpp"
 #include "channel/codec/redis_message_codec.hpp"
+#include "channel/codec/redis_reply_writer.hpp"
 #include <errno.h>
 
 namespace ardb
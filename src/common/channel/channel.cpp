@@ -47,6 +47,7 @@ static SpinMutexLock g_channel_id_mutex;
 void Channel::IOEventCallback(struct aeEventLoop *eventLoop, int fd, void *clientData, int mask)
 {
     Channel* channel = (Channel*) clientData;
+    uint64 start = channel->m_service->m_rebalance_threshold > 0 ? get_current_epoch_micros() : 0;
     bool fired = false;
     if (mask & AE_READABLE)
     {
@@ -60,13 +61,17 @@ void Channel::IOEventCallback(struct aeEventLoop *eventLoop, int fd, void *clien
             channel->OnWrite();
         }
     }
+    if (start > 0)
+    {
+        channel->AddBusyTime(get_current_epoch_micros() - start);
+    }
 }
 
 Channel::Channel(Channel* parent, ChannelService& service) :
         m_user_configed(false), m_has_removed(false), m_parent_id(0), m_service(&service), m_id(0), m_fd(-1), m_flush_timertask_id(-1), m_pipeline_initializor(
         NULL), m_pipeline_initailizor_user_data(NULL), m_pipeline_finallizer(
         NULL), m_pipeline_finallizer_user_data(NULL), m_detached(false), m_close_after_write(false), m_block_read(false), m_file_sending(
-        NULL), m_attach(NULL), m_attach_destructor(NULL)
+        NULL), m_attach(NULL), m_attach_destructor(NULL), m_busy_usecs(0), m_last_busy_usecs(0), m_load_epoch(0)
 {
 
     {
@@ -84,6 +89,28 @@ Channel::Channel(Channel* parent, ChannelService& service) :
     }
 }
 
+void Channel::AddBusyTime(uint64 usecs)
+{
+    uint32 epoch = m_service->m_load_epoch;
+    if (m_load_epoch != epoch)
+    {
+        m_last_busy_usecs = (m_load_epoch + 1 == epoch) ? m_busy_usecs : 0;
+        m_busy_usecs = 0;
+        m_load_epoch = epoch;
+    }
+    m_busy_usecs += usecs;
+}
+
+uint64 Channel::GetLastBusyTime()
+{
+    uint32 epoch = m_service->m_load_epoch;
+    if (m_load_epoch == epoch)
+    {
+        return m_last_busy_usecs;
+    }
+    return m_load_epoch + 1 == epoch ? m_busy_usecs : 0;
+}
+
 int Channel::GetWriteFD()
 {
     return m_fd;
@@ -120,6 +147,7 @@ bool Channel::UnblockRead()
     if(m_inputBuffer.ReadableBytes() > 0)
     {
         fire_message_received<Buffer>(this, &m_inputBuffer, NULL);
+        fire_channel_read_complete(this);
     }
     return true;
 }
@@ -558,6 +586,7 @@ void Channel::OnRead()
         //TRACE_LOG(
         //        "DataReceived with %d bytes in channel %u.", m_inputBuffer.ReadableBytes(), GetID());
         fire_message_received<Buffer>(this, &m_inputBuffer, NULL);
+        fire_channel_read_complete(this);
     }
     else
     {
@@ -587,6 +616,22 @@ void Channel::OnWrite()
     }
     if (NULL != m_file_sending)
     {
+        if (NULL != m_file_sending->guard && !m_file_sending->guard(m_file_sending->data, m_file_sending->file_rest_len))
+        {
+            if (m_file_sending->close_fd)
+            {
+                close(m_file_sending->fd);
+            }
+            IOCallback* cb = m_file_sending->on_failure;
+            void* cbdata = m_file_sending->data;
+            DELETE(m_file_sending);
+            if (NULL != cb)
+            {
+                cb(cbdata);
+            }
+            Close();
+            return;
+        }
         EnableWriting();
         off_t len = m_file_sending->file_rest_len;
 #if defined(__APPLE__)
@@ -617,7 +662,10 @@ void Channel::OnWrite()
 
         if (m_file_sending->file_rest_len == 0)
         {
-            close(m_file_sending->fd);
+            if (m_file_sending->close_fd)
+            {
+                close(m_file_sending->fd);
+            }
             m_file_sending->fd = -1;
             if (NULL != m_file_sending->on_complete)
             {
@@ -634,7 +682,7 @@ void Channel::OnWrite()
         }
     }
     fire_channel_writable(this);
-    if (!m_outputBuffer.Readable() && m_options.auto_disable_writing)
+    if (!m_outputBuffer.Readable() && NULL == m_file_sending && m_options.auto_disable_writing)
     {
         DisableWriting();
     }
@@ -714,7 +762,10 @@ bool Channel::DoClose(bool inDestructor)
 
     if (NULL != m_file_sending)
     {
-        close(m_file_sending->fd);
+        if (m_file_sending->close_fd)
+        {
+            close(m_file_sending->fd);
+        }
         m_file_sending->fd = -1;
         if (NULL != m_file_sending->on_failure)
         {
@@ -126,6 +126,7 @@ namespace ardb
     };
 
     typedef void IOCallback(void* data);
+    typedef bool SendFileGuard(void* data, off_t file_rest_len);
     struct SendFileSetting
     {
             int fd;
@@ -134,9 +135,11 @@ namespace ardb
             void* data;
             IOCallback* on_complete;
             IOCallback* on_failure;
+            SendFileGuard* guard; /* checked before every partial send, the sending fails if it returns false */
+            bool close_fd; /* close the fd after the file is sent or failed */
             SendFileSetting() :
                     fd(-1), file_offset(0), file_rest_len(0), data(NULL), on_complete(
-                    NULL), on_failure(NULL)
+                    NULL), on_failure(NULL), guard(NULL), close_fd(true)
             {
             }
     };
@@ -183,6 +186,13 @@ namespace ardb
             void* m_attach;
             AttachDestructor* m_attach_destructor;
 
+            /*
+             * time spent in io callbacks within the current & the last load period of the service
+             */
+            uint64 m_busy_usecs;
+            uint64 m_last_busy_usecs;
+            uint32 m_load_epoch;
+
             Channel(Channel* parent, ChannelService& factory);
 
             void Run();
@@ -207,6 +217,8 @@ namespace ardb
 
             void CancelFlushTimerTask();
             void CreateFlushTimerTask();
+            void AddBusyTime(uint64 usecs);
+            uint64 GetLastBusyTime();
 
             friend class ChannelService;
         public:
@@ -32,13 +32,34 @@
 #include "util/datagram_packet.hpp"
 #include "buffer/buffer_helper.hpp"
 #include <list>
+#include <algorithm>
+#include <functional>
 
 using namespace ardb;
 
+/*
+ * max channels moved from one thread per rebalance
+ */
+static const uint32 kMaxMigrateChannels = 16;
+
+struct MigrateTask
+{
+        ChannelService* source;
+        ChannelService* target;
+        uint64 budget_usecs;
+};
+
+struct MigratingChannel
+{
+        Channel* ch;
+        ChannelService* target;
+};
+
 ChannelService::ChannelService(uint32 setsize)
-        : m_setsize(setsize), m_eventLoop(NULL), m_timer(NULL), m_signal_channel(
+        : m_setsize(setsize), m_eventLoop(NULL), m_timer(NULL), m_timing_wheel(NULL), m_signal_channel(
         NULL), m_self_soft_signal_channel(NULL), m_running(false), m_thread_pool_size(1), m_tid(0), m_lifecycle_callback(
-                NULL), m_pool_index(0), m_parent(NULL)
+                NULL), m_pool_index(0), m_parent(NULL), m_rebalance_threshold(0), m_rebalance_cooldown(0), m_busy_permille(
+                0), m_load_epoch(0), m_last_busy_usecs(0), m_last_load_sample(0)
 {
     m_eventLoop = aeCreateEventLoop(m_setsize);
     m_self_soft_signal_channel = NewSoftSignalChannel();
@@ -90,6 +111,11 @@ uint32 ChannelService::GetThreadPoolSize()
     return m_thread_pool_size;
 }
 
+void ChannelService::SetRebalanceThreshold(uint32 percent)
+{
+    m_rebalance_threshold = percent > 100 ? 100 : percent;
+}
+
 ChannelService& ChannelService::GetNextChannelService()
 {
     static uint32 idx = 0;
@@ -325,7 +351,9 @@ void ChannelService::StartSubPool()
             s->SetParent(this);
             s->m_pool_index = i + 1;
             s->RegisterLifecycleCallback(m_lifecycle_callback);
+            s->m_rebalance_threshold = m_rebalance_threshold;
 //            s->RegisterUserEventCallback(m_user_cb, m_user_cb_data);
+            ShareListeners(s, i);
             m_sub_pool.push_back(s);
             LaunchThread* launch = new LaunchThread(s);
             launch->Start();
@@ -334,6 +362,50 @@ void ChannelService::StartSubPool()
     }
 }
 
+/*
+ * bind a SO_REUSEPORT listener of the sub service for every reuse port server socket, must be invoked
+ * before the sub service's thread started.
+ */
+void ChannelService::ShareListeners(ChannelService* sub, uint32 sub_idx)
+{
+    ChannelTable::iterator it = m_channel_table.begin();
+    while (it != m_channel_table.end())
+    {
+        Channel* ch = it->second;
+        it++;
+        if ((ch->GetID() & 0xF) != TCP_SERVER_SOCKET_CHANNEL_ID_BIT_MASK)
+        {
+            continue;
+        }
+        ServerSocketChannel* server = (ServerSocketChannel*) ch;
+        if (!server->IsReusePort() || sub_idx < server->m_pool_min || sub_idx >= server->m_pool_max)
+        {
+            continue;
+        }
+        ServerSocketChannel* listener = sub->NewServerSocketChannel();
+        listener->EnableReusePort();
+        if (!listener->Bind(&(server->m_bind_address)) || !listener->IsReusePort())
+        {
+            WARN_LOG("Failed to bind %s with SO_REUSEPORT in thread:%u, connections are accepted by main thread.", server->GetStringAddress().c_str(), sub->m_pool_index);
+            sub->DeleteChannel(listener);
+            continue;
+        }
+        if (server->m_user_configed)
+        {
+            listener->Configure(server->m_options);
+        }
+        if (NULL != server->m_pipeline_initializor)
+        {
+            listener->SetChannelPipelineInitializor(server->m_pipeline_initializor, server->m_pipeline_initailizor_user_data);
+        }
+        if (NULL != server->m_pipeline_finallizer)
+        {
+            listener->SetChannelPipelineFinalizer(server->m_pipeline_finallizer, server->m_pipeline_finallizer_user_data);
+        }
+        listener->m_adress_str = server->m_adress_str;
+    }
+}
+
 void ChannelService::Start()
 {
     if (!m_running)
@@ -407,6 +479,15 @@ Timer& ChannelService::GetTimer()
     return *m_timer;
 }
 
+TimingWheel& ChannelService::GetTimingWheel()
+{
+    if (NULL == m_timing_wheel)
+    {
+        m_timing_wheel = new TimingWheel(GetTimer());
+    }
+    return *m_timing_wheel;
+}
+
 SignalChannel& ChannelService::GetSignalChannel()
 {
     if (NULL == m_signal_channel)
@@ -556,9 +637,168 @@ void ChannelService::DeleteChannel(Channel* ch)
 void ChannelService::Run()
 {
     VerifyRemoveQueue();
+    SampleLoad();
+    Rebalance();
     Routine();
 }
 
+void ChannelService::SampleLoad()
+{
+    uint64 now = get_current_epoch_micros();
+    uint64 busy = aeGetBusyTime(m_eventLoop);
+    if (m_last_load_sample > 0 && now > m_last_load_sample)
+    {
+        uint64 permille = (busy - m_last_busy_usecs) * 1000 / (now - m_last_load_sample);
+        uint32 busy_permille = permille > 1000 ? 1000 : permille;
+        uint32 old = GetBusyPermille();
+        while (!atomic_cmp_set_uint32(&m_busy_permille, old, busy_permille))
+        {
+            old = GetBusyPermille();
+        }
+    }
+    m_last_load_sample = now;
+    m_last_busy_usecs = busy;
+    m_load_epoch++;
+}
+
+void ChannelService::Rebalance()
+{
+    if (0 == m_rebalance_threshold || m_sub_pool.size() < 2)
+    {
+        return;
+    }
+    if (m_rebalance_cooldown > 0)
+    {
+        /*
+         * wait the migrated channels reflected in the load samples of both threads
+         */
+        m_rebalance_cooldown--;
+        return;
+    }
+    ChannelService* busiest = m_sub_pool[0];
+    ChannelService* idlest = m_sub_pool[0];
+    uint32 max_permille = busiest->GetBusyPermille();
+    uint32 min_permille = max_permille;
+    for (size_t i = 1; i < m_sub_pool.size(); i++)
+    {
+        uint32 permille = m_sub_pool[i]->GetBusyPermille();
+        if (permille > max_permille)
+        {
+            busiest = m_sub_pool[i];
+            max_permille = permille;
+        }
+        if (permille < min_permille)
+        {
+            idlest = m_sub_pool[i];
+            min_permille = permille;
+        }
+    }
+    uint32 gap = max_permille - min_permille;
+    if (gap < m_rebalance_threshold * 10)
+    {
+        return;
+    }
+    MigrateTask* task = new MigrateTask;
+    task->source = busiest;
+    task->target = idlest;
+    /*
+     * move about half of the gap, the channels' busy time is measured in the last one second period
+     */
+    task->budget_usecs = (uint64) gap * 1000 / 2;
+    busiest->AsyncIO(0, MigrateChannelsCB, task);
+    m_rebalance_cooldown = 2;
+}
+
+void ChannelService::MigrateChannelsCB(Channel*, void* data)
+{
+    MigrateTask* task = (MigrateTask*) data;
+    task->source->MigrateChannels(task->target, task->budget_usecs);
+    delete task;
+}
+
+void ChannelService::AcceptMigratedChannelCB(Channel*, void* data)
+{
+    MigratingChannel* migrating = (MigratingChannel*) data;
+    Channel* ch = migrating->ch;
+    ChannelService* serv = migrating->target;
+    delete migrating;
+    ch->m_service = serv;
+    ch->m_load_epoch = serv->m_load_epoch;
+    ch->m_busy_usecs = 0;
+    ch->m_last_busy_usecs = 0;
+    serv->m_channel_table[ch->GetID()] = ch;
+    if (aeCreateFileEvent(serv->GetRawEventLoop(), ch->m_fd, AE_READABLE, Channel::IOEventCallback, ch) == AE_ERR)
+    {
+        int err = errno;
+        ERROR_LOG("Failed to add event for migrated channel for fd:%d for reason:%s", ch->m_fd, strerror(err));
+        ch->Close();
+        return;
+    }
+    ch->m_detached = false;
+    if (NULL != serv->m_lifecycle_callback)
+    {
+        serv->m_lifecycle_callback->OnChannelMigrateIn(serv, ch);
+    }
+}
+
+bool ChannelService::IsMigratable(Channel* ch)
+{
+    /*
+     * only accepted tcp channels idle between requests, all their states are owned by the channel itself
+     */
+    return (ch->GetID() & 0xF) == TCP_CLIENT_SOCKET_CHANNEL_ID_BIT_MASK && 0 != ch->m_parent_id && ch->m_fd > 0
+            && !ch->m_detached && !ch->m_block_read && !ch->m_has_removed && !ch->m_close_after_write
+            && NULL == ch->m_file_sending && -1 == ch->m_flush_timertask_id && !ch->m_inputBuffer.Readable()
+            && !ch->m_outputBuffer.Readable();
+}
+
+void ChannelService::MigrateChannels(ChannelService* target, uint64 budget_usecs)
+{
+    if (NULL == m_lifecycle_callback)
+    {
+        return;
+    }
+    typedef std::vector<std::pair<uint64, Channel*> > CandidateArray;
+    CandidateArray candidates;
+    ChannelTable::iterator it = m_channel_table.begin();
+    while (it != m_channel_table.end())
+    {
+        Channel* ch = it->second;
+        it++;
+        uint64 busy = ch->GetLastBusyTime();
+        if (busy > 0 && busy <= budget_usecs && IsMigratable(ch))
+        {
+            candidates.push_back(std::make_pair(busy, ch));
+        }
+    }
+    /*
+     * heaviest first, a channel heavier than the budget would only move the hotspot
+     */
+    std::sort(candidates.begin(), candidates.end(), std::greater<std::pair<uint64, Channel*> >());
+    uint32 moved = 0;
+    for (size_t i = 0; i < candidates.size() && moved < kMaxMigrateChannels; i++)
+    {
+        uint64 busy = candidates[i].first;
+        Channel* ch = candidates[i].second;
+        if (busy > budget_usecs || !m_lifecycle_callback->OnChannelMigrateOut(this, ch))
+        {
+            continue;
+        }
+        ch->DetachFD();
+        m_channel_table.erase(ch->GetID());
+        MigratingChannel* migrating = new MigratingChannel;
+        migrating->ch = ch;
+        migrating->target = target;
+        target->AsyncIO(0, AcceptMigratedChannelCB, migrating);
+        budget_usecs -= busy;
+        moved++;
+    }
+    if (moved > 0)
+    {
+        DEBUG_LOG("Migrate %u channels from thread:%u to thread:%u", moved, m_pool_index, target->m_pool_index);
+    }
+}
+
 int ChannelService::AsyncIO(const ChannelAsyncIOContext& ctx, bool wait)
 {
     m_async_io_queue.Push(ctx);
@@ -670,6 +910,10 @@ int ChannelService::AsyncIO(uint32 id, ChannelAsyncIOCallback* cb, void* data, b
 
 ChannelService::~ChannelService()
 {
+    /*
+     * drop the wheel while its timer is still alive, entries destroyed with the channels are unlinked already
+     */
+    DELETE(m_timing_wheel);
     CloseAllChannels(false);
     aeDeleteEventLoop(m_eventLoop);
     ThreadVector::iterator tit = m_sub_pool_ts.begin();
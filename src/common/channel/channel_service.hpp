@@ -33,6 +33,7 @@
 #include "util/datagram_packet.hpp"
 //#include "util/zmq/ypipe.hpp"
 #include "util/concurrent_queue.hpp"
+#include "util/atomic.hpp"
 #include "thread/thread.hpp"
 #include "channel/channel_event.hpp"
 #include "channel/timer/timer_channel.hpp"
@@ -43,6 +44,7 @@
 #include "channel/socket/serversocket_channel.hpp"
 #include "channel/fifo/fifo_channel.hpp"
 #include "timer/timer.hpp"
+#include "timer/timing_wheel.hpp"
 #include <list>
 #include <utility>
 
@@ -69,6 +71,20 @@ namespace ardb
             virtual void OnStart(ChannelService* serv, uint32 idx) = 0;
             virtual void OnStop(ChannelService* serv, uint32 idx) = 0;
             virtual void OnRoutine(ChannelService* serv, uint32 idx) = 0;
+            /*
+             * invoked in the loop thread of 'serv' before an accepted channel moves to a lighter loaded
+             * thread, return false to keep the channel.
+             */
+            virtual bool OnChannelMigrateOut(ChannelService* serv, Channel* ch)
+            {
+                return false;
+            }
+            /*
+             * invoked in the loop thread of 'serv' after the channel moved in
+             */
+            virtual void OnChannelMigrateIn(ChannelService* serv, Channel* ch)
+            {
+            }
             virtual ~ChannelServiceLifeCycle()
             {
             }
@@ -92,6 +108,7 @@ namespace ardb
             uint32 m_setsize;
             aeEventLoop* m_eventLoop;
             TimerChannel* m_timer;
+            TimingWheel* m_timing_wheel;
             SignalChannel* m_signal_channel;
             SoftSignalChannel* m_self_soft_signal_channel;
             RemoveChannelQueue m_remove_queue;
@@ -120,6 +137,19 @@ namespace ardb
 
             ChannelService* m_parent;
 
+            /*
+             * load balancing between sub pool threads:
+             * every second each thread samples the ratio(permille) of time it spent processing events,
+             * the parent moves accepted channels from the busiest thread to the idlest one once the gap
+             * exceeds 'm_rebalance_threshold' percent.
+             */
+            uint32 m_rebalance_threshold;
+            uint32 m_rebalance_cooldown;
+            volatile uint32 m_busy_permille;
+            uint32 m_load_epoch;
+            uint64 m_last_busy_usecs;
+            uint64 m_last_load_sample;
+
             bool EventSunk(ChannelPipeline* pipeline, ChannelEvent& e)
             {
                 ERROR_LOG("Not support this operation!Please register a channel handler to handle this event.");
@@ -151,7 +181,14 @@ namespace ardb
             void RemoveChannel(Channel* ch);
             void VerifyRemoveQueue();
             void StartSubPool();
+            void ShareListeners(ChannelService* sub, uint32 sub_idx);
             void AttachAcceptedChannel(SocketChannel *ch);
+            void SampleLoad();
+            void Rebalance();
+            bool IsMigratable(Channel* ch);
+            void MigrateChannels(ChannelService* target, uint64 budget_usecs);
+            static void MigrateChannelsCB(Channel*, void*);
+            static void AcceptMigratedChannelCB(Channel*, void*);
             int AsyncIO(const ChannelAsyncIOContext& ctx, bool wait);
             void Routine();
             void SetParent(ChannelService* parent)
@@ -168,11 +205,26 @@ namespace ardb
             {
                 return m_pool_index;
             }
+            /*
+             * 0 disables migrating channels between sub pool threads
+             */
+            void SetRebalanceThreshold(uint32 percent);
+            /*
+             * written by the sub pool thread itself and read by the parent, so accessed by atomic ops
+             */
+            uint32 GetBusyPermille() const
+            {
+                return atomic_add_uint32(const_cast<volatile uint32*>(&m_busy_permille), 0);
+            }
 
             void Wakeup();
             bool IsInLoopThread() const;
             Channel* GetChannel(uint32 channelID);
             Timer& GetTimer();
+            /*
+             * per thread timing wheel for the large amount of per connection deadlines, only usable in loop thread
+             */
+            TimingWheel& GetTimingWheel();
             SignalChannel& GetSignalChannel();
             SoftSignalChannel* NewSoftSignalChannel();
 
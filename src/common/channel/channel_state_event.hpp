@@ -35,7 +35,7 @@ namespace ardb
 {
 	enum ChannelState
 	{
-		OPEN = 1, BOUND = 2, CONNECTED = 3, CLOSED = 4, WRITABLE = 5
+		OPEN = 1, BOUND = 2, CONNECTED = 3, CLOSED = 4, WRITABLE = 5, READ_COMPLETE = 6
 	};
 
 
@@ -74,6 +74,14 @@ namespace ardb
 			{
 				ctx.SendUpstream(e);
 			}
+			/*
+			 * all messages decoded from the last read have been received
+			 */
+			virtual void ChannelReadComplete(ChannelHandlerContext& ctx,
+					ChannelStateEvent& e)
+			{
+				ctx.SendUpstream(e);
+			}
 			virtual void MessageReceived(ChannelHandlerContext& ctx,
 					MessageEvent<T>& e) = 0;
 			bool CanHandleUpstream()
@@ -111,6 +119,11 @@ namespace ardb
 						ChannelWritable(ctx, e);
 						break;
 					}
+					case READ_COMPLETE:
+					{
+						ChannelReadComplete(ctx, e);
+						break;
+					}
 					default:
 					{
 						ctx.SendUpstream(e);
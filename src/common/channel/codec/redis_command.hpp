@@ -142,6 +142,7 @@ namespace ardb
             REDIS_CMD_PFCOUNT = 124,
             REDIS_CMD_PFMERGE = 125,
             REDIS_CMD_SETXX = 126,
+            REDIS_CMD_BITPOS = 127,
 
             //'hash' commands
             REDIS_CMD_HDEL = 150,
@@ -33,6 +33,9 @@
 #include "util/exception/api_exception.hpp"
 #include <string.h>
 #include <limits.h>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 
 using ardb::BufferHelper;
 using namespace ardb::codec;
@@ -40,11 +43,57 @@ using namespace ardb;
 
 #define REDIS_INLINE_MAX_SIZE   (1024*64) /* Max size of inline reads */
 #define REDIS_MBULK_BIG_ARG     (1024*32)
+#define REDIS_BULK_LEN_LINE_MAX 32 /* Max size of a '*<count>\r\n' or '$<len>\r\n' line after the type byte */
 
 /* Client request types */
 static const uint32 REDIS_REQ_INLINE = 1;
 static const uint32 REDIS_REQ_MULTIBULK = 2;
-static const char* kCRLF = "\r\n";
+
+/*
+ * Offset of the first 'c' within 'len' bytes of 's', -1 if not found.
+ * SSE2 tests 16 bytes per compare, so a whole bulk length line is located in one step;
+ * the tail and non SSE2 builds fall back to memchr.
+ */
+static inline int64_t scan_byte(const char* s, size_t len, char c)
+{
+    size_t i = 0;
+#if defined(__SSE2__)
+    const __m128i pattern = _mm_set1_epi8(c);
+    for (; i + 16 <= len; i += 16)
+    {
+        int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (s + i)), pattern));
+        if (0 != mask)
+        {
+            return i + __builtin_ctz(mask);
+        }
+    }
+#endif
+    const char* p = (const char*) memchr(s + i, c, len - i);
+    return NULL == p ? -1 : p - s;
+}
+
+/*
+ * Offset of the first "\r\n" within 'len' bytes of 's', -1 if not found.
+ */
+static inline int64_t scan_crlf(const char* s, size_t len)
+{
+    size_t start = 0;
+    while (start < len)
+    {
+        int64_t cr = scan_byte(s + start, len - start, '\r');
+        if (cr < 0)
+        {
+            return -1;
+        }
+        size_t pos = start + cr;
+        if (pos + 1 < len && s[pos + 1] == '\n')
+        {
+            return pos;
+        }
+        start = pos + 1;
+    }
+    return -1;
+}
 
 int FastRedisCommandDecoder::ProcessMultibulkBuffer(Buffer& buffer, std::string& err)
 {
@@ -57,7 +106,8 @@ int FastRedisCommandDecoder::ProcessMultibulkBuffer(Buffer& buffer, std::string&
         m_cmd.Clear();
         m_argc = 0;
         /* Multi bulk length cannot be read without a \r\n */
-        newline = strchr(buffer.GetRawReadBuffer(), '\r');
+        int64_t cr = scan_byte(buffer.GetRawReadBuffer(), buffer.ReadableBytes(), '\r');
+        newline = cr < 0 ? NULL : buffer.GetRawReadBuffer() + cr;
         if (newline == NULL)
         {
             if (buffer.ReadableBytes() > REDIS_INLINE_MAX_SIZE)
@@ -96,7 +146,8 @@ int FastRedisCommandDecoder::ProcessMultibulkBuffer(Buffer& buffer, std::string&
         /* Read bulk length if unknown */
         if (m_bulklen == -1)
         {
-            newline = strchr(buffer.GetRawReadBuffer() + pos, '\r');
+            int64_t cr = scan_byte(buffer.GetRawReadBuffer() + pos, buffer.ReadableBytes() - pos, '\r');
+            newline = cr < 0 ? NULL : buffer.GetRawReadBuffer() + pos + cr;
             if (newline == NULL)
             {
                 if (buffer.ReadableBytes() > REDIS_INLINE_MAX_SIZE)
@@ -130,7 +181,7 @@ int FastRedisCommandDecoder::ProcessMultibulkBuffer(Buffer& buffer, std::string&
         }
 
         /* Read bulk argument */
-        if (buffer.ReadableBytes() - pos < (unsigned) (m_bulklen + 2))
+        if (buffer.ReadableBytes() - pos < (size_t) (m_bulklen + 2))
         {
             /* Not enough data (+2 == trailing \r\n) */
             break;
@@ -238,11 +289,12 @@ void FastRedisCommandDecoder::MessageReceived(ChannelHandlerContext& ctx, Messag
 
 int RedisCommandDecoder::ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame& frame)
 {
-    int index = buffer.IndexOf(kCRLF, 2);
-    if (-1 == index)
+    int64_t crlf = scan_crlf(buffer.GetRawReadBuffer(), buffer.ReadableBytes());
+    if (-1 == crlf)
     {
         return 0;
     }
+    int index = buffer.GetReadIndex() + crlf;
     while (true)
     {
         char ch;
@@ -261,12 +313,12 @@ int RedisCommandDecoder::ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame&
             buffer.AdvanceReadIndex(2); //skip "\r\n"
             break;
         }
-        int space_index = buffer.IndexOf(" ", 1, current, index);
-        if (-1 == space_index)
+        int64_t space = scan_byte(buffer.GetRawReadBuffer(), index - current, ' ');
+        if (-1 == space)
         {
             break;
         }
-        frame.FillNextArgument(buffer, space_index - current);
+        frame.FillNextArgument(buffer, space);
         buffer.AdvanceReadIndex(1); //skip space char
     }
     int current = buffer.GetReadIndex();
@@ -278,21 +330,34 @@ int RedisCommandDecoder::ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame&
     return 1;
 }
 
+/*
+ * Parse the '<len>\r\n' line at the read index.
+ * return 1 if parsed, 0 if more data is required, -1 if the line does not end with CRLF, -2 if it's not a number
+ */
 static inline int readBulkLen(Buffer& buffer, int& len)
 {
-    char *eptr = NULL;
     const char* raw = buffer.GetRawReadBuffer();
-    int tmp = strtol(raw, &eptr, 10);
-    if ((eptr - raw) > (int64_t)(buffer.ReadableBytes() - 2))
+    size_t readable = buffer.ReadableBytes();
+    int64_t cr = scan_byte(raw, readable < REDIS_BULK_LEN_LINE_MAX ? readable : REDIS_BULK_LEN_LINE_MAX, '\r');
+    if (cr < 0)
+    {
+        return readable < REDIS_BULK_LEN_LINE_MAX ? 0 : -1;
+    }
+    if ((size_t) cr + 1 >= readable)
     {
         return 0;
     }
-    if (*eptr != '\r' || *(eptr + 1) != '\n')
+    if (raw[cr + 1] != '\n')
     {
         return -1;
     }
-    len = tmp;
-    buffer.AdvanceReadIndex(eptr - raw + 2);
+    int64_t tmp = 0;
+    if (!string2ll(raw, cr, &tmp) || tmp > INT_MAX || tmp < INT_MIN)
+    {
+        return -2;
+    }
+    len = (int) tmp;
+    buffer.AdvanceReadIndex(cr + 2);
     return 1;
 }
 
@@ -305,7 +370,7 @@ static inline int readBulkLen(Buffer& buffer, int& len)
         }\
 }while(0)
 
-int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer, RedisCommandFrame& frame)
+int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer, RedisCommandFrame& frame, size_t* pending_bulk)
 {
     if (buffer.ReadableBytes() < 3)  //at least  '0\r\n'
     {
@@ -319,7 +384,14 @@ int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer
     }
     else if (read_len_ret < 0)
     {
-        THROW_DECODE_EX("Protocol error: expected CRLF at bulk length end");
+        if (-1 == read_len_ret)
+        {
+            THROW_DECODE_EX("Protocol error: expected CRLF at bulk length end");
+        }
+        else
+        {
+            THROW_DECODE_EX("Protocol error: invalid multibulk length");
+        }
         return -1;
     }
     if (multibulklen > 512 * 1024 * 1024)
@@ -354,16 +426,27 @@ int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer
         }
         else if (read_len_ret < 0)
         {
-            THROW_DECODE_EX("Protocol error: expected CRLF at bulk length end");
+            if (-1 == read_len_ret)
+            {
+                THROW_DECODE_EX("Protocol error: expected CRLF at bulk length end");
+            }
+            else
+            {
+                THROW_DECODE_EX("Protocol error: invalid bulk length");
+            }
             return -1;
         }
-        if (arglen > 512 * 1024 * 1024)
+        if (arglen < 0 || arglen > 512 * 1024 * 1024)
         {
             THROW_DECODE_EX("Protocol error: invalid bulk length");
             return -1;
         }
         if (buffer.ReadableBytes() < (size_t)(arglen + 2))
         {
+            if (NULL != pending_bulk && arglen >= REDIS_MBULK_BIG_ARG)
+            {
+                *pending_bulk = arglen + 2 - buffer.ReadableBytes();
+            }
             return 0;
         }
         if (buffer.GetRawReadBuffer()[arglen] != '\r' || buffer.GetRawReadBuffer()[arglen + 1] != '\n')
@@ -378,7 +461,7 @@ int RedisCommandDecoder::ProcessMultibulkBuffer(Channel* channel, Buffer& buffer
     return 1;
 }
 
-bool RedisCommandDecoder::Decode(Channel* channel, Buffer& buffer, RedisCommandFrame& msg)
+bool RedisCommandDecoder::Decode(Channel* channel, Buffer& buffer, RedisCommandFrame& msg, size_t* pending_bulk)
 {
     while (buffer.Readable() && (buffer.GetRawReadBuffer()[0] == '\r' || buffer.GetRawReadBuffer()[0] == '\n'))
     {
@@ -393,7 +476,7 @@ bool RedisCommandDecoder::Decode(Channel* channel, Buffer& buffer, RedisCommandF
         {
             //reqtype = REDIS_REQ_MULTIBULK;
             msg.m_is_inline = false;
-            ret = ProcessMultibulkBuffer(channel, buffer, msg);
+            ret = ProcessMultibulkBuffer(channel, buffer, msg, pending_bulk);
         }
         else
         {
@@ -435,7 +518,25 @@ bool RedisCommandDecoder::Decode(ChannelHandlerContext& ctx, Channel* channel, B
         msg.Clear();
         return true;
     }
-    return Decode(channel, buffer, msg);
+    m_pending_bulk = 0;
+    return Decode(channel, buffer, msg, &m_pending_bulk);
+}
+
+bool RedisCommandDecoder::RetainPartialFrame(Channel* channel, Buffer& input)
+{
+    if (NULL == channel || &input != &(channel->GetInputBuffer()))
+    {
+        return false;
+    }
+    if (m_pending_bulk > 0)
+    {
+        /*
+         * the rest of a big bulk argument is read straight behind its header,
+         * so its bytes are copied only once: from the input buffer into the command argument
+         */
+        input.EnsureWritableBytes(m_pending_bulk);
+    }
+    return true;
 }
 
 //===================================encoder==============================
@@ -43,16 +43,21 @@ namespace ardb
         {
             protected:
                 bool m_ignore_empty;
+                /*
+                 * bytes still missing for a big bulk argument which is only partially received
+                 */
+                size_t m_pending_bulk;
                 static int ProcessInlineBuffer(Buffer& buffer, RedisCommandFrame& frame);
-                static int ProcessMultibulkBuffer(Channel* ch, Buffer& buffer, RedisCommandFrame& frame);
+                static int ProcessMultibulkBuffer(Channel* ch, Buffer& buffer, RedisCommandFrame& frame, size_t* pending_bulk);
                 bool Decode(ChannelHandlerContext& ctx, Channel* channel, Buffer& buffer, RedisCommandFrame& msg);
+                bool RetainPartialFrame(Channel* channel, Buffer& input);
                 friend class RedisMessageDecoder;
                 friend class FastRedisCommandDecoder;
             public:
-                RedisCommandDecoder(bool ignore_empty = true):m_ignore_empty(ignore_empty)
+                RedisCommandDecoder(bool ignore_empty = true):m_ignore_empty(ignore_empty), m_pending_bulk(0)
                 {
                 }
-                static bool Decode(Channel* ch, Buffer& buffer, RedisCommandFrame& msg);
+                static bool Decode(Channel* ch, Buffer& buffer, RedisCommandFrame& msg, size_t* pending_bulk = NULL);
         };
 
         class FastRedisCommandDecoder: public ChannelUpstreamHandler<Buffer>
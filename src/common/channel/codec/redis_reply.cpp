@@ -394,6 +394,11 @@ namespace ardb
                     str.assign("WRONGTYPE Key is not a valid HyperLogLog string value.");
                     break;
                 }
+                case ERR_CORRUPTED_VALUE:
+                {
+                    str.assign("INVALIDOBJ Corrupted value detected");
+                    break;
+                }
                 default:
                 {
                     str = g_engine->GetErrorReason(code);
@@ -0,0 +1,265 @@
+/*
+ *Copyright (c) 2013-2014, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "redis_reply_writer.hpp"
+#include "util/string_helper.hpp"
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+#define RESP_SHARED_HEADERS 512
+
+namespace ardb
+{
+    namespace codec
+    {
+        struct RESPSharedHeaders
+        {
+                char array_headers[RESP_SHARED_HEADERS][8];
+                uint8 array_header_lens[RESP_SHARED_HEADERS];
+                char bulk_headers[RESP_SHARED_HEADERS][8];
+                uint8 bulk_header_lens[RESP_SHARED_HEADERS];
+                RESPSharedHeaders()
+                {
+                    for (int i = 0; i < RESP_SHARED_HEADERS; i++)
+                    {
+                        array_header_lens[i] = snprintf(array_headers[i], sizeof(array_headers[i]), "*%d\r\n", i);
+                        bulk_header_lens[i] = snprintf(bulk_headers[i], sizeof(bulk_headers[i]), "$%d\r\n", i);
+                    }
+                }
+        };
+        static RESPSharedHeaders g_shared_headers;
+
+        /*
+         * encode a RESP header into buf which must have at least 32 bytes, returns the header length
+         */
+        static size_t encode_header(char* buf, char prefix, int64 len)
+        {
+            if (len >= 0 && len < RESP_SHARED_HEADERS && (prefix == '*' || prefix == '$'))
+            {
+                size_t n = prefix == '*' ? g_shared_headers.array_header_lens[len] : g_shared_headers.bulk_header_lens[len];
+                memcpy(buf, prefix == '*' ? g_shared_headers.array_headers[len] : g_shared_headers.bulk_headers[len], n);
+                return n;
+            }
+            buf[0] = prefix;
+            size_t n = 1 + ll2string(buf + 1, 29, len);
+            buf[n++] = '\r';
+            buf[n++] = '\n';
+            return n;
+        }
+
+        RedisReplyWriter::RedisReplyWriter(RedisReply& reply, Buffer* wire)
+                : m_reply(reply), m_buffer(wire), m_streamed(false)
+        {
+        }
+
+        RedisReply* RedisReplyWriter::NextReply()
+        {
+            if (NULL != m_buffer && !m_streamed)
+            {
+                /*
+                 * the reply goes to the wire, drop the default reply so that the caller encodes nothing
+                 */
+                m_reply.SetEmpty();
+                m_streamed = true;
+            }
+            if (m_levels.empty())
+            {
+                return NULL != m_buffer ? NULL : &m_reply;
+            }
+            ArrayLevel& level = m_levels.back();
+            level.count++;
+            return NULL != m_buffer ? NULL : &(level.reply->AddMember());
+        }
+
+        void RedisReplyWriter::WriteHeader(char prefix, int64 len)
+        {
+            char buf[32];
+            size_t n = encode_header(buf, prefix, len);
+            m_buffer->Write(buf, n);
+        }
+
+        void RedisReplyWriter::WriteBulk(const char* str, size_t len)
+        {
+            char buf[32];
+            size_t n = encode_header(buf, '$', len);
+            m_buffer->EnsureWritableBytes(n + len + 2);
+            m_buffer->Write(buf, n);
+            m_buffer->Write(str, len);
+            m_buffer->Write("\r\n", 2);
+        }
+
+        void RedisReplyWriter::BeginArray(int64 expected_len)
+        {
+            RedisReply* r = NextReply();
+            ArrayLevel level;
+            level.mark = 0;
+            level.header_len = 0;
+            level.expected = expected_len;
+            level.count = 0;
+            level.reply = r;
+            if (NULL != m_buffer)
+            {
+                level.mark = m_buffer->GetWriteIndex();
+                if (expected_len >= 0)
+                {
+                    WriteHeader('*', expected_len);
+                    level.header_len = m_buffer->GetWriteIndex() - level.mark;
+                }
+            }
+            else
+            {
+                r->ReserveMember(0);
+            }
+            m_levels.push_back(level);
+        }
+
+        void RedisReplyWriter::EndArray()
+        {
+            if (m_levels.empty())
+            {
+                return;
+            }
+            ArrayLevel level = m_levels.back();
+            m_levels.pop_back();
+            if (NULL == m_buffer || level.count == level.expected)
+            {
+                return;
+            }
+            char header[32];
+            size_t header_len = encode_header(header, '*', level.count);
+            size_t body_len = m_buffer->GetWriteIndex() - level.mark - level.header_len;
+            if (header_len > level.header_len)
+            {
+                m_buffer->EnsureWritableBytes(header_len - level.header_len);
+            }
+            char* raw = const_cast<char*>(m_buffer->GetRawBuffer());
+            if (header_len != level.header_len)
+            {
+                memmove(raw + level.mark + header_len, raw + level.mark + level.header_len, body_len);
+                m_buffer->SetWriteIndex(level.mark + header_len + body_len);
+            }
+            memcpy(raw + level.mark, header, header_len);
+        }
+
+        void RedisReplyWriter::AddString(const Data& v)
+        {
+            if (v.IsNil())
+            {
+                AddNil();
+                return;
+            }
+            RedisReply* r = NextReply();
+            if (NULL != r)
+            {
+                r->SetString(v);
+            }
+            else if (v.IsString())
+            {
+                WriteBulk(v.CStr(), v.StringLength());
+            }
+            else
+            {
+                v.ToString(m_str_cache);
+                WriteBulk(m_str_cache.data(), m_str_cache.size());
+            }
+        }
+
+        void RedisReplyWriter::AddString(const std::string& v)
+        {
+            AddString(v.data(), v.size());
+        }
+
+        void RedisReplyWriter::AddString(const char* v, size_t len)
+        {
+            RedisReply* r = NextReply();
+            if (NULL != r)
+            {
+                r->SetString(std::string(v, len));
+            }
+            else
+            {
+                WriteBulk(v, len);
+            }
+        }
+
+        void RedisReplyWriter::AddInteger(int64 v)
+        {
+            RedisReply* r = NextReply();
+            if (NULL != r)
+            {
+                r->SetInteger(v);
+            }
+            else
+            {
+                WriteHeader(':', v);
+            }
+        }
+
+        void RedisReplyWriter::AddDouble(double v)
+        {
+            RedisReply* r = NextReply();
+            if (NULL != r)
+            {
+                r->SetDouble(v);
+            }
+            else if (isinf(v))
+            {
+                WriteBulk(v > 0 ? "inf" : "-inf", v > 0 ? 3 : 4);
+            }
+            else
+            {
+                char buf[128];
+                int len = snprintf(buf, sizeof(buf), "%.17g", v);
+                WriteBulk(buf, len);
+            }
+        }
+
+        void RedisReplyWriter::AddNil()
+        {
+            RedisReply* r = NextReply();
+            if (NULL != r)
+            {
+                r->Clear();
+            }
+            else
+            {
+                m_buffer->Write("$-1\r\n", 5);
+            }
+        }
+
+        RedisReplyWriter::~RedisReplyWriter()
+        {
+            while (!m_levels.empty())
+            {
+                EndArray();
+            }
+        }
+    }
+}
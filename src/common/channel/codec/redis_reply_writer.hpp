@@ -0,0 +1,92 @@
+/*
+ *Copyright (c) 2013-2013, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef REDIS_REPLY_WRITER_HPP_
+#define REDIS_REPLY_WRITER_HPP_
+
+#include "redis_reply.hpp"
+#include "buffer/buffer.hpp"
+#include <vector>
+#include <string>
+
+namespace ardb
+{
+    namespace codec
+    {
+        /*
+         * Streaming reply builder for commands replying large arrays.
+         * With a wire buffer the reply is encoded as RESP straight into it, length/integer headers below
+         * a small limit are copied from precomputed tables and no RedisReply member is allocated.
+         * Without a wire buffer (lua, transactions, replication) the same calls fill the RedisReply tree.
+         * The reply set before the first call stays as is if nothing is written, but everything must be checked
+         * before the first call since a streamed reply could not be replaced by an error.
+         */
+        class RedisReplyWriter
+        {
+            private:
+                struct ArrayLevel
+                {
+                        size_t mark;
+                        size_t header_len;
+                        int64 expected;
+                        int64 count;
+                        RedisReply* reply;
+                };
+                RedisReply& m_reply;
+                Buffer* m_buffer;
+                std::vector<ArrayLevel> m_levels;
+                std::string m_str_cache;
+                bool m_streamed;
+                RedisReply* NextReply();
+                void WriteHeader(char prefix, int64 len);
+                void WriteBulk(const char* str, size_t len);
+            public:
+                RedisReplyWriter(RedisReply& reply, Buffer* wire = NULL);
+                bool IsDirect() const
+                {
+                    return NULL != m_buffer;
+                }
+                /*
+                 * expected_len >= 0 writes the header at once and it is only rewritten if the array ends with
+                 * another number of members, otherwise the header is inserted in front of the members at EndArray.
+                 */
+                void BeginArray(int64 expected_len = -1);
+                void EndArray();
+                void AddString(const Data& v);
+                void AddString(const std::string& v);
+                void AddString(const char* v, size_t len);
+                void AddInteger(int64 v);
+                void AddDouble(double v);
+                void AddNil();
+                ~RedisReplyWriter();
+        };
+    }
+}
+
+#endif /* REDIS_REPLY_WRITER_HPP_ */
@@ -134,6 +134,14 @@ namespace ardb
 				{
 					return Decode(ctx, channel, buffer, msg);
 				}
+				/*
+				 * Return true to leave an incomplete frame inside the channel's own input buffer
+				 * instead of copying it into the cumulation buffer, the next read appends right behind it.
+				 */
+				virtual bool RetainPartialFrame(Channel* channel, Buffer& input)
+				{
+					return false;
+				}
 			public:
 				StackFrameDecoder()
 				{
@@ -155,7 +163,7 @@ namespace ardb
 					} else
 					{
 						CallDecode(ctx, e.GetChannel(), *input);
-						if (input->Readable())
+						if (input->Readable() && !RetainPartialFrame(e.GetChannel(), *input))
 						{
 							m_cumulation.Write(input, input->ReadableBytes());
 						}
@@ -39,11 +39,16 @@
 
 #include "ae.h"
 #include "zmalloc.h"
+#include "util/uring.h"
 
 /* Include the best multiplexing layer supported by this system.
  * The following should be ordered by performances, descending. */
 #ifdef HAVE_EPOLL
+#ifdef HAVE_IO_URING
+#include "ae_uring.cc"
+#else
 #include "ae_epoll.cc"
+#endif
 #else
 #ifdef HAVE_KQUEUE
 #include "ae_kqueue.cc"
@@ -81,6 +86,9 @@ aeEventLoop *aeCreateEventLoop(int setsize)
 	eventLoop->stop = 0;
 	eventLoop->maxfd = -1;
 	eventLoop->beforesleep = NULL;
+	eventLoop->busyusecs = 0;
+	eventLoop->processing = 0;
+	eventLoop->apiuring = 0;
     if (aeApiCreate(eventLoop) == -1) goto err;
 
 	/* Events with mask == AE_NONE are not set. So let's initialize the
@@ -157,6 +165,13 @@ int aeGetFileEvents(aeEventLoop *eventLoop, int fd) {
     return fe->mask;
 }
 
+static long long aeUstime(void)
+{
+	struct timeval val;
+	gettimeofday(&val, 0);
+	return ((long long) val.tv_sec) * 1000000 + val.tv_usec;
+}
+
 static void aeGetTime(long *seconds, long *milliseconds)
 {
 //	struct timeval tv;
@@ -351,7 +366,9 @@ static int processTimeEvents(aeEventLoop *eventLoop)
 int aeProcessEvents(aeEventLoop *eventLoop, int flags)
 {
 	int processed = 0, numevents;
-
+	/* nested calls(from inside a fired event) are already accounted by the outer call */
+	int outer = !eventLoop->processing;
+	long long busy_start = 0;
 
 	/* Nothing to do? return ASAP */
 	if (!(flags & AE_TIME_EVENTS) && !(flags & AE_FILE_EVENTS))
@@ -411,6 +428,11 @@ int aeProcessEvents(aeEventLoop *eventLoop, int flags)
 			}
 		}
 		numevents = aeApiPoll(eventLoop, tvp);
+		if (outer)
+		{
+			eventLoop->processing = 1;
+			busy_start = aeUstime();
+		}
 
 		for (j = 0; j < numevents; j++)
 		{
@@ -438,7 +460,19 @@ int aeProcessEvents(aeEventLoop *eventLoop, int flags)
 	}
 	/* Check time events */
 	if (flags & AE_TIME_EVENTS)
+	{
+		if (outer && !eventLoop->processing)
+		{
+			eventLoop->processing = 1;
+			busy_start = aeUstime();
+		}
 		processed += processTimeEvents(eventLoop);
+	}
+	if (outer && eventLoop->processing)
+	{
+		eventLoop->busyusecs += aeUstime() - busy_start;
+		eventLoop->processing = 0;
+	}
 
 	return processed; /* return the number of processed file/time events */
 }
@@ -496,3 +530,8 @@ void aeSetBeforeSleepProc(aeEventLoop *eventLoop,
 {
 	eventLoop->beforesleep = beforesleep;
 }
+
+long long aeGetBusyTime(aeEventLoop *eventLoop)
+{
+	return eventLoop->busyusecs;
+}
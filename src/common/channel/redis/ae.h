@@ -106,7 +106,10 @@ typedef struct aeEventLoop {
     aeTimeEvent *timeEventHead;
     int stop;
     void *apidata; /* This is used for polling API specific data */
+    int apiuring; /* apidata is io_uring state, the loop fell back to epoll if 0 */
     aeBeforeSleepProc *beforesleep;
+    long long busyusecs; /* time spent processing fired events, polling excluded */
+    int processing;
 } aeEventLoop;
 
 /* Prototypes */
@@ -130,6 +133,7 @@ int aeWait(int fd, int mask, long long milliseconds);
 void aeMain(aeEventLoop *eventLoop);
 char *aeGetApiName(void);
 void aeSetBeforeSleepProc(aeEventLoop *eventLoop, aeBeforeSleepProc *beforesleep);
+long long aeGetBusyTime(aeEventLoop *eventLoop);
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,247 @@
+ /* Released under the BSD license. See the COPYING file for more info. */
+
+/*
+ * io_uring backend: readiness is still reported to ae the same way as epoll, but every
+ * poll arm/remove is queued as a sqe and all of them are submitted together with the
+ * wait, so one io_uring_enter replaces the epoll_ctl calls plus epoll_wait of a loop.
+ * Polls are one shot and the fired ones are re-armed with the next wait: arming a poll on a fd
+ * which is still ready completes at once, so events stay level triggered as epoll reports them
+ * without any extra syscall.
+ * Falls back to epoll for the loop if io_uring is not enabled or not supported(waiting with a
+ * timeout needs linux 5.11).
+ */
+#include <poll.h>
+#include <string.h>
+
+#define aeApiState aeEpollApiState
+#define aeApiCreate aeEpollApiCreate
+#define aeApiFree aeEpollApiFree
+#define aeApiAddEvent aeEpollApiAddEvent
+#define aeApiDelEvent aeEpollApiDelEvent
+#define aeApiPoll aeEpollApiPoll
+#define aeApiName aeEpollApiName
+#include "ae_epoll.cc"
+#undef aeApiState
+#undef aeApiCreate
+#undef aeApiFree
+#undef aeApiAddEvent
+#undef aeApiDelEvent
+#undef aeApiPoll
+#undef aeApiName
+
+#define AE_URING_REMOVE_DATA 0xFFFFFFFFFFFFFFFFULL
+#define AE_URING_MAX_ENTRIES 4096
+
+typedef struct aeUringState
+{
+    uring_t *ring;
+    unsigned *gens;        /* generation of the poll armed on each fd, stale completions are skipped */
+    unsigned char *armed;  /* mask of the poll armed on each fd */
+    int *slots;            /* index of each fd in the fired events of current poll, -1 if not fired */
+    int *pending;          /* fds fired last time, their polls are re-armed with the next wait */
+    int npending;
+} aeUringState;
+
+/* Fall back to epoll for the loops created after io_uring failed, aeApiName reports it */
+static int aeUringFellBack = 0;
+
+static inline uint64_t aeUringData(aeUringState *state, int fd)
+{
+    return ((uint64_t) state->gens[fd] << 32) | (uint32_t) fd;
+}
+
+/* Make the armed poll of fd match mask */
+static int aeUringArm(aeUringState *state, int fd, int mask)
+{
+    struct io_uring_sqe *sqe;
+    if (state->armed[fd] == mask)
+        return 0;
+    if (state->armed[fd] != AE_NONE)
+    {
+        sqe = uring_get_sqe(state->ring);
+        if (sqe == NULL)
+            return -1;
+        sqe->opcode = IORING_OP_POLL_REMOVE;
+        sqe->fd = -1;
+        sqe->addr = aeUringData(state, fd);
+        sqe->user_data = AE_URING_REMOVE_DATA;
+        state->gens[fd]++;
+        state->armed[fd] = AE_NONE;
+    }
+    if (mask != AE_NONE)
+    {
+        unsigned events = 0;
+        sqe = uring_get_sqe(state->ring);
+        if (sqe == NULL)
+            return -1;
+        if (mask & AE_READABLE)
+            events |= POLLIN;
+        if (mask & AE_WRITABLE)
+            events |= POLLOUT;
+        sqe->opcode = IORING_OP_POLL_ADD;
+        sqe->fd = fd;
+        sqe->poll32_events = events;
+        sqe->user_data = aeUringData(state, fd);
+        state->armed[fd] = mask;
+    }
+    return 0;
+}
+
+static void aeUringFire(aeEventLoop *eventLoop, int fd, int mask, int *numevents)
+{
+    aeUringState *state = eventLoop->apidata;
+    int j = state->slots[fd];
+    if (j < 0)
+    {
+        j = (*numevents)++;
+        state->slots[fd] = j;
+        eventLoop->fired[j].fd = fd;
+        eventLoop->fired[j].mask = 0;
+    }
+    eventLoop->fired[j].mask |= mask;
+}
+
+static int aeUringMask(int events)
+{
+    int mask = 0;
+    if (events & (POLLERR | POLLHUP))
+        return AE_READABLE | AE_WRITABLE;
+    if (events & POLLIN)
+        mask |= AE_READABLE;
+    if (events & POLLOUT)
+        mask |= AE_WRITABLE;
+    return mask;
+}
+
+static int aeApiCreate(aeEventLoop *eventLoop)
+{
+    eventLoop->apiuring = 0;
+    if (uring_enabled())
+    {
+        aeUringState *state = zmalloc(sizeof(aeUringState));
+        unsigned entries = eventLoop->setsize < AE_URING_MAX_ENTRIES ? eventLoop->setsize : AE_URING_MAX_ENTRIES;
+        if (state)
+        {
+            memset(state, 0, sizeof(*state));
+            state->gens = zmalloc(sizeof(unsigned) * eventLoop->setsize);
+            state->armed = zmalloc(eventLoop->setsize);
+            state->slots = zmalloc(sizeof(int) * eventLoop->setsize);
+            state->pending = zmalloc(sizeof(int) * eventLoop->setsize);
+            state->ring = uring_create(entries);
+        }
+        if (state && state->gens && state->armed && state->slots && state->pending && state->ring
+                && uring_can_wait_timeout(state->ring))
+        {
+            int i;
+            memset(state->gens, 0, sizeof(unsigned) * eventLoop->setsize);
+            memset(state->armed, 0, eventLoop->setsize);
+            for (i = 0; i < eventLoop->setsize; i++)
+                state->slots[i] = -1;
+            eventLoop->apidata = state;
+            eventLoop->apiuring = 1;
+            return 0;
+        }
+        if (state)
+        {
+            if (state->ring) uring_destroy(state->ring);
+            zfree(state->gens);
+            zfree(state->armed);
+            zfree(state->slots);
+            zfree(state->pending);
+            zfree(state);
+        }
+        aeUringFellBack = 1;
+    }
+    return aeEpollApiCreate(eventLoop);
+}
+
+static void aeApiFree(aeEventLoop *eventLoop)
+{
+    if (!eventLoop->apiuring)
+    {
+        aeEpollApiFree(eventLoop);
+        return;
+    }
+    aeUringState *state = eventLoop->apidata;
+    uring_destroy(state->ring);
+    zfree(state->gens);
+    zfree(state->armed);
+    zfree(state->slots);
+    zfree(state->pending);
+    zfree(state);
+}
+
+static int aeApiAddEvent(aeEventLoop *eventLoop, int fd, int mask)
+{
+    if (!eventLoop->apiuring)
+        return aeEpollApiAddEvent(eventLoop, fd, mask);
+    return aeUringArm(eventLoop->apidata, fd, mask | eventLoop->events[fd].mask);
+}
+
+static void aeApiDelEvent(aeEventLoop *eventLoop, int fd, int delmask)
+{
+    if (!eventLoop->apiuring)
+    {
+        aeEpollApiDelEvent(eventLoop, fd, delmask);
+        return;
+    }
+    /*
+     * the removal is only queued and submitted with the next wait, the fd may be closed & reused
+     * before that since completions of the removed poll carry an old generation and are dropped
+     */
+    aeUringArm(eventLoop->apidata, fd, eventLoop->events[fd].mask & (~delmask));
+}
+
+static int aeApiPoll(aeEventLoop *eventLoop, struct timeval *tvp)
+{
+    if (!eventLoop->apiuring)
+        return aeEpollApiPoll(eventLoop, tvp);
+    aeUringState *state = eventLoop->apidata;
+    struct io_uring_cqe *cqe;
+    unsigned wait_nr = 1;
+    int64_t timeout = -1;
+    int numevents = 0, j;
+
+    if (tvp != NULL)
+    {
+        timeout = (int64_t) tvp->tv_sec * 1000000 + tvp->tv_usec;
+        if (timeout == 0)
+            wait_nr = 0;
+    }
+    /* re-arm with the current mask, handlers may have changed or removed it */
+    for (j = 0; j < state->npending; j++)
+    {
+        int fd = state->pending[j];
+        aeUringArm(state, fd, eventLoop->events[fd].mask);
+    }
+    state->npending = 0;
+    if (uring_peek_cqe(state->ring) != NULL)
+        wait_nr = 0;
+    uring_submit_wait_timeout(state->ring, wait_nr, timeout);
+
+    while (numevents < eventLoop->setsize && (cqe = uring_peek_cqe(state->ring)) != NULL)
+    {
+        uint64_t data = cqe->user_data;
+        int res = cqe->res;
+        int fd = (int) (data & 0xFFFFFFFF);
+        uring_cqe_seen(state->ring);
+        if (data == AE_URING_REMOVE_DATA)
+            continue;
+        if (fd < 0 || fd >= eventLoop->setsize || (unsigned) (data >> 32) != state->gens[fd])
+            continue;
+        state->armed[fd] = AE_NONE;
+        aeUringFire(eventLoop, fd, res < 0 ? AE_READABLE | AE_WRITABLE : aeUringMask(res), &numevents);
+    }
+    for (j = 0; j < numevents; j++)
+    {
+        int fd = eventLoop->fired[j].fd;
+        state->slots[fd] = -1;
+        state->pending[state->npending++] = fd;
+    }
+    return numevents;
+}
+
+static char *aeApiName(void)
+{
+    return uring_enabled() && !aeUringFellBack ? "io_uring" : aeEpollApiName();
+}
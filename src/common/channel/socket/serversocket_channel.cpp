@@ -38,7 +38,7 @@
 using namespace ardb;
 
 ServerSocketChannel::ServerSocketChannel(ChannelService& factory) :
-        SocketChannel(factory), m_connected_socks(0), m_pool_min(0), m_pool_max(0)
+        SocketChannel(factory), m_connected_socks(0), m_pool_min(0), m_pool_max(0), m_reuse_port(false)
 {
 }
 
@@ -129,6 +129,19 @@ bool ServerSocketChannel::DoBind(Address* local)
             WARN_LOG("Failed to set SO_REUSEADDR for socket.");
         }
     }
+    if (m_reuse_port)
+    {
+#ifdef SO_REUSEPORT
+        if (addr.IsUnix() || setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &flag, sizeof(flag)) != 0)
+        {
+            WARN_LOG("Failed to set SO_REUSEPORT for socket, fallback to single acceptor.");
+            m_reuse_port = false;
+        }
+#else
+        WARN_LOG("SO_REUSEPORT is not supported, fallback to single acceptor.");
+        m_reuse_port = false;
+#endif
+    }
     //setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, (void*) &on, sizeof(on));
     if (::bind(fd, (struct sockaddr*) &(addr.GetRawSockAddr()), addr.GetRawSockAddrSize()) == -1)
     {
@@ -150,6 +163,7 @@ bool ServerSocketChannel::DoBind(Address* local)
         return false;
     }
     m_fd = fd;
+    m_bind_address = addr;
     return true;
 }
 
@@ -252,6 +266,11 @@ void ServerSocketChannel::BindThreadPool(uint32 min, uint32 max)
     m_pool_max = max;
 }
 
+void ServerSocketChannel::EnableReusePort()
+{
+    m_reuse_port = true;
+}
+
 ServerSocketChannel::~ServerSocketChannel()
 {
 }
@@ -42,6 +42,8 @@ namespace ardb
 			uint32 m_connected_socks;
 			uint32 m_pool_min;
 			uint32 m_pool_max;
+			bool m_reuse_port;
+			SocketInetAddress m_bind_address;
 			std::string m_adress_str;
 			bool DoBind(Address* local);
 			bool DoConnect(Address* remote);
@@ -53,6 +55,14 @@ namespace ardb
 			ServerSocketChannel(ChannelService& factory);
 			uint32 ConnectedSockets();
 			void BindThreadPool(uint32 min, uint32 max);
+			/*
+			 * bind with SO_REUSEPORT, every thread of the bound pool then listens & accepts on its own socket
+			 */
+			void EnableReusePort();
+			bool IsReusePort() const
+			{
+			    return m_reuse_port;
+			}
 			const std::string& GetStringAddress()
 			{
 			    return m_adress_str;
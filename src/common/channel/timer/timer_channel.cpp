@@ -53,6 +53,10 @@ void TimerChannel::OnScheduled(TimerTask* task)
 {
     //TimerTask* nearestTask = getNearestTimerTask();
     int64 nextTime = GetNearestTaskTriggerTime();
+    /*
+     * ae time events are in millis while the task delay is in its own unit
+     */
+    int64 delay = millistime(task->GetDelay(), task->GetTimeUnit());
     if (nextTime < 0
             || static_cast<uint64>(nextTime) > task->GetNextTriggerTime())
     {
@@ -61,7 +65,7 @@ void TimerChannel::OnScheduled(TimerTask* task)
             if (nextTime > 0)
             {
                 aeModifyTimeEvent(GetService().GetRawEventLoop(), m_timer_id,
-                        task->GetDelay());
+                        delay);
             }
             else
             {
@@ -76,7 +80,7 @@ void TimerChannel::OnScheduled(TimerTask* task)
                 m_timer_id = -1;
             }
             m_timer_id = aeCreateTimeEvent(GetService().GetRawEventLoop(),
-                    task->GetDelay(), TimeoutCB, this, NULL);
+                    delay, TimeoutCB, this, NULL);
         }
     }
 }
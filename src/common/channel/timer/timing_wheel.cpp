@@ -0,0 +1,188 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "timing_wheel.hpp"
+#include "timer.hpp"
+#include "util/time_helper.hpp"
+
+using namespace ardb;
+
+void TimingWheelEntry::Cancel()
+{
+    if (NULL != wheel)
+    {
+        wheel->Cancel(*this);
+    }
+}
+
+TimingWheel::TimingWheel(Timer& timer, uint32 slots, uint32 tick_ms)
+        : m_timer(timer), m_slots(NULL), m_slot_mask(0), m_tick_ms(tick_ms > 0 ? tick_ms : 1), m_current_tick(0), m_size(
+                0), m_task_id(-1)
+{
+    uint32 n = 1;
+    while (n < slots)
+    {
+        n <<= 1;
+    }
+    m_slot_mask = n - 1;
+    m_slots = new TimingWheelEntry[n];
+    for (uint32 i = 0; i < n; i++)
+    {
+        m_slots[i].prev = m_slots[i].next = &m_slots[i];
+    }
+}
+
+void TimingWheel::Link(TimingWheelEntry* head, TimingWheelEntry* entry)
+{
+    entry->prev = head->prev;
+    entry->next = head;
+    head->prev->next = entry;
+    head->prev = entry;
+}
+
+void TimingWheel::Unlink(TimingWheelEntry* entry)
+{
+    entry->prev->next = entry->next;
+    entry->next->prev = entry->prev;
+    entry->prev = entry->next = NULL;
+}
+
+void TimingWheel::Schedule(TimingWheelEntry& entry, uint64 delay_ms)
+{
+    if (entry.IsScheduled())
+    {
+        entry.wheel->Cancel(entry);
+    }
+    uint64 now = get_current_epoch_millis();
+    if (0 == m_size)
+    {
+        m_current_tick = now / m_tick_ms;
+    }
+    entry.deadline = now + delay_ms;
+    /*
+     * round up so that all entries of a passed slot are due, a deadline in the current tick goes to the next one
+     */
+    uint64 tick = (entry.deadline + m_tick_ms - 1) / m_tick_ms;
+    if (tick <= m_current_tick)
+    {
+        tick = m_current_tick + 1;
+    }
+    Link(&m_slots[tick & m_slot_mask], &entry);
+    entry.wheel = this;
+    m_size++;
+    if (-1 == m_task_id)
+    {
+        m_task_id = m_timer.Schedule(this, m_tick_ms, m_tick_ms, MILLIS);
+    }
+}
+
+void TimingWheel::Cancel(TimingWheelEntry& entry)
+{
+    if (entry.wheel != this)
+    {
+        return;
+    }
+    Unlink(&entry);
+    entry.wheel = NULL;
+    m_size--;
+}
+
+uint32 TimingWheel::Advance(uint64 now_ms)
+{
+    uint64 target = now_ms / m_tick_ms;
+    if (target <= m_current_tick)
+    {
+        return 0;
+    }
+    /*
+     * collect due entries first since callbacks may schedule or cancel any entry
+     */
+    TimingWheelEntry expired;
+    expired.prev = expired.next = &expired;
+    uint64 passed = target - m_current_tick;
+    if (passed > m_slot_mask + 1)
+    {
+        passed = m_slot_mask + 1;
+    }
+    for (uint64 i = 1; i <= passed; i++)
+    {
+        TimingWheelEntry* head = &m_slots[(m_current_tick + i) & m_slot_mask];
+        TimingWheelEntry* entry = head->next;
+        while (entry != head)
+        {
+            TimingWheelEntry* next = entry->next;
+            if (entry->deadline <= now_ms)
+            {
+                Unlink(entry);
+                Link(&expired, entry);
+            }
+            entry = next;
+        }
+    }
+    m_current_tick = target;
+    uint32 fired = 0;
+    while (expired.next != &expired)
+    {
+        TimingWheelEntry* entry = expired.next;
+        Cancel(*entry);
+        fired++;
+        if (NULL != entry->cb)
+        {
+            entry->cb(entry->data);
+        }
+    }
+    return fired;
+}
+
+void TimingWheel::Run()
+{
+    Advance(get_current_epoch_millis());
+    if (0 == m_size && -1 != m_task_id)
+    {
+        m_timer.Cancel(m_task_id);
+        m_task_id = -1;
+    }
+}
+
+TimingWheel::~TimingWheel()
+{
+    if (-1 != m_task_id)
+    {
+        m_timer.Cancel(m_task_id);
+    }
+    for (uint32 i = 0; i <= m_slot_mask; i++)
+    {
+        TimingWheelEntry* head = &m_slots[i];
+        while (head->next != head)
+        {
+            Cancel(*head->next);
+        }
+    }
+    delete[] m_slots;
+}
@@ -0,0 +1,116 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef NOVA_TIMING_WHEEL_HPP_
+#define NOVA_TIMING_WHEEL_HPP_
+#include "common.hpp"
+
+namespace ardb
+{
+    class Timer;
+    class TimingWheel;
+    typedef void TimingWheelCallback(void* data);
+
+    /*
+     * An intrusive timer embedded in its owner, the callback is invoked once by the wheel after the deadline.
+     * Destroying an entry cancels it.
+     */
+    struct TimingWheelEntry
+    {
+            TimingWheelEntry* prev;
+            TimingWheelEntry* next;
+            TimingWheel* wheel;
+            uint64 deadline;
+            TimingWheelCallback* cb;
+            void* data;
+            TimingWheelEntry(TimingWheelCallback* c = NULL, void* d = NULL)
+                    : prev(NULL), next(NULL), wheel(NULL), deadline(0), cb(c), data(d)
+            {
+            }
+            bool IsScheduled() const
+            {
+                return NULL != wheel;
+            }
+            void Cancel();
+            ~TimingWheelEntry()
+            {
+                Cancel();
+            }
+        private:
+            TimingWheelEntry(const TimingWheelEntry&);
+            TimingWheelEntry& operator=(const TimingWheelEntry&);
+    };
+
+    /*
+     * Hashed timing wheel: entries are hashed into 'slots' buckets by their deadline tick, schedule & cancel
+     * are O(1) and a tick only visits the bucket it passes, entries of later rounds stay in place.
+     * The wheel is driven by a periodic task of the owner thread's timer which only runs while entries exist,
+     * so it must only be used from that thread.
+     */
+    class TimingWheel: public Runnable
+    {
+        private:
+            Timer& m_timer;
+            TimingWheelEntry* m_slots;
+            uint32 m_slot_mask;
+            uint32 m_tick_ms;
+            uint64 m_current_tick;
+            uint32 m_size;
+            int32 m_task_id;
+            void Link(TimingWheelEntry* head, TimingWheelEntry* entry);
+            void Unlink(TimingWheelEntry* entry);
+            void Run();
+            friend struct TimingWheelEntry;
+        public:
+            /*
+             * 'slots' is rounded up to a power of 2
+             */
+            TimingWheel(Timer& timer, uint32 slots = 512, uint32 tick_ms = 10);
+            /*
+             * (re)schedule the entry to fire after 'delay_ms'
+             */
+            void Schedule(TimingWheelEntry& entry, uint64 delay_ms);
+            void Cancel(TimingWheelEntry& entry);
+            /*
+             * fire all entries whose deadline is not after 'now_ms', return the fired count
+             */
+            uint32 Advance(uint64 now_ms);
+            uint32 Size() const
+            {
+                return m_size;
+            }
+            uint32 GetTickMillis() const
+            {
+                return m_tick_ms;
+            }
+            ~TimingWheel();
+    };
+}
+
+#endif /* NOVA_TIMING_WHEEL_HPP_ */
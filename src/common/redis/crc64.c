@@ -38,6 +38,7 @@
  * POSSIBILITY OF SUCH DAMAGE. */
 
 #include <stdint.h>
+#include <pthread.h>
 
 static const uint64_t crc64_tab[256] = {
     UINT64_C(0x0000000000000000), UINT64_C(0x7ad870c830358979),
@@ -170,22 +171,122 @@ static const uint64_t crc64_tab[256] = {
     UINT64_C(0x536fa08fdfd90e51), UINT64_C(0x29b7d047efec8728),
 };
 
-uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l) {
-    uint64_t j;
+#define CRC64_POLY_REFLECTED UINT64_C(0x95ac9329ac4bc9b5)
+
+/* Tables for slicing-by-8, crc64_slice_tab[0] is crc64_tab, crc64_slice_tab[k][n]
+ * is the crc of byte n followed by k zero bytes. */
+static uint64_t crc64_slice_tab[8][256];
+static pthread_once_t crc64_slice_once = PTHREAD_ONCE_INIT;
 
-    for (j = 0; j < l; j++) {
-        uint8_t byte = s[j];
-        crc = crc64_tab[(uint8_t)crc ^ byte] ^ (crc >> 8);
+static void crc64_init_slice_tab(void) {
+    int n, k;
+    for (n = 0; n < 256; n++) {
+        uint64_t crc = crc64_tab[n];
+        crc64_slice_tab[0][n] = crc;
+        for (k = 1; k < 8; k++) {
+            crc = crc64_tab[(uint8_t)crc] ^ (crc >> 8);
+            crc64_slice_tab[k][n] = crc;
+        }
+    }
+}
+
+static inline uint64_t crc64_load_le64(const unsigned char *s) {
+    return (uint64_t)s[0] | ((uint64_t)s[1] << 8) | ((uint64_t)s[2] << 16) |
+           ((uint64_t)s[3] << 24) | ((uint64_t)s[4] << 32) |
+           ((uint64_t)s[5] << 40) | ((uint64_t)s[6] << 48) |
+           ((uint64_t)s[7] << 56);
+}
+
+uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l) {
+    pthread_once(&crc64_slice_once, crc64_init_slice_tab);
+    /* Process the unaligned head byte by byte, then 8 bytes per step. */
+    while (l && ((uintptr_t)s & 7)) {
+        crc = crc64_tab[(uint8_t)crc ^ *s++] ^ (crc >> 8);
+        l--;
+    }
+    while (l >= 8) {
+        crc ^= crc64_load_le64(s);
+        crc = crc64_slice_tab[7][crc & 0xff] ^
+              crc64_slice_tab[6][(crc >> 8) & 0xff] ^
+              crc64_slice_tab[5][(crc >> 16) & 0xff] ^
+              crc64_slice_tab[4][(crc >> 24) & 0xff] ^
+              crc64_slice_tab[3][(crc >> 32) & 0xff] ^
+              crc64_slice_tab[2][(crc >> 40) & 0xff] ^
+              crc64_slice_tab[1][(crc >> 48) & 0xff] ^
+              crc64_slice_tab[0][crc >> 56];
+        s += 8;
+        l -= 8;
+    }
+    while (l--) {
+        crc = crc64_tab[(uint8_t)crc ^ *s++] ^ (crc >> 8);
     }
     return crc;
 }
 
+/* GF(2) matrix helpers for crc64_combine(), same as zlib's crc32_combine(). */
+static uint64_t gf2_matrix_times(const uint64_t *mat, uint64_t vec) {
+    uint64_t sum = 0;
+    while (vec) {
+        if (vec & 1)
+            sum ^= *mat;
+        vec >>= 1;
+        mat++;
+    }
+    return sum;
+}
+
+static void gf2_matrix_square(uint64_t *square, const uint64_t *mat) {
+    int n;
+    for (n = 0; n < 64; n++)
+        square[n] = gf2_matrix_times(mat, mat[n]);
+}
+
+uint64_t crc64_combine(uint64_t crc1, uint64_t crc2, uint64_t len2) {
+    uint64_t row;
+    uint64_t even[64]; /* even-power-of-two zeros operator */
+    uint64_t odd[64];  /* odd-power-of-two zeros operator */
+    int n;
+
+    if (len2 == 0)
+        return crc1;
+
+    /* Operator for one zero bit in odd. */
+    odd[0] = CRC64_POLY_REFLECTED;
+    row = 1;
+    for (n = 1; n < 64; n++) {
+        odd[n] = row;
+        row <<= 1;
+    }
+    /* Operator for two zero bits in even, then four zero bits in odd. */
+    gf2_matrix_square(even, odd);
+    gf2_matrix_square(odd, even);
+
+    /* Apply len2 zeros to crc1, the first square puts the operator for one
+     * zero byte, eight zero bits, in even. */
+    do {
+        gf2_matrix_square(even, odd);
+        if (len2 & 1)
+            crc1 = gf2_matrix_times(even, crc1);
+        len2 >>= 1;
+        if (len2 == 0)
+            break;
+        gf2_matrix_square(odd, even);
+        if (len2 & 1)
+            crc1 = gf2_matrix_times(odd, crc1);
+        len2 >>= 1;
+    } while (len2 != 0);
+    return crc1 ^ crc2;
+}
+
 /* Test main */
 #ifdef TEST_MAIN
 #include <stdio.h>
 int main(void) {
     printf("e9c6d914c4b8d9ca == %016llx\n",
         (unsigned long long) crc64(0,(unsigned char*)"123456789",9));
+    printf("e9c6d914c4b8d9ca == %016llx\n",
+        (unsigned long long) crc64_combine(crc64(0,(unsigned char*)"1234",4),
+                                           crc64(0,(unsigned char*)"56789",5),5));
     return 0;
 }
 #endif
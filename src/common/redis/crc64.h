@@ -7,6 +7,8 @@ extern "C"
 #include <stdint.h>
 
     uint64_t crc64(uint64_t crc, const unsigned char *s, uint64_t l);
+    /* crc of the concatenation A+B, from crc1 of A, crc2 of B (computed from 0) and len2 of B */
+    uint64_t crc64_combine(uint64_t crc1, uint64_t crc2, uint64_t len2);
 #ifdef __cplusplus
 }
 #endif
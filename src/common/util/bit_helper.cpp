@@ -0,0 +1,576 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#include "util/bit_helper.hpp"
+#include <string.h>
+
+#if defined(__x86_64__) && (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define BIT_KERNEL_X86 1
+#include <cpuid.h>
+#include <immintrin.h>
+#if (defined(__clang__) && __clang_major__ >= 6) || (!defined(__clang__) && __GNUC__ >= 8)
+#define BIT_KERNEL_X86_AVX512 1
+#endif
+#endif
+
+namespace ardb
+{
+    typedef uint64 BitPopcountFunc(const void* s, size_t count);
+    typedef void BitOperateFunc(int op, void* dst, const void* src, size_t count);
+    typedef size_t BitSkipBytesFunc(const void* s, size_t count, uint8 skipval);
+
+    struct BitKernelOps
+    {
+            const char* name;
+            BitPopcountFunc* popcount;
+            BitOperateFunc* operate;
+            BitSkipBytesFunc* skip_bytes;
+    };
+
+    static inline uint64 load_uint64(const uint8* p)
+    {
+        uint64 v;
+        memcpy(&v, p, sizeof(v));
+        return v;
+    }
+
+    static inline void store_uint64(uint8* p, uint64 v)
+    {
+        memcpy(p, &v, sizeof(v));
+    }
+
+    //copy from redis
+    static uint64 scalar_popcount(const void* s, size_t count)
+    {
+        uint64 bits = 0;
+        const uint8* p = (const uint8*) s;
+        static const unsigned char bitsinbyte[256] =
+        { 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
+                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3,
+                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 1, 2, 2, 3, 2, 3, 3, 4, 2, 3, 3, 4, 3, 4, 4, 5, 2, 3,
+                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 2, 3, 3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 2, 3,
+                3, 4, 3, 4, 4, 5, 3, 4, 4, 5, 4, 5, 5, 6, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 3, 4, 4, 5, 4, 5, 5, 6, 4, 5, 5, 6, 5, 6, 6, 7, 4, 5,
+                5, 6, 5, 6, 6, 7, 5, 6, 6, 7, 6, 7, 7, 8 };
+
+        /* Count bits 16 bytes at a time */
+        while (count >= 16)
+        {
+            uint32_t aux1, aux2, aux3, aux4;
+
+            memcpy(&aux1, p, 4);
+            memcpy(&aux2, p + 4, 4);
+            memcpy(&aux3, p + 8, 4);
+            memcpy(&aux4, p + 12, 4);
+            p += 16;
+            count -= 16;
+
+            aux1 = aux1 - ((aux1 >> 1) & 0x55555555);
+            aux1 = (aux1 & 0x33333333) + ((aux1 >> 2) & 0x33333333);
+            aux2 = aux2 - ((aux2 >> 1) & 0x55555555);
+            aux2 = (aux2 & 0x33333333) + ((aux2 >> 2) & 0x33333333);
+            aux3 = aux3 - ((aux3 >> 1) & 0x55555555);
+            aux3 = (aux3 & 0x33333333) + ((aux3 >> 2) & 0x33333333);
+            aux4 = aux4 - ((aux4 >> 1) & 0x55555555);
+            aux4 = (aux4 & 0x33333333) + ((aux4 >> 2) & 0x33333333);
+            bits += ((((aux1 + (aux1 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux2 + (aux2 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24)
+                    + ((((aux3 + (aux3 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24) + ((((aux4 + (aux4 >> 4)) & 0x0F0F0F0F) * 0x01010101) >> 24);
+        }
+        /* Count the remaining bytes */
+        while (count--)
+            bits += bitsinbyte[*p++];
+        return bits;
+    }
+
+    static void scalar_operate(int op, void* dst, const void* src, size_t count)
+    {
+        uint8* d = (uint8*) dst;
+        const uint8* s = (const uint8*) src;
+        size_t i = 0;
+        switch (op)
+        {
+            case BIT_OP_AND:
+            {
+                for (; i + 8 <= count; i += 8)
+                    store_uint64(d + i, load_uint64(d + i) & load_uint64(s + i));
+                for (; i < count; i++)
+                    d[i] &= s[i];
+                break;
+            }
+            case BIT_OP_OR:
+            {
+                for (; i + 8 <= count; i += 8)
+                    store_uint64(d + i, load_uint64(d + i) | load_uint64(s + i));
+                for (; i < count; i++)
+                    d[i] |= s[i];
+                break;
+            }
+            case BIT_OP_XOR:
+            {
+                for (; i + 8 <= count; i += 8)
+                    store_uint64(d + i, load_uint64(d + i) ^ load_uint64(s + i));
+                for (; i < count; i++)
+                    d[i] ^= s[i];
+                break;
+            }
+            case BIT_OP_NOT:
+            {
+                for (; i + 8 <= count; i += 8)
+                    store_uint64(d + i, ~load_uint64(d + i));
+                for (; i < count; i++)
+                    d[i] = ~d[i];
+                break;
+            }
+            default:
+            {
+                break;
+            }
+        }
+    }
+
+    static size_t scalar_skip_bytes(const void* s, size_t count, uint8 skipval)
+    {
+        const uint8* p = (const uint8*) s;
+        uint64 skipword = skipval * 0x0101010101010101ULL;
+        size_t i = 0;
+        for (; i + 8 <= count; i += 8)
+        {
+            if (load_uint64(p + i) != skipword)
+                break;
+        }
+        for (; i < count; i++)
+        {
+            if (p[i] != skipval)
+                break;
+        }
+        return i;
+    }
+
+#ifdef BIT_KERNEL_X86
+    /*
+     * sse4.2 kernel: hardware POPCNT on 64bit words, 128bit vectors for the rest
+     */
+    __attribute__((target("sse4.2,popcnt")))
+    static uint64 sse42_popcount(const void* s, size_t count)
+    {
+        const uint8* p = (const uint8*) s;
+        uint64 c0 = 0, c1 = 0, c2 = 0, c3 = 0;
+        while (count >= 32)
+        {
+            c0 += _mm_popcnt_u64(load_uint64(p));
+            c1 += _mm_popcnt_u64(load_uint64(p + 8));
+            c2 += _mm_popcnt_u64(load_uint64(p + 16));
+            c3 += _mm_popcnt_u64(load_uint64(p + 24));
+            p += 32;
+            count -= 32;
+        }
+        while (count >= 8)
+        {
+            c0 += _mm_popcnt_u64(load_uint64(p));
+            p += 8;
+            count -= 8;
+        }
+        return c0 + c1 + c2 + c3 + scalar_popcount(p, count);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    static void sse42_operate(int op, void* dst, const void* src, size_t count)
+    {
+        uint8* d = (uint8*) dst;
+        const uint8* s = (const uint8*) src;
+        size_t i = 0;
+        switch (op)
+        {
+            case BIT_OP_AND:
+            {
+                for (; i + 16 <= count; i += 16)
+                    _mm_storeu_si128((__m128i*) (d + i),
+                            _mm_and_si128(_mm_loadu_si128((const __m128i*) (d + i)), _mm_loadu_si128((const __m128i*) (s + i))));
+                break;
+            }
+            case BIT_OP_OR:
+            {
+                for (; i + 16 <= count; i += 16)
+                    _mm_storeu_si128((__m128i*) (d + i),
+                            _mm_or_si128(_mm_loadu_si128((const __m128i*) (d + i)), _mm_loadu_si128((const __m128i*) (s + i))));
+                break;
+            }
+            case BIT_OP_XOR:
+            {
+                for (; i + 16 <= count; i += 16)
+                    _mm_storeu_si128((__m128i*) (d + i),
+                            _mm_xor_si128(_mm_loadu_si128((const __m128i*) (d + i)), _mm_loadu_si128((const __m128i*) (s + i))));
+                break;
+            }
+            case BIT_OP_NOT:
+            {
+                const __m128i ones = _mm_set1_epi32(-1);
+                for (; i + 16 <= count; i += 16)
+                    _mm_storeu_si128((__m128i*) (d + i), _mm_xor_si128(_mm_loadu_si128((const __m128i*) (d + i)), ones));
+                break;
+            }
+            default:
+            {
+                return;
+            }
+        }
+        scalar_operate(op, d + i, BIT_OP_NOT == op ? NULL : s + i, count - i);
+    }
+
+    __attribute__((target("sse4.2,popcnt")))
+    static size_t sse42_skip_bytes(const void* s, size_t count, uint8 skipval)
+    {
+        const uint8* p = (const uint8*) s;
+        const __m128i skip = _mm_set1_epi8((char) skipval);
+        size_t i = 0;
+        for (; i + 16 <= count; i += 16)
+        {
+            unsigned int mask = _mm_movemask_epi8(_mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*) (p + i)), skip));
+            if (mask != 0xFFFF)
+            {
+                return i + __builtin_ctz(~mask);
+            }
+        }
+        return i + scalar_skip_bytes(p + i, count - i, skipval);
+    }
+
+    /*
+     * avx2 kernel: nibble lookup popcount (Mula et al.) summed by VPSADBW, 256bit vectors for the rest
+     */
+    __attribute__((target("avx2")))
+    static inline __m256i avx2_popcount_bytes(__m256i v)
+    {
+        const __m256i lookup = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4, 0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3,
+                3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        __m256i lo = _mm256_and_si256(v, low_mask);
+        __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+        return _mm256_add_epi8(_mm256_shuffle_epi8(lookup, lo), _mm256_shuffle_epi8(lookup, hi));
+    }
+
+    __attribute__((target("avx2")))
+    static uint64 avx2_popcount(const void* s, size_t count)
+    {
+        const uint8* p = (const uint8*) s;
+        __m256i total = _mm256_setzero_si256();
+        /*
+         * per byte counters hold at most 8 * 8 bits before they are widened
+         */
+        while (count >= 256)
+        {
+            __m256i local = _mm256_setzero_si256();
+            for (int k = 0; k < 8; k++)
+            {
+                local = _mm256_add_epi8(local, avx2_popcount_bytes(_mm256_loadu_si256((const __m256i*) (p + k * 32))));
+            }
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(local, _mm256_setzero_si256()));
+            p += 256;
+            count -= 256;
+        }
+        while (count >= 32)
+        {
+            __m256i cnt = avx2_popcount_bytes(_mm256_loadu_si256((const __m256i*) p));
+            total = _mm256_add_epi64(total, _mm256_sad_epu8(cnt, _mm256_setzero_si256()));
+            p += 32;
+            count -= 32;
+        }
+        uint64 bits = (uint64) _mm256_extract_epi64(total, 0) + (uint64) _mm256_extract_epi64(total, 1)
+                + (uint64) _mm256_extract_epi64(total, 2) + (uint64) _mm256_extract_epi64(total, 3);
+        return bits + scalar_popcount(p, count);
+    }
+
+    __attribute__((target("avx2")))
+    static void avx2_operate(int op, void* dst, const void* src, size_t count)
+    {
+        uint8* d = (uint8*) dst;
+        const uint8* s = (const uint8*) src;
+        size_t i = 0;
+        switch (op)
+        {
+            case BIT_OP_AND:
+            {
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (d + i),
+                            _mm256_and_si256(_mm256_loadu_si256((const __m256i*) (d + i)), _mm256_loadu_si256((const __m256i*) (s + i))));
+                break;
+            }
+            case BIT_OP_OR:
+            {
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (d + i),
+                            _mm256_or_si256(_mm256_loadu_si256((const __m256i*) (d + i)), _mm256_loadu_si256((const __m256i*) (s + i))));
+                break;
+            }
+            case BIT_OP_XOR:
+            {
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (d + i),
+                            _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (d + i)), _mm256_loadu_si256((const __m256i*) (s + i))));
+                break;
+            }
+            case BIT_OP_NOT:
+            {
+                const __m256i ones = _mm256_set1_epi32(-1);
+                for (; i + 32 <= count; i += 32)
+                    _mm256_storeu_si256((__m256i*) (d + i), _mm256_xor_si256(_mm256_loadu_si256((const __m256i*) (d + i)), ones));
+                break;
+            }
+            default:
+            {
+                return;
+            }
+        }
+        scalar_operate(op, d + i, BIT_OP_NOT == op ? NULL : s + i, count - i);
+    }
+
+    __attribute__((target("avx2")))
+    static size_t avx2_skip_bytes(const void* s, size_t count, uint8 skipval)
+    {
+        const uint8* p = (const uint8*) s;
+        const __m256i skip = _mm256_set1_epi8((char) skipval);
+        size_t i = 0;
+        for (; i + 32 <= count; i += 32)
+        {
+            unsigned int mask = (unsigned int) _mm256_movemask_epi8(_mm256_cmpeq_epi8(_mm256_loadu_si256((const __m256i*) (p + i)), skip));
+            if (mask != 0xFFFFFFFFU)
+            {
+                return i + __builtin_ctz(~mask);
+            }
+        }
+        return i + scalar_skip_bytes(p + i, count - i, skipval);
+    }
+
+#ifdef BIT_KERNEL_X86_AVX512
+    /*
+     * avx512 kernel: VPOPCNTQ on 512bit vectors
+     */
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static uint64 avx512_popcount(const void* s, size_t count)
+    {
+        const uint8* p = (const uint8*) s;
+        __m512i total = _mm512_setzero_si512();
+        while (count >= 64)
+        {
+            total = _mm512_add_epi64(total, _mm512_popcnt_epi64(_mm512_loadu_si512((const void*) p)));
+            p += 64;
+            count -= 64;
+        }
+        uint64 lanes[8];
+        _mm512_storeu_si512((void*) lanes, total);
+        uint64 bits = lanes[0] + lanes[1] + lanes[2] + lanes[3] + lanes[4] + lanes[5] + lanes[6] + lanes[7];
+        return bits + scalar_popcount(p, count);
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static void avx512_operate(int op, void* dst, const void* src, size_t count)
+    {
+        uint8* d = (uint8*) dst;
+        const uint8* s = (const uint8*) src;
+        size_t i = 0;
+        switch (op)
+        {
+            case BIT_OP_AND:
+            {
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (d + i),
+                            _mm512_and_si512(_mm512_loadu_si512((const void*) (d + i)), _mm512_loadu_si512((const void*) (s + i))));
+                break;
+            }
+            case BIT_OP_OR:
+            {
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (d + i),
+                            _mm512_or_si512(_mm512_loadu_si512((const void*) (d + i)), _mm512_loadu_si512((const void*) (s + i))));
+                break;
+            }
+            case BIT_OP_XOR:
+            {
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (d + i),
+                            _mm512_xor_si512(_mm512_loadu_si512((const void*) (d + i)), _mm512_loadu_si512((const void*) (s + i))));
+                break;
+            }
+            case BIT_OP_NOT:
+            {
+                const __m512i ones = _mm512_set1_epi32(-1);
+                for (; i + 64 <= count; i += 64)
+                    _mm512_storeu_si512((void*) (d + i), _mm512_xor_si512(_mm512_loadu_si512((const void*) (d + i)), ones));
+                break;
+            }
+            default:
+            {
+                return;
+            }
+        }
+        scalar_operate(op, d + i, BIT_OP_NOT == op ? NULL : s + i, count - i);
+    }
+
+    __attribute__((target("avx512f,avx512vpopcntdq")))
+    static size_t avx512_skip_bytes(const void* s, size_t count, uint8 skipval)
+    {
+        const uint8* p = (const uint8*) s;
+        const __m512i skip = _mm512_set1_epi32((int) (skipval * 0x01010101U));
+        size_t i = 0;
+        for (; i + 64 <= count; i += 64)
+        {
+            __mmask8 mask = _mm512_cmpneq_epi64_mask(_mm512_loadu_si512((const void*) (p + i)), skip);
+            if (mask != 0)
+            {
+                /*
+                 * locate the byte inside the first mismatched 64bit word
+                 */
+                size_t word = i + __builtin_ctz(mask) * 8;
+                return word + scalar_skip_bytes(p + word, 8, skipval);
+            }
+        }
+        return i + scalar_skip_bytes(p + i, count - i, skipval);
+    }
+#endif
+
+    static inline uint64 read_xcr0()
+    {
+        uint32 eax, edx;
+        __asm__ __volatile__("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return ((uint64) edx << 32) | eax;
+    }
+#endif
+
+    static BitKernelOps g_bit_kernels[BIT_KERNEL_MAX] =
+    {
+        { "scalar", scalar_popcount, scalar_operate, scalar_skip_bytes },
+#ifdef BIT_KERNEL_X86
+        { "sse4.2", sse42_popcount, sse42_operate, sse42_skip_bytes },
+        { "avx2", avx2_popcount, avx2_operate, avx2_skip_bytes },
+#else
+        { "sse4.2", NULL, NULL, NULL },
+        { "avx2", NULL, NULL, NULL },
+#endif
+#ifdef BIT_KERNEL_X86_AVX512
+        { "avx512", avx512_popcount, avx512_operate, avx512_skip_bytes },
+#else
+        { "avx512", NULL, NULL, NULL },
+#endif
+    };
+
+    /*
+     * widest kernel usable on this cpu, AVX/AVX-512 also require the os to save the ymm/zmm state (XCR0)
+     */
+    static int detect_bit_kernel()
+    {
+        int kernel = BIT_KERNEL_SCALAR;
+#ifdef BIT_KERNEL_X86
+        static const uint32 kCpuid1EcxSSE42 = 1U << 20;
+        static const uint32 kCpuid1EcxPopcnt = 1U << 23;
+        static const uint32 kCpuid1EcxOSXSave = 1U << 27;
+        static const uint32 kCpuid1EcxAVX = 1U << 28;
+        static const uint32 kCpuid7EbxAVX2 = 1U << 5;
+        static const uint32 kCpuid7EbxAVX512F = 1U << 16;
+        static const uint32 kCpuid7EcxAVX512VPopcntDQ = 1U << 14;
+        static const uint64 kXcr0YmmState = 0x6;
+        static const uint64 kXcr0ZmmState = 0xe6;
+
+        uint32 eax, ebx, ecx, edx;
+        if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+        {
+            return kernel;
+        }
+        if (!(ecx & kCpuid1EcxSSE42) || !(ecx & kCpuid1EcxPopcnt))
+        {
+            return kernel;
+        }
+        kernel = BIT_KERNEL_SSE42;
+        if (!(ecx & kCpuid1EcxOSXSave) || !(ecx & kCpuid1EcxAVX))
+        {
+            return kernel;
+        }
+        uint64 xcr0 = read_xcr0();
+        if ((xcr0 & kXcr0YmmState) != kXcr0YmmState || __get_cpuid_max(0, NULL) < 7)
+        {
+            return kernel;
+        }
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if (ebx & kCpuid7EbxAVX2)
+        {
+            kernel = BIT_KERNEL_AVX2;
+        }
+        if ((xcr0 & kXcr0ZmmState) == kXcr0ZmmState && (ebx & kCpuid7EbxAVX512F) && (ecx & kCpuid7EcxAVX512VPopcntDQ)
+                && NULL != g_bit_kernels[BIT_KERNEL_AVX512].popcount)
+        {
+            kernel = BIT_KERNEL_AVX512;
+        }
+#endif
+        return kernel;
+    }
+
+    static const int g_detected_bit_kernel = detect_bit_kernel();
+    static const BitKernelOps* g_bit_ops = &g_bit_kernels[g_detected_bit_kernel];
+
+    uint64 bit_popcount(const void* s, size_t count)
+    {
+        return g_bit_ops->popcount(s, count);
+    }
+
+    void bit_operate(int op, void* dst, const void* src, size_t count)
+    {
+        g_bit_ops->operate(op, dst, src, count);
+    }
+
+    size_t bit_skip_bytes(const void* s, size_t count, uint8 skipval)
+    {
+        return g_bit_ops->skip_bytes(s, count, skipval);
+    }
+
+    bool bit_kernel_supported(int kernel)
+    {
+        return kernel >= BIT_KERNEL_SCALAR && kernel <= g_detected_bit_kernel;
+    }
+
+    const char* bit_kernel_name(int kernel)
+    {
+        if (kernel < BIT_KERNEL_SCALAR || kernel >= BIT_KERNEL_MAX)
+        {
+            return "unknown";
+        }
+        return g_bit_kernels[kernel].name;
+    }
+
+    int bit_kernel_current()
+    {
+        return g_bit_ops - g_bit_kernels;
+    }
+
+    bool bit_kernel_select(int kernel)
+    {
+        if (!bit_kernel_supported(kernel))
+        {
+            return false;
+        }
+        g_bit_ops = &g_bit_kernels[kernel];
+        return true;
+    }
+}
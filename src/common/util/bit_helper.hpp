@@ -0,0 +1,76 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef BIT_HELPER_HPP_
+#define BIT_HELPER_HPP_
+#include "common.hpp"
+#include <stdint.h>
+
+/*
+ * Bulk bit kernels used by BITCOUNT/BITOP/BITPOS.
+ * The widest kernel supported by the cpu & os is selected once at startup through CPUID,
+ * the scalar kernel is always available as fallback.
+ */
+namespace ardb
+{
+    enum BitOperation
+    {
+        BIT_OP_AND = 0, BIT_OP_OR = 1, BIT_OP_XOR = 2, BIT_OP_NOT = 3,
+    };
+
+    enum BitKernel
+    {
+        BIT_KERNEL_SCALAR = 0, BIT_KERNEL_SSE42 = 1, BIT_KERNEL_AVX2 = 2, BIT_KERNEL_AVX512 = 3, BIT_KERNEL_MAX = 4,
+    };
+
+    /*
+     * number of set bits in 'count' bytes starting at 's'
+     */
+    uint64 bit_popcount(const void* s, size_t count);
+    /*
+     * dst = dst 'op' src for 'count' bytes, 'src' is ignored by BIT_OP_NOT
+     */
+    void bit_operate(int op, void* dst, const void* src, size_t count);
+    /*
+     * number of leading bytes in 's' equal to 'skipval'
+     */
+    size_t bit_skip_bytes(const void* s, size_t count, uint8 skipval);
+
+    bool bit_kernel_supported(int kernel);
+    const char* bit_kernel_name(int kernel);
+    /*
+     * current selected kernel, the detected one unless overrided by bit_kernel_select
+     */
+    int bit_kernel_current();
+    /*
+     * force the given kernel, used by benchmark, return false if not supported
+     */
+    bool bit_kernel_select(int kernel);
+}
+#endif /* BIT_HELPER_HPP_ */
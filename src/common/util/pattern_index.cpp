@@ -0,0 +1,186 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "util/pattern_index.hpp"
+#include "util/string_helper.hpp"
+#include <algorithm>
+
+namespace ardb
+{
+    PatternIndex::Node* PatternIndex::Node::Child(char c) const
+    {
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            if (children[i].first == c)
+            {
+                return children[i].second;
+            }
+        }
+        return NULL;
+    }
+
+    PatternIndex::Node* PatternIndex::Node::AddChild(char c)
+    {
+        std::vector<std::pair<char, Node*> >::iterator it = children.begin();
+        while (it != children.end() && it->first < c)
+        {
+            it++;
+        }
+        if (it != children.end() && it->first == c)
+        {
+            return it->second;
+        }
+        Node* child = new Node;
+        children.insert(it, std::make_pair(c, child));
+        return child;
+    }
+
+    void PatternIndex::Node::RemoveChild(char c)
+    {
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            if (children[i].first == c)
+            {
+                delete children[i].second;
+                children.erase(children.begin() + i);
+                return;
+            }
+        }
+    }
+
+    PatternIndex::Node::~Node()
+    {
+        for (size_t i = 0; i < children.size(); i++)
+        {
+            delete children[i].second;
+        }
+    }
+
+    PatternIndex::PatternIndex()
+            : m_size(0)
+    {
+    }
+
+    size_t PatternIndex::LiteralPrefixLength(const std::string& pattern)
+    {
+        size_t i = 0;
+        while (i < pattern.size())
+        {
+            char c = pattern[i];
+            if (c == '*' || c == '?' || c == '[' || c == '\\')
+            {
+                break;
+            }
+            i++;
+        }
+        return i;
+    }
+
+    bool PatternIndex::Insert(const std::string& pattern)
+    {
+        size_t prefix_len = LiteralPrefixLength(pattern);
+        Node* node = &m_root;
+        for (size_t i = 0; i < prefix_len; i++)
+        {
+            node = node->AddChild(pattern[i]);
+        }
+        if (std::find(node->patterns.begin(), node->patterns.end(), pattern) != node->patterns.end())
+        {
+            return false;
+        }
+        node->patterns.push_back(pattern);
+        m_size++;
+        return true;
+    }
+
+    bool PatternIndex::Remove(const std::string& pattern)
+    {
+        size_t prefix_len = LiteralPrefixLength(pattern);
+        std::vector<Node*> path;
+        Node* node = &m_root;
+        path.push_back(node);
+        for (size_t i = 0; i < prefix_len && NULL != node; i++)
+        {
+            node = node->Child(pattern[i]);
+            path.push_back(node);
+        }
+        if (NULL == node)
+        {
+            return false;
+        }
+        std::vector<std::string>::iterator found = std::find(node->patterns.begin(), node->patterns.end(), pattern);
+        if (found == node->patterns.end())
+        {
+            return false;
+        }
+        node->patterns.erase(found);
+        m_size--;
+        /*
+         * prune the nodes left without any pattern below
+         */
+        for (size_t i = prefix_len; i > 0; i--)
+        {
+            Node* n = path[i];
+            if (!n->patterns.empty() || !n->children.empty())
+            {
+                break;
+            }
+            path[i - 1]->RemoveChild(pattern[i - 1]);
+        }
+        return true;
+    }
+
+    size_t PatternIndex::Match(const char* str, size_t len, std::vector<const std::string*>& matched) const
+    {
+        size_t count = 0;
+        const Node* node = &m_root;
+        size_t i = 0;
+        while (NULL != node)
+        {
+            for (size_t j = 0; j < node->patterns.size(); j++)
+            {
+                const std::string& pattern = node->patterns[j];
+                /*
+                 * the literal prefix already matched
+                 */
+                if (stringmatchlen(pattern.data() + i, pattern.size() - i, str + i, len - i, 0))
+                {
+                    matched.push_back(&pattern);
+                    count++;
+                }
+            }
+            if (i == len)
+            {
+                break;
+            }
+            node = node->Child(str[i]);
+            i++;
+        }
+        return count;
+    }
+}
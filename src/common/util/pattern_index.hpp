@@ -0,0 +1,73 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ * 
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ * 
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ * 
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS 
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF 
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef PATTERN_INDEX_HPP_
+#define PATTERN_INDEX_HPP_
+#include "common.hpp"
+#include <string>
+#include <vector>
+
+namespace ardb
+{
+    /*
+     * Glob patterns indexed by a trie on their literal prefix(chars before the first '*', '?', '[' or '\'),
+     * patterns starting with a special char stay at the root as a fallback list. Matching a string only
+     * evaluates the patterns whose literal prefix is a prefix of it.
+     */
+    class PatternIndex
+    {
+        private:
+            struct Node
+            {
+                    std::vector<std::pair<char, Node*> > children; //sorted by char
+                    std::vector<std::string> patterns;
+                    Node* Child(char c) const;
+                    Node* AddChild(char c);
+                    void RemoveChild(char c);
+                    ~Node();
+            };
+            Node m_root;
+            size_t m_size;
+        public:
+            PatternIndex();
+            static size_t LiteralPrefixLength(const std::string& pattern);
+            bool Insert(const std::string& pattern);
+            bool Remove(const std::string& pattern);
+            /*
+             * append the patterns matching the string, returned pointers are valid until next Insert/Remove
+             */
+            size_t Match(const char* str, size_t len, std::vector<const std::string*>& matched) const;
+            size_t Size() const
+            {
+                return m_size;
+            }
+    };
+}
+
+#endif /* PATTERN_INDEX_HPP_ */
@@ -394,6 +394,16 @@ namespace ardb
         return time(NULL);
     }
 
+    uint64 get_thread_cpu_micros()
+    {
+        struct timespec ts;
+        if (0 != clock_gettime(CLOCK_THREAD_CPUTIME_ID, &ts))
+        {
+            return get_current_epoch_micros();
+        }
+        return ((uint64) ts.tv_sec) * 1000000 + ts.tv_nsec / 1000;
+    }
+
     struct tm& get_current_tm(time_t now)
     {
         now = init_tm(now);
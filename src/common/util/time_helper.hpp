@@ -57,6 +57,10 @@ namespace ardb
 	uint64 get_current_epoch_millis();
 	uint64 get_current_epoch_micros();
 	uint32 get_current_epoch_seconds();
+	/*
+	 * cpu time consumed by the calling thread
+	 */
+	uint64 get_thread_cpu_micros();
 
 	uint32 get_current_year_day(time_t now = 0);
 	uint32 get_current_hour(time_t now = 0);
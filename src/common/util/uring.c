@@ -0,0 +1,541 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "uring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
+static int g_uring_enable = 0;
+static int g_uring_available = -1;
+
+#ifdef HAVE_IO_URING
+#include <sys/mman.h>
+#include <signal.h>
+
+struct uring_t
+{
+        int fd;
+        unsigned* sq_head;
+        unsigned* sq_tail;
+        unsigned sq_mask;
+        unsigned sq_entries;
+        unsigned* sq_array;
+        unsigned* cq_head;
+        unsigned* cq_tail;
+        unsigned cq_mask;
+        struct io_uring_sqe* sqes;
+        struct io_uring_cqe* cqes;
+        void* sq_ring;
+        size_t sq_ring_size;
+        void* cq_ring;
+        size_t cq_ring_size;
+        size_t sqes_size;
+        unsigned sqe_tail;
+        unsigned to_submit;
+        unsigned features;
+};
+
+uring_t* uring_create(unsigned entries)
+{
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    int fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+    if (fd < 0)
+    {
+        return NULL;
+    }
+    uring_t* ring = (uring_t*) calloc(1, sizeof(uring_t));
+    if (NULL == ring)
+    {
+        close(fd);
+        return NULL;
+    }
+    ring->fd = fd;
+    ring->sq_ring_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+    ring->cq_ring_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        if (ring->cq_ring_size > ring->sq_ring_size)
+            ring->sq_ring_size = ring->cq_ring_size;
+        ring->cq_ring_size = ring->sq_ring_size;
+    }
+    ring->sq_ring = mmap(NULL, ring->sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+    IORING_OFF_SQ_RING);
+    if (MAP_FAILED == ring->sq_ring)
+    {
+        ring->sq_ring = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+    if (p.features & IORING_FEAT_SINGLE_MMAP)
+    {
+        ring->cq_ring = ring->sq_ring;
+    }
+    else
+    {
+        ring->cq_ring = mmap(NULL, ring->cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+        IORING_OFF_CQ_RING);
+        if (MAP_FAILED == ring->cq_ring)
+        {
+            ring->cq_ring = NULL;
+            uring_destroy(ring);
+            return NULL;
+        }
+    }
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = (struct io_uring_sqe*) mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+            fd, IORING_OFF_SQES);
+    if (MAP_FAILED == ring->sqes)
+    {
+        ring->sqes = NULL;
+        uring_destroy(ring);
+        return NULL;
+    }
+    char* sq = (char*) ring->sq_ring;
+    char* cq = (char*) ring->cq_ring;
+    ring->sq_head = (unsigned*) (sq + p.sq_off.head);
+    ring->sq_tail = (unsigned*) (sq + p.sq_off.tail);
+    ring->sq_mask = *(unsigned*) (sq + p.sq_off.ring_mask);
+    ring->sq_entries = *(unsigned*) (sq + p.sq_off.ring_entries);
+    ring->sq_array = (unsigned*) (sq + p.sq_off.array);
+    ring->cq_head = (unsigned*) (cq + p.cq_off.head);
+    ring->cq_tail = (unsigned*) (cq + p.cq_off.tail);
+    ring->cq_mask = *(unsigned*) (cq + p.cq_off.ring_mask);
+    ring->cqes = (struct io_uring_cqe*) (cq + p.cq_off.cqes);
+    ring->sqe_tail = *ring->sq_tail;
+    ring->features = p.features;
+    return ring;
+}
+
+void uring_destroy(uring_t* ring)
+{
+    if (NULL == ring)
+    {
+        return;
+    }
+    if (NULL != ring->sqes)
+    {
+        munmap(ring->sqes, ring->sqes_size);
+    }
+    if (NULL != ring->cq_ring && ring->cq_ring != ring->sq_ring)
+    {
+        munmap(ring->cq_ring, ring->cq_ring_size);
+    }
+    if (NULL != ring->sq_ring)
+    {
+        munmap(ring->sq_ring, ring->sq_ring_size);
+    }
+    close(ring->fd);
+    free(ring);
+}
+
+struct io_uring_sqe* uring_get_sqe(uring_t* ring)
+{
+    unsigned head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (ring->sqe_tail - head >= ring->sq_entries)
+    {
+        if (uring_submit(ring, 0) < 0)
+        {
+            return NULL;
+        }
+        head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+        if (ring->sqe_tail - head >= ring->sq_entries)
+        {
+            return NULL;
+        }
+    }
+    unsigned idx = ring->sqe_tail & ring->sq_mask;
+    struct io_uring_sqe* sqe = &ring->sqes[idx];
+    memset(sqe, 0, sizeof(*sqe));
+    ring->sq_array[idx] = idx;
+    ring->sqe_tail++;
+    ring->to_submit++;
+    return sqe;
+}
+
+static int uring_enter(uring_t* ring, unsigned wait_nr, unsigned flags, void* arg, size_t argsz)
+{
+    __atomic_store_n(ring->sq_tail, ring->sqe_tail, __ATOMIC_RELEASE);
+    while (1)
+    {
+        int ret = (int) syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, wait_nr,
+                (wait_nr > 0 ? IORING_ENTER_GETEVENTS : 0) | flags, arg, argsz);
+        if (ret < 0)
+        {
+            int err = errno;
+            if (EINTR == err && 0 == wait_nr)
+            {
+                continue;
+            }
+            return -err;
+        }
+        ring->to_submit = (unsigned) ret >= ring->to_submit ? 0 : ring->to_submit - ret;
+        return ret;
+    }
+}
+
+int uring_submit(uring_t* ring, unsigned wait_nr)
+{
+    return uring_enter(ring, wait_nr, 0, NULL, 0);
+}
+
+int uring_can_wait_timeout(uring_t* ring)
+{
+#ifdef IORING_FEAT_EXT_ARG
+    return (ring->features & IORING_FEAT_EXT_ARG) ? 1 : 0;
+#else
+    return 0;
+#endif
+}
+
+int uring_submit_wait_timeout(uring_t* ring, unsigned wait_nr, int64_t timeout_usecs)
+{
+    if (timeout_usecs < 0 || 0 == wait_nr)
+    {
+        return uring_submit(ring, wait_nr);
+    }
+#ifdef IORING_FEAT_EXT_ARG
+    struct __kernel_timespec ts;
+    struct io_uring_getevents_arg arg;
+    ts.tv_sec = timeout_usecs / 1000000;
+    ts.tv_nsec = (timeout_usecs % 1000000) * 1000;
+    memset(&arg, 0, sizeof(arg));
+    arg.sigmask_sz = _NSIG / 8;
+    arg.ts = (uint64_t) (uintptr_t) &ts;
+    return uring_enter(ring, wait_nr, IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+#else
+    return -ENOTSUP;
+#endif
+}
+
+struct io_uring_cqe* uring_peek_cqe(uring_t* ring)
+{
+    unsigned head = *ring->cq_head;
+    if (head == __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE))
+    {
+        return NULL;
+    }
+    return &ring->cqes[head & ring->cq_mask];
+}
+
+int uring_wait_cqe(uring_t* ring, struct io_uring_cqe** cqe)
+{
+    while (NULL == (*cqe = uring_peek_cqe(ring)))
+    {
+        int ret = uring_submit(ring, 1);
+        if (ret < 0 && -EINTR != ret)
+        {
+            return ret;
+        }
+    }
+    return 0;
+}
+
+void uring_cqe_seen(uring_t* ring)
+{
+    __atomic_store_n(ring->cq_head, *ring->cq_head + 1, __ATOMIC_RELEASE);
+}
+
+static int uring_probe(void)
+{
+    uring_t* ring = uring_create(4);
+    if (NULL == ring)
+    {
+        return 0;
+    }
+    /*
+     * IORING_REGISTER_PROBE is supported since linux 5.6, older kernels use epoll/write
+     */
+    size_t len = sizeof(struct io_uring_probe) + 256 * sizeof(struct io_uring_probe_op);
+    struct io_uring_probe* probe = (struct io_uring_probe*) calloc(1, len);
+    int ok = 0;
+    if (NULL != probe && syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) >= 0)
+    {
+        int ops[] = { IORING_OP_POLL_ADD, IORING_OP_POLL_REMOVE, IORING_OP_WRITE, IORING_OP_FSYNC };
+        size_t i;
+        ok = 1;
+        for (i = 0; i < sizeof(ops) / sizeof(ops[0]); i++)
+        {
+            if (ops[i] > probe->last_op || !(probe->ops[ops[i]].flags & IO_URING_OP_SUPPORTED))
+            {
+                ok = 0;
+            }
+        }
+    }
+    free(probe);
+    uring_destroy(ring);
+    return ok;
+}
+#endif
+
+void uring_enable(int on)
+{
+    g_uring_enable = on;
+}
+
+int uring_enabled(void)
+{
+    if (!g_uring_enable)
+    {
+        return 0;
+    }
+#ifdef HAVE_IO_URING
+    if (g_uring_available < 0)
+    {
+        g_uring_available = uring_probe();
+    }
+    return g_uring_available;
+#else
+    return 0;
+#endif
+}
+
+#define URING_WRITER_BUFS 4
+#define URING_WRITER_BUF_SIZE (1024 * 1024)
+
+struct uring_writer_t
+{
+#ifdef HAVE_IO_URING
+        uring_t* ring;
+#endif
+        int fd;
+        int err;
+        int64_t offset; /* file offset of the current buffer */
+        unsigned cur;
+        unsigned inflight;
+        char* bufs[URING_WRITER_BUFS];
+        size_t lens[URING_WRITER_BUFS];
+        int64_t offsets[URING_WRITER_BUFS];
+        int busy[URING_WRITER_BUFS];
+};
+
+#ifdef HAVE_IO_URING
+/*
+ * wait one write completion, write errors are kept in 'err', return < 0 only if waiting failed
+ */
+static int uring_writer_reap(uring_writer_t* w)
+{
+    struct io_uring_cqe* cqe = NULL;
+    int ret = uring_wait_cqe(w->ring, &cqe);
+    if (ret < 0)
+    {
+        w->err = ret;
+        return ret;
+    }
+    unsigned idx = (unsigned) cqe->user_data;
+    int res = cqe->res;
+    uring_cqe_seen(w->ring);
+    if (idx >= URING_WRITER_BUFS || !w->busy[idx])
+    {
+        return 0;
+    }
+    w->busy[idx] = 0;
+    w->inflight--;
+    if (res < 0)
+    {
+        w->err = res;
+    }
+    else if ((size_t) res < w->lens[idx])
+    {
+        /*
+         * short write, write the rest synchronously
+         */
+        size_t done = res;
+        while (done < w->lens[idx])
+        {
+            ssize_t n = pwrite(w->fd, w->bufs[idx] + done, w->lens[idx] - done, w->offsets[idx] + done);
+            if (n <= 0)
+            {
+                w->err = -errno;
+                break;
+            }
+            done += n;
+        }
+    }
+    w->lens[idx] = 0;
+    return 0;
+}
+
+static int uring_writer_submit(uring_writer_t* w)
+{
+    unsigned idx = w->cur;
+    if (0 == w->lens[idx])
+    {
+        return 0;
+    }
+    struct io_uring_sqe* sqe = uring_get_sqe(w->ring);
+    if (NULL == sqe)
+    {
+        w->err = -EBUSY;
+        return w->err;
+    }
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = w->fd;
+    sqe->addr = (uint64_t) (uintptr_t) w->bufs[idx];
+    sqe->len = (unsigned) w->lens[idx];
+    sqe->off = (uint64_t) w->offset;
+    sqe->user_data = idx;
+    w->offsets[idx] = w->offset;
+    w->busy[idx] = 1;
+    w->inflight++;
+    w->offset += w->lens[idx];
+    int ret = uring_submit(w->ring, 0);
+    if (ret < 0)
+    {
+        w->err = ret;
+        return ret;
+    }
+    w->cur = (w->cur + 1) % URING_WRITER_BUFS;
+    while (w->busy[w->cur])
+    {
+        if (uring_writer_reap(w) < 0)
+        {
+            break;
+        }
+    }
+    return w->err;
+}
+#endif
+
+uring_writer_t* uring_writer_open(int fd, int64_t offset)
+{
+#ifdef HAVE_IO_URING
+    if (!uring_enabled())
+    {
+        return NULL;
+    }
+    uring_writer_t* w = (uring_writer_t*) calloc(1, sizeof(uring_writer_t));
+    if (NULL == w)
+    {
+        return NULL;
+    }
+    w->ring = uring_create(URING_WRITER_BUFS * 2);
+    if (NULL == w->ring)
+    {
+        free(w);
+        return NULL;
+    }
+    w->fd = fd;
+    w->offset = offset;
+    return w;
+#else
+    return NULL;
+#endif
+}
+
+int uring_writer_write(uring_writer_t* w, const void* buf, size_t len)
+{
+#ifdef HAVE_IO_URING
+    const char* p = (const char*) buf;
+    while (len > 0 && 0 == w->err)
+    {
+        unsigned idx = w->cur;
+        if (NULL == w->bufs[idx])
+        {
+            w->bufs[idx] = (char*) malloc(URING_WRITER_BUF_SIZE);
+            if (NULL == w->bufs[idx])
+            {
+                w->err = -ENOMEM;
+                break;
+            }
+        }
+        size_t n = URING_WRITER_BUF_SIZE - w->lens[idx];
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(w->bufs[idx] + w->lens[idx], p, n);
+        w->lens[idx] += n;
+        p += n;
+        len -= n;
+        if (w->lens[idx] == URING_WRITER_BUF_SIZE)
+        {
+            uring_writer_submit(w);
+        }
+    }
+    return w->err;
+#else
+    return -1;
+#endif
+}
+
+int uring_writer_flush(uring_writer_t* w)
+{
+#ifdef HAVE_IO_URING
+    if (0 == w->err)
+    {
+        uring_writer_submit(w);
+    }
+    while (w->inflight > 0)
+    {
+        if (uring_writer_reap(w) < 0)
+        {
+            break;
+        }
+    }
+    return w->err;
+#else
+    return -1;
+#endif
+}
+
+int uring_writer_seek(uring_writer_t* w, int64_t offset)
+{
+    int ret = uring_writer_flush(w);
+    if (0 == ret)
+    {
+        w->offset = offset;
+    }
+    return ret;
+}
+
+int64_t uring_writer_tell(uring_writer_t* w)
+{
+    return w->offset + w->lens[w->cur];
+}
+
+int uring_writer_close(uring_writer_t* w)
+{
+    if (NULL == w)
+    {
+        return 0;
+    }
+    int ret = uring_writer_flush(w);
+#ifdef HAVE_IO_URING
+    uring_destroy(w->ring);
+#endif
+    unsigned i;
+    for (i = 0; i < URING_WRITER_BUFS; i++)
+    {
+        free(w->bufs[i]);
+    }
+    free(w);
+    return ret;
+}
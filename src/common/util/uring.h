@@ -0,0 +1,100 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef URING_H_
+#define URING_H_
+
+#include <stdint.h>
+#include <stddef.h>
+
+/*
+ * A minimal io_uring binding over raw syscalls(no liburing dependency), used by the
+ * 'ae' io_uring backend and the replication file writers.
+ */
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#include <sys/syscall.h>
+#if defined(__NR_io_uring_setup) && defined(__NR_io_uring_enter) && defined(__NR_io_uring_register)
+#include <linux/io_uring.h>
+#define HAVE_IO_URING 1
+#endif
+#endif
+#endif
+
+#ifdef __cplusplus
+extern "C"
+{
+#endif
+
+    /*
+     * io_uring is used only after enabled & the running kernel supports all the operations we need,
+     * otherwise callers fall back to epoll/write.
+     */
+    void uring_enable(int on);
+    int uring_enabled(void);
+
+#ifdef HAVE_IO_URING
+    typedef struct uring_t uring_t;
+    uring_t* uring_create(unsigned entries);
+    void uring_destroy(uring_t* ring);
+    /*
+     * returned sqe is zeroed, pending sqes are submitted first if the submission queue is full
+     */
+    struct io_uring_sqe* uring_get_sqe(uring_t* ring);
+    /*
+     * submit pending sqes & wait 'wait_nr' completions, return submitted count or -errno
+     */
+    int uring_submit(uring_t* ring, unsigned wait_nr);
+    /*
+     * waiting with a timeout needs IORING_FEAT_EXT_ARG(linux 5.11), a negative timeout waits forever
+     */
+    int uring_can_wait_timeout(uring_t* ring);
+    int uring_submit_wait_timeout(uring_t* ring, unsigned wait_nr, int64_t timeout_usecs);
+    struct io_uring_cqe* uring_peek_cqe(uring_t* ring);
+    int uring_wait_cqe(uring_t* ring, struct io_uring_cqe** cqe);
+    void uring_cqe_seen(uring_t* ring);
+#endif
+
+    /*
+     * sequential file writer: data is copied into a few buffers written asynchronously while
+     * the caller fills the next one, open returns NULL if io_uring is not enabled.
+     */
+    typedef struct uring_writer_t uring_writer_t;
+    uring_writer_t* uring_writer_open(int fd, int64_t offset);
+    int uring_writer_write(uring_writer_t* w, const void* buf, size_t len);
+    int uring_writer_flush(uring_writer_t* w);
+    int uring_writer_seek(uring_writer_t* w, int64_t offset);
+    int64_t uring_writer_tell(uring_writer_t* w);
+    int uring_writer_close(uring_writer_t* w);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* URING_H_ */
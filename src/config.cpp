@@ -31,6 +31,7 @@
 #include "util/file_helper.hpp"
 #include "util/string_helper.hpp"
 #include "util/system_helper.hpp"
+#include "db/codec.hpp"
 #include <errno.h>
 
 #define ARDB_AUTHPASS_MAX_LEN 512
@@ -54,6 +55,12 @@ OP_NAMESPACE_BEGIN
             ERROR_LOG("[Config]Password is longer than %u", ARDB_AUTHPASS_MAX_LEN);
             return false;
         }
+        uint8 key_format;
+        if (strcasecmp(cfg.key_format.c_str(), "auto") && !parse_key_encode_format(cfg.key_format, key_format))
+        {
+            ERROR_LOG("[Config]Invalid value:%s for 'key-format'", cfg.key_format.c_str());
+            return false;
+        }
         return true;
     }
 
@@ -89,6 +96,19 @@ OP_NAMESPACE_BEGIN
         {
             thread_pool_size = available_processors();
         }
+        conf_get_bool(props, "reuseport", reuse_port);
+        conf_get_int64(props, "io-thread-rebalance-threshold", io_thread_rebalance_threshold);
+        if (io_thread_rebalance_threshold < 0)
+            io_thread_rebalance_threshold = 0;
+        if (io_thread_rebalance_threshold > 100)
+            io_thread_rebalance_threshold = 100;
+        conf_get_string(props, "io-backend", io_backend);
+        lower_string(io_backend);
+        if (io_backend != "epoll" && io_backend != "io_uring")
+        {
+            WARN_LOG("Invalid 'io-backend' config:%s, use 'epoll' instead.", io_backend.c_str());
+            io_backend = "epoll";
+        }
         conf_get_int64(props, "hz", hz);
         if (hz < CONFIG_MIN_HZ)
             hz = CONFIG_MIN_HZ;
@@ -150,11 +170,13 @@ OP_NAMESPACE_BEGIN
         {
             conf_get_string(props, "rocksdb.compaction", rocksdb_compaction);
             conf_get_bool(props, "rocksdb.disableWAL", rocksdb_disablewal);
+            conf_get_bool(props, "rocksdb.syncWAL", rocksdb_syncwal);
             conf_get_bool(props, "rocksdb.scan-total-order", rocksdb_scan_total_order);
         }
 
         conf_get_string(props, "engine", engine);
         conf_get_string(props, "data-dir", data_base_path);
+        conf_get_string(props, "key-format", key_format);
         conf_get_string(props, "backup-dir", backup_dir);
         conf_get_string(props, "repl-dir", repl_data_dir);
         make_dir(repl_data_dir);
@@ -179,6 +201,16 @@ OP_NAMESPACE_BEGIN
 
         conf_get_string(props, "loglevel", loglevel);
         conf_get_string(props, "logfile", logfile);
+        conf_get_int64(props, "log-async-buffer-size", log_async_buffer_size);
+        std::string log_async_full_policy = log_async_block_when_full ? "block" : "drop";
+        conf_get_string(props, "log-async-full-policy", log_async_full_policy);
+        lower_string(log_async_full_policy);
+        if (log_async_full_policy != "drop" && log_async_full_policy != "block")
+        {
+            WARN_LOG("Invalid 'log-async-full-policy' config:%s, use 'drop' instead.", log_async_full_policy.c_str());
+            log_async_full_policy = "drop";
+        }
+        log_async_block_when_full = log_async_full_policy == "block";
         conf_get_bool(props, "daemonize", daemonize);
 
         conf_get_int64(props, "repl-backlog-size", repl_backlog_size);
@@ -190,13 +222,27 @@ OP_NAMESPACE_BEGIN
         conf_get_int64(props, "min-slaves-to-write", repl_min_slaves_to_write);
         conf_get_int64(props, "min-slaves-max-lag", repl_min_slaves_max_lag);
         conf_get_bool(props, "slave-serve-stale-data", repl_serve_stale_data);
+        conf_get_int64(props, "slave-workers", slave_workers);
+        if (slave_workers <= 0)
+        {
+            slave_workers = available_processors();
+        }
         conf_get_int64(props, "max-slave-worker-queue", max_slave_worker_queue);
         if(max_slave_worker_queue <= 0)
         {
             max_slave_worker_queue = 1024;
         }
+        conf_get_int64(props, "max-slave-worker-batch", max_slave_worker_batch);
+        if (max_slave_worker_batch <= 0)
+        {
+            max_slave_worker_batch = 1;
+        }
 
         conf_get_bool(props, "repl-disable-tcp-nodelay", repl_disable_tcp_nodelay);
+        conf_get_bool(props, "repl-wal-sendfile", repl_wal_sendfile);
+        conf_get_string(props, "repl-wal-compression", repl_wal_compression);
+        conf_get_bool(props, "repl-diskless-sync", repl_diskless_sync);
+        conf_get_int64(props, "repl-diskless-sync-delay", repl_diskless_sync_delay);
         conf_get_int64(props, "lua-time-limit", lua_time_limit);
 
         conf_get_int64(props, "snapshot-max-lag-offset", snapshot_max_lag_offset);
@@ -296,6 +342,32 @@ OP_NAMESPACE_BEGIN
         conf_get_int64(props, "qps-limit-per-connection", qps_limit_per_connection);
         conf_get_int64(props, "range-delete-min-size", range_delete_min_size);
         conf_get_int64(props, "stream-lru-cache-size", stream_lru_cache_size);
+        conf_get_int64(props, "zset-rank-index-min-size", zset_rank_index_min_size);
+        conf_get_int64(props, "list-chunk-max-size", list_chunk_max_size);
+        conf_get_int64(props, "hash-max-compact-entries", hash_max_compact_entries);
+        conf_get_int64(props, "set-max-compact-entries", set_max_compact_entries);
+        conf_get_int64(props, "zset-max-compact-entries", zset_max_compact_entries);
+        conf_get_int64(props, "compact-max-value-size", compact_max_value_size);
+        conf_get_int64(props, "string-segment-size", string_segment_size);
+        conf_get_int64(props, "expire-cycle-threads", expire_cycle_threads);
+        if (expire_cycle_threads < 1)
+            expire_cycle_threads = 1;
+        if (expire_cycle_threads > 16)
+            expire_cycle_threads = 16;
+        conf_get_int64(props, "expire-cycle-cpu-percent", expire_cycle_cpu_percent);
+        if (expire_cycle_cpu_percent < 1)
+            expire_cycle_cpu_percent = 1;
+        if (expire_cycle_cpu_percent > 100)
+            expire_cycle_cpu_percent = 100;
+        conf_get_int64(props, "group-commit-max-batch", group_commit_max_batch);
+        if (group_commit_max_batch < 1)
+            group_commit_max_batch = 1;
+        conf_get_int64(props, "group-commit-max-delay-us", group_commit_max_delay_micros);
+        if (group_commit_max_delay_micros < 0)
+            group_commit_max_delay_micros = 0;
+        conf_get_int64(props, "pipeline-read-batch-max", pipeline_read_batch_max);
+        if (pipeline_read_batch_max < 1)
+            pipeline_read_batch_max = 1;
 
         conf_get_bool(props, "rocksdb.read_fill_cache", rocksdb_read_fill_cache);
         conf_get_bool(props, "rocksdb.iter_fill_cache", rocksdb_iter_fill_cache);
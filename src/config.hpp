@@ -75,6 +75,7 @@ OP_NAMESPACE_BEGIN
             std::string engine;
             std::string home;
             std::string data_base_path;
+            std::string key_format;
             int64 slowlog_log_slower_than;
             int64 slowlog_max_len;
 
@@ -82,6 +83,7 @@ OP_NAMESPACE_BEGIN
             std::string rocksdb_compaction;
             bool rocksdb_scan_total_order;
             bool rocksdb_disablewal;
+            bool rocksdb_syncwal;
 
             std::string repl_data_dir;
             std::string backup_dir;
@@ -100,7 +102,9 @@ OP_NAMESPACE_BEGIN
             bool slave_readonly;
             bool slave_serve_stale_data;
             int64 slave_priority;
+            int64 slave_workers;
             int64 max_slave_worker_queue;
+            int64 max_slave_worker_batch;
 
             StringTreeSet trusted_ip;
 
@@ -113,6 +117,8 @@ OP_NAMESPACE_BEGIN
 
             std::string loglevel;
             std::string logfile;
+            int64_t log_async_buffer_size;
+            bool log_async_block_when_full;
 
             std::string pidfile;
 
@@ -132,6 +138,10 @@ OP_NAMESPACE_BEGIN
             bool slave_ignore_expire;
             bool slave_ignore_del;
             bool repl_disable_tcp_nodelay;
+            bool repl_wal_sendfile;
+            std::string repl_wal_compression;
+            bool repl_diskless_sync;
+            int64_t repl_diskless_sync_delay;
 
             bool scan_redis_compatible;
             int64_t scan_cursor_expire_after;
@@ -155,6 +165,26 @@ OP_NAMESPACE_BEGIN
 
             int64_t stream_lru_cache_size;
 
+            int64_t zset_rank_index_min_size;
+            int64_t list_chunk_max_size;
+            int64_t hash_max_compact_entries;
+            int64_t set_max_compact_entries;
+            int64_t zset_max_compact_entries;
+            int64_t compact_max_value_size;
+            int64_t string_segment_size;
+
+            int64_t expire_cycle_threads;
+            int64_t expire_cycle_cpu_percent;
+
+            int64_t group_commit_max_batch;
+            int64_t group_commit_max_delay_micros;
+
+            int64_t pipeline_read_batch_max;
+
+            bool reuse_port;
+            int64_t io_thread_rebalance_threshold;
+            std::string io_backend;
+
             std::string _conf_file;
             std::string _executable;
             Properties conf_props;
@@ -164,20 +194,24 @@ OP_NAMESPACE_BEGIN
 
             ArdbConfig()
                     : daemonize(false), thread_pool_size(0), hz(10), max_clients(10000), tcp_keepalive(0), timeout(0), engine(
-                            "rocksdb"), slowlog_log_slower_than(10000), slowlog_max_len(128), rocksdb_compaction(
-                            "none"), rocksdb_scan_total_order(false), rocksdb_disablewal(false), repl_data_dir(
+                            "rocksdb"), key_format("auto"), slowlog_log_slower_than(10000), slowlog_max_len(128), rocksdb_compaction(
+                            "none"), rocksdb_scan_total_order(false), rocksdb_disablewal(false), rocksdb_syncwal(false), repl_data_dir(
                             "./repl"), backup_dir("./backup"), backup_redis_format(false), repl_ping_slave_period(10), repl_timeout(
                             60), repl_backlog_size(100 * 1024 * 1024), repl_backlog_cache_size(100 * 1024 * 1024), repl_backlog_sync_period(
                             1), repl_backlog_time_limit(3600), repl_min_slaves_to_write(0), repl_min_slaves_max_lag(10), repl_serve_stale_data(
                             false), slave_cleardb_before_fullresync(true), slave_readonly(true), slave_serve_stale_data(
-                            true), slave_priority(100), max_slave_worker_queue(1024), lua_time_limit(0), master_port(0), loglevel(
-                            "INFO"), hll_sparse_max_bytes(3000), reply_pool_size(1000), slave_client_output_buffer_limit(
+                            true), slave_priority(100), slave_workers(2), max_slave_worker_queue(1024), max_slave_worker_batch(64), lua_time_limit(0), master_port(0), loglevel(
+                            "INFO"), log_async_buffer_size(0), log_async_block_when_full(false), hll_sparse_max_bytes(3000), reply_pool_size(1000), slave_client_output_buffer_limit(
                             256 * 1024 * 1024), pubsub_client_output_buffer_limit(32 * 1024 * 1024), slave_ignore_expire(
-                            false), slave_ignore_del(false), repl_disable_tcp_nodelay(true), scan_redis_compatible(
+                            false), slave_ignore_del(false), repl_disable_tcp_nodelay(true), repl_wal_sendfile(true), repl_wal_compression(
+                            "none"), repl_diskless_sync(false), repl_diskless_sync_delay(5), scan_redis_compatible(
                             true), scan_cursor_expire_after(60), snapshot_max_lag_offset(500 * 1024 * 1024), maxsnapshots(
                             10), redis_compatible(false), compact_after_snapshot_load(false), redis_compatible_version(
                             "2.8.0"), statistics_log_period(300), qps_limit_per_host(0), qps_limit_per_connection(0), range_delete_min_size(
-                            100), stream_lru_cache_size(1024),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
+                            100), stream_lru_cache_size(1024), zset_rank_index_min_size(
+                            128), list_chunk_max_size(128), hash_max_compact_entries(
+                            128), set_max_compact_entries(128), zset_max_compact_entries(128), compact_max_value_size(
+                            64), string_segment_size(65536), expire_cycle_threads(2), expire_cycle_cpu_percent(25), group_commit_max_batch(32), group_commit_max_delay_micros(0), pipeline_read_batch_max(64), reuse_port(false), io_thread_rebalance_threshold(25), io_backend("epoll"),rocksdb_read_fill_cache(true),rocksdb_iter_fill_cache(true)
             {
             }
             bool Parse(const Properties& props);
@@ -59,10 +59,11 @@ OP_NAMESPACE_BEGIN
             unsigned reply_off :1;
             unsigned reply_skip :1;
             unsigned block_keys_locked :1;
+            unsigned readonly :1; //current command only reads keys, its key locks are shared
             CallFlags()
                     : no_wal(0), no_fill_reply(0), create_if_notexist(0), fuzzy_check(0), redis_compatible(0), iterate_multi_keys(
                             0), iterate_no_upperbound(0), iterate_total_order(0), slave(0), lua(0), pubsub(0), bulk_loading(
-                            0), reply_off(0), reply_skip(0), block_keys_locked(0)
+                            0), reply_off(0), reply_skip(0), block_keys_locked(0), readonly(0)
             {
             }
     };
@@ -129,6 +130,12 @@ OP_NAMESPACE_BEGIN
             int64 uptime;
             int64 last_interaction_ustime;
             int64 resume_ustime;
+            /*
+             * both fire in the io thread of the connection, one closes it after 'timeout' seconds idle,
+             * the other resumes it from CLIENT PAUSE
+             */
+            TimingWheelEntry idle_timer;
+            TimingWheelEntry pause_timer;
             ClientContext()
                     : processing(false), client(NULL), uptime(0), last_interaction_ustime(0), resume_ustime(-1)
             {
@@ -175,6 +182,10 @@ OP_NAMESPACE_BEGIN
             typedef TreeMap<KeyPrefix, const void*>::Type BlockKeyTable;
             BlockKeyTable keys;
             uint64 timeout;
+            /*
+             * replies nil and unblocks the client once the timeout reached, canceled with the state
+             */
+            TimingWheelEntry deadline;
             BlockListTarget* list_target;
             BlockStreamTarget* stream_target;
             uint32 block_keytype;
@@ -205,6 +216,7 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    struct ReadBatch;
     typedef void ContextFunc(void*);
     struct ContextFunctor
     {
@@ -235,14 +247,24 @@ OP_NAMESPACE_BEGIN
             CallFlags flags;
             bool authenticated;
             bool keyslocked;
+            bool keyslocked_shared; //keys are locked shared or read from engine snapshot, they must not be modified
 
             const void* engine_snapshot;
             void* cmd_proxy;
+            /*
+             * output buffer of the client connection while its command is called, RedisReplyWriter streams
+             * replies into it directly. NULL for lua, transactions, replication and muted clients.
+             */
+            Buffer* reply_buffer;
+            /*
+             * values loaded by Ardb::PrefetchReads for the pipelined reads being called, NULL otherwise
+             */
+            ReadBatch* read_batch;
             ContextFunctorArray post_cmd_func;
             Context()
                     : reply(NULL), client(NULL), transc(NULL), pubsub(
                     NULL), bpop(NULL), current_cmd(NULL), dirty(0), last_cmdtype(REDIS_CMD_INVALID), transc_err(0), authenticated(
-                            true), keyslocked(false), engine_snapshot(NULL), cmd_proxy(NULL)
+                            true), keyslocked(false), keyslocked_shared(false), engine_snapshot(NULL), cmd_proxy(NULL), reply_buffer(NULL), read_batch(NULL)
             {
                 ns.SetString("0", false);
             }
@@ -102,7 +102,6 @@ OP_NAMESPACE_BEGIN
     {
             void Run()
             {
-                g_db->ScanExpiredKeys();
                 g_snapshot_manager->Routine();
             }
     };
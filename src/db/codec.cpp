@@ -34,10 +34,245 @@
 #include <cmath>
 #include <float.h>
 
-static const uint8 kCurrentMetaFormat = 0;
+extern "C"
+{
+#include "redis/listpack.h"
+}
+
+/*
+ * 0: initial format
+ * 1: zset meta carries 'zset_rank_indexed'
+ * 2: list meta carries chunk layout
+ * 3: hash/set/zset meta carries compact elements
+ */
+static const uint8 kCurrentMetaFormat = 4;
 
 OP_NAMESPACE_BEGIN
 
+    /*
+     * Tags of elements in comparable key format, ordered as 'Data::Compare' in non alpha mode:
+     * nil < number < string
+     */
+    enum ComparableElementTag
+    {
+        COMPARABLE_TAG_NIL = 0, COMPARABLE_TAG_NUMBER = 1, COMPARABLE_TAG_STRING = 2,
+    };
+
+    static uint8 g_key_encode_format = KEY_FORMAT_LEGACY;
+
+    void set_key_encode_format(uint8 format)
+    {
+        g_key_encode_format = format;
+    }
+    uint8 get_key_encode_format()
+    {
+        return g_key_encode_format;
+    }
+    const char* key_encode_format_name(uint8 format)
+    {
+        switch (format)
+        {
+            case KEY_FORMAT_LEGACY:
+            {
+                return "legacy";
+            }
+            case KEY_FORMAT_COMPARABLE:
+            {
+                return "comparable";
+            }
+            default:
+            {
+                return "unknown";
+            }
+        }
+    }
+    bool parse_key_encode_format(const std::string& name, uint8& format)
+    {
+        if (!strcasecmp(name.c_str(), "legacy"))
+        {
+            format = KEY_FORMAT_LEGACY;
+            return true;
+        }
+        if (!strcasecmp(name.c_str(), "comparable"))
+        {
+            format = KEY_FORMAT_COMPARABLE;
+            return true;
+        }
+        return false;
+    }
+
+    /*
+     * String is written with every 0x00 escaped as 0x00 0xFF and terminated by 0x00 0x01,
+     * so a string sorts before any longer string it prefixes.
+     */
+    static void encode_comparable_string(Buffer& buffer, const char* str, size_t len)
+    {
+        const char* end = str + len;
+        while (str < end)
+        {
+            const char* zero = (const char*) memchr(str, 0, end - str);
+            if (NULL == zero)
+            {
+                buffer.Write(str, end - str);
+                break;
+            }
+            buffer.Write(str, zero - str);
+            buffer.WriteByte(0);
+            buffer.WriteByte((char) 0xFF);
+            str = zero + 1;
+        }
+        buffer.WriteByte(0);
+        buffer.WriteByte(1);
+    }
+
+    static bool decode_comparable_string(Buffer& buffer, Data& data, bool clone_str)
+    {
+        const char* start = buffer.GetRawReadBuffer();
+        const char* end = start + buffer.ReadableBytes();
+        const char* cursor = start;
+        const char* zero = NULL;
+        bool escaped = false;
+        while (true)
+        {
+            zero = (const char*) memchr(cursor, 0, end - cursor);
+            if (NULL == zero || zero + 1 >= end)
+            {
+                return false;
+            }
+            if ((uint8) zero[1] == 1)
+            {
+                break;
+            }
+            if ((uint8) zero[1] != 0xFF)
+            {
+                return false;
+            }
+            escaped = true;
+            cursor = zero + 2;
+        }
+        if (!escaped)
+        {
+            data.SetString(start, zero - start, clone_str);
+        }
+        else
+        {
+            /*
+             * escaped content can not be referenced in place, always copy it
+             */
+            std::string str;
+            str.reserve(zero - start);
+            for (const char* p = start; p < zero; p++)
+            {
+                str.push_back(*p);
+                if (0 == *p)
+                {
+                    p++;
+                }
+            }
+            data.SetString(str, false, true);
+        }
+        buffer.AdvanceReadIndex(zero - start + 2);
+        return true;
+    }
+
+    static uint64 comparable_double(double v)
+    {
+        if (v == 0)
+        {
+            v = 0; //-0.0 is equal to 0.0
+        }
+        uint64 bits;
+        memcpy(&bits, &v, sizeof(bits));
+        if (bits & 0x8000000000000000ULL)
+        {
+            return ~bits;
+        }
+        return bits | 0x8000000000000000ULL;
+    }
+
+    static double decode_comparable_double(uint64 bits)
+    {
+        if (bits & 0x8000000000000000ULL)
+        {
+            bits &= ~0x8000000000000000ULL;
+        }
+        else
+        {
+            bits = ~bits;
+        }
+        double v;
+        memcpy(&v, &bits, sizeof(v));
+        return v;
+    }
+
+    /*
+     * Number is written as its sortable double value followed by an exact int64 part,
+     * integers beyond 2^53 still sort exactly while int/float keep comparing by value.
+     */
+    static void encode_comparable_data(Buffer& buffer, const Data& data)
+    {
+        if (data.IsNil())
+        {
+            buffer.WriteByte((char) COMPARABLE_TAG_NIL);
+            return;
+        }
+        if (data.IsNumber())
+        {
+            double dv = data.GetFloat64();
+            int64 exact = data.GetIntegerPart();
+            buffer.WriteByte((char) COMPARABLE_TAG_NUMBER);
+            BufferHelper::WriteFixUInt64(buffer, comparable_double(dv));
+            BufferHelper::WriteFixUInt64(buffer, ((uint64) exact) ^ 0x8000000000000000ULL);
+            return;
+        }
+        buffer.WriteByte((char) COMPARABLE_TAG_STRING);
+        encode_comparable_string(buffer, data.CStr(), data.StringLength());
+    }
+
+    static bool decode_comparable_data(Buffer& buffer, Data& data, bool clone_str)
+    {
+        char tag;
+        if (!buffer.ReadByte(tag))
+        {
+            return false;
+        }
+        switch (tag)
+        {
+            case COMPARABLE_TAG_NIL:
+            {
+                data.Clear();
+                return true;
+            }
+            case COMPARABLE_TAG_NUMBER:
+            {
+                uint64 dbits, ebits;
+                if (!BufferHelper::ReadFixUInt64(buffer, dbits) || !BufferHelper::ReadFixUInt64(buffer, ebits))
+                {
+                    return false;
+                }
+                double dv = decode_comparable_double(dbits);
+                int64 exact = (int64) (ebits ^ 0x8000000000000000ULL);
+                if ((double) exact == dv)
+                {
+                    data.SetInt64(exact);
+                }
+                else
+                {
+                    data.SetFloat64(dv);
+                }
+                return true;
+            }
+            case COMPARABLE_TAG_STRING:
+            {
+                return decode_comparable_string(buffer, data, clone_str);
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
     void KeyObject::SetType(uint8 t)
     {
         type = t;
@@ -45,6 +280,8 @@ OP_NAMESPACE_BEGIN
         {
             case KEY_SET_MEMBER:
             case KEY_LIST_ELEMENT:
+            case KEY_LIST_CHUNK:
+            case KEY_STRING_SEGMENT:
             case KEY_ZSET_SCORE:
             case KEY_HASH_FIELD:
             case KEY_STREAM_ELEMENT:
@@ -58,6 +295,14 @@ OP_NAMESPACE_BEGIN
                 elements.resize(2);
                 break;
             }
+            case KEY_ZSET_RANK:
+            {
+                /*
+                 * 0: level 1: score 2: member
+                 */
+                elements.resize(3);
+                break;
+            }
             case KEY_TTL_SORT:
             {
                 /*
@@ -76,6 +321,15 @@ OP_NAMESPACE_BEGIN
 
     bool KeyObject::DecodeNS(Buffer& buffer, bool clone_str)
     {
+        return DecodeNS(buffer, clone_str, g_key_encode_format);
+    }
+
+    bool KeyObject::DecodeNS(Buffer& buffer, bool clone_str, uint8 format)
+    {
+        if (format == KEY_FORMAT_COMPARABLE)
+        {
+            return decode_comparable_data(buffer, ns, clone_str);
+        }
         return ns.Decode(buffer, clone_str);
     }
 
@@ -124,6 +378,20 @@ OP_NAMESPACE_BEGIN
 
     bool KeyObject::DecodeKey(Buffer& buffer, bool clone_str)
     {
+        return DecodeKey(buffer, clone_str, g_key_encode_format);
+    }
+
+    bool KeyObject::DecodeKey(Buffer& buffer, bool clone_str, uint8 format)
+    {
+        if (format == KEY_FORMAT_COMPARABLE)
+        {
+            if (!decode_comparable_string(buffer, key, clone_str))
+            {
+                ERROR_LOG("Invalid comparable key content.");
+                return false;
+            }
+            return true;
+        }
         uint32 keylen;
         if (!BufferHelper::ReadVarUInt32(buffer, keylen))
         {
@@ -153,7 +421,12 @@ OP_NAMESPACE_BEGIN
 
     bool KeyObject::DecodePrefix(Buffer& buffer, bool clone_str)
     {
-        if (!DecodeKey(buffer, clone_str))
+        return DecodePrefix(buffer, clone_str, g_key_encode_format);
+    }
+
+    bool KeyObject::DecodePrefix(Buffer& buffer, bool clone_str, uint8 format)
+    {
+        if (!DecodeKey(buffer, clone_str, format))
         {
             return false;
         }
@@ -178,37 +451,45 @@ OP_NAMESPACE_BEGIN
         return (int) len;
     }
     bool KeyObject::DecodeElement(Buffer& buffer, bool clone_str, int idx)
+    {
+        return DecodeElement(buffer, clone_str, idx, g_key_encode_format);
+    }
+    bool KeyObject::DecodeElement(Buffer& buffer, bool clone_str, int idx, uint8 format)
     {
         if (elements.size() <= (size_t)idx)
         {
             elements.resize(idx + 1);
         }
+        if (format == KEY_FORMAT_COMPARABLE)
+        {
+            return decode_comparable_data(buffer, elements[idx], clone_str);
+        }
         return elements[idx].Decode(buffer, clone_str);
     }
     bool KeyObject::Decode(Buffer& buffer, bool clone_str, bool with_ns)
+    {
+        return DecodeAs(g_key_encode_format, buffer, clone_str, with_ns);
+    }
+    bool KeyObject::DecodeAs(uint8 format, Buffer& buffer, bool clone_str, bool with_ns)
     {
         Clear();
         if (with_ns)
         {
-            if (!ns.Decode(buffer, clone_str))
+            if (!DecodeNS(buffer, clone_str, format))
             {
                 return false;
             }
         }
-        if (!DecodePrefix(buffer, clone_str))
+        if (!DecodePrefix(buffer, clone_str, format))
         {
             return false;
         }
-//        if (!DecodeKey(buffer, clone_str))
-//        {
-//            return false;
-//        }
         int elen1 = DecodeElementLength(buffer);
         if (elen1 > 0)
         {
             for (int i = 0; i < elen1; i++)
             {
-                if (!DecodeElement(buffer, clone_str, i))
+                if (!DecodeElement(buffer, clone_str, i, format))
                 {
                     return false;
                 }
@@ -217,13 +498,39 @@ OP_NAMESPACE_BEGIN
         return true;
     }
 
+    void KeyObject::EncodeNS(Buffer& buffer) const
+    {
+        if (g_key_encode_format == KEY_FORMAT_COMPARABLE)
+        {
+            encode_comparable_data(buffer, ns);
+        }
+        else
+        {
+            ns.Encode(buffer);
+        }
+    }
     void KeyObject::EncodePrefix(Buffer& buffer) const
     {
-        BufferHelper::WriteVarUInt32(buffer, key.StringLength());
-        buffer.Write(key.CStr(), key.StringLength());
+        EncodePrefix(buffer, g_key_encode_format);
+    }
+    void KeyObject::EncodePrefix(Buffer& buffer, uint8 format) const
+    {
+        if (format == KEY_FORMAT_COMPARABLE)
+        {
+            encode_comparable_string(buffer, key.CStr(), key.StringLength());
+        }
+        else
+        {
+            BufferHelper::WriteVarUInt32(buffer, key.StringLength());
+            buffer.Write(key.CStr(), key.StringLength());
+        }
         buffer.WriteByte((char) type);
     }
     Slice KeyObject::Encode(Buffer& buffer, bool verify, bool with_ns) const
+    {
+        return EncodeAs(g_key_encode_format, buffer, verify, with_ns);
+    }
+    Slice KeyObject::EncodeAs(uint8 format, Buffer& buffer, bool verify, bool with_ns) const
     {
         if (verify && !IsValid())
         {
@@ -231,15 +538,35 @@ OP_NAMESPACE_BEGIN
             return Slice();
         }
         size_t mark = buffer.GetWriteIndex();
-        if (with_ns)
+        if (format == KEY_FORMAT_COMPARABLE)
         {
-            ns.Encode(buffer);
+            if (with_ns)
+            {
+                encode_comparable_data(buffer, ns);
+            }
+            EncodePrefix(buffer, format);
+            /*
+             * meta key never compares its elements, so they are not part of the encoded key
+             */
+            size_t element_size = type == KEY_META ? 0 : elements.size();
+            buffer.WriteByte((char) element_size);
+            for (size_t i = 0; i < element_size; i++)
+            {
+                encode_comparable_data(buffer, elements[i]);
+            }
         }
-        EncodePrefix(buffer);
-        buffer.WriteByte((char) elements.size());
-        for (size_t i = 0; i < elements.size(); i++)
+        else
         {
-            elements[i].Encode(buffer);
+            if (with_ns)
+            {
+                ns.Encode(buffer);
+            }
+            EncodePrefix(buffer, format);
+            buffer.WriteByte((char) elements.size());
+            for (size_t i = 0; i < elements.size(); i++)
+            {
+                elements[i].Encode(buffer);
+            }
         }
         return Slice(buffer.GetRawBuffer() + mark, buffer.GetWriteIndex() - mark);
     }
@@ -280,6 +607,9 @@ OP_NAMESPACE_BEGIN
             case KEY_STREAM:
             case KEY_STREAM_ELEMENT:
             case KEY_STREAM_PEL:
+            case KEY_ZSET_RANK:
+            case KEY_LIST_CHUNK:
+            case KEY_STRING_SEGMENT:
             {
                 return true;
             }
@@ -311,7 +641,8 @@ OP_NAMESPACE_BEGIN
     }
 
     MetaObject::MetaObject()
-            : format(kCurrentMetaFormat), ttl(0), size(-1), list_sequential(true)
+            : format(kCurrentMetaFormat), ttl(0), size(-1), list_sequential(true), zset_rank_indexed(false), list_chunk_size(0), list_head_chunk(
+                    0), list_head_size(0), string_segment_size(0)
     {
 
     }
@@ -321,16 +652,29 @@ OP_NAMESPACE_BEGIN
         ttl = 0;
         size = -1;
         list_sequential = true;
+        zset_rank_indexed = false;
+        list_chunk_size = 0;
+        list_head_chunk = 0;
+        list_head_size = 0;
+        compact_data.clear();
+        string_segment_size = 0;
     }
     void MetaObject::Encode(Buffer& buffer, uint8 type) const
     {
-        buffer.WriteByte((char) format);
+        /*
+         * meta is always written in current format
+         */
+        buffer.WriteByte((char) kCurrentMetaFormat);
         BufferHelper::WriteVarInt64(buffer, ttl);
         switch (type)
         {
             case KEY_STRING:
             {
-                //do nothing
+                BufferHelper::WriteVarInt64(buffer, string_segment_size);
+                if (string_segment_size > 0)
+                {
+                    BufferHelper::WriteVarInt64(buffer, size);
+                }
                 break;
             }
             case KEY_LIST:
@@ -352,6 +696,24 @@ OP_NAMESPACE_BEGIN
             case KEY_LIST:
             {
                 buffer.WriteByte(list_sequential ? 1 : 0);
+                BufferHelper::WriteVarInt64(buffer, list_chunk_size);
+                if (list_chunk_size > 0)
+                {
+                    BufferHelper::WriteVarInt64(buffer, list_head_chunk);
+                    BufferHelper::WriteVarInt64(buffer, list_head_size);
+                }
+                break;
+            }
+            case KEY_ZSET:
+            {
+                buffer.WriteByte(zset_rank_indexed ? 1 : 0);
+                BufferHelper::WriteVarString(buffer, compact_data);
+                break;
+            }
+            case KEY_SET:
+            case KEY_HASH:
+            {
+                BufferHelper::WriteVarString(buffer, compact_data);
                 break;
             }
             case KEY_STREAM:
@@ -383,7 +745,18 @@ OP_NAMESPACE_BEGIN
         {
             case KEY_STRING:
             {
-                //do nothing
+                string_segment_size = 0;
+                if (format >= 4)
+                {
+                    if (!BufferHelper::ReadVarInt64(buffer, string_segment_size))
+                    {
+                        return false;
+                    }
+                    if (string_segment_size > 0 && !BufferHelper::ReadVarInt64(buffer, size))
+                    {
+                        return false;
+                    }
+                }
                 break;
             }
             case KEY_LIST:
@@ -412,6 +785,50 @@ OP_NAMESPACE_BEGIN
                     return false;
                 }
                 list_sequential = (bool) tmp;
+                list_chunk_size = 0;
+                list_head_chunk = 0;
+                list_head_size = 0;
+                if (format >= 2)
+                {
+                    if (!BufferHelper::ReadVarInt64(buffer, list_chunk_size))
+                    {
+                        return false;
+                    }
+                    if (list_chunk_size > 0
+                            && (!BufferHelper::ReadVarInt64(buffer, list_head_chunk)
+                                    || !BufferHelper::ReadVarInt64(buffer, list_head_size)))
+                    {
+                        return false;
+                    }
+                }
+                break;
+            }
+            case KEY_ZSET:
+            {
+                zset_rank_indexed = false;
+                if (format >= 1)
+                {
+                    if (!buffer.ReadByte(tmp))
+                    {
+                        return false;
+                    }
+                    zset_rank_indexed = (bool) tmp;
+                }
+                compact_data.clear();
+                if (format >= 3 && !BufferHelper::ReadVarString(buffer, compact_data))
+                {
+                    return false;
+                }
+                break;
+            }
+            case KEY_SET:
+            case KEY_HASH:
+            {
+                compact_data.clear();
+                if (format >= 3 && !BufferHelper::ReadVarString(buffer, compact_data))
+                {
+                    return false;
+                }
                 break;
             }
             case KEY_STREAM:
@@ -501,6 +918,58 @@ OP_NAMESPACE_BEGIN
         return replaced;
     }
 
+    /*
+     * every element is a listpack entry holding the encoded data, which keeps int/float/string encoding of elements.
+     */
+    bool ValueObject::GetCompactElements(DataArray& elements) const
+    {
+        elements.clear();
+        if (meta.compact_data.empty())
+        {
+            return true;
+        }
+        unsigned char* lp = (unsigned char*) meta.compact_data.data();
+        if (meta.compact_data.size() < 7 || lpBytes(lp) != meta.compact_data.size())
+        {
+            return false;
+        }
+        unsigned char intbuf[LP_INTBUF_SIZE];
+        unsigned char* p = lpFirst(lp);
+        while (NULL != p)
+        {
+            int64_t len = 0;
+            unsigned char* ele = lpGet(p, &len, intbuf);
+            Buffer buffer((char*) ele, 0, len);
+            Data data;
+            if (!data.Decode(buffer, true))
+            {
+                return false;
+            }
+            elements.push_back(data);
+            p = lpNext(lp, p);
+        }
+        return type == KEY_SET || elements.size() % 2 == 0;
+    }
+
+    void ValueObject::SetCompactElements(const DataArray& elements)
+    {
+        meta.compact_data.clear();
+        if (elements.empty())
+        {
+            return;
+        }
+        unsigned char* lp = lpNew();
+        Buffer buffer;
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            buffer.Clear();
+            elements[i].Encode(buffer);
+            lp = lpAppend(lp, (unsigned char*) buffer.GetRawReadBuffer(), buffer.ReadableBytes());
+        }
+        meta.compact_data.assign((const char*) lp, lpBytes(lp));
+        lpFree(lp);
+    }
+
     static void encode_value_object(Buffer& encode_buffer, uint8 type, uint16 merge_op, const DataArray& args,
             const MetaObject* meta)
     {
@@ -60,12 +60,28 @@ OP_NAMESPACE_BEGIN
 
         KEY_STREAM = 12, KEY_STREAM_ELEMENT = 13, KEY_STREAM_PEL = 14,
 
+        KEY_ZSET_RANK = 15, KEY_LIST_CHUNK = 16, KEY_STRING_SEGMENT = 17,
+
         /*
          * Reserver 20 types
          */
         KEY_TTL_SORT = 29, KEY_MERGE = 30, KEY_END = 31, /* max value for 1byte */
     };
 
+    /*
+     * Binary layout of encoded keys.
+     * KEY_FORMAT_LEGACY:     length prefixed key & self-described elements, engines must order keys by 'compare_keys'.
+     * KEY_FORMAT_COMPARABLE: order preserving layout, encoded keys could be ordered by memcmp directly.
+     */
+    enum KeyEncodeFormat
+    {
+        KEY_FORMAT_LEGACY = 0, KEY_FORMAT_COMPARABLE = 1,
+    };
+    void set_key_encode_format(uint8 format);
+    uint8 get_key_encode_format();
+    const char* key_encode_format_name(uint8 format);
+    bool parse_key_encode_format(const std::string& name, uint8& format);
+
     struct KeyObject
     {
         private:
@@ -196,6 +212,22 @@ OP_NAMESPACE_BEGIN
             {
                 setElement(idx, 0);
             }
+            void SetListChunkId(int64_t id)
+            {
+                getElement(0).SetInt64(id);
+            }
+            int64_t GetListChunkId() const
+            {
+                return GetElement(0).GetInt64();
+            }
+            void SetStringSegmentId(int64_t id)
+            {
+                getElement(0).SetInt64(id);
+            }
+            int64_t GetStringSegmentId() const
+            {
+                return GetElement(0).GetInt64();
+            }
             double GetListIndex() const
             {
                 return GetElement(0).GetFloat64();
@@ -233,6 +265,27 @@ OP_NAMESPACE_BEGIN
             {
                 return GetElement(0).GetFloat64();
             }
+            /*
+             * rank index node of sorted set, 0: level 1: score 2: member of the first position in the block
+             */
+            void SetZSetRankNode(int64 level, double score, const Data& member)
+            {
+                getElement(0).SetInt64(level);
+                getElement(1).SetFloat64(score);
+                setElement(member, 2);
+            }
+            int64 GetZSetRankLevel() const
+            {
+                return GetElement(0).GetInt64();
+            }
+            double GetZSetRankScore() const
+            {
+                return GetElement(1).GetFloat64();
+            }
+            const Data& GetZSetRankMember() const
+            {
+                return GetElement(2);
+            }
             void SetTTLKeyNamespace(const Data& ns)
             {
                 setElement(ns, 1);
@@ -263,14 +316,22 @@ OP_NAMESPACE_BEGIN
             // compare (namespace, key)
             int ComparePrefix(const KeyObject& other) const;
             Slice Encode(Buffer& buffer, bool verify = true, bool with_ns = false) const;
+            Slice EncodeAs(uint8 format, Buffer& buffer, bool verify = true, bool with_ns = false) const;
+            void EncodeNS(Buffer& buffer) const;
             void EncodePrefix(Buffer& buffer) const;
+            void EncodePrefix(Buffer& buffer, uint8 format) const;
             bool DecodeNS(Buffer& buffer, bool clone_str);
+            bool DecodeNS(Buffer& buffer, bool clone_str, uint8 format);
             bool DecodeKey(Buffer& buffer, bool clone_str);
+            bool DecodeKey(Buffer& buffer, bool clone_str, uint8 format);
             bool DecodeType(Buffer& buffer);
             bool DecodePrefix(Buffer& buffer, bool clone_str);
+            bool DecodePrefix(Buffer& buffer, bool clone_str, uint8 format);
             int DecodeElementLength(Buffer& buffer);
             bool DecodeElement(Buffer& buffer, bool clone_str, int idx);
+            bool DecodeElement(Buffer& buffer, bool clone_str, int idx, uint8 format);
             bool Decode(Buffer& buffer, bool clone_str, bool with_ns = false);
+            bool DecodeAs(uint8 format, Buffer& buffer, bool clone_str, bool with_ns = false);
 
             void CloneStringPart();
 
@@ -295,6 +356,12 @@ OP_NAMESPACE_BEGIN
             int64_t ttl;
             int64_t size;
             bool list_sequential;  //indicate that list is sequential ot not
+            bool zset_rank_indexed; //indicate that zset has rank index or not
+            int64_t list_chunk_size; //elements per chunk of chunked list, 0 for list stored as one key per element
+            int64_t list_head_chunk; //id of the first chunk, following chunks have consecutive ids
+            int64_t list_head_size;  //elements in the first chunk, chunks between the first and the last are full
+            std::string compact_data; //listpack of all elements of small hash/set/zset, empty for elements stored as keys
+            int64_t string_segment_size; //bytes per segment of segmented string, 0 for string stored in meta value
 
             StreamID stream_last_id;
             MetaObject();
@@ -445,6 +512,55 @@ OP_NAMESPACE_BEGIN
             {
                 return getElement(0);
             }
+            DataArray& GetListChunkElements()
+            {
+                return vals;
+            }
+            bool IsListChunked()
+            {
+                return meta.list_chunk_size > 0;
+            }
+            /*
+             * small hash/set/zset could keep all elements in meta value, hash & zset elements are stored as
+             * field/value & member/score pairs.
+             */
+            bool IsCompact() const
+            {
+                return !meta.compact_data.empty();
+            }
+            bool GetCompactElements(DataArray& elements) const;
+            void SetCompactElements(const DataArray& elements);
+            /*
+             * large string could be split into fixed size segments stored as KEY_STRING_SEGMENT keys,
+             * meta keeps the total string length as object len.
+             */
+            bool IsStringSegmented() const
+            {
+                return meta.string_segment_size > 0;
+            }
+            int64_t GetStringSegmentSize() const
+            {
+                return meta.string_segment_size;
+            }
+            void SetStringSegmentSize(int64_t v)
+            {
+                meta.string_segment_size = v;
+            }
+            /*
+             * segment value, 0: segment bytes 1: cached popcount of segment bytes
+             */
+            Data& GetStringSegment()
+            {
+                return getElement(0);
+            }
+            int64_t GetStringSegmentBits() const
+            {
+                return vals.size() > 1 ? vals[1].GetInt64() : 0;
+            }
+            void SetStringSegmentBits(int64_t v)
+            {
+                getElement(1).SetInt64(v);
+            }
             Data& GetListElement()
             {
                 return getElement(0);
@@ -483,6 +599,14 @@ OP_NAMESPACE_BEGIN
             {
                 getElement(0).SetFloat64(s);
             }
+            int64 GetZSetRankCount()
+            {
+                return getElement(0).GetInt64();
+            }
+            void SetZSetRankCount(int64 v)
+            {
+                getElement(0).SetInt64(v);
+            }
             void SetMergeArgs(const DataArray& args)
             {
                 vals = args;
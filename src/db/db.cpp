@@ -68,6 +68,10 @@ OP_NAMESPACE_BEGIN
     {
         return (flags & ARDB_CMD_WRITE) > 0;
     }
+    bool Ardb::RedisCommandHandlerSetting::IsReadOnlyCommand() const
+    {
+        return (flags & ARDB_CMD_READONLY) > 0 && !IsWriteCommand();
+    }
 
     size_t Ardb::RedisCommandHash::operator ()(const std::string& t) const
     {
@@ -83,15 +87,26 @@ OP_NAMESPACE_BEGIN
         return strcasecmp(s1.c_str(), s2.c_str()) == 0 ? true : false;
     }
 
-    Ardb::KeyLockGuard::KeyLockGuard(Context& cctx, const KeyObject& key, bool _lock)
-            : ctx(cctx), lock(_lock)
+    Ardb::KeyLockGuard::KeyLockGuard(Context& cctx, const KeyObject& key, bool _lock, bool exclusive)
+            : ctx(cctx), lock(_lock), shared(false), snapshot(NULL)
     {
         if (lock)
         {
             ctx.keyslocked = true;
+            shared = ctx.flags.readonly && !exclusive;
+            ctx.keyslocked_shared = shared;
+            if (shared && NULL == ctx.engine_snapshot && g_db->m_engine->GetFeatureSet().support_snapshot_read)
+            {
+                /*
+                 * reads of single key command are consistent inside one engine snapshot, no lock needed
+                 */
+                snapshot = g_db->m_engine->CreateSnapshot();
+                ctx.engine_snapshot = snapshot;
+                return;
+            }
             lk.key = key.GetKey();
             lk.ns = key.GetNameSpace();
-            g_db->LockKey(lk);
+            g_db->LockKey(lk, shared);
         }
 
     }
@@ -100,15 +115,25 @@ OP_NAMESPACE_BEGIN
     {
         if (lock)
         {
-            g_db->UnlockKey(lk);
+            if (NULL != snapshot)
+            {
+                ctx.engine_snapshot = NULL;
+                g_db->m_engine->ReleaseSnapshot(snapshot);
+            }
+            else
+            {
+                g_db->UnlockKey(lk, shared);
+            }
             ctx.keyslocked = false;
+            ctx.keyslocked_shared = false;
         }
     }
 
     Ardb::KeysLockGuard::KeysLockGuard(Context& cctx, const KeyObjectArray& keys)
-            : ctx(cctx)
+            : ctx(cctx), shared(cctx.flags.readonly)
     {
         ctx.keyslocked = true;
+        ctx.keyslocked_shared = shared;
         for (size_t i = 0; i < keys.size(); i++)
         {
             KeyPrefix lk;
@@ -116,11 +141,12 @@ OP_NAMESPACE_BEGIN
             lk.ns = keys[i].GetNameSpace();
             ks.insert(lk);
         }
-        g_db->LockKeys(ks);
+        g_db->LockKeys(ks, shared);
     }
     Ardb::KeysLockGuard::KeysLockGuard(Context& cctx, const KeyObject& key1, const KeyObject& key2)
-            : ctx(cctx)
+            : ctx(cctx), shared(cctx.flags.readonly)
     {
+        ctx.keyslocked_shared = shared;
         KeyPrefix lk1, lk2;
         lk1.key = key1.GetKey();
         lk1.ns = key1.GetNameSpace();
@@ -128,22 +154,27 @@ OP_NAMESPACE_BEGIN
         lk2.ns = key2.GetNameSpace();
         ks.insert(lk1);
         ks.insert(lk2);
-        g_db->LockKeys(ks);
+        g_db->LockKeys(ks, shared);
     }
     Ardb::KeysLockGuard::~KeysLockGuard()
     {
-        g_db->UnlockKeys(ks);
+        g_db->UnlockKeys(ks, shared);
         ctx.keyslocked = false;
+        ctx.keyslocked_shared = false;
     }
 
     static CostTrack g_cmd_cost_tracks[REDIS_CMD_MAX];
+    static CountTrack g_expired_keys;
+    static CountTrack g_expire_cycle_cpu_micros;
+    static CountTrack g_read_batches;
+    static CountTrack g_read_batch_cmds;
 
     Ardb::Ardb()
             : m_engine(NULL), m_starttime(0), m_loading_data(false), m_compacting_data(false), m_prepare_snapshot_num(
-                    0), m_write_caller_num(0), m_db_caller_num(0), m_redis_cursor_seed(0), m_watched_ctxs(NULL), m_ready_keys(
-                    NULL), m_monitors(
+                    0), m_write_caller_num(0), m_db_caller_num(0), m_expire_load_cursor(0), m_expire_index_loaded(false), m_redis_cursor_seed(
+                    0), m_pubsub_pattern_match_calls(0), m_pubsub_pattern_match_usecs(0), m_watched_ctxs(NULL), m_ready_keys(NULL), m_monitors(
             NULL), m_restoring_nss(
-            NULL), m_min_ttl(-1),g_background(NULL)
+            NULL), g_background(NULL)
     {
         g_db = this;
         m_settings.set_empty_key("");
@@ -202,6 +233,7 @@ OP_NAMESPACE_BEGIN
         { "pttl", REDIS_CMD_PTTL, &Ardb::PTTL, 1, 1, "r", 0, 0, 0 },
         { "type", REDIS_CMD_TYPE, &Ardb::Type, 1, 1, "r", 0, 0, 0 },
         { "bitcount", REDIS_CMD_BITCOUNT, &Ardb::Bitcount, 1, 3, "r", 0, 0, 0 },
+        { "bitpos", REDIS_CMD_BITPOS, &Ardb::Bitpos, 2, 4, "r", 0, 0, 0 },
         { "bitop", REDIS_CMD_BITOP, &Ardb::Bitop, 3, -1, "w", 1, 0, 0 },
         { "bitopcount", REDIS_CMD_BITOPCUNT, &Ardb::BitopCount, 2, -1, "r", 0, 0, 0 },
         { "decr", REDIS_CMD_DECR, &Ardb::Decr, 1, 1, "w", 1, 0, 0 },
@@ -340,14 +372,14 @@ OP_NAMESPACE_BEGIN
         { "restore", REDIS_CMD_RESTORE, &Ardb::Restore, 3, 4, "w", 0, 0, 0 },
         { "migrate", REDIS_CMD_MIGRATE, &Ardb::Migrate, 5, -1, "w", 0, 0, 0 },
         { "migratedb", REDIS_CMD_MIGRATEDB, &Ardb::MigrateDB, 4, 4, "w", 0, 0, 0 },
-        { "restorechunk", REDIS_CMD_RESTORECHUNK, &Ardb::RestoreChunk, 1, 1, "wl", 0, 0, 0 },
+        { "restorechunk", REDIS_CMD_RESTORECHUNK, &Ardb::RestoreChunk, 1, 2, "wl", 0, 0, 0 },
         { "restoredb", REDIS_CMD_RESTOREDB, &Ardb::RestoreDB, 1, 1, "wl", 0, 0, 0 },
         { "monitor", REDIS_CMD_MONITOR, &Ardb::Monitor, 0, 0, "ars", 0, 0, 0 },
         { "debug", REDIS_CMD_DEBUG, &Ardb::Debug, 2, -1, "ars", 0, 0, 0 },
         { "touch", REDIS_CMD_TOUCH, &Ardb::Touch, 1, -2, "rF", 0, 0, 0 },
 		{ "command", REDIS_CMD_COMMAND, &Ardb::Command, 0, -1, "r", 0, 0, 0 },
 		{ "xread", REDIS_CMD_XREAD, &Ardb::XRead, 2, -1, "r", 0, 0, 0 },
-		{ "xreadgroup", REDIS_CMD_XREAD, &Ardb::XRead, 5, -1, "rw", 0, 0, 0 },
+		{ "xreadgroup", REDIS_CMD_XREADGROUP, &Ardb::XRead, 5, -1, "rw", 0, 0, 0 },
 		{ "xadd", REDIS_CMD_XADD, &Ardb::XAdd, 4, -1, "w", 0, 0, 0 },
 		{ "xlen", REDIS_CMD_XLEN, &Ardb::XLen, 1, 1, "r", 0, 0, 0 },
 		{ "xpending", REDIS_CMD_XPENDING, &Ardb::XPending, 2, 6, "r", 0, 0, 0 },
@@ -432,6 +464,14 @@ OP_NAMESPACE_BEGIN
             }
             m_settings[settingTable[i].name] = settingTable[i];
         }
+        g_expired_keys.name = "expired_keys";
+        g_expire_cycle_cpu_micros.name = "expire_cycle_cpu_micros";
+        Statistics::GetSingleton().AddTrack(&g_expired_keys);
+        Statistics::GetSingleton().AddTrack(&g_expire_cycle_cpu_micros);
+        g_read_batches.name = "pipeline_read_batches";
+        g_read_batch_cmds.name = "pipeline_read_batch_cmds";
+        Statistics::GetSingleton().AddTrack(&g_read_batches);
+        Statistics::GetSingleton().AddTrack(&g_read_batch_cmds);
     }
 
     Ardb::~Ardb()
@@ -523,9 +563,17 @@ OP_NAMESPACE_BEGIN
         }
         if(chdir(GetConf().home.c_str())){}
         ArdbLogger::InitDefaultLogger(m_conf.loglevel, m_conf.logfile);
+        if (m_conf.log_async_buffer_size > 0)
+        {
+            ArdbLogger::StartAsyncLogger(m_conf.log_async_buffer_size, m_conf.log_async_block_when_full);
+        }
 
         std::string dbdir = GetConf().data_base_path + "/" + g_engine_name;
         make_dir(dbdir);
+        if (0 != LoadKeyFormat(dbdir))
+        {
+            return -1;
+        }
         int err = 0;
         m_engine = create_engine();
         if (NULL == m_engine)
@@ -550,8 +598,65 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    /*
+     * The key format of an existing data dir is fixed once it's created, it's recorded in a 'KEY_FORMAT' file,
+     * data dir created by older versions without the file is always in legacy format.
+     * 'key-format auto' uses the recorded format, or the engine's default format for an empty data dir.
+     */
+    int Ardb::LoadKeyFormat(const std::string& dbdir)
+    {
+        uint8 format = KEY_FORMAT_LEGACY;
+        bool auto_format = !strcasecmp(GetConf().key_format.c_str(), "auto");
+        std::string format_file = dbdir + "/KEY_FORMAT";
+        std::string content;
+        bool recorded = false;
+        if (0 == file_read_full(format_file, content))
+        {
+            content = trim_string(content);
+            if (!parse_key_encode_format(content, format))
+            {
+                ERROR_LOG("Invalid key format:%s in %s", content.c_str(), format_file.c_str());
+                return -1;
+            }
+            recorded = true;
+        }
+        else
+        {
+            std::deque<std::string> fs;
+            list_subfiles(dbdir, fs, true);
+            if (fs.empty())
+            {
+                if (auto_format)
+                {
+                    format = engine_default_key_format();
+                }
+                else
+                {
+                    parse_key_encode_format(GetConf().key_format, format);
+                }
+            }
+        }
+        if (!auto_format && strcasecmp(GetConf().key_format.c_str(), key_encode_format_name(format)))
+        {
+            ERROR_LOG("Data dir:%s is in %s key format while 'key-format' is %s, use 'import' on an empty data dir to migrate it.",
+                    dbdir.c_str(), key_encode_format_name(format), GetConf().key_format.c_str());
+            return -1;
+        }
+        if (!recorded)
+        {
+            file_write_content(format_file, key_encode_format_name(format));
+        }
+        set_key_encode_format(format);
+        INFO_LOG("Ardb use %s key format.", key_encode_format_name(format));
+        return 0;
+    }
+
     int Ardb::Repair(const std::string& dir)
     {
+        if (0 != LoadKeyFormat(dir))
+        {
+            return -1;
+        }
         m_engine = create_engine();
         if (NULL == m_engine)
         {
@@ -716,114 +821,22 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
-    bool Ardb::LockKey(const KeyPrefix& lk, int wait_limit)
+    void Ardb::LockKey(const KeyPrefix& lk, bool shared)
     {
-//        KeyPrefix lk;
-//        lk.ns = key.GetNameSpace();
-//        lk.key = key.GetKey();
-        int wait_counter = 0;
-        while (wait_limit <= 0 || wait_counter < wait_limit)
-        {
-            ThreadMutexLock* lock = NULL;
-            {
-                LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
-                std::pair<LockTable::iterator, bool> ret = m_locking_keys.insert(LockTable::value_type(lk, NULL));
-                if (!ret.second && NULL != ret.first->second)
-                {
-                    /*
-                     * already locked by other thread, wait until unlocked
-                     */
-                    lock = ret.first->second;
-                }
-                else
-                {
-                    /*
-                     * no other thread lock on the key
-                     */
-                    if (!m_lock_pool.empty())
-                    {
-                        lock = m_lock_pool.top();
-                        m_lock_pool.pop();
-                    }
-                    else
-                    {
-                        NEW(lock, ThreadMutexLock);
-                    }
-                    ret.first->second = lock;
-                    return true;
-                }
-            }
-
-            if (NULL != lock)
-            {
-                LockGuard<ThreadMutexLock> guard(*lock);
-                lock->Wait(1, MILLIS);
-                wait_counter++;
-            }
-        }
-        return false;
+        m_key_locks.Lock(lk, shared);
     }
-    void Ardb::UnlockKey(const KeyPrefix& lk)
+    void Ardb::UnlockKey(const KeyPrefix& lk, bool shared)
     {
-//        KeyPrefix lk;
-//        lk.ns = key.GetNameSpace();
-//        lk.key = key.GetKey();
-        {
-            LockGuard<SpinMutexLock> guard(m_locking_keys_lock);
-            LockTable::iterator ret = m_locking_keys.find(lk);
-            if (ret != m_locking_keys.end())
-            {
-                ThreadMutexLock* lock = ret->second;
-                m_locking_keys.erase(ret);
-                if(NULL != lock)
-                {
-                    m_lock_pool.push(lock);
-                    LockGuard<ThreadMutexLock> guard(*lock);
-                    lock->Notify();
-                }
-            }
-        }
+        m_key_locks.Unlock(lk, shared);
     }
 
-    void Ardb::LockKeys(const KeyPrefixSet& ks)
+    void Ardb::LockKeys(const KeyPrefixSet& ks, bool shared)
     {
-        while(true)
-        {
-            std::vector<KeyPrefix> locked_keys;
-            KeyPrefixSet::const_iterator kit = ks.begin();
-            while (kit != ks.end())
-            {
-                if(!LockKey(*kit, 1))
-                {
-                    break;
-                }
-                locked_keys.push_back(*kit);
-                kit++;
-            }
-            if(locked_keys.size() == (size_t)ks.size())
-            {
-                return;
-            }
-            //release locked keys, and try again
-            for(size_t i = 0; i < locked_keys.size(); i++)
-            {
-                UnlockKey(locked_keys[i]);
-            }
-        }
-
-//        for (size_t i = 0; i < ks.size(); i++)
-//        {
-//            LockKey(ks[i]);
-//        }
+        m_key_locks.Lock(ks, shared);
     }
-    void Ardb::UnlockKeys(const KeyPrefixSet& ks)
+    void Ardb::UnlockKeys(const KeyPrefixSet& ks, bool shared)
     {
-        KeyPrefixSet::const_iterator kit = ks.begin();
-        while (kit != ks.end())
-        {
-            UnlockKey(*kit);
-            kit++;
-        }
+        m_key_locks.Unlock(ks, shared);
     }
 
     void Ardb::FeedReplicationDelOperation(Context& ctx, const Data& ns, const std::string& key)
@@ -872,208 +885,185 @@ OP_NAMESPACE_BEGIN
     void Ardb::SaveTTL(Context& ctx, const Data& ns, const std::string& key, int64 old_ttl, int64_t new_ttl)
     {
         /*
-         * only works with engine that has no compactfilter support
+         * the expire index is only kept in memory, it's rebuilt from meta values at startup
          */
-        if (m_engine->GetFeatureSet().support_compactfilter)
-        {
-            return;
-        }
-        if (new_ttl > 0)
-        {
-            if (m_min_ttl <= 0 || m_min_ttl > new_ttl)
-            {
-                m_min_ttl = new_ttl;
-            }
-            Data tll_ns(TTL_DB_NSMAESPACE, false);
-            KeyObject new_ttl_key(tll_ns, KEY_TTL_SORT, "");
-            new_ttl_key.SetTTL(new_ttl);
-            new_ttl_key.SetTTLKeyNamespace(ns);
-            new_ttl_key.SetTTLKey(key);
-            ValueObject v;
-            v.SetType(KEY_TTL_SORT);
-            ctx.flags.create_if_notexist = 1;
-            m_engine->Put(ctx, new_ttl_key, v);
-        }
-        if (old_ttl > 0)
-        {
-            Data tll_ns(TTL_DB_NSMAESPACE, false);
-            KeyObject old_ttl_key(tll_ns, KEY_TTL_SORT, "");
-            old_ttl_key.SetTTL(old_ttl);
-            old_ttl_key.SetTTLKeyNamespace(ns);
-            old_ttl_key.SetTTLKey(key);
-            m_engine->Del(ctx, old_ttl_key);
-        }
+        m_expire_index.Set(ns, Data::WrapCStr(key), new_ttl);
     }
 
-    void Ardb::ScanTTLDB()
+    /*
+     * rebuild expire index from meta values of all keys, it stops once the thread cpu time reaches the deadline and
+     * continues from the last loaded key in next call, returns true when all namespaces are loaded.
+     */
+    bool Ardb::LoadExpireIndex(uint64 cpu_deadline)
     {
-        /*
-         * only works with engine that has no compactfilter support
-         */
-        if (m_engine->GetFeatureSet().support_compactfilter || !GetConf().master_host.empty())
+        Context load_ctx;
+        load_ctx.flags.iterate_multi_keys = 1;
+        load_ctx.flags.iterate_total_order = 1;
+        if (0 == m_expire_load_cursor && m_expire_load_key.empty())
         {
-            return;
-        }
-        if (0 == m_min_ttl)
-        {
-            return;
+            m_expire_load_nss.clear();
+            m_engine->ListNameSpaces(load_ctx, m_expire_load_nss);
         }
-        uint32 max_scan_keys_one_iter = 1000;
-        uint32 scaned_keys = 0;
-        uint32 total_expired_keys = 0;
-        Context scan_ctx;
-        Data tll_ns(TTL_DB_NSMAESPACE, false);
-        KeyObject scan_key(tll_ns, KEY_TTL_SORT, "");
-        scan_key.SetTTL(m_min_ttl);
-        Iterator* iter = m_engine->Find(scan_ctx, scan_key);
-        if (!iter->Valid())
+        uint64 loaded_keys = 0;
+        while (m_expire_load_cursor < m_expire_load_nss.size())
         {
-            m_min_ttl = 0; //no expire key
-        }
-        uint64 start_time = get_current_epoch_millis();
-        while (iter->Valid() && scaned_keys < max_scan_keys_one_iter)
-        {
-            KeyObject& k = iter->Key(true);
-            m_min_ttl = k.GetTTL();
-            if (k.GetTTL() > (int64_t)get_current_epoch_millis())
+            const Data& ns = m_expire_load_nss[m_expire_load_cursor];
+            if (ns.AsString() == TTL_DB_NSMAESPACE)
             {
-                break;
+                /*
+                 * ttl db written by older versions is replaced by the expire index, it's left untouched
+                 * so that the data dir could still be opened by older versions.
+                 */
+                m_expire_load_cursor++;
+                continue;
             }
-            scaned_keys++;
-            ValueObject meta;
-            KeyObject meta_key(k.GetElement(1), KEY_META, k.GetElement(2));
-            KeyLockGuard guard(scan_ctx, meta_key);
-            if (0 == m_engine->Get(scan_ctx, meta_key, meta))
+            load_ctx.ns = ns;
+            Iterator* iter = NULL;
+            if (m_expire_load_key.empty())
+            {
+                KeyObject start;
+                start.SetNameSpace(ns);
+                iter = m_engine->Find(load_ctx, start);
+            }
+            else
             {
-                if (meta.GetTTL() == k.GetTTL())
+                KeyObject start(ns, KEY_END, m_expire_load_key);
+                iter = m_engine->Find(load_ctx, start);
+            }
+            bool complete = true;
+            while (iter->Valid())
+            {
+                KeyObject& k = iter->Key(false);
+                if (k.GetType() != KEY_META)
                 {
-                    //delete whole key
-                    if (meta.GetType() == KEY_STRING)
-                    {
-                        m_engine->Del(scan_ctx, meta_key);
-                    }
-                    else
-                    {
-                        DelKey(scan_ctx, meta_key);
-                    }
-                    total_expired_keys++;
-                    FeedReplicationDelOperation(scan_ctx, meta_key.GetNameSpace(), meta_key.GetKey().AsString());
+                    KeyObject next(ns, KEY_END, k.GetKey());
+                    iter->Jump(next);
+                    continue;
+                }
+                int64 ttl = iter->Value(false).GetTTL();
+                if (ttl > 0)
+                {
+                    m_expire_index.Set(ns, k.GetKey(), ttl, true);
+                }
+                loaded_keys++;
+                if (loaded_keys % 128 == 0 && get_thread_cpu_micros() >= cpu_deadline)
+                {
+                    k.GetKey().ToString(m_expire_load_key);
+                    complete = false;
+                    break;
                 }
+                iter->Next();
             }
-            else
+            DELETE(iter);
+            if (!complete)
             {
-
+                return false;
             }
-            iter->Del();
-            iter->Next();
-        }
-        DELETE(iter);
-        uint64 end_time = get_current_epoch_millis();
-        if (total_expired_keys > 0)
-        {
-            INFO_LOG("Cost %llums to delete %u keys.", (end_time - start_time), total_expired_keys);
+            m_expire_load_key.clear();
+            m_expire_load_cursor++;
         }
+        m_expire_load_nss.clear();
+        INFO_LOG("Expire index rebuilt with %llu keys.", (unsigned long long) m_expire_index.Size());
+        return true;
     }
+
     void Ardb::GC()
     {
         ClearRetiredStreamCache();
     }
 
-    int64 Ardb::ScanExpiredKeys()
+    int64 Ardb::ActiveExpireCycle(uint32 worker, uint32 workers, uint64 cpu_budget_micros, uint32& shard_cursor)
     {
+        uint64 start_cpu = get_thread_cpu_micros();
+        uint64 cpu_deadline = start_cpu + cpu_budget_micros;
+        if (0 == worker && !m_expire_index_loaded)
+        {
+            /*
+             * the rebuild takes at most half of the budget, keys already indexed are still expired meanwhile
+             */
+            m_expire_index_loaded = LoadExpireIndex(start_cpu + cpu_budget_micros / 2);
+        }
         /*
-         * do not do scan expire on slaves
+         * do not do expire on slaves, master would replicate 'del' for expired keys
          */
         if (!GetConf().master_host.empty())
         {
             return 0;
         }
-        if (!m_engine->GetFeatureSet().support_compactfilter)
-        {
-            ScanTTLDB();
-            return 0;
-        }
-        KeyPrefix scan_key;
-        Context scan_ctx;
+        Context expire_ctx;
         int64 total_expired_keys = 0;
-        uint64 start_time = get_current_epoch_millis();
-        while (true)
+        uint32 shards = m_expire_index.ShardCount();
+        ExpireKeyArray keys;
+        bool budget_used_up = false;
+        for (uint32 i = 0; i < shards && !budget_used_up; i++)
         {
+            uint32 shard = (shard_cursor + i) % shards;
+            if (shard % workers != worker)
             {
-                LockGuard<SpinMutexLock> guard(m_expires_lock);
-                if (!m_expires.empty())
-                {
-                    scan_key = *(m_expires.begin());
-                    m_expires.erase(m_expires.begin());
-                }
-                else
+                continue;
+            }
+            while (true)
+            {
+                keys.clear();
+                if (0 == m_expire_index.PopExpired(shard, get_current_epoch_millis(), 64, keys))
                 {
                     break;
                 }
-            }
-            if (scan_key.IsNil())
-            {
-                break;
-            }
-            KeyObject key(scan_key.ns, KEY_META, scan_key.key);
-            KeyLockGuard keylocker(scan_ctx, key);
-            ValueObject meta;
-            bool toremove = false;
-            int err = m_engine->Get(scan_ctx, key, meta);
-            if (ERR_ENTRY_NOT_EXIST == err)
-            {
-                toremove = true;
-            }
-            else if (0 == err)
-            {
-                if (0 == m_engine->Get(scan_ctx, key, meta))
+                for (size_t j = 0; j < keys.size(); j++)
                 {
-                    uint64 ttl = meta.GetTTL();
-                    if (ttl == 0 || ttl > get_current_epoch_millis())
+                    KeyObject key(keys[j].key.ns, KEY_META, keys[j].key.key);
+                    KeyLockGuard keylocker(expire_ctx, key);
+                    ValueObject meta;
+                    if (0 != m_engine->Get(expire_ctx, key, meta))
+                    {
+                        continue;
+                    }
+                    int64 ttl = meta.GetTTL();
+                    if (ttl <= 0)
                     {
                         continue;
                     }
-                    toremove = true;
+                    if (ttl > (int64) get_current_epoch_millis())
+                    {
+                        /*
+                         * ttl changed after the key was indexed
+                         */
+                        m_expire_index.Set(key.GetNameSpace(), key.GetKey(), ttl, true);
+                        continue;
+                    }
+                    /*
+                     * generate 'del' command for master instance
+                     */
+                    FeedReplicationDelOperation(expire_ctx, key.GetNameSpace(), key.GetKey().AsString());
+                    if (KEY_STRING == meta.GetType() && !meta.IsStringSegmented())
+                    {
+                        RemoveKey(expire_ctx, key);
+                    }
+                    else
+                    {
+                        DelKey(expire_ctx, key);
+                    }
                     total_expired_keys++;
                 }
+                if (get_thread_cpu_micros() >= cpu_deadline)
+                {
+                    /*
+                     * next cycle starts from this shard, left expired keys are counted in expire lag
+                     */
+                    shard_cursor = shard;
+                    budget_used_up = true;
+                    break;
+                }
             }
-            else
-            {
-                continue;
-            }
-            total_expired_keys++;
-            if (toremove)
-            {
-                /*
-                 * generate 'del' command for master instance
-                 */
-                FeedReplicationDelOperation(scan_ctx, key.GetNameSpace(), key.GetKey().AsString());
-            }
-            if (KEY_STRING == meta.GetType())
-            {
-                RemoveKey(scan_ctx, key);
-            }
-            else if (meta.GetType() > 0)
-            {
-                DelKey(scan_ctx, key);
-            }
-        }
-        uint64 end_time = get_current_epoch_millis();
-        if (total_expired_keys > 0)
-        {
-            INFO_LOG("Cost %llums to delete %lld keys.", (end_time - start_time), total_expired_keys);
         }
-        return 0;
+        g_expired_keys.Add(total_expired_keys);
+        g_expire_cycle_cpu_micros.Add(get_thread_cpu_micros() - start_cpu);
+        return total_expired_keys;
     }
+
     void Ardb::AddExpiredKey(const Data& ns, const Data& key)
     {
-        KeyPrefix k;
-        k.key = key;
-        k.ns = ns;
-        k.key.ToMutableStr();
-        k.ns.ToMutableStr();
-        LockGuard<SpinMutexLock> guard(m_expires_lock);
-        m_expires.insert(k);
+        m_expire_index.Set(ns, key, get_current_epoch_millis());
     }
 
     int Ardb::FindElementByRedisCursor(const std::string& cursor, std::string& element)
@@ -1151,11 +1141,21 @@ OP_NAMESPACE_BEGIN
             }
             if (meta.GetTTL() > 0 && meta.GetTTL() < (int64_t)get_current_epoch_millis())
             {
-                if (GetConf().master_host.empty() || !GetConf().slave_readonly)
+                if (ctx.keyslocked_shared)
+                {
+                    /*
+                     * key is only locked for reading, let the expire cycle delete it
+                     */
+                    if (GetConf().master_host.empty())
+                    {
+                        AddExpiredKey(key.GetNameSpace(), key.GetKey());
+                    }
+                }
+                else if (GetConf().master_host.empty() || !GetConf().slave_readonly)
                 {
-                    KeyLockGuard keylocker(ctx, key, ctx.keyslocked ? false : true);
+                    KeyLockGuard keylocker(ctx, key, ctx.keyslocked ? false : true, true);
                     int old_dirty = ctx.dirty;
-                    if (meta.GetType() == KEY_STRING)
+                    if (meta.GetType() == KEY_STRING && !meta.IsStringSegmented())
                     {
                         RemoveKey(ctx, key);
                     }
@@ -1190,6 +1190,256 @@ OP_NAMESPACE_BEGIN
         return true;
     }
 
+    /*
+     * compact encoding is only used in redis compatible mode, since other mode writes elements without reading meta.
+     */
+    bool Ardb::CompactFits(Context& ctx, uint8 type, const DataArray& elements)
+    {
+        if (!ctx.flags.redis_compatible)
+        {
+            return false;
+        }
+        int64_t max_entries = 0;
+        switch (type)
+        {
+            case KEY_HASH:
+            {
+                max_entries = GetConf().hash_max_compact_entries;
+                break;
+            }
+            case KEY_SET:
+            {
+                max_entries = GetConf().set_max_compact_entries;
+                break;
+            }
+            case KEY_ZSET:
+            {
+                max_entries = GetConf().zset_max_compact_entries;
+                break;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+        size_t step = type == KEY_SET ? 1 : 2;
+        if (max_entries <= 0 || elements.size() / step > (size_t) max_entries)
+        {
+            return false;
+        }
+        for (size_t i = 0; i < elements.size(); i++)
+        {
+            if (type == KEY_ZSET && i % 2 == 1)
+            {
+                continue;
+            }
+            if (elements[i].StringLength() > (uint32) GetConf().compact_max_value_size)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    /*
+     * returns the position of first entry not less than 'element', compact elements are kept sorted by field/member
+     * on write, so lookups are binary searches.
+     */
+    size_t Ardb::CompactLocate(uint8 type, const DataArray& elements, const Data& element, bool& found)
+    {
+        size_t step = type == KEY_SET ? 1 : 2;
+        size_t low = 0, high = elements.size() / step;
+        while (low < high)
+        {
+            size_t mid = (low + high) / 2;
+            if (elements[mid * step] < element)
+            {
+                low = mid + 1;
+            }
+            else
+            {
+                high = mid;
+            }
+        }
+        found = low * step < elements.size() && elements[low * step] == element;
+        return low * step;
+    }
+
+    /*
+     * write back elements of a compact collection, it would be expanded once it does not fit compact encoding.
+     */
+    int Ardb::CompactSave(Context& ctx, const KeyObject& key, ValueObject& meta, const DataArray& elements)
+    {
+        if (elements.empty())
+        {
+            return RemoveKey(ctx, key);
+        }
+        meta.SetObjectLen(meta.GetType() == KEY_SET ? elements.size() : elements.size() / 2);
+        meta.SetCompactElements(elements);
+        if (!CompactFits(ctx, meta.GetType(), elements))
+        {
+            return CompactExpand(ctx, key, meta);
+        }
+        return SetKeyValue(ctx, key, meta);
+    }
+
+    int Ardb::CompactExpand(Context& ctx, const KeyObject& key, ValueObject& meta)
+    {
+        DataArray elements;
+        if (!meta.GetCompactElements(elements))
+        {
+            return ERR_CORRUPTED_VALUE;
+        }
+        WriteBatchGuard batch(ctx, m_engine);
+        meta.SetCompactElements(DataArray());
+        meta.ClearMinMaxData();
+        size_t step = meta.GetType() == KEY_SET ? 1 : 2;
+        ZSetRankDeltas rank_deltas;
+        bool rank_indexed = meta.GetType() == KEY_ZSET && ZSetRankIndexNeeded(meta, elements.size() / step);
+        for (size_t i = 0; i + step <= elements.size(); i += step)
+        {
+            switch (meta.GetType())
+            {
+                case KEY_HASH:
+                {
+                    KeyObject field(key.GetNameSpace(), KEY_HASH_FIELD, key.GetKey());
+                    field.SetHashField(elements[i]);
+                    ValueObject field_value;
+                    field_value.SetType(KEY_HASH_FIELD);
+                    field_value.SetHashValue(elements[i + 1]);
+                    SetKeyValue(ctx, field, field_value);
+                    break;
+                }
+                case KEY_SET:
+                {
+                    KeyObject member(key.GetNameSpace(), KEY_SET_MEMBER, key.GetKey());
+                    member.SetSetMember(elements[i]);
+                    ValueObject empty;
+                    empty.SetType(KEY_SET_MEMBER);
+                    SetKeyValue(ctx, member, empty);
+                    break;
+                }
+                case KEY_ZSET:
+                {
+                    double score = elements[i + 1].GetFloat64();
+                    KeyObject sort_key(key.GetNameSpace(), KEY_ZSET_SORT, key.GetKey());
+                    sort_key.SetZSetMember(elements[i]);
+                    sort_key.SetZSetScore(score);
+                    ValueObject empty;
+                    empty.SetType(KEY_ZSET_SORT);
+                    SetKeyValue(ctx, sort_key, empty);
+                    KeyObject score_key(key.GetNameSpace(), KEY_ZSET_SCORE, key.GetKey());
+                    score_key.SetZSetMember(elements[i]);
+                    ValueObject score_value;
+                    score_value.SetType(KEY_ZSET_SCORE);
+                    score_value.SetZSetScore(score);
+                    SetKeyValue(ctx, score_key, score_value);
+                    if (rank_indexed)
+                    {
+                        ZSetRankUpdate(rank_deltas, score, elements[i], 1);
+                    }
+                    break;
+                }
+                default:
+                {
+                    break;
+                }
+            }
+            if (meta.GetType() != KEY_HASH)
+            {
+                meta.SetMinMaxData(elements[i]);
+            }
+        }
+        if (rank_indexed)
+        {
+            ZSetRankFlush(ctx, key, rank_deltas);
+            meta.GetMetaObject().zset_rank_indexed = true;
+        }
+        SetKeyValue(ctx, key, meta);
+        return ctx.transc_err;
+    }
+
+    /*
+     * writers which do not read meta (non redis compatible mode) expand an existing compact collection first
+     */
+    int Ardb::CompactExpand(Context& ctx, const KeyObject& key)
+    {
+        KeyLockGuard guard(ctx, key, ctx.keyslocked ? false : true);
+        ValueObject meta;
+        if (0 != m_engine->Get(ctx, key, meta) || !meta.IsCompact())
+        {
+            return 0;
+        }
+        return CompactExpand(ctx, key, meta);
+    }
+
+    /*
+     * erase fields/members from compact elements, returns the number of erased entries, object length is untouched.
+     */
+    int64_t Ardb::CompactErase(ValueObject& meta, const DataSet& members)
+    {
+        DataArray elements, rest;
+        if (!meta.GetCompactElements(elements))
+        {
+            return 0;
+        }
+        size_t step = meta.GetType() == KEY_SET ? 1 : 2;
+        for (size_t i = 0; i + step <= elements.size(); i += step)
+        {
+            if (members.count(elements[i]) == 0)
+            {
+                rest.insert(rest.end(), elements.begin() + i, elements.begin() + i + step);
+            }
+        }
+        int64_t erased = (elements.size() - rest.size()) / step;
+        if (erased > 0)
+        {
+            meta.SetCompactElements(rest);
+        }
+        return erased;
+    }
+
+    Iterator* Ardb::FindElements(Context& ctx, const KeyObject& key, ValueObject& meta)
+    {
+        if (meta.IsCompact())
+        {
+            CompactIterator* iter = NULL;
+            NEW(iter, CompactIterator(key, meta));
+            return iter;
+        }
+        return m_engine->Find(ctx, key);
+    }
+
+    /*
+     * MultiGet for element keys which all belong to the same collection
+     */
+    int Ardb::MultiGetElements(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs)
+    {
+        if (keys.empty())
+        {
+            return 0;
+        }
+        KeyObject meta_key(keys[0].GetNameSpace(), KEY_META, keys[0].GetKey());
+        ValueObject meta;
+        if (0 != m_engine->Get(ctx, meta_key, meta) || !meta.IsCompact())
+        {
+            return m_engine->MultiGet(ctx, keys, values, errs);
+        }
+        CompactIterator iter(keys[0], meta);
+        values.resize(keys.size());
+        errs.assign(keys.size(), ERR_ENTRY_NOT_EXIST);
+        for (size_t i = 0; i < keys.size(); i++)
+        {
+            iter.Jump(keys[i]);
+            if (iter.Valid() && iter.Key(false).Compare(keys[i]) == 0)
+            {
+                values[i] = iter.Value(false);
+                errs[i] = 0;
+            }
+        }
+        return 0;
+    }
+
     static void async_write_reply_callback(Channel* ch, void * data)
     {
         RedisReply* r = (RedisReply*) data;
@@ -1232,7 +1482,7 @@ OP_NAMESPACE_BEGIN
         UnsubscribeAll(ctx, false, false);
         if (NULL != ctx.client)
         {
-            m_clients.GetValue().erase(ctx.client->clientid);
+            ctx.client->idle_timer.Cancel();
             LockGuard<SpinMutexLock> guard(m_clients_lock);
             m_all_clients.erase(&ctx);
         }
@@ -1251,86 +1501,60 @@ OP_NAMESPACE_BEGIN
         }
     }
 
-#define CLIENTS_CRON_MIN_ITERATIONS 5
-    void Ardb::ScanClients()
+    void Ardb::AddClient(Context& ctx)
     {
-        std::vector<Context*> to_close;
-        uint64 now = get_current_epoch_micros();
-        ClientIdSet& local_clients = m_clients.GetValue();
-        if (local_clients.empty())
+        if (NULL != ctx.client)
         {
-            return;
-        }
-        int64 numclients = local_clients.size();
-        int64 iterations = numclients / GetConf().hz;
-
-        /* Process at least a few clients while we are at it, even if we need
-         * to process less than CLIENTS_CRON_MIN_ITERATIONS to meet our contract
-         * of processing each client once per second. */
-        if (iterations < CLIENTS_CRON_MIN_ITERATIONS) iterations =
-                (numclients < CLIENTS_CRON_MIN_ITERATIONS) ? numclients : CLIENTS_CRON_MIN_ITERATIONS;
-        ClientId& last_scan_clientid = m_last_scan_clientid.GetValue();
-        ClientIdSet::iterator it = local_clients.lower_bound(last_scan_clientid);
-        while (it != local_clients.end() && iterations--)
-        {
-            ClientId& clientid = *it;
-            Context* client = clientid.ctx;
-            if (GetConf().tcp_keepalive > 0)
-            {
-                if (!client->IsBlocking() && !client->IsSubscribed())
-                {
-                    if ((int64_t)now - client->client->last_interaction_ustime >= GetConf().tcp_keepalive * 1000 * 1000)
-                    {
-                        //timeout;
-                        to_close.push_back(client);
-                        client = NULL;
-                    }
-                }
-            }
-            if (NULL != client && client->IsBlocking())
             {
-                if (client->GetBPop().timeout > 0 && now >= client->GetBPop().timeout)
-                {
-                    //timeout;
-                    RedisReply empty_bulk;
-                    empty_bulk.ReserveMember(-1);
-                    client->client->client->Write(empty_bulk);
-                    to_close.push_back(client);
-                }
+                LockGuard<SpinMutexLock> guard(m_clients_lock);
+                m_all_clients.insert(&ctx);
             }
-            if (NULL != client && NULL != client->client && NULL != client->client->client)
-            {
-                if (client->client->resume_ustime > 0 && (int64_t)now <= client->client->resume_ustime)
-                {
-                    client->client->client->AttachFD();
-                    client->client->resume_ustime = -1;
-                }
-            }
-            it++;
+            CheckIdleClient(ctx);
         }
-        for (size_t i = 0; i < to_close.size(); i++)
+    }
+
+    bool Ardb::DetachClient(Context& ctx)
+    {
+        if (NULL != ctx.client && ctx.client->idle_timer.IsScheduled())
         {
-            to_close[i]->client->client->Close();
+            ctx.client->idle_timer.Cancel();
+            return true;
         }
-        if (it == local_clients.end())
+        return false;
+    }
+
+    void Ardb::AttachClient(Context& ctx)
+    {
+        CheckIdleClient(ctx);
+    }
+
+    void Ardb::IdleTimeoutCallback(void* data)
+    {
+        Context* ctx = (Context*) data;
+        g_db->CheckIdleClient(*ctx);
+    }
+
+    void Ardb::CheckIdleClient(Context& ctx)
+    {
+        ClientContext* client = ctx.client;
+        if (NULL == client || NULL == client->client || client->client->IsClosed() || GetConf().timeout <= 0)
         {
-            last_scan_clientid.id = 0;
-            last_scan_clientid.ctx = NULL;
+            return;
         }
-        else
+        int64 timeout_ms = GetConf().timeout * 1000;
+        int64 idle_ms = ((int64) get_current_epoch_micros() - client->last_interaction_ustime) / 1000;
+        if (client->processing || ctx.IsBlocking() || ctx.IsSubscribed() || ctx.flags.slave)
         {
-            last_scan_clientid = (*it);
+            idle_ms = 0;
         }
-    }
-
-    void Ardb::AddClient(Context& ctx)
-    {
-        if (NULL != ctx.client)
+        if (idle_ms >= timeout_ms)
         {
-            m_clients.GetValue().insert(ctx.client->clientid);
-            LockGuard<SpinMutexLock> guard(m_clients_lock);
-            m_all_clients.insert(&ctx);
+            client->client->Close();
+            return;
         }
+        client->idle_timer.cb = IdleTimeoutCallback;
+        client->idle_timer.data = &ctx;
+        client->client->GetService().GetTimingWheel().Schedule(client->idle_timer, timeout_ms - idle_ms);
     }
 
     bool Ardb::IsLoadingData()
@@ -1373,7 +1597,10 @@ OP_NAMESPACE_BEGIN
         }
         atomic_add_uint32(&m_db_caller_num, 1);
 
+        unsigned old_readonly = ctx.flags.readonly;
+        ctx.flags.readonly = setting.IsReadOnlyCommand() ? 1 : 0;
         int ret = (this->*(setting.handler))(ctx, args);
+        ctx.flags.readonly = old_readonly;
         atomic_sub_uint32(&m_db_caller_num, 1);
         if(!ctx.post_cmd_func.empty())
         {
@@ -1555,4 +1782,95 @@ OP_NAMESPACE_BEGIN
         return ret;
     }
 
+    bool Ardb::IsBatchableRead(Context& ctx, RedisCommandFrame& cmd)
+    {
+        if (ctx.InTransaction() || ctx.IsSubscribed() || !ctx.authenticated)
+        {
+            return false;
+        }
+        RedisCommandHandlerSetting* setting = FindRedisCommandHandlerSetting(cmd);
+        if (NULL == setting)
+        {
+            return false;
+        }
+        switch (setting->type)
+        {
+            case REDIS_CMD_GET:
+            case REDIS_CMD_EXISTS:
+            {
+                return cmd.GetArguments().size() == 1;
+            }
+            case REDIS_CMD_HGET:
+            {
+                return cmd.GetArguments().size() == 2;
+            }
+            default:
+            {
+                return false;
+            }
+        }
+    }
+
+    void Ardb::PrefetchReads(Context& ctx, RedisCommandFrameArray& cmds, ReadBatch& batch)
+    {
+        batch.Clear();
+        for (size_t i = 0; i < cmds.size(); i++)
+        {
+            const std::string& keystr = cmds[i].GetArguments()[0];
+            batch.cmds.push_back(&cmds[i]);
+            batch.offsets.push_back(batch.keys.size());
+            KeyObject meta_key(ctx.ns, KEY_META, keystr);
+            batch.keys.push_back(meta_key);
+            if (cmds[i].GetArguments().size() == 2)
+            {
+                /*
+                 * HGET, the field is loaded with its meta like Ardb::HGet does
+                 */
+                KeyObject field_key(ctx.ns, KEY_HASH_FIELD, keystr);
+                field_key.SetHashField(cmds[i].GetArguments()[1]);
+                batch.keys.push_back(field_key);
+            }
+        }
+        int err = m_engine->MultiGet(ctx, batch.keys, batch.values, batch.errs);
+        if ((0 != err && ERR_ENTRY_NOT_EXIST != err) || batch.errs.size() != batch.keys.size()
+                || batch.values.size() != batch.keys.size())
+        {
+            /*
+             * let every command read the engine by itself, it gets the error as if it's not batched
+             */
+            batch.Clear();
+            return;
+        }
+        ctx.read_batch = &batch;
+        g_read_batches.Add(1);
+        g_read_batch_cmds.Add(cmds.size());
+    }
+
+    ValueObject* Ardb::GetBatchedValues(Context& ctx, size_t count, const int*& errs)
+    {
+        ReadBatch* batch = ctx.read_batch;
+        if (NULL == batch)
+        {
+            return NULL;
+        }
+        /*
+         * commands are called in batch order, a command rejected before its handler just leaves its slot behind
+         */
+        while (batch->cursor < batch->cmds.size() && batch->cmds[batch->cursor] != ctx.current_cmd)
+        {
+            batch->cursor++;
+        }
+        if (batch->cursor == batch->cmds.size())
+        {
+            return NULL;
+        }
+        size_t offset = batch->offsets[batch->cursor];
+        if (offset + count > batch->keys.size())
+        {
+            return NULL;
+        }
+        errs = &(batch->errs[offset]);
+        return &(batch->values[offset]);
+    }
+
 OP_NAMESPACE_END
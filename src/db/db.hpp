@@ -36,8 +36,11 @@
 #include "thread/thread_mutex_lock.hpp"
 #include "channel/all_includes.hpp"
 #include "util/lru.hpp"
+#include "util/pattern_index.hpp"
 #include "command/lua_scripting.hpp"
 #include "db/engine.hpp"
+#include "db/key_lock_table.hpp"
+#include "db/expire_index.hpp"
 #include "statistics.hpp"
 #include "context.hpp"
 #include "config.hpp"
@@ -46,6 +49,7 @@
 #include <sparsehash/dense_hash_map>
 
 #define TTL_DB_NSMAESPACE "__TTL_DB__"
+#define PUBSUB_SHARD_COUNT 16
 
 using namespace ardb::codec;
 
@@ -57,6 +61,35 @@ OP_NAMESPACE_BEGIN
     struct StreamGroupMeta;
     struct StreamNACK;
     class BackGroundThread;
+    class ExpireThread;
+
+    /*
+     * keys of consecutive pipelined GET/HGET/EXISTS loaded by one engine MultiGet, the commands are
+     * still called one by one and take their values from here instead of the engine
+     */
+    struct ReadBatch
+    {
+            KeyObjectArray keys;
+            ValueObjectArray values;
+            ErrCodeArray errs;
+            std::vector<const RedisCommandFrame*> cmds;
+            std::vector<size_t> offsets; //index of the first key of cmds[i]
+            size_t cursor;
+            ReadBatch()
+                    : cursor(0)
+            {
+            }
+            void Clear()
+            {
+                keys.clear();
+                values.clear();
+                errs.clear();
+                cmds.clear();
+                offsets.clear();
+                cursor = 0;
+            }
+    };
+
     class Ardb
     {
         public:
@@ -75,6 +108,7 @@ OP_NAMESPACE_BEGIN
                     //CostTrack
                     bool IsAllowedInScript() const;
                     bool IsWriteCommand() const;
+                    bool IsReadOnlyCommand() const;
             };
             struct RedisCommandHash
             {
@@ -85,19 +119,26 @@ OP_NAMESPACE_BEGIN
                     bool operator()(const std::string& s1, const std::string& s2) const;
             };
 
+            /*
+             * read only commands lock the key shared, or read from an engine snapshot without locking if the
+             * engine supports it, 'exclusive' forces a write lock inside read only commands.
+             */
             struct KeyLockGuard
             {
                     Context& ctx;
                     KeyPrefix lk;
                     bool lock;
+                    bool shared;
+                    EngineSnapshot snapshot;
 
-                    KeyLockGuard(Context& cctx, const KeyObject& key, bool _lock = true);
+                    KeyLockGuard(Context& cctx, const KeyObject& key, bool _lock = true, bool exclusive = false);
                     ~KeyLockGuard();
             };
             struct KeysLockGuard
             {
                     Context& ctx;
                     KeyPrefixSet ks;
+                    bool shared;
                     KeysLockGuard(Context& cctx, const KeyObjectArray& keys);
                     KeysLockGuard(Context& cctx, const KeyObject& key1, const KeyObject& key2);
                     ~KeysLockGuard();
@@ -115,17 +156,18 @@ OP_NAMESPACE_BEGIN
             ArdbConfig m_conf;
             ThreadLocal<LUAInterpreter> m_lua;
 
-            typedef TreeSet<KeyPrefix>::Type ExpireKeySet;
-            SpinMutexLock m_expires_lock;
-            ExpireKeySet m_expires;
+            ExpireIndex m_expire_index;
+            /*
+             * cursor of the incremental expire index rebuild, only used by the first expire thread
+             */
+            DataArray m_expire_load_nss;
+            size_t m_expire_load_cursor;
+            std::string m_expire_load_key;
+            bool m_expire_index_loaded;
 
             typedef google::dense_hash_map<std::string, RedisCommandHandlerSetting, RedisCommandHash, RedisCommandEqual> RedisCommandHandlerSettingTable;
             RedisCommandHandlerSettingTable m_settings;
-            typedef TreeMap<KeyPrefix, ThreadMutexLock*>::Type LockTable;
-            typedef std::stack<ThreadMutexLock*> LockPool;
-            SpinMutexLock m_locking_keys_lock;
-            LockTable m_locking_keys;
-            LockPool m_lock_pool;
+            KeyLockTable m_key_locks;
 
             SpinMutexLock m_redis_cursor_lock;
             typedef LRUCache<uint64, std::string> RedisCursorCache;
@@ -133,9 +175,21 @@ OP_NAMESPACE_BEGIN
             RedisCursorCache m_redis_cursor_cache;
 
             typedef TreeMap<std::string, ContextSet>::Type PubSubChannelTable;
+            /*
+             * channels are hashed into shards so that PUBLISH on unrelated channels does not contend,
+             * patterns stay in one table guarded by 'm_pubsub_lock' since every PUBLISH matches all of them.
+             */
+            struct PubSubShard
+            {
+                    SpinRWLock lock;
+                    PubSubChannelTable channels;
+            };
+            PubSubShard m_pubsub_shards[PUBSUB_SHARD_COUNT];
             SpinRWLock m_pubsub_lock;
-            PubSubChannelTable m_pubsub_channels;
             PubSubChannelTable m_pubsub_patterns;
+            PatternIndex m_pubsub_pattern_index;
+            volatile uint64 m_pubsub_pattern_match_calls;
+            volatile uint64 m_pubsub_pattern_match_usecs;
 
             SpinMutexLock m_watched_keys_lock;
             typedef TreeMap<KeyPrefix, ContextSet>::Type WatchedContextTable;
@@ -150,17 +204,14 @@ OP_NAMESPACE_BEGIN
             SpinRWLock m_monitors_lock;
             ContextSet* m_monitors;
 
-            ThreadLocal<ClientIdSet> m_clients;
-            ThreadLocal<ClientId> m_last_scan_clientid;
             SpinMutexLock m_clients_lock;
             ContextSet m_all_clients;
 
             SpinMutexLock m_restoring_lock;
             DataSet* m_restoring_nss;
 
-            int64_t m_min_ttl;
-
             BackGroundThread* g_background;
+            std::vector<ExpireThread*> m_expire_threads;
 
             static void MigrateCoroTask(void* data);
             static void MigrateDBCoroTask(void* data);
@@ -176,16 +227,16 @@ OP_NAMESPACE_BEGIN
             void CloseWriteLatchBeforeSnapshotPrepare();
 
             void SaveTTL(Context& ctx, const Data& ns, const std::string& key, int64 old_ttl, int64_t new_ttl);
-            void ScanTTLDB();
+            bool LoadExpireIndex(uint64 cpu_deadline);
             void FeedReplicationBacklog(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
             void FeedMonitors(Context& ctx, const Data& ns, RedisCommandFrame& cmd);
 
             int WriteReply(Context& ctx, RedisReply* r, bool async);
 
-            bool LockKey(const KeyPrefix& key, int wait_limit = -1);
-            void UnlockKey(const KeyPrefix& key);
-            void LockKeys(const KeyPrefixSet& key);
-            void UnlockKeys(const KeyPrefixSet& key);
+            void LockKey(const KeyPrefix& key, bool shared = false);
+            void UnlockKey(const KeyPrefix& key, bool shared = false);
+            void LockKeys(const KeyPrefixSet& key, bool shared = false);
+            void UnlockKeys(const KeyPrefixSet& key, bool shared = false);
 
             Engine* GetEngine()
             {
@@ -213,6 +264,8 @@ OP_NAMESPACE_BEGIN
 
             void FillInfoResponse(Context& ctx, const std::string& section, std::string& info);
 
+            PubSubShard& GetPubSubShard(const std::string& channel);
+            size_t PubSubChannelsCount();
             int SubscribeChannel(Context& ctx, const std::string& channel, bool is_pattern);
             int UnsubscribeChannel(Context& ctx, const std::string& channel, bool is_pattern, bool notify);
             int UnsubscribeAll(Context& ctx, bool is_pattern, bool notify);
@@ -226,6 +279,33 @@ OP_NAMESPACE_BEGIN
             int ListPopValue(Context& ctx, const KeyPrefix& key, bool lpop, std::string& value, RedisCommandFrame& cmd);
             int ListPushValue(Context& ctx, const KeyPrefix& key, const std::string& value, bool lpush,
                     RedisCommandFrame& cmd);
+            /*
+             * std::map keeps element pointers returned by ListChunkLoad valid while more chunks are loaded
+             */
+            typedef std::map<int64_t, ValueObject> ListChunkTable;
+            int ListChunkLoad(Context& ctx, const KeyObject& key, ListChunkTable& chunks, int64_t id,
+                    DataArray*& elements);
+            int ListChunkSave(Context& ctx, const KeyObject& key, ListChunkTable& chunks, int64_t id);
+            int64_t ListChunkLocate(ValueObject& meta, int64_t& index);
+            int ListChunkRemove(Context& ctx, const KeyObject& key, int64_t from, int64_t to, int64_t elements);
+            int ListChunkInsert(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks,
+                    int64_t id, int64_t offset, const Data& element, std::vector<int64_t>& modified);
+            int ListChunkRepack(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks,
+                    int64_t from, int64_t last);
+            int ListChunkConvert(Context& ctx, const KeyObject& key, ValueObject& meta, ListChunkTable& chunks);
+            /*
+             * segments of large string keyed by segment id, a segment not stored yet is all zero bytes
+             */
+            typedef std::map<int64_t, ValueObject> StringSegmentTable;
+            int StringSegmentsLoad(Context& ctx, const KeyObject& key, int64_t from, int64_t to,
+                    StringSegmentTable& segments);
+            int StringSegmentsSave(Context& ctx, const KeyObject& key, StringSegmentTable& segments);
+            int StringSegmentsRead(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t start, int64_t end,
+                    std::string& str);
+            int StringSegmentsWrite(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t offset,
+                    const std::string& range);
+            int StringSegmentsConvert(Context& ctx, const KeyObject& key, ValueObject& meta, int64_t new_len);
+            int StringSegmentsClear(Context& ctx, const KeyObject& key, ValueObject& meta);
 
             bool AdjustMergeOp(uint16& op, DataArray& args);
             int MergeAppend(Context& ctx, const KeyObject& key, ValueObject& val, const std::string& append);
@@ -250,6 +330,19 @@ OP_NAMESPACE_BEGIN
             int GetMinMax(Context& ctx, const KeyObject& key, ValueObject& meta, Iterator*& iter);
             int GetMinMax(Context& ctx, const KeyObject& key, KeyType ele_type, ValueObject& meta, Iterator*& iter);
 
+            bool CompactFits(Context& ctx, uint8 type, const DataArray& elements);
+            size_t CompactLocate(uint8 type, const DataArray& elements, const Data& element, bool& found);
+            int CompactSave(Context& ctx, const KeyObject& key, ValueObject& meta, const DataArray& elements);
+            int CompactExpand(Context& ctx, const KeyObject& key, ValueObject& meta);
+            int CompactExpand(Context& ctx, const KeyObject& key);
+            int64_t CompactErase(ValueObject& meta, const DataSet& members);
+            Iterator* FindElements(Context& ctx, const KeyObject& key, ValueObject& meta);
+            int MultiGetElements(Context& ctx, const KeyObjectArray& keys, ValueObjectArray& values, ErrCodeArray& errs);
+            /*
+             * the 'count' values loaded by the read batch for the command being called, NULL if it's not batched
+             */
+            ValueObject* GetBatchedValues(Context& ctx, size_t count, const int*& errs);
+
             int DelKey(Context& ctx, const KeyObject& meta_key, Iterator*& iter);
             int DelKey(Context& ctx, const std::string& key);
             int DelKey(Context& ctx, const KeyObject& key);
@@ -257,10 +350,22 @@ OP_NAMESPACE_BEGIN
             int AsyncDeleteKey(Context& ctx, const Data& ns, const std::string& key);
 
             int HIterate(Context& ctx, RedisCommandFrame& cmd);
+            int HSetCompact(Context& ctx, RedisCommandFrame& cmd, const KeyObject& key, ValueObject& meta, bool* inserted);
+            int SMoveCompact(Context& ctx, KeyObjectArray& ks, ValueObjectArray& vs);
+            int SStoreMembers(Context& ctx, const KeyObject& key, const DataSet& members);
             int ZIterateByRank(Context& ctx, RedisCommandFrame& cmd);
             int ZIterateByScore(Context& ctx, RedisCommandFrame& cmd);
             int ZIterateByLex(Context& ctx, RedisCommandFrame& cmd);
             int ZPop(Context& ctx, RedisReply& r, const std::string& key, ValueObject* meta, int64_t count, bool reverse, bool emitkey, bool lock);
+            typedef TreeMap<std::pair<double, Data>, int64_t>::Type ZSetRankDeltas;
+            bool ZSetRankIndexNeeded(ValueObject& meta, int64_t size);
+            void ZSetRankUpdate(ZSetRankDeltas& deltas, double score, const Data& member, int64_t delta);
+            int ZSetRankBuild(Context& ctx, const KeyObject& key, ZSetRankDeltas& deltas);
+            int ZSetRankFlush(Context& ctx, const KeyObject& key, ZSetRankDeltas& deltas);
+            int64_t ZSetRankCountLess(Context& ctx, const KeyObject& key, double score, const Data& member);
+            int64_t ZSetRankCountScore(Context& ctx, const KeyObject& key, ValueObject& meta, double score, bool inclusive);
+            int64_t ZSetRankOf(Context& ctx, const KeyObject& key, double score, const Data& member);
+            Iterator* ZSetRankSeek(Context& ctx, const KeyObject& key, int64_t rank);
 
             int StreamDel(Context& ctx, const KeyObject& key);
             int StreamDelItem(Context& ctx, const std::string& key, const StreamID& id);
@@ -291,6 +396,7 @@ OP_NAMESPACE_BEGIN
 
             int BlockForKeys(Context& ctx, const StringArray& keys, const AnyArray& vals, KeyType ktype, uint32 mstimeout);
             static void AsyncUnblockKeysCallback(Channel* ch, void * data);
+            static void BlockTimeoutCallback(void* data);
             int UnblockKeys(Context& ctx, bool sync = true, RedisReply* reply = NULL);
             int WakeClientsBlockingOnZSet(Context& ctx, const KeyPrefix& ready_key,  Context& unblock_client);
             int WakeClientsBlockingOnList(Context& ctx,  const KeyPrefix& ready_key, Context& unblock_client);
@@ -511,6 +617,7 @@ OP_NAMESPACE_BEGIN
             int DoCall(Context& ctx, RedisCommandHandlerSetting& setting, RedisCommandFrame& cmd);
             RedisCommandHandlerSetting* FindRedisCommandHandlerSetting(RedisCommandFrame& cmd);
             void RenameCommand();
+            int LoadKeyFormat(const std::string& dbdir);
 
             int CreateBackGroundThread();
             int StopBackGroundThread();
@@ -519,14 +626,26 @@ OP_NAMESPACE_BEGIN
             friend class ObjectIO;
             friend class ObjectBuffer;
             friend class Snapshot;
+            friend class SnapshotStreamLoader;
             friend class Master;
             friend class Slave;
+            friend class DBWriter;
             friend class BackGroundThread;
+            friend class ExpireThread;
         public:
             Ardb();
             int Init(const std::string& conf_file);
             int Repair(const std::string& dir);
             int Call(Context& ctx, RedisCommandFrame& cmd);
+            /*
+             * if the command is a single key GET/HGET/EXISTS which could join a pipelined read batch
+             */
+            bool IsBatchableRead(Context& ctx, RedisCommandFrame& cmd);
+            /*
+             * load the keys of the batchable reads 'cmds' with one MultiGet into 'batch' and attach it to the
+             * context, the caller calls the commands in order then detaches & clears the batch
+             */
+            void PrefetchReads(Context& ctx, RedisCommandFrameArray& cmds, ReadBatch& batch);
             int MergeOperation(const KeyObject& key, ValueObject& val, uint16_t op, DataArray& args);
             int MergeOperands(uint16_t left, const DataArray& left_args, uint16_t& right, DataArray& right_args);
             void AddExpiredKey(const Data& ns, const Data& key);
@@ -534,8 +653,22 @@ OP_NAMESPACE_BEGIN
             int TouchWatchKey(Context& ctx, const KeyObject& key);
             void FreeClient(Context& ctx);
             void AddClient(Context& ctx);
-            void ScanClients();
-            int64 ScanExpiredKeys();
+            /*
+             * move the client's timers out of/into the timing wheel of current io thread
+             */
+            bool DetachClient(Context& ctx);
+            void AttachClient(Context& ctx);
+            /*
+             * close the client if idle for 'timeout' seconds, otherwise (re)arm its idle timer for the rest time,
+             * so the timer is pushed back lazily instead of on every command
+             */
+            void CheckIdleClient(Context& ctx);
+            static void IdleTimeoutCallback(void* data);
+            /*
+             * delete expired keys of the worker's index shards until no expired key left or cpu budget used up,
+             * returns the number of deleted keys
+             */
+            int64 ActiveExpireCycle(uint32 worker, uint32 workers, uint64 cpu_budget_micros, uint32& shard_cursor);
             void GC();
 
             const ArdbConfig& GetConf() const
@@ -32,6 +32,8 @@
 #include "util/file_helper.hpp"
 #include "thread/event_condition.hpp"
 #include "db.hpp"
+#include "util/murmur3.h"
+#include <algorithm>
 
 #define DEFAULT_LOCAL_ENCODE_BUFFER_SIZE 8192
 
@@ -65,6 +67,13 @@ OP_NAMESPACE_BEGIN
         return encode_buffer_cache;
     }
 
+    struct DBWriterTask
+    {
+            RedisCommandFrame* cmd;
+            uint64 queued_ms;
+    };
+    typedef std::vector<DBWriterTask> DBWriterTaskArray;
+
     class DBWriterWorker: public Thread
     {
         public:
@@ -73,13 +82,16 @@ OP_NAMESPACE_BEGIN
             DBWriter* writer;
             bool running;
             volatile bool writing;
+            ThreadMutexLock queue_lock;
+            std::deque<DBWriterTask> queue;
+            uint64 writing_since;
+            int64 executed;
             DBWriterWorker(DBWriter* w) :
-                    writer(w), running(true),writing(false)
+                    writer(w), running(true),writing(false), writing_since(0), executed(0)
             {
             }
             void Call(RedisCommandFrame& cmd)
             {
-                writing = true;
                 worker_ctx.ClearFlags();
                 worker_ctx.flags = flags;
                 g_db->Call(worker_ctx, cmd);
@@ -89,19 +101,110 @@ OP_NAMESPACE_BEGIN
                     WARN_LOG("Slave sync error:%s", r.Error().c_str());
                 }
                 r.Clear();
+            }
+            void Enqueue(RedisCommandFrame& cmd)
+            {
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                while(queue.size() >= (size_t)(g_db->GetConf().max_slave_worker_queue))
+                {
+                    queue_lock.Wait(1);
+                }
+                DBWriterTask task;
+                NEW(task.cmd, RedisCommandFrame);
+                *task.cmd = cmd;
+                task.queued_ms = get_current_epoch_millis();
+                queue.push_back(task);
+                queue_lock.NotifyAll();
+            }
+            bool Dequeue(DBWriterTaskArray& tasks, size_t limit, int timeout)
+            {
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                if(queue.empty())
+                {
+                    queue_lock.Wait(timeout);
+                }
+                while (!queue.empty() && tasks.size() < limit)
+                {
+                    tasks.push_back(queue.front());
+                    queue.pop_front();
+                }
+                if (!tasks.empty())
+                {
+                    writing = true;
+                    writing_since = tasks[0].queued_ms;
+                    queue_lock.NotifyAll();
+                }
+                return !tasks.empty();
+            }
+            void Execute(DBWriterTaskArray& tasks)
+            {
+                size_t i = 0;
+                while (i < tasks.size())
+                {
+                    /*
+                     * commands in a write batch could not read writes of each other, so the batch is committed
+                     * before executing a command on a key which is already written in it.
+                     */
+                    StringTreeSet batch_keys;
+                    {
+                        WriteBatchGuard batch(worker_ctx, g_engine);
+                        for (; i < tasks.size(); i++)
+                        {
+                            if (!batch_keys.insert(tasks[i].cmd->GetArguments()[0]).second)
+                            {
+                                break;
+                            }
+                            Call(*tasks[i].cmd);
+                            DELETE(tasks[i].cmd);
+                        }
+                    }
+                    if (0 != worker_ctx.transc_err)
+                    {
+                        WARN_LOG("Slave sync write batch error:%d", worker_ctx.transc_err);
+                        worker_ctx.transc_err = 0;
+                    }
+                }
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                executed += tasks.size();
                 writing = false;
+                queue_lock.NotifyAll();
+            }
+            void WaitIdle()
+            {
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                while (!queue.empty() || writing)
+                {
+                    queue_lock.Wait(1);
+                }
+            }
+            int64 Lag()
+            {
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                uint64 since = writing ? writing_since : (queue.empty() ? 0 : queue.front().queued_ms);
+                if (0 == since)
+                {
+                    return 0;
+                }
+                uint64 now = get_current_epoch_millis();
+                return now > since ? now - since : 0;
             }
             void Run()
             {
+                DBWriterTaskArray tasks;
                 while (running)
                 {
-                    RedisCommandFrame* cmd = writer->Dequeue(1);
-                    if(NULL != cmd)
+                    tasks.clear();
+                    if (Dequeue(tasks, g_db->GetConf().max_slave_worker_batch, 1))
                     {
-                        Call(*cmd);
-                        DELETE(cmd);
+                        Execute(tasks);
                     }
                 }
+                LockGuard<ThreadMutexLock> guard(queue_lock);
+                while (!queue.empty())
+                {
+                    DELETE(queue.front().cmd);
+                    queue.pop_front();
+                }
             }
             void AdviceStop()
             {
@@ -109,7 +212,68 @@ OP_NAMESPACE_BEGIN
             }
     };
 
-    DBWriter::DBWriter()
+    /*
+     * returns true if the command only writes the key in its first argument, which could be executed by the
+     * worker owning the key concurrently with commands on other keys.
+     */
+    static bool is_single_key_write(Ardb::RedisCommandHandlerSetting* setting, RedisCommandFrame& cmd)
+    {
+        if (NULL == setting || !setting->IsWriteCommand() || cmd.GetArguments().empty())
+        {
+            return false;
+        }
+        switch (setting->type)
+        {
+            case REDIS_CMD_DEL:
+            case REDIS_CMD_UNLINK:
+            {
+                return cmd.GetArguments().size() == 1;
+            }
+            case REDIS_CMD_FLUSHDB:
+            case REDIS_CMD_FLUSHALL:
+            case REDIS_CMD_IMPORT:
+            case REDIS_CMD_BITOP:
+            case REDIS_CMD_MSET:
+            case REDIS_CMD_MSET2:
+            case REDIS_CMD_MSETNX:
+            case REDIS_CMD_MSETNX2:
+            case REDIS_CMD_SDIFFSTORE:
+            case REDIS_CMD_SINTERSTORE:
+            case REDIS_CMD_SUNIONSTORE:
+            case REDIS_CMD_SMOVE:
+            case REDIS_CMD_ZINTERSTORE:
+            case REDIS_CMD_ZUNIONSTORE:
+            case REDIS_CMD_BZPOPMIN:
+            case REDIS_CMD_BZPOPMAX:
+            case REDIS_CMD_BLPOP:
+            case REDIS_CMD_BRPOP:
+            case REDIS_CMD_RPOPLPUSH:
+            case REDIS_CMD_BRPOPLPUSH:
+            case REDIS_CMD_MOVE:
+            case REDIS_CMD_RENAME:
+            case REDIS_CMD_RENAMENX:
+            case REDIS_CMD_SORT:
+            case REDIS_CMD_GEO_RADIUS:
+            case REDIS_CMD_GEO_RADIUSBYMEMBER:
+            case REDIS_CMD_PFMERGE:
+            case REDIS_CMD_MIGRATE:
+            case REDIS_CMD_MIGRATEDB:
+            case REDIS_CMD_RESTOREDB:
+            case REDIS_CMD_RESTORECHUNK:
+            case REDIS_CMD_XGROUP:
+            case REDIS_CMD_XREADGROUP:
+            {
+                return false;
+            }
+            default:
+            {
+                return true;
+            }
+        }
+    }
+
+    DBWriter::DBWriter() :
+            m_in_transc(false)
     {
 
     }
@@ -142,59 +306,74 @@ OP_NAMESPACE_BEGIN
         return g_engine->Put(ctx, k, value);
     }
 
-    void DBWriter::Enqueue(RedisCommandFrame& cmd)
+    void DBWriter::WaitWorkersIdle()
     {
+        for (size_t i = 0; i < m_workers.size(); i++)
+        {
+            m_workers[i]->WaitIdle();
+        }
+    }
 
-        if (!strncasecmp(cmd.GetCommand().c_str(), "select", 6))
+    void DBWriter::Enqueue(RedisCommandFrame& cmd)
+    {
+        Ardb::RedisCommandHandlerSetting* setting = g_db->FindRedisCommandHandlerSetting(cmd);
+        if (!m_in_transc && is_single_key_write(setting, cmd))
+        {
+            const std::string& key = cmd.GetArguments()[0];
+            uint32 hash = 0;
+            MurmurHash3_x86_32(key.data(), key.size(), 0, &hash);
+            m_workers[hash % m_workers.size()]->Enqueue(cmd);
+            return;
+        }
+        /*
+         * other commands may touch keys owned by several workers, or affect all commands later, so
+         * wait all queued commands executed, then execute it in current thread.
+         */
+        WaitWorkersIdle();
+        RedisCommandType type = NULL != setting ? setting->type : REDIS_CMD_INVALID;
+        if (REDIS_CMD_SELECT == type)
         {
-            /*
-             * wait all commands in queue executed, because 'select' affect all commands later
-             */
-            LockGuard<ThreadMutexLock> guard(m_queue_lock);
-            while(!m_queue.empty())
-            {
-                m_queue_lock.Wait(1);
-            }
             for(size_t i = 0 ; i < m_workers.size(); i++)
             {
-                while(m_workers[i]->writing)
-                {
-                    m_queue_lock.Wait(1);
-                }
                 m_workers[i]->Call(cmd);
             }
             return;
         }
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        while(m_queue.size() >= (size_t)(g_db->GetConf().max_slave_worker_queue))
+        if (REDIS_CMD_MULTI == type)
         {
-            m_queue_lock.Wait(1);
+            /*
+             * commands in transaction are queued in the context of first worker until 'exec'
+             */
+            m_in_transc = true;
         }
-        RedisCommandFrame* new_cmd;
-        NEW(new_cmd, RedisCommandFrame);
-        *new_cmd = cmd;
-        m_queue.push_back(new_cmd);
-        m_queue_lock.Notify();
-    }
-    RedisCommandFrame* DBWriter::Dequeue(int timeout)
-    {
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        if(m_queue.empty())
+        else if (REDIS_CMD_EXEC == type || REDIS_CMD_DISCARD == type)
         {
-            m_queue_lock.Wait(timeout);
+            m_in_transc = false;
         }
-        RedisCommandFrame* cmd = NULL;
-        if(!m_queue.empty())
+        m_workers[0]->Call(cmd);
+    }
+    int64 DBWriter::QueueSize()
+    {
+        int64 size = 0;
+        for (size_t i = 0; i < m_workers.size(); i++)
         {
-            cmd =  m_queue.front();
-            m_queue.pop_front();
+            size += WorkerQueueSize(i);
         }
-        return cmd;
+        return size;
     }
-    int64 DBWriter::QueueSize()
+    int64 DBWriter::WorkerQueueSize(size_t idx)
+    {
+        LockGuard<ThreadMutexLock> guard(m_workers[idx]->queue_lock);
+        return m_workers[idx]->queue.size();
+    }
+    int64 DBWriter::WorkerLag(size_t idx)
     {
-        LockGuard<ThreadMutexLock> guard(m_queue_lock);
-        return m_queue.size();
+        return m_workers[idx]->Lag();
+    }
+    int64 DBWriter::WorkerExecutedCount(size_t idx)
+    {
+        LockGuard<ThreadMutexLock> guard(m_workers[idx]->queue_lock);
+        return m_workers[idx]->executed;
     }
     void DBWriter::SetNamespace(Context& ctx, const std::string& ns)
     {
@@ -250,6 +429,7 @@ OP_NAMESPACE_BEGIN
             DELETE(m_workers[i]);
         }
         m_workers.clear();
+        m_in_transc = false;
     }
 
     DBWriter::~DBWriter()
@@ -257,5 +437,123 @@ OP_NAMESPACE_BEGIN
         Stop();
     }
 
+    static bool compact_entry_less(const std::pair<KeyObject, ValueObject>& e1,
+            const std::pair<KeyObject, ValueObject>& e2)
+    {
+        return e1.first.Compare(e2.first) < 0;
+    }
+    static bool compact_entry_key_less(const std::pair<KeyObject, ValueObject>& e, const KeyObject& key)
+    {
+        return e.first.Compare(key) < 0;
+    }
+
+    CompactIterator::CompactIterator(const KeyObject& key, const ValueObject& meta)
+            : m_cursor(0)
+    {
+        DataArray elements;
+        if (!meta.GetCompactElements(elements))
+        {
+            WARN_LOG("Invalid compact elements in key:%s", key.GetKey().AsString().c_str());
+            elements.clear();
+        }
+        size_t step = meta.GetType() == KEY_SET ? 1 : 2;
+        for (size_t i = 0; i + step <= elements.size(); i += step)
+        {
+            KeyObject ele_key(key.GetNameSpace(), key.GetType(), key.GetKey());
+            ValueObject ele_value;
+            ele_value.SetType(key.GetType());
+            switch (key.GetType())
+            {
+                case KEY_HASH_FIELD:
+                {
+                    ele_key.SetHashField(elements[i]);
+                    ele_value.SetHashValue(elements[i + 1]);
+                    break;
+                }
+                case KEY_SET_MEMBER:
+                {
+                    ele_key.SetSetMember(elements[i]);
+                    break;
+                }
+                case KEY_ZSET_SORT:
+                {
+                    ele_key.SetZSetScore(elements[i + 1].GetFloat64());
+                    ele_key.SetZSetMember(elements[i]);
+                    break;
+                }
+                case KEY_ZSET_SCORE:
+                {
+                    ele_key.SetZSetMember(elements[i]);
+                    ele_value.SetZSetScore(elements[i + 1].GetFloat64());
+                    break;
+                }
+                default:
+                {
+                    continue;
+                }
+            }
+            m_entries.push_back(std::make_pair(ele_key, ele_value));
+        }
+        /*
+         * compact elements are kept sorted by field/member on write, only sort keys are ordered by score first
+         */
+        if (key.GetType() == KEY_ZSET_SORT)
+        {
+            std::sort(m_entries.begin(), m_entries.end(), compact_entry_less);
+        }
+        Jump(key);
+    }
+    bool CompactIterator::Valid()
+    {
+        return m_cursor < m_entries.size();
+    }
+    void CompactIterator::Next()
+    {
+        if (m_cursor < m_entries.size())
+        {
+            m_cursor++;
+        }
+    }
+    void CompactIterator::Prev()
+    {
+        m_cursor = m_cursor > 0 && m_cursor <= m_entries.size() ? m_cursor - 1 : m_entries.size();
+    }
+    void CompactIterator::Jump(const KeyObject& next)
+    {
+        m_cursor = std::lower_bound(m_entries.begin(), m_entries.end(), next, compact_entry_key_less) - m_entries.begin();
+    }
+    void CompactIterator::JumpToFirst()
+    {
+        m_cursor = 0;
+    }
+    void CompactIterator::JumpToLast()
+    {
+        m_cursor = m_entries.empty() ? 0 : m_entries.size() - 1;
+    }
+    KeyObject& CompactIterator::Key(bool clone_str)
+    {
+        return m_entries[m_cursor].first;
+    }
+    Slice CompactIterator::RawKey()
+    {
+        m_raw_key.Clear();
+        return m_entries[m_cursor].first.Encode(m_raw_key, false);
+    }
+    Slice CompactIterator::RawValue()
+    {
+        m_raw_value.Clear();
+        return m_entries[m_cursor].second.Encode(m_raw_value);
+    }
+    ValueObject& CompactIterator::Value(bool clone_str)
+    {
+        return m_entries[m_cursor].second;
+    }
+    void CompactIterator::Del()
+    {
+        /*
+         * elements of compact collection are only removed by rewriting meta value
+         */
+    }
+
 OP_NAMESPACE_END
 
@@ -32,6 +32,7 @@
 
 #include "common/common.hpp"
 #include "codec.hpp"
+#include "engine.hpp"
 #include "context.hpp"
 #include "thread/thread_local.hpp"
 #include "thread/thread_mutex_lock.hpp"
@@ -62,20 +63,48 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     *  An iterator over elements of a compact hash/set/zset, which presents the elements the same as they are
+     *  stored as keys, so that read paths could be shared by both encodings.
+     *  Writers must expand compact collections before deleting elements by iterator.
+     */
+    class CompactIterator: public Iterator
+    {
+        private:
+            typedef std::vector<std::pair<KeyObject, ValueObject> > EntryArray;
+            EntryArray m_entries;
+            size_t m_cursor;
+            Buffer m_raw_key;
+            Buffer m_raw_value;
+        public:
+            CompactIterator(const KeyObject& key, const ValueObject& meta);
+            bool Valid();
+            void Next();
+            void Prev();
+            void Jump(const KeyObject& next);
+            void JumpToFirst();
+            void JumpToLast();
+            KeyObject& Key(bool clone_str);
+            Slice RawKey();
+            Slice RawValue();
+            ValueObject& Value(bool clone_str);
+            void Del();
+    };
+
     /*
      *  A multi thread db writer, which could do db write operations by several threads to increase
      *  write performance.
-     *  It's used in loading snapshot.
+     *  It's used in loading snapshot and executing commands synced from master, commands are dispatched to
+     *  workers by key hash to keep the execution order of same key.
      */
     class DBWriterWorker;
     class DBWriter
     {
         private:
             std::vector<DBWriterWorker*> m_workers;
-            ThreadMutexLock m_queue_lock;
-            std::deque<RedisCommandFrame*> m_queue;
+            bool m_in_transc;
             void Enqueue(RedisCommandFrame& cmd);
-            RedisCommandFrame* Dequeue(int timeout);
+            void WaitWorkersIdle();
             friend class DBWriterWorker;
         public:
             DBWriter();
@@ -87,6 +116,16 @@ OP_NAMESPACE_BEGIN
             void SetDefaulFlags(CallFlags flags);
             void SetMasterClient(Context& ctx);
             int64 QueueSize();
+            size_t WorkerCount() const
+            {
+                return m_workers.size();
+            }
+            int64 WorkerQueueSize(size_t idx);
+            /*
+             * milliseconds since the oldest command not yet executed by the worker was queued
+             */
+            int64 WorkerLag(size_t idx);
+            int64 WorkerExecutedCount(size_t idx);
             void Stop();
             void Clear();
             ~DBWriter();
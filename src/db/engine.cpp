@@ -53,6 +53,13 @@ OP_NAMESPACE_BEGIN
         {
             return ret;
         }
+        if (get_key_encode_format() == KEY_FORMAT_COMPARABLE)
+        {
+            /*
+             * comparable keys are ordered by raw bytes
+             */
+            return Slice(k1, k1_len).compare(Slice(k2, k2_len));
+        }
 
         Buffer kbuf1(const_cast<char*>(k1), 0, k1_len);
         Buffer kbuf2(const_cast<char*>(k2), 0, k2_len);
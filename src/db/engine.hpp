@@ -71,9 +71,10 @@ OP_NAMESPACE_BEGIN
             unsigned support_merge :1;
             unsigned support_backup :1;
             unsigned support_delete_range :1;
+            unsigned support_snapshot_read :1;
             FeatureSet() :
                     support_namespace(0), support_compactfilter(0), support_merge(0), support_backup(0), support_delete_range(
-                            0)
+                            0), support_snapshot_read(0)
             {
             }
     };
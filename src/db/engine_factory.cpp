@@ -75,6 +75,19 @@ Engine* create_engine()
     return engine;
 }
 
+/*
+ * rocksdb/leveldb record the comparator name in data dir and refuse to open it with another comparator,
+ * other engines would silently misorder keys if a comparable data dir is opened by older versions.
+ */
+uint8 engine_default_key_format()
+{
+#if defined __USE_ROCKSDB__ || defined __USE_LEVELDB__
+    return KEY_FORMAT_COMPARABLE;
+#else
+    return KEY_FORMAT_LEGACY;
+#endif
+}
+
 OP_NAMESPACE_END
 
 
@@ -35,6 +35,7 @@
 
 OP_NAMESPACE_BEGIN
     Engine* create_engine();
+    uint8 engine_default_key_format();
 OP_NAMESPACE_END
 
 #endif /* SRC_DB_ENGINE_FACTORY_HPP_ */
@@ -0,0 +1,356 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "expire_index.hpp"
+#include "key_lock_table.hpp"
+#include "util/math_helper.hpp"
+#include "util/time_helper.hpp"
+#include "thread/lock_guard.hpp"
+
+#define EXPIRE_WHEEL_BITS 8
+#define EXPIRE_WHEEL_MASK 255
+
+OP_NAMESPACE_BEGIN
+
+    void ExpireIndex::ExpireList::PushBack(ExpireNode* node)
+    {
+        node->list = this;
+        node->next = NULL;
+        node->prev = tail;
+        if (NULL != tail)
+        {
+            tail->next = node;
+        }
+        else
+        {
+            head = node;
+        }
+        tail = node;
+        size++;
+    }
+
+    void ExpireIndex::ExpireList::PushFront(ExpireNode* node)
+    {
+        node->list = this;
+        node->prev = NULL;
+        node->next = head;
+        if (NULL != head)
+        {
+            head->prev = node;
+        }
+        else
+        {
+            tail = node;
+        }
+        head = node;
+        size++;
+    }
+
+    void ExpireIndex::ExpireList::Remove(ExpireNode* node)
+    {
+        if (NULL != node->prev)
+        {
+            node->prev->next = node->next;
+        }
+        else
+        {
+            head = node->next;
+        }
+        if (NULL != node->next)
+        {
+            node->next->prev = node->prev;
+        }
+        else
+        {
+            tail = node->prev;
+        }
+        node->prev = node->next = NULL;
+        node->list = NULL;
+        size--;
+    }
+
+    ExpireIndex::ExpireShard::~ExpireShard()
+    {
+        ExpireNodeTable::iterator it = nodes.begin();
+        while (it != nodes.end())
+        {
+            delete it->second;
+            it++;
+        }
+    }
+
+    void ExpireIndex::ExpireShard::Schedule(ExpireNode* node)
+    {
+        int64 expire_at = node->expire_at;
+        if (expire_at <= tick)
+        {
+            /*
+             * keep the due list roughly ordered, its head is used to estimate the expire lag
+             */
+            if (NULL == due.tail || due.tail->expire_at <= expire_at)
+            {
+                due.PushBack(node);
+            }
+            else
+            {
+                due.PushFront(node);
+            }
+            return;
+        }
+        uint64 delta = (uint64) (expire_at - tick);
+        for (uint32 level = 0; level < 4; level++)
+        {
+            if (delta < (1ULL << (EXPIRE_WHEEL_BITS * (level + 1))))
+            {
+                wheel[level][(expire_at >> (EXPIRE_WHEEL_BITS * level)) & EXPIRE_WHEEL_MASK].PushBack(node);
+                level_size[level]++;
+                return;
+            }
+        }
+        overflow.PushBack(node);
+    }
+
+    void ExpireIndex::ExpireShard::Unlink(ExpireNode* node)
+    {
+        ExpireList* list = node->list;
+        if (list >= &wheel[0][0] && list < &wheel[0][0] + 4 * 256)
+        {
+            level_size[(list - &wheel[0][0]) / 256]--;
+        }
+        list->Remove(node);
+    }
+
+    void ExpireIndex::ExpireShard::Cascade(ExpireList& list)
+    {
+        if (&list != &overflow)
+        {
+            level_size[(&list - &wheel[0][0]) / 256] -= list.size;
+        }
+        ExpireNode* node = list.head;
+        list.head = list.tail = NULL;
+        list.size = 0;
+        while (NULL != node)
+        {
+            ExpireNode* next = node->next;
+            Schedule(node);
+            node = next;
+        }
+    }
+
+    void ExpireIndex::ExpireShard::Advance(int64 now)
+    {
+        while (tick < now)
+        {
+            if ((size_t) nodes.size() == due.size)
+            {
+                /*
+                 * nothing left in the wheel
+                 */
+                tick = now;
+                break;
+            }
+            /*
+             * nothing happens before the next cascade of the lowest non empty level, skip the ticks between
+             */
+            uint32 empty_bits = 0;
+            while (empty_bits < EXPIRE_WHEEL_BITS * 4 && 0 == level_size[empty_bits / EXPIRE_WHEEL_BITS])
+            {
+                empty_bits += EXPIRE_WHEEL_BITS;
+            }
+            if (empty_bits > 0)
+            {
+                int64 boundary = ((tick >> empty_bits) + 1) << empty_bits;
+                if (boundary > now)
+                {
+                    tick = now;
+                    break;
+                }
+                tick = boundary - 1;
+            }
+            tick++;
+            uint32 index = tick & EXPIRE_WHEEL_MASK;
+            if (0 == index)
+            {
+                uint32 level = 1;
+                for (; level < 4; level++)
+                {
+                    uint32 upper_index = (tick >> (EXPIRE_WHEEL_BITS * level)) & EXPIRE_WHEEL_MASK;
+                    Cascade(wheel[level][upper_index]);
+                    if (0 != upper_index)
+                    {
+                        break;
+                    }
+                }
+                if (4 == level)
+                {
+                    Cascade(overflow);
+                }
+            }
+            ExpireList& slot = wheel[0][index];
+            level_size[0] -= slot.size;
+            while (NULL != slot.head)
+            {
+                ExpireNode* node = slot.head;
+                slot.Remove(node);
+                due.PushBack(node);
+            }
+        }
+    }
+
+    ExpireIndex::ExpireIndex(uint32 shards)
+            : m_shards(NULL), m_shard_mask(0)
+    {
+        shards = upper_power_of_two(shards > 0 ? shards : 1);
+        m_shards = new ExpireShard[shards];
+        m_shard_mask = shards - 1;
+        int64 now = get_current_epoch_millis();
+        for (uint32 i = 0; i < shards; i++)
+        {
+            m_shards[i].tick = now;
+        }
+    }
+
+    ExpireIndex::ExpireShard& ExpireIndex::GetShard(const KeyPrefix& key)
+    {
+        return m_shards[hash_key_prefix(key) & m_shard_mask];
+    }
+
+    void ExpireIndex::Set(const Data& ns, const Data& key, int64 expire_at, bool only_if_absent)
+    {
+        if (expire_at <= 0)
+        {
+            Remove(ns, key);
+            return;
+        }
+        KeyPrefix prefix;
+        prefix.ns = ns;
+        prefix.key = key;
+        ExpireShard& shard = GetShard(prefix);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        ExpireNodeTable::iterator found = shard.nodes.find(prefix);
+        ExpireNode* node = NULL;
+        if (found != shard.nodes.end())
+        {
+            node = found->second;
+            if (only_if_absent || node->expire_at == expire_at)
+            {
+                return;
+            }
+            shard.Unlink(node);
+        }
+        else
+        {
+            node = new ExpireNode;
+            clone_key_prefix(node->key, prefix);
+            shard.nodes.insert(ExpireNodeTable::value_type(node->key, node));
+        }
+        node->expire_at = expire_at;
+        shard.Schedule(node);
+    }
+
+    void ExpireIndex::Remove(const Data& ns, const Data& key)
+    {
+        KeyPrefix prefix;
+        prefix.ns = ns;
+        prefix.key = key;
+        ExpireShard& shard = GetShard(prefix);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        ExpireNodeTable::iterator found = shard.nodes.find(prefix);
+        if (found == shard.nodes.end())
+        {
+            return;
+        }
+        ExpireNode* node = found->second;
+        shard.nodes.erase(found);
+        shard.Unlink(node);
+        delete node;
+    }
+
+    size_t ExpireIndex::PopExpired(uint32 shard_idx, int64 now, size_t max, ExpireKeyArray& keys)
+    {
+        ExpireShard& shard = m_shards[shard_idx & m_shard_mask];
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        shard.Advance(now);
+        size_t count = 0;
+        while (count < max && NULL != shard.due.head)
+        {
+            ExpireNode* node = shard.due.head;
+            shard.due.Remove(node);
+            shard.nodes.erase(node->key);
+            ExpireKey expired;
+            expired.key = node->key;
+            expired.expire_at = node->expire_at;
+            keys.push_back(expired);
+            delete node;
+            count++;
+        }
+        return count;
+    }
+
+    size_t ExpireIndex::Size()
+    {
+        size_t size = 0;
+        for (uint32 i = 0; i <= m_shard_mask; i++)
+        {
+            LockGuard<SpinMutexLock> guard(m_shards[i].lock);
+            size += m_shards[i].nodes.size();
+        }
+        return size;
+    }
+
+    size_t ExpireIndex::PendingSize()
+    {
+        size_t size = 0;
+        for (uint32 i = 0; i <= m_shard_mask; i++)
+        {
+            LockGuard<SpinMutexLock> guard(m_shards[i].lock);
+            size += m_shards[i].due.size;
+        }
+        return size;
+    }
+
+    int64 ExpireIndex::Lag(int64 now)
+    {
+        int64 lag = 0;
+        for (uint32 i = 0; i <= m_shard_mask; i++)
+        {
+            LockGuard<SpinMutexLock> guard(m_shards[i].lock);
+            if (NULL != m_shards[i].due.head && now - m_shards[i].due.head->expire_at > lag)
+            {
+                lag = now - m_shards[i].due.head->expire_at;
+            }
+        }
+        return lag;
+    }
+
+    ExpireIndex::~ExpireIndex()
+    {
+        delete[] m_shards;
+    }
+
+OP_NAMESPACE_END
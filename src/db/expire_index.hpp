@@ -0,0 +1,140 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SRC_DB_EXPIRE_INDEX_HPP_
+#define SRC_DB_EXPIRE_INDEX_HPP_
+#include "common/common.hpp"
+#include "context.hpp"
+#include "thread/spin_mutex_lock.hpp"
+#include <vector>
+#include <string.h>
+
+OP_NAMESPACE_BEGIN
+
+    struct ExpireKey
+    {
+            KeyPrefix key;
+            int64 expire_at;
+            ExpireKey()
+                    : expire_at(0)
+            {
+            }
+    };
+    typedef std::vector<ExpireKey> ExpireKeyArray;
+
+    /*
+     * In memory index of key TTLs(epoch milliseconds) used by the active expire cycle of all engines.
+     * Keys are hashed into shards, each shard is a hierarchical timing wheel with 1ms tick:
+     * 4 levels of 256 slots cover 2^32ms, later TTLs wait in an overflow list until the top level wraps.
+     * Setting a new TTL moves the key's node directly, so the index holds one node per key at most.
+     * The index is only a hint, the expire cycle always checks the key's meta before deleting.
+     */
+    class ExpireIndex
+    {
+        private:
+            struct ExpireList;
+            struct ExpireNode
+            {
+                    KeyPrefix key;
+                    int64 expire_at;
+                    ExpireNode* prev;
+                    ExpireNode* next;
+                    ExpireList* list;
+                    ExpireNode()
+                            : expire_at(0), prev(NULL), next(NULL), list(NULL)
+                    {
+                    }
+            };
+            struct ExpireList
+            {
+                    ExpireNode* head;
+                    ExpireNode* tail;
+                    size_t size;
+                    ExpireList()
+                            : head(NULL), tail(NULL), size(0)
+                    {
+                    }
+                    void PushBack(ExpireNode* node);
+                    void PushFront(ExpireNode* node);
+                    void Remove(ExpireNode* node);
+            };
+            typedef TreeMap<KeyPrefix, ExpireNode*>::Type ExpireNodeTable;
+            struct ExpireShard
+            {
+                    SpinMutexLock lock;
+                    int64 tick;
+                    ExpireList wheel[4][256];
+                    ExpireList overflow;
+                    ExpireList due;
+                    ExpireNodeTable nodes;
+                    size_t level_size[4];
+                    ExpireShard()
+                            : tick(0)
+                    {
+                        memset(level_size, 0, sizeof(level_size));
+                    }
+                    ~ExpireShard();
+                    void Schedule(ExpireNode* node);
+                    void Unlink(ExpireNode* node);
+                    void Cascade(ExpireList& list);
+                    void Advance(int64 now);
+            };
+            ExpireShard* m_shards;
+            uint32 m_shard_mask;
+            ExpireShard& GetShard(const KeyPrefix& key);
+        public:
+            ExpireIndex(uint32 shards = 64);
+            /*
+             * set the key's TTL, a non positive TTL removes the key from index
+             */
+            void Set(const Data& ns, const Data& key, int64 expire_at, bool only_if_absent = false);
+            void Remove(const Data& ns, const Data& key);
+            /*
+             * take at most 'max' keys whose TTL <= now from the shard, they are removed from index
+             */
+            size_t PopExpired(uint32 shard, int64 now, size_t max, ExpireKeyArray& keys);
+            uint32 ShardCount() const
+            {
+                return m_shard_mask + 1;
+            }
+            size_t Size();
+            /*
+             * keys already expired but not popped yet
+             */
+            size_t PendingSize();
+            /*
+             * approximate age of the oldest pending expired key in milliseconds
+             */
+            int64 Lag(int64 now);
+            ~ExpireIndex();
+    };
+
+OP_NAMESPACE_END
+
+#endif /* SRC_DB_EXPIRE_INDEX_HPP_ */
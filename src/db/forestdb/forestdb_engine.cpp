@@ -90,7 +90,7 @@ namespace ardb
             }
             if (meta.GetTTL() > 0 && meta.GetTTL() <= (int64_t)get_current_epoch_millis())
             {
-                if (meta.GetType() != KEY_STRING)
+                if (meta.GetType() != KEY_STRING || meta.IsStringSegmented())
                 {
                     Data ns;
                     ns.SetString(kv_store_name, false);
@@ -0,0 +1,143 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "group_commit.hpp"
+#include "util/time_helper.hpp"
+
+OP_NAMESPACE_BEGIN
+
+    GroupCommitQueue::GroupCommitQueue(GroupCommitHandler* handler)
+            : m_handler(handler), m_leader_active(false), m_max_batch(1), m_max_delay_micros(0)
+    {
+        m_group_count.name = "group_commits";
+        m_write_count.name = "group_commit_batches";
+        m_batch_writes.name = "group_commit_batch_writes";
+        m_batch_writes.dump_flags = STAT_DUMP_INFO_CMD;
+        CostRanges ranges;
+        ranges.push_back(CostRange(1, 1));
+        ranges.push_back(CostRange(2, 4));
+        ranges.push_back(CostRange(5, 16));
+        ranges.push_back(CostRange(17, 64));
+        ranges.push_back(CostRange(65, UINT64_MAX));
+        m_batch_writes.SetCostRanges(ranges);
+        m_batch_bytes.name = "group_commit_batch_bytes";
+        m_batch_bytes.dump_flags = STAT_DUMP_INFO_CMD;
+        ranges.clear();
+        ranges.push_back(CostRange(0, 1024));
+        ranges.push_back(CostRange(1025, 16 * 1024));
+        ranges.push_back(CostRange(16 * 1024 + 1, 256 * 1024));
+        ranges.push_back(CostRange(256 * 1024 + 1, 4 * 1024 * 1024));
+        ranges.push_back(CostRange(4 * 1024 * 1024 + 1, UINT64_MAX));
+        m_batch_bytes.SetCostRanges(ranges);
+        Statistics::GetSingleton().AddTrack(&m_group_count);
+        Statistics::GetSingleton().AddTrack(&m_write_count);
+        Statistics::GetSingleton().AddTrack(&m_batch_writes);
+        Statistics::GetSingleton().AddTrack(&m_batch_bytes);
+    }
+
+    void GroupCommitQueue::SetLimits(uint32 max_batch, uint32 max_delay_micros)
+    {
+        m_lock.Lock();
+        m_max_batch = max_batch > 0 ? max_batch : 1;
+        m_max_delay_micros = max_delay_micros;
+        m_lock.Unlock();
+    }
+
+    void GroupCommitQueue::Record(size_t writes, size_t bytes)
+    {
+        m_group_count.Add(1);
+        m_write_count.Add(writes);
+        m_batch_writes.AddCost(writes);
+        m_batch_bytes.AddCost(bytes);
+    }
+
+    int GroupCommitQueue::Commit(void* batch, size_t bytes)
+    {
+        Writer self(batch, bytes);
+        m_lock.Lock();
+        if (m_max_batch <= 1)
+        {
+            m_lock.Unlock();
+            int err = m_handler->CommitGroup(&batch, 1);
+            Record(1, bytes);
+            return err;
+        }
+        m_writers.push_back(&self);
+        if (m_leader_active && m_writers.size() >= m_max_batch)
+        {
+            /*
+             * a leader waiting for followers could stop waiting now
+             */
+            m_lock.NotifyAll();
+        }
+        while (!self.done && (m_leader_active || m_writers.front() != &self))
+        {
+            m_lock.Wait();
+        }
+        if (self.done)
+        {
+            m_lock.Unlock();
+            return self.err;
+        }
+        m_leader_active = true;
+        if (m_max_delay_micros > 0 && m_writers.size() < m_max_batch)
+        {
+            uint64 deadline = get_current_epoch_micros() + m_max_delay_micros;
+            uint64 now = 0;
+            while (m_writers.size() < m_max_batch && (now = get_current_epoch_micros()) < deadline)
+            {
+                m_lock.Wait(deadline - now, MICROS);
+            }
+        }
+        size_t count = m_writers.size() < m_max_batch ? m_writers.size() : m_max_batch;
+        std::vector<void*> batches(count);
+        size_t total_bytes = 0;
+        for (size_t i = 0; i < count; i++)
+        {
+            batches[i] = m_writers[i]->batch;
+            total_bytes += m_writers[i]->bytes;
+        }
+        m_lock.Unlock();
+
+        int err = m_handler->CommitGroup(&batches[0], count);
+        Record(count, total_bytes);
+
+        m_lock.Lock();
+        for (size_t i = 0; i < count; i++)
+        {
+            m_writers.front()->err = err;
+            m_writers.front()->done = true;
+            m_writers.pop_front();
+        }
+        m_leader_active = false;
+        m_lock.NotifyAll();
+        m_lock.Unlock();
+        return err;
+    }
+
+OP_NAMESPACE_END
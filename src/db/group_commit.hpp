@@ -0,0 +1,96 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SRC_DB_GROUP_COMMIT_HPP_
+#define SRC_DB_GROUP_COMMIT_HPP_
+#include "common/common.hpp"
+#include "statistics.hpp"
+#include "thread/thread_mutex_lock.hpp"
+#include <deque>
+#include <vector>
+
+OP_NAMESPACE_BEGIN
+
+    /*
+     * Engine side of the group commit stage, writes all the given batches as one engine write.
+     */
+    class GroupCommitHandler
+    {
+        public:
+            virtual int CommitGroup(void** batches, size_t count) = 0;
+            virtual ~GroupCommitHandler()
+            {
+            }
+    };
+
+    /*
+     * Leader/follower group commit of write batches from concurrent threads.
+     * The first thread arriving at an idle queue becomes the leader, it waits at most 'max delay' micros
+     * for followers, then commits up to 'max batch' queued batches by one engine write and wakes the
+     * followers with the result. Threads arriving while a leader is writing queue up behind it, and the
+     * next leader is elected among them once the write completes.
+     */
+    class GroupCommitQueue
+    {
+        private:
+            struct Writer
+            {
+                    void* batch;
+                    size_t bytes;
+                    int err;
+                    bool done;
+                    Writer(void* b, size_t size)
+                            : batch(b), bytes(size), err(0), done(false)
+                    {
+                    }
+            };
+            GroupCommitHandler* m_handler;
+            ThreadMutexLock m_lock;
+            std::deque<Writer*> m_writers;
+            bool m_leader_active;
+            uint32 m_max_batch;
+            uint32 m_max_delay_micros;
+
+            CountTrack m_group_count;
+            CountTrack m_write_count;
+            CostTrack m_batch_writes;
+            CostTrack m_batch_bytes;
+            void Record(size_t writes, size_t bytes);
+        public:
+            GroupCommitQueue(GroupCommitHandler* handler);
+            /*
+             * max_batch <= 1 disables grouping, every batch is committed by its own thread
+             */
+            void SetLimits(uint32 max_batch, uint32 max_delay_micros);
+            int Commit(void* batch, size_t bytes);
+    };
+
+OP_NAMESPACE_END
+
+#endif /* SRC_DB_GROUP_COMMIT_HPP_ */
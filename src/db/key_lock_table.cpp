@@ -0,0 +1,255 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "key_lock_table.hpp"
+#include "util/murmur3.h"
+#include "util/math_helper.hpp"
+#include "util/time_helper.hpp"
+
+OP_NAMESPACE_BEGIN
+
+    static uint32 hash_key_part(const Data& data, uint32 seed)
+    {
+        uint32 hash = seed;
+        if (data.IsNil())
+        {
+            return hash;
+        }
+        if (data.IsString())
+        {
+            MurmurHash3_x86_32(data.CStr(), data.StringLength(), seed, &hash);
+        }
+        else
+        {
+            std::string str = data.AsString();
+            MurmurHash3_x86_32(str.data(), str.size(), seed, &hash);
+        }
+        return hash;
+    }
+
+    static void clone_key_part(Data& dst, const Data& src)
+    {
+        if (src.IsCStr())
+        {
+            dst.SetString(src.CStr(), src.StringLength(), true);
+        }
+        else
+        {
+            dst = src;
+        }
+    }
+
+    uint32 hash_key_prefix(const KeyPrefix& key)
+    {
+        return hash_key_part(key.key, hash_key_part(key.ns, 0));
+    }
+
+    void clone_key_prefix(KeyPrefix& dst, const KeyPrefix& src)
+    {
+        clone_key_part(dst.ns, src.ns);
+        clone_key_part(dst.key, src.key);
+    }
+
+    KeyLockTable::LockShard::~LockShard()
+    {
+        LockEntryTable::iterator it = entries.begin();
+        while (it != entries.end())
+        {
+            delete it->second;
+            it++;
+        }
+        for (size_t i = 0; i < pool.size(); i++)
+        {
+            delete pool[i];
+        }
+    }
+
+    KeyLockTable::KeyLockTable(uint32 shards)
+            : m_shards(NULL), m_shard_mask(0)
+    {
+        shards = upper_power_of_two(shards > 0 ? shards : 1);
+        m_shards = new LockShard[shards];
+        m_shard_mask = shards - 1;
+
+        m_wait_count.name = "key_lock_waits";
+        m_wait_micros.name = "key_lock_wait_micros";
+        m_wait_cost.name = "key_lock_wait";
+        m_wait_cost.dump_flags = STAT_DUMP_INFO_CMD;
+        CostRanges ranges;
+        ranges.push_back(CostRange(0, 100));
+        ranges.push_back(CostRange(101, 1000));
+        ranges.push_back(CostRange(1001, 10000));
+        ranges.push_back(CostRange(10001, 100000));
+        ranges.push_back(CostRange(100001, UINT64_MAX));
+        m_wait_cost.SetCostRanges(ranges);
+        Statistics::GetSingleton().AddTrack(&m_wait_count);
+        Statistics::GetSingleton().AddTrack(&m_wait_micros);
+        Statistics::GetSingleton().AddTrack(&m_wait_cost);
+    }
+
+    KeyLockTable::LockShard& KeyLockTable::GetShard(const KeyPrefix& key)
+    {
+        return m_shards[hash_key_prefix(key) & m_shard_mask];
+    }
+
+    void KeyLockTable::Lock(const KeyPrefix& key, bool shared)
+    {
+        LockShard& shard = GetShard(key);
+        shard.mutex.Lock();
+        LockEntryTable::iterator found = shard.entries.find(key);
+        if (found == shard.entries.end())
+        {
+            LockEntry* created = NULL;
+            if (!shard.pool.empty())
+            {
+                created = shard.pool.back();
+                shard.pool.pop_back();
+            }
+            else
+            {
+                created = new LockEntry;
+            }
+            KeyPrefix owned;
+            clone_key_prefix(owned, key);
+            found = shard.entries.insert(LockEntryTable::value_type(owned, created)).first;
+        }
+        LockEntry* entry = found->second;
+        bool available = shared ? (!entry->locked && 0 == entry->write_waiters) : (!entry->locked && 0 == entry->readers);
+        if (available)
+        {
+            if (shared)
+            {
+                entry->readers++;
+            }
+            else
+            {
+                entry->locked = true;
+            }
+            shard.mutex.Unlock();
+            return;
+        }
+        /*
+         * the entry is kept in table while there are waiters, so the pointer is stable while sleeping
+         */
+        uint64 start = get_current_epoch_micros();
+        if (shared)
+        {
+            entry->read_waiters++;
+            while (entry->locked || entry->write_waiters > 0)
+            {
+                pthread_cond_wait(&entry->read_cond.GetRawCondition(), &shard.mutex.GetRawMutex());
+            }
+            entry->read_waiters--;
+            entry->readers++;
+        }
+        else
+        {
+            entry->write_waiters++;
+            while (entry->locked || entry->readers > 0)
+            {
+                pthread_cond_wait(&entry->write_cond.GetRawCondition(), &shard.mutex.GetRawMutex());
+            }
+            entry->write_waiters--;
+            entry->locked = true;
+        }
+        shard.mutex.Unlock();
+
+        uint64 cost = get_current_epoch_micros() - start;
+        m_wait_count.Add(1);
+        m_wait_micros.Add(cost);
+        m_wait_cost.AddCost(cost);
+    }
+
+    void KeyLockTable::Unlock(const KeyPrefix& key, bool shared)
+    {
+        LockShard& shard = GetShard(key);
+        shard.mutex.Lock();
+        LockEntryTable::iterator found = shard.entries.find(key);
+        if (found != shard.entries.end())
+        {
+            LockEntry* entry = found->second;
+            if (shared)
+            {
+                if (entry->readers > 0)
+                {
+                    entry->readers--;
+                }
+            }
+            else
+            {
+                entry->locked = false;
+            }
+            if (!entry->locked && 0 == entry->readers)
+            {
+                /*
+                 * a waiting writer goes first, otherwise all waiting readers are released together
+                 */
+                if (entry->write_waiters > 0)
+                {
+                    pthread_cond_signal(&entry->write_cond.GetRawCondition());
+                }
+                else if (entry->read_waiters > 0)
+                {
+                    pthread_cond_broadcast(&entry->read_cond.GetRawCondition());
+                }
+            }
+            if (entry->Idle())
+            {
+                shard.entries.erase(found);
+                shard.pool.push_back(entry);
+            }
+        }
+        shard.mutex.Unlock();
+    }
+
+    void KeyLockTable::Lock(const KeyPrefixSet& keys, bool shared)
+    {
+        KeyPrefixSet::const_iterator it = keys.begin();
+        while (it != keys.end())
+        {
+            Lock(*it, shared);
+            it++;
+        }
+    }
+
+    void KeyLockTable::Unlock(const KeyPrefixSet& keys, bool shared)
+    {
+        KeyPrefixSet::const_iterator it = keys.begin();
+        while (it != keys.end())
+        {
+            Unlock(*it, shared);
+            it++;
+        }
+    }
+
+    KeyLockTable::~KeyLockTable()
+    {
+        delete[] m_shards;
+    }
+
+OP_NAMESPACE_END
@@ -0,0 +1,106 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef SRC_DB_KEY_LOCK_TABLE_HPP_
+#define SRC_DB_KEY_LOCK_TABLE_HPP_
+#include "common/common.hpp"
+#include "context.hpp"
+#include "statistics.hpp"
+#include "thread/thread_mutex.hpp"
+#include "thread/thread_condition.hpp"
+#include <vector>
+
+OP_NAMESPACE_BEGIN
+
+    uint32 hash_key_prefix(const KeyPrefix& key);
+    /*
+     * deep copy of a key whose string parts may only point to a caller's buffer, tables keeping keys beyond
+     * the caller's scope must own their bytes
+     */
+    void clone_key_prefix(KeyPrefix& dst, const KeyPrefix& src);
+
+    /*
+     * Per key lock table, keys are hashed into shards so that threads locking different keys
+     * rarely touch the same mutex. A thread waiting for a locked key sleeps on the key's own
+     * condition and is woken directly by the unlocking thread.
+     * A key is locked either exclusive by one writer or shared by many readers, waiting writers
+     * block new readers so that a hot key can not starve its writers.
+     */
+    class KeyLockTable
+    {
+        private:
+            struct LockEntry
+            {
+                    ThreadCondition read_cond;
+                    ThreadCondition write_cond;
+                    uint32 readers;
+                    uint32 read_waiters;
+                    uint32 write_waiters;
+                    bool locked;
+                    LockEntry()
+                            : readers(0), read_waiters(0), write_waiters(0), locked(false)
+                    {
+                    }
+                    bool Idle() const
+                    {
+                        return !locked && 0 == readers && 0 == read_waiters && 0 == write_waiters;
+                    }
+            };
+            typedef TreeMap<KeyPrefix, LockEntry*>::Type LockEntryTable;
+            struct LockShard
+            {
+                    ThreadMutex mutex;
+                    LockEntryTable entries;
+                    std::vector<LockEntry*> pool;
+                    char padding[64];
+                    ~LockShard();
+            };
+            LockShard* m_shards;
+            uint32 m_shard_mask;
+
+            CountTrack m_wait_count;
+            CountTrack m_wait_micros;
+            CostTrack m_wait_cost;
+
+            LockShard& GetShard(const KeyPrefix& key);
+        public:
+            KeyLockTable(uint32 shards = 256);
+            void Lock(const KeyPrefix& key, bool shared = false);
+            void Unlock(const KeyPrefix& key, bool shared = false);
+            /*
+             * lock keys one by one in the set's order, every multi keys locker uses the same order so they never deadlock
+             */
+            void Lock(const KeyPrefixSet& keys, bool shared = false);
+            void Unlock(const KeyPrefixSet& keys, bool shared = false);
+            ~KeyLockTable();
+    };
+
+OP_NAMESPACE_END
+
+#endif /* SRC_DB_KEY_LOCK_TABLE_HPP_ */
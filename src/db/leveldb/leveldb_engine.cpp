@@ -260,7 +260,14 @@ namespace ardb
 
         static LevelDBComparator comparator;
         m_options.create_if_missing = true;
-        m_options.comparator = &comparator;
+        if (get_key_encode_format() == KEY_FORMAT_COMPARABLE)
+        {
+            m_options.comparator = leveldb::BytewiseComparator();
+        }
+        else
+        {
+            m_options.comparator = &comparator;
+        }
         if (m_cfg.block_cache_size > 0)
         {
             leveldb::Cache* cache = leveldb::NewLRUCache(m_cfg.block_cache_size);
@@ -364,7 +371,14 @@ namespace ardb
     {
         static LevelDBComparator comparator;
         static LevelDBLogger logger;
-        m_options.comparator = &comparator;
+        if (get_key_encode_format() == KEY_FORMAT_COMPARABLE)
+        {
+            m_options.comparator = leveldb::BytewiseComparator();
+        }
+        else
+        {
+            m_options.comparator = &comparator;
+        }
         m_options.info_log = &logger;
         leveldb::Status status = leveldb::RepairDB(dir, m_options);
         return status.ok() ? 0 : -1;
@@ -391,7 +405,9 @@ namespace ardb
         LevelDBLocalContext& local_ctx = g_local_ctx.GetValue();
         leveldb::WriteOptions opt;
         Buffer& encode_buffer = local_ctx.GetEncodeBufferCache();
-        ns.Encode(encode_buffer);
+        KeyObject ns_key;
+        ns_key.SetNameSpace(ns);
+        ns_key.EncodeNS(encode_buffer);
         encode_buffer.Write(key.data(), key.size());
         leveldb::Slice key_slice(encode_buffer.GetRawReadBuffer(), encode_buffer.ReadableBytes());
         leveldb::Slice value_slice(value.data(), value.size());
@@ -848,7 +864,9 @@ namespace ardb
          * trim namespace header
          */
         Buffer buf((char*) s.data(), 0, s.size());
-        ns.Decode(buf, false);
+        KeyObject ns_key;
+        ns_key.DecodeNS(buf, false);
+        ns = ns_key.GetNameSpace();
         return Slice(buf.GetRawReadBuffer(), buf.ReadableBytes());
     }
     Slice LevelDBIterator::RawKey()
@@ -59,6 +59,7 @@
 #define LMDB_CKP_OP 3
 
 #define LMDB_META_NAMESPACE "__LMDB_META__"
+#define LMDB_KEY_FORMAT_KEY "key_format"
 
 namespace ardb
 {
@@ -350,7 +351,10 @@ namespace ardb
             recreate_local_txn = true;
         }
         CHECK_RET(mdb_open(txn, ns.AsString().c_str(), create_if_noexist ? MDB_CREATE : 0, &dbi), false);
-        mdb_set_compare(txn, dbi, LMDBCompareFunc);
+        if (get_key_encode_format() != KEY_FORMAT_COMPARABLE)
+        {
+            mdb_set_compare(txn, dbi, LMDBCompareFunc);
+        }
 
         std::string ns_key = "ns:" + ns.AsString();
         std::string ns_val = ns.AsString();
@@ -438,6 +442,7 @@ namespace ardb
             ERROR_LOG("Failed to create meta cursor for reason:%s", mdb_strerror(rc));
             return -1;
         }
+        bool has_ns = false;
         do
         {
             MDB_val key, val;
@@ -448,6 +453,7 @@ namespace ardb
                 //printf("####%s\n", ns_key.c_str());
                 if (has_prefix(ns_key, "ns:"))
                 {
+                    has_ns = true;
                     Data ns;
                     ns.SetString((const char*) val.mv_data, val.mv_size, true);
                     MDB_dbi tmp;
@@ -470,6 +476,48 @@ namespace ardb
             }
         }
         while (rc == 0);
+        /*
+         * lmdb does not record the key comparator, the key format is saved in meta db and checked on every open
+         * so that a copied/restored data file could never be read with a different key order.
+         */
+        MDB_val format_key, format_val;
+        format_key.mv_data = (void *) LMDB_KEY_FORMAT_KEY;
+        format_key.mv_size = strlen(LMDB_KEY_FORMAT_KEY);
+        uint8 format = KEY_FORMAT_LEGACY;
+        rc = mdb_get(local_ctx.txn, m_meta_dbi, &format_key, &format_val);
+        if (0 == rc)
+        {
+            std::string format_name((const char*) format_val.mv_data, format_val.mv_size);
+            if (!parse_key_encode_format(format_name, format))
+            {
+                ERROR_LOG("Invalid key format:%s in lmdb at %s", format_name.c_str(), m_dbdir.c_str());
+                mdb_txn_abort(local_ctx.txn);
+                local_ctx.txn = NULL;
+                return -1;
+            }
+        }
+        else if (!has_ns)
+        {
+            /*
+             * new created lmdb, data written by older versions without the record is always in legacy format
+             */
+            format = get_key_encode_format();
+        }
+        if (format != get_key_encode_format())
+        {
+            ERROR_LOG("Key format of lmdb at %s is %s, but %s is expected.", m_dbdir.c_str(), key_encode_format_name(format),
+                    key_encode_format_name(get_key_encode_format()));
+            mdb_txn_abort(local_ctx.txn);
+            local_ctx.txn = NULL;
+            return -1;
+        }
+        if (0 != rc)
+        {
+            std::string format_name = key_encode_format_name(format);
+            format_val.mv_data = (void *) format_name.data();
+            format_val.mv_size = format_name.size();
+            CHECK_RET(mdb_put(local_ctx.txn, m_meta_dbi, &format_key, &format_val, 0), -1);
+        }
         mdb_txn_commit(local_ctx.txn);
         local_ctx.txn = NULL;
         INFO_LOG("Success to open lmdb at %s", m_dbdir.c_str());
@@ -604,8 +604,71 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * replays records of write batches into one group batch through the public WriteBatch API
+     */
+    class RocksDBGroupBatch: public rocksdb::WriteBatch::Handler
+    {
+        private:
+            typedef std::shared_ptr<rocksdb::ColumnFamilyHandle> ColumnFamilyHandlePtr;
+            typedef TreeMap<uint32_t, ColumnFamilyHandlePtr>::Type ColumnFamilyHandleIDTable;
+            RocksDBEngine* m_engine;
+            ColumnFamilyHandleIDTable m_handlers;
+            rocksdb::ColumnFamilyHandle* GetHandle(uint32_t id)
+            {
+                ColumnFamilyHandleIDTable::iterator found = m_handlers.find(id);
+                if (found != m_handlers.end())
+                {
+                    return found->second.get();
+                }
+                ColumnFamilyHandlePtr handle = m_engine->GetColumnFamilyHandleById(id);
+                m_handlers[id] = handle;
+                if (NULL == handle.get() && 0 == id)
+                {
+                    return m_engine->m_db->DefaultColumnFamily();
+                }
+                return handle.get();
+            }
+        public:
+            rocksdb::WriteBatch batch;
+            RocksDBGroupBatch(RocksDBEngine* engine)
+                    : m_engine(engine)
+            {
+            }
+            rocksdb::Status PutCF(uint32_t id, const rocksdb::Slice& key, const rocksdb::Slice& value) override
+            {
+                rocksdb::ColumnFamilyHandle* cf = GetHandle(id);
+                return NULL == cf ? rocksdb::Status::InvalidArgument("column family dropped") : batch.Put(cf, key, value);
+            }
+            rocksdb::Status DeleteCF(uint32_t id, const rocksdb::Slice& key) override
+            {
+                rocksdb::ColumnFamilyHandle* cf = GetHandle(id);
+                return NULL == cf ? rocksdb::Status::InvalidArgument("column family dropped") : batch.Delete(cf, key);
+            }
+            rocksdb::Status SingleDeleteCF(uint32_t id, const rocksdb::Slice& key) override
+            {
+                rocksdb::ColumnFamilyHandle* cf = GetHandle(id);
+                return NULL == cf ? rocksdb::Status::InvalidArgument("column family dropped") : batch.SingleDelete(cf, key);
+            }
+            rocksdb::Status DeleteRangeCF(uint32_t id, const rocksdb::Slice& begin, const rocksdb::Slice& end) override
+            {
+                rocksdb::ColumnFamilyHandle* cf = GetHandle(id);
+                return NULL == cf ?
+                        rocksdb::Status::InvalidArgument("column family dropped") : batch.DeleteRange(cf, begin, end);
+            }
+            rocksdb::Status MergeCF(uint32_t id, const rocksdb::Slice& key, const rocksdb::Slice& value) override
+            {
+                rocksdb::ColumnFamilyHandle* cf = GetHandle(id);
+                return NULL == cf ? rocksdb::Status::InvalidArgument("column family dropped") : batch.Merge(cf, key, value);
+            }
+            void LogData(const rocksdb::Slice& blob) override
+            {
+                batch.PutLogData(blob);
+            }
+    };
+
     RocksDBEngine::RocksDBEngine()
-            : m_db(NULL), m_bulk_loading(false), disablewal(false)
+            : m_db(NULL), m_bulk_loading(false), disablewal(false), syncwal(false), m_group_commit(this)
     {
     }
 
@@ -743,7 +806,14 @@ OP_NAMESPACE_BEGIN
         //g_iter_cache.Init();
 
         static RocksDBComparator comparator;
-        m_options.comparator = &comparator;
+        if (get_key_encode_format() == KEY_FORMAT_COMPARABLE)
+        {
+            m_options.comparator = rocksdb::BytewiseComparator();
+        }
+        else
+        {
+            m_options.comparator = &comparator;
+        }
         m_options.merge_operator.reset(new MergeOperator);
         m_options.prefix_extractor.reset(new RocksDBPrefixExtractor);
         m_options.compaction_filter_factory.reset(new RocksDBCompactionFilterFactory(this));
@@ -778,6 +848,9 @@ OP_NAMESPACE_BEGIN
         {
             disablewal = true;
         }
+        syncwal = g_db->GetConf().rocksdb_syncwal;
+        m_group_commit.SetLimits((uint32) g_db->GetConf().group_commit_max_batch,
+                (uint32) g_db->GetConf().group_commit_max_delay_micros);
 
         m_options.IncreaseParallelism();
         m_options.stats_dump_period_sec = (unsigned int) g_db->GetConf().statistics_log_period;
@@ -794,7 +867,14 @@ OP_NAMESPACE_BEGIN
     int RocksDBEngine::Repair(const std::string& dir)
     {
         static RocksDBComparator comparator;
-        m_options.comparator = &comparator;
+        if (get_key_encode_format() == KEY_FORMAT_COMPARABLE)
+        {
+            m_options.comparator = rocksdb::BytewiseComparator();
+        }
+        else
+        {
+            m_options.comparator = &comparator;
+        }
         m_options.merge_operator.reset(new MergeOperator);
         m_options.prefix_extractor.reset(new RocksDBPrefixExtractor);
         m_options.compaction_filter_factory.reset(new RocksDBCompactionFilterFactory(this));
@@ -803,6 +883,21 @@ OP_NAMESPACE_BEGIN
         return rocksdb_err(rocksdb::RepairDB(dir, m_options));
     }
 
+    RocksDBEngine::ColumnFamilyHandlePtr RocksDBEngine::GetColumnFamilyHandleById(uint32 id)
+    {
+        RWLockGuard<SpinRWLock> guard(m_lock, true);
+        ColumnFamilyHandleTable::iterator it = m_handlers.begin();
+        while (it != m_handlers.end())
+        {
+            if (it->second->GetID() == id)
+            {
+                return it->second;
+            }
+            it++;
+        }
+        return NULL;
+    }
+
     Data RocksDBEngine::GetNamespaceByColumnFamilyId(uint32 id)
     {
         Data ns;
@@ -915,6 +1010,7 @@ OP_NAMESPACE_BEGIN
 
         rocksdb::ReadOptions opt;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         std::vector<rocksdb::Status> ss = m_db->MultiGet(opt, cfs, ks, &vs);
 
         for (size_t i = 0; i < ss.size(); i++)
@@ -939,6 +1035,7 @@ OP_NAMESPACE_BEGIN
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
         rocksdb::ReadOptions opt;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         std::string& valstr = rocks_ctx.GetStringCache();
         Buffer& key_encode_buffer = rocks_ctx.GetEncodeBuferCache();
         rocksdb::Slice key_slice = to_rocksdb_slice(key.Encode(key_encode_buffer));
@@ -1067,6 +1164,7 @@ OP_NAMESPACE_BEGIN
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
         rocksdb::ReadOptions opt;
         opt.fill_cache = g_db->GetConf().rocksdb_read_fill_cache;
+        opt.snapshot = (const rocksdb::Snapshot*) ctx.engine_snapshot;
         Buffer& key_encode_buffer = rocks_ctx.GetEncodeBuferCache();
         std::string& tmp = rocks_ctx.GetStringCache();
         rocksdb::Slice k = to_rocksdb_slice(key.Encode(key_encode_buffer));
@@ -1168,17 +1266,53 @@ OP_NAMESPACE_BEGIN
     int RocksDBEngine::CommitWriteBatch(Context& ctx)
     {
         RocksDBLocalContext& rocks_ctx = g_rocks_context.GetValue();
+        int err = 0;
         if (rocks_ctx.transc.ReleaseRef(false) == 0)
         {
-            rocksdb::WriteOptions opt;
-            if (disablewal || ctx.flags.bulk_loading)
+            rocksdb::WriteBatch& batch = rocks_ctx.transc.GetBatch();
+            if (batch.Count() > 0)
             {
-                opt.disableWAL = true;
+                if (ctx.flags.bulk_loading && !disablewal)
+                {
+                    /*
+                     * bulk loading batches skip the WAL, they could not share a write with other batches
+                     */
+                    rocksdb::WriteOptions opt;
+                    opt.disableWAL = true;
+                    err = rocksdb_err(m_db->Write(opt, &batch));
+                }
+                else
+                {
+                    err = m_group_commit.Commit(&batch, batch.GetDataSize());
+                }
             }
-            m_db->Write(opt, &rocks_ctx.transc.GetBatch());
             rocks_ctx.transc.Clear();
         }
-        return 0;
+        return err;
+    }
+    int RocksDBEngine::CommitGroup(void** batches, size_t count)
+    {
+        rocksdb::WriteOptions opt;
+        opt.disableWAL = disablewal;
+        opt.sync = syncwal && !disablewal;
+        rocksdb::Status s;
+        if (1 == count)
+        {
+            s = m_db->Write(opt, (rocksdb::WriteBatch*) batches[0]);
+        }
+        else
+        {
+            RocksDBGroupBatch group(this);
+            for (size_t i = 0; i < count && s.ok(); i++)
+            {
+                s = ((rocksdb::WriteBatch*) batches[i])->Iterate(&group);
+            }
+            if (s.ok())
+            {
+                s = m_db->Write(opt, &group.batch);
+            }
+        }
+        return rocksdb_err(s);
     }
     int RocksDBEngine::DiscardWriteBatch(Context& ctx)
     {
@@ -1308,6 +1442,7 @@ OP_NAMESPACE_BEGIN
         features.support_merge = 1;
         features.support_backup = 1;
         features.support_delete_range = 1;
+        features.support_snapshot_read = 1;
         return features;
     }
 
@@ -43,6 +43,7 @@
 #include "rocksdb/merge_operator.h"
 #include "rocksdb/utilities/backupable_db.h"
 #include "db/engine.hpp"
+#include "db/group_commit.hpp"
 #include <vector>
 #include <sparsehash/dense_hash_map>
 #include <memory>
@@ -94,7 +95,8 @@ OP_NAMESPACE_BEGIN
     };
 
     class RocksDBCompactionFilter;
-    class RocksDBEngine: public Engine
+    class RocksDBGroupBatch;
+    class RocksDBEngine: public Engine, public GroupCommitHandler
     {
         private:
             typedef std::shared_ptr<rocksdb::ColumnFamilyHandle> ColumnFamilyHandlePtr;
@@ -109,14 +111,18 @@ OP_NAMESPACE_BEGIN
             ThreadMutex m_backup_lock;
             bool m_bulk_loading;
             bool disablewal;
+            bool syncwal;
+            GroupCommitQueue m_group_commit;
 
             ColumnFamilyHandlePtr GetColumnFamilyHandle(Context& ctx, const Data& name, bool create_if_noexist);
 
+            ColumnFamilyHandlePtr GetColumnFamilyHandleById(uint32 id);
             Data GetNamespaceByColumnFamilyId(uint32 id);
             int ReOpen(rocksdb::Options& options);
             void Close();
             friend class RocksDBIterator;
             friend class RocksDBCompactionFilter;
+            friend class RocksDBGroupBatch;
             int DelKeySlice(rocksdb::WriteBatch* batch, rocksdb::ColumnFamilyHandle* cf, const rocksdb::Slice& key);
         public:
             RocksDBEngine();
@@ -135,6 +141,7 @@ OP_NAMESPACE_BEGIN
             int BeginWriteBatch(Context& ctx);
             int CommitWriteBatch(Context& ctx);
             int DiscardWriteBatch(Context& ctx);
+            int CommitGroup(void** batches, size_t count);
             int Compact(Context& ctx, const KeyObject& start, const KeyObject& end);
             int ListNameSpaces(Context& ctx, DataArray& nss);
             int DropNameSpace(Context& ctx, const Data& ns);
@@ -30,10 +30,16 @@
 #include "logger.hpp"
 #include "util/helpers.hpp"
 #include "thread/thread_mutex.hpp"
+#include "thread/thread_mutex_lock.hpp"
+#include "thread/thread_local.hpp"
+#include "thread/thread.hpp"
 #include "thread/lock_guard.hpp"
+#include "util/atomic.hpp"
 #include <stdarg.h>
 #include <stdio.h>
 #include <sstream>
+#include <vector>
+#include <algorithm>
 namespace ardb
 {
     static ArdbLogHandler* kLogHandler = 0;
@@ -51,6 +57,92 @@ namespace ardb
 
     static ThreadMutex kLogMutex;
 
+    /*
+     * async mode: every thread appends [header][line] records into its own single producer/single consumer
+     * ring, the flusher thread drains all rings under 'kLogMutex', orders the lines by time and writes them
+     * with one fflush.
+     */
+    struct LogRecordHeader
+    {
+            uint32 len;
+            uint32 reserved;
+            uint64 timestamp;
+    };
+    struct LogRing
+    {
+            char* buf;
+            uint32 size;
+            /*
+             * 'head' is only written by the producer and 'tail' only by the flusher, each side publishes its
+             * position by a release store and reads the other one by an acquire load
+             */
+            uint64_t head;
+            uint64_t tail;
+            bool closed;
+            LogRing(uint32 n) :
+                            buf(new char[n]), size(n), head(0), tail(0), closed(false)
+            {
+            }
+            void Write(uint64 pos, const char* data, uint32 len)
+            {
+                uint32 offset = pos & (size - 1);
+                uint32 first = std::min(len, size - offset);
+                memcpy(buf + offset, data, first);
+                memcpy(buf, data + first, len - first);
+            }
+            void Read(uint64 pos, char* data, uint32 len)
+            {
+                uint32 offset = pos & (size - 1);
+                uint32 first = std::min(len, size - offset);
+                memcpy(data, buf + offset, first);
+                memcpy(data + first, buf, len - first);
+            }
+            ~LogRing()
+            {
+                delete[] buf;
+            }
+    };
+    struct LogRingHolder
+    {
+            LogRing* ring;
+            LogRingHolder() :
+                            ring(NULL)
+            {
+            }
+            ~LogRingHolder()
+            {
+                /*
+                 * thread exits, the flusher deletes the ring once drained
+                 */
+                if (NULL != ring)
+                {
+                    __atomic_store_n(&ring->closed, true, __ATOMIC_RELEASE);
+                }
+            }
+    };
+    struct LogBatchEntry
+    {
+            uint64 timestamp;
+            size_t offset;
+            uint32 len;
+            bool operator<(const LogBatchEntry& other) const
+            {
+                return timestamp < other.timestamp;
+            }
+    };
+    typedef std::vector<LogRing*> LogRingArray;
+    static ThreadLocal<LogRingHolder> kLogRingHolder;
+    static ThreadMutex kLogRingsMutex;
+    static LogRingArray kLogRings;
+    static volatile bool kLogAsync = false;
+    static uint32 kLogRingSize = 0;
+    static bool kLogBlockWhenFull = false;
+    static volatile uint64_t kLogDroppedLines = 0;
+    static ThreadMutexLock kLogFlusherLock;
+    static Thread* kLogFlusher = NULL;
+    static volatile bool kLogFlusherRunning = false;
+    static const uint32 k_log_flush_period_ms = 10;
+
     static void reopen_default_logfile()
     {
         if (!kLogFilePath.empty())
@@ -97,6 +189,156 @@ namespace ardb
         rename(kLogFilePath.c_str(), path.c_str());
     }
 
+    /*
+     * must be called with 'kLogMutex' locked
+     */
+    static void flush_default_logfile()
+    {
+        fflush(kLogFile);
+        if (!kLogFilePath.empty() && kLogFile != stdout)
+        {
+            long file_size = ftell(kLogFile);
+            if (file_size < 0)
+            {
+                reopen_default_logfile();
+            }
+            else if ((uint32) file_size >= k_max_file_size)
+            {
+                rollover_default_logfile();
+                reopen_default_logfile();
+            }
+        }
+    }
+
+    /*
+     * must be called with 'kLogMutex' locked, returns the number of written lines
+     */
+    static size_t drain_log_rings()
+    {
+        LogRingArray rings;
+        {
+            LockGuard<ThreadMutex> guard(kLogRingsMutex);
+            rings = kLogRings;
+        }
+        static std::string batch;
+        static std::vector<LogBatchEntry> entries;
+        batch.clear();
+        entries.clear();
+        for (size_t i = 0; i < rings.size(); i++)
+        {
+            LogRing* ring = rings[i];
+            bool closed = __atomic_load_n(&ring->closed, __ATOMIC_ACQUIRE);
+            uint64 head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+            uint64 pos = ring->tail;
+            while (pos < head)
+            {
+                LogRecordHeader header;
+                ring->Read(pos, (char*) &header, sizeof(header));
+                LogBatchEntry entry;
+                entry.timestamp = header.timestamp;
+                entry.offset = batch.size();
+                entry.len = header.len;
+                batch.resize(entry.offset + header.len);
+                ring->Read(pos + sizeof(header), &batch[entry.offset], header.len);
+                entries.push_back(entry);
+                pos += sizeof(header) + header.len;
+            }
+            if (pos > ring->tail)
+            {
+                __atomic_store_n(&ring->tail, pos, __ATOMIC_RELEASE);
+            }
+            if (closed)
+            {
+                LockGuard<ThreadMutex> guard(kLogRingsMutex);
+                kLogRings.erase(std::find(kLogRings.begin(), kLogRings.end(), ring));
+                delete ring;
+            }
+        }
+        if (entries.empty())
+        {
+            return 0;
+        }
+        /*
+         * lines of one ring are in order already, stable sort keeps them
+         */
+        std::stable_sort(entries.begin(), entries.end());
+        for (size_t i = 0; i < entries.size(); i++)
+        {
+            fwrite(batch.data() + entries[i].offset, 1, entries[i].len, kLogFile);
+        }
+        flush_default_logfile();
+        if (batch.capacity() > 4 * kLogRingSize)
+        {
+            std::string().swap(batch);
+        }
+        return entries.size();
+    }
+
+    static void wakeup_log_flusher()
+    {
+        kLogFlusherLock.Lock();
+        kLogFlusherLock.Notify();
+        kLogFlusherLock.Unlock();
+    }
+
+    static void push_log_line(uint64 timestamp, const std::string& line)
+    {
+        LogRingHolder& holder = kLogRingHolder.GetValue();
+        if (NULL == holder.ring)
+        {
+            holder.ring = new LogRing(kLogRingSize);
+            LockGuard<ThreadMutex> guard(kLogRingsMutex);
+            kLogRings.push_back(holder.ring);
+        }
+        LogRing* ring = holder.ring;
+        LogRecordHeader header;
+        header.len = line.size();
+        header.reserved = 0;
+        header.timestamp = timestamp;
+        uint64 need = sizeof(header) + line.size();
+        if (need > ring->size)
+        {
+            atomic_add_uint64(&kLogDroppedLines, 1);
+            return;
+        }
+        uint64 head = ring->head;
+        uint64 used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        while (ring->size - used < need)
+        {
+            if (!kLogBlockWhenFull || !kLogFlusherRunning)
+            {
+                atomic_add_uint64(&kLogDroppedLines, 1);
+                return;
+            }
+            wakeup_log_flusher();
+            Thread::Sleep(1, MILLIS);
+            used = head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+        }
+        ring->Write(head, (const char*) &header, sizeof(header));
+        ring->Write(head + sizeof(header), line.data(), line.size());
+        __atomic_store_n(&ring->head, head + need, __ATOMIC_RELEASE);
+        if ((used + need) * 2 > ring->size && used * 2 <= ring->size)
+        {
+            wakeup_log_flusher();
+        }
+    }
+
+    struct LogFlusher: public Runnable
+    {
+            void Run()
+            {
+                while (kLogFlusherRunning)
+                {
+                    kLogFlusherLock.Lock();
+                    kLogFlusherLock.Wait(k_log_flush_period_ms, MILLIS);
+                    kLogFlusherLock.Unlock();
+                    LockGuard<ThreadMutex> guard(kLogMutex);
+                    drain_log_rings();
+                }
+            }
+    };
+    static LogFlusher kLogFlusherTask;
+
     static void default_loghandler(LogLevel level, const char* filename, const char* function, int line,
                     const char* format, ...)
     {
@@ -144,22 +386,23 @@ namespace ardb
         char timetag[256];
         struct tm& tm = get_current_tm();
         sprintf(timetag, "%02u-%02u %02u:%02u:%02u", tm.tm_mon + 1, tm.tm_mday, tm.tm_hour, tm.tm_min, tm.tm_sec);
+        char head[512];
+        int head_len = snprintf(head, sizeof(head), "[%u] %s,%03u %s ", getpid(), timetag, mills, levelstr);
+        std::string log_line;
+        log_line.reserve(head_len + record.size() + 1);
+        log_line.append(head, head_len).append(record).append("\n");
+        if (kLogAsync && level != FATAL_LOG_LEVEL)
+        {
+            push_log_line(timestamp, log_line);
+            return;
+        }
         LockGuard<ThreadMutex> guard(kLogMutex);
-        fprintf(kLogFile, "[%u] %s,%03u %s %s\n", getpid(), timetag, mills, levelstr, record.c_str());
-        fflush(kLogFile);
-        if (!kLogFilePath.empty() && kLogFile != stdout)
+        if (kLogAsync)
         {
-            long file_size = ftell(kLogFile);
-            if (file_size < 0)
-            {
-                reopen_default_logfile();
-            }
-            else if ((uint32) file_size >= k_max_file_size)
-            {
-                rollover_default_logfile();
-                reopen_default_logfile();
-            }
+            drain_log_rings();
         }
+        fwrite(log_line.data(), 1, log_line.size(), kLogFile);
+        flush_default_logfile();
     }
 
     static bool default_logchcker(LogLevel level)
@@ -212,8 +455,47 @@ namespace ardb
         SetLogLevel(level);
     }
 
+    void ArdbLogger::StartAsyncLogger(uint64_t thread_buffer_size, bool block_when_full)
+    {
+        if (kLogAsync || 0 == thread_buffer_size)
+        {
+            return;
+        }
+        uint32 size = 4096;
+        while (size < thread_buffer_size && size < (1U << 30))
+        {
+            size <<= 1;
+        }
+        kLogRingSize = size;
+        kLogBlockWhenFull = block_when_full;
+        kLogFlusherRunning = true;
+        kLogFlusher = new Thread(&kLogFlusherTask);
+        kLogFlusher->Start();
+        kLogAsync = true;
+    }
+
+    bool ArdbLogger::IsAsyncLogger()
+    {
+        return kLogAsync;
+    }
+
+    uint64_t ArdbLogger::GetDroppedLines()
+    {
+        return kLogDroppedLines;
+    }
+
     void ArdbLogger::DestroyDefaultLogger()
     {
+        if (NULL != kLogFlusher)
+        {
+            kLogAsync = false;
+            kLogFlusherRunning = false;
+            wakeup_log_flusher();
+            kLogFlusher->Join();
+            DELETE(kLogFlusher);
+            LockGuard<ThreadMutex> guard(kLogMutex);
+            drain_log_rings();
+        }
         if (kLogFile != stdout)
         {
             fclose(kLogFile);
@@ -31,6 +31,7 @@
 #define LOGGER_MACROS_HPP_
 
 #include <string>
+#include <stdint.h>
 
 namespace ardb
 {
@@ -71,6 +72,15 @@ namespace ardb
             static void InitDefaultLogger(const std::string& level,
                             const std::string& logfile);
             static void SetLogLevel(const std::string& level);
+            /*
+             * switch the default logger to async mode: lines are formatted into a ring of 'thread_buffer_size'
+             * bytes owned by the calling thread and written in batches by a flusher thread. A full ring drops
+             * the line or waits for the flusher if 'block_when_full' is set. FATAL lines are always written
+             * synchronously after draining the rings.
+             */
+            static void StartAsyncLogger(uint64_t thread_buffer_size, bool block_when_full);
+            static bool IsAsyncLogger();
+            static uint64_t GetDroppedLines();
             static void DestroyDefaultLogger();
             static FILE* GetLogStream();
     };
@@ -32,32 +32,22 @@
 #include <sys/stat.h>
 #include "network.hpp"
 #include "repl/repl.hpp"
+#include "rate_limiter.hpp"
+#include "util/uring.h"
 
 OP_NAMESPACE_BEGIN
     static ThreadLocal<RedisReplyPool> g_reply_pool;
     static QPSTrack g_total_qps;
     static CountTrack g_total_connections_received;
     static CountTrack g_rejected_connections;
+    static CountTrack g_migrated_connections;
     static std::vector<QPSTrack> g_serverQpsTracks;
     static std::vector<InstantQPS> g_serverInstanceQps;
-    static TreeMap<std::string, InstantQPS>::Type g_hostInstanceQpsTable;
-    static SpinMutexLock g_hostInstanceQpsTableLock;
 
-    static uint64_t incHostInstanceQps(const std::string& host, time_t now)
+    class ServerLifecycleHandler: public ChannelServiceLifeCycle
     {
-    	LockGuard<SpinMutexLock> guard(g_hostInstanceQpsTableLock);
-    	return g_hostInstanceQpsTable[host].Inc(now);
-    }
-
-    class ServerLifecycleHandler: public ChannelServiceLifeCycle, public Runnable
-    {
-            void Run()
-            {
-                g_db->ScanClients();
-            }
             void OnStart(ChannelService* serv, uint32 idx)
             {
-                serv->GetTimer().Schedule(this, 1, 1000 / g_db->GetConf().hz, MILLIS);
                 g_reply_pool.GetValue().SetMaxSize(g_db->GetConf().reply_pool_size);
             }
             void OnStop(ChannelService* serv, uint32 idx)
@@ -68,6 +58,8 @@ OP_NAMESPACE_BEGIN
             {
 
             }
+            bool OnChannelMigrateOut(ChannelService* serv, Channel* ch);
+            void OnChannelMigrateIn(ChannelService* serv, Channel* ch);
     };
 
     struct ResumeOverloadConnection: public Runnable
@@ -96,28 +88,97 @@ OP_NAMESPACE_BEGIN
             ClientContext m_client_ctx;
             Context m_ctx;
             bool m_delete_after_processing;
+            bool m_client_tracked;
             RedisReplyPool* pool;
             std::string client_host;
+            TokenBucket* host_bucket;
             InstantQPS conn_qps;
+            /*
+             * pipelined single key reads delayed until the end of the current read, then loaded by one MultiGet
+             */
+            RedisCommandFrameArray m_read_cmds;
+            ReadBatch m_read_batch;
 
-            void suspendConnection(uint64 now)
+            /*
+             * stop reading for 'wait' micros, or until next second if 'wait' is 0
+             */
+            void suspendConnection(uint64 now, uint64 wait)
             {
             	 if (NULL != m_client_ctx.client && !m_client_ctx.client->IsDetached())
             	 {
             		  m_client_ctx.client->DetachFD();
             		  uint64 one_sec_micros = 1000*1000;
-            	      uint64 next = one_sec_micros - (now % one_sec_micros);
+            	      uint64 next = wait > 0 ? wait : one_sec_micros - (now % one_sec_micros);
             	      ChannelService& serv = m_client_ctx.client->GetService();
             	      serv.GetTimer().ScheduleHeapTask(new ResumeOverloadConnection(serv, m_client_ctx.client->GetID()), next == 0 ? 1000 : next, -1, MICROS);
             	 }
             }
 
+            /*
+             * call the delayed reads in order, return false if the handler is deleted
+             */
+            bool flushReadBatch()
+            {
+                if (m_read_cmds.empty())
+                {
+                    return true;
+                }
+                if (m_read_cmds.size() > 1)
+                {
+                    g_db->PrefetchReads(m_ctx, m_read_cmds, m_read_batch);
+                }
+                for (size_t i = 0; i < m_read_cmds.size(); i++)
+                {
+                    if (!processCommand(&m_read_cmds[i]))
+                    {
+                        return false;
+                    }
+                }
+                m_ctx.read_batch = NULL;
+                m_read_batch.Clear();
+                m_read_cmds.clear();
+                return true;
+            }
+
             void MessageReceived(ChannelHandlerContext& ctx, MessageEvent<RedisCommandFrame>& e)
             {
-            	uint64 now = get_current_epoch_micros();
-                m_client_ctx.last_interaction_ustime = now;
                 m_client_ctx.client = ctx.GetChannel();
                 RedisCommandFrame* cmd = e.GetMessage();
+                int64 batch_max = g_db->GetConf().pipeline_read_batch_max;
+                if (batch_max > 1 && g_db->IsBatchableRead(m_ctx, *cmd))
+                {
+                    if (m_read_cmds.empty())
+                    {
+                        m_read_cmds.reserve(batch_max);
+                    }
+                    m_read_cmds.resize(m_read_cmds.size() + 1);
+                    RedisCommandFrame& delayed = m_read_cmds.back();
+                    delayed.GetMutableCommand().swap(cmd->GetMutableCommand());
+                    delayed.GetMutableArguments().swap(cmd->GetMutableArguments());
+                    if ((int64) m_read_cmds.size() >= batch_max)
+                    {
+                        flushReadBatch();
+                    }
+                    return;
+                }
+                if (flushReadBatch())
+                {
+                    processCommand(cmd);
+                }
+            }
+
+            void ChannelReadComplete(ChannelHandlerContext& ctx, ChannelStateEvent& e)
+            {
+                flushReadBatch();
+            }
+
+            /*
+             * return false if the handler is deleted
+             */
+            bool processCommand(RedisCommandFrame* cmd)
+            {
+            	uint64 now = get_current_epoch_micros();
+                m_client_ctx.last_interaction_ustime = now;
                 m_client_ctx.processing = true;
                 if (NULL == pool)
                 {
@@ -126,8 +187,15 @@ OP_NAMESPACE_BEGIN
                 pool->Clear();
                 m_ctx.SetReply(&(pool->Allocate()));
                 RedisReply& reply = m_ctx.GetReply();
+                Buffer& output = m_client_ctx.client->GetOutputBuffer();
+                if (!m_ctx.flags.reply_off && !m_ctx.flags.reply_skip)
+                {
+                    m_ctx.reply_buffer = &output;
+                }
                 int ret = g_db->Call(m_ctx, *cmd);
+                m_ctx.reply_buffer = NULL;
                 bool is_overload = false;
+                uint64 throttle_wait = 0;
                 g_serverQpsTracks[server_index].IncMsgCount(1);
                 g_total_qps.IncMsgCount(1);
                 now = get_current_epoch_micros();
@@ -136,13 +204,10 @@ OP_NAMESPACE_BEGIN
                 {
              		is_overload = conn_qps.Inc(now_sec) >= (uint64_t)(g_db->GetConf().qps_limit_per_connection);
                 }
-             	if(g_db->GetConf().qps_limit_per_host > 0 && !client_host.empty())
+             	if(g_db->GetConf().qps_limit_per_host > 0 && NULL != host_bucket)
              	{
-             		uint64_t instance_qps = incHostInstanceQps(client_host, now_sec);
-             		if(!is_overload)
-             		{
-             		    is_overload = instance_qps >= (uint64_t)(g_db->GetConf().qps_limit_per_host);
-             		}
+             	    uint64 rate = g_db->GetConf().qps_limit_per_host;
+             	    throttle_wait = host_bucket->Take(now, rate, HostRateLimiter::BurstOf(rate));
              	}
              	if(g_db->GetConf().servers[server_index].qps_limit > 0)
              	{
@@ -155,7 +220,7 @@ OP_NAMESPACE_BEGIN
                 if (m_delete_after_processing)
                 {
                     delete this;
-                    return;
+                    return false;
                 }
                 if (reply.type != 0 && !m_ctx.flags.reply_off)
                 {
@@ -166,6 +231,13 @@ OP_NAMESPACE_BEGIN
                         m_ctx.flags.reply_off = 1;
                     }
                 }
+                else if (output.Readable())
+                {
+                    /*
+                     * reply streamed into the output buffer by the command
+                     */
+                    m_client_ctx.client->EnableWriting();
+                }
                 if (ret < -1)
                 {
                     ChannelService* root = &(m_client_ctx.client->GetService());
@@ -174,7 +246,7 @@ OP_NAMESPACE_BEGIN
                         root = root->GetParent();
                     }
                     root->Stop();
-                    return;
+                    return true;
                 }
                 else if (-1 == ret)
                 {
@@ -183,15 +255,39 @@ OP_NAMESPACE_BEGIN
                 m_client_ctx.processing = false;
                 m_client_ctx.last_interaction_ustime = now;
                 m_ctx.ClearState();
+                if (g_db->GetConf().timeout > 0 && !m_client_ctx.idle_timer.IsScheduled())
+                {
+                    /*
+                     * 'timeout' enabled by CONFIG SET after connected
+                     */
+                    g_db->CheckIdleClient(m_ctx);
+                }
 
                 if(is_overload)
                 {
-                	suspendConnection(m_client_ctx.last_interaction_ustime);
+                	suspendConnection(m_client_ctx.last_interaction_ustime, 0);
+                }
+                else if (throttle_wait > 0)
+                {
+                    suspendConnection(m_client_ctx.last_interaction_ustime, throttle_wait);
                 }
+                return true;
             }
             void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e)
             {
+                m_ctx.read_batch = NULL;
+                m_read_batch.Clear();
+                m_read_cmds.clear();
                 g_db->FreeClient(m_ctx);
+                releaseHostBucket();
+            }
+            void releaseHostBucket()
+            {
+                if (NULL != host_bucket)
+                {
+                    HostRateLimiter::GetSingleton().Release(client_host);
+                    host_bucket = NULL;
+                }
             }
             void ChannelConnected(ChannelHandlerContext& ctx, ChannelStateEvent& e)
             {
@@ -218,6 +314,10 @@ OP_NAMESPACE_BEGIN
                     const SocketUnixAddress* addr = (const SocketUnixAddress*) remote;
                     client_host = addr->GetPath();
                 }
+                if (!client_host.empty())
+                {
+                    host_bucket = HostRateLimiter::GetSingleton().Acquire(client_host);
+                }
 
                 //client ip white list
                 //ReadLockGuard<SpinRWLock> guard(const_cast<SpinRWLock>(g_db->GetConf().lock));
@@ -245,13 +345,17 @@ OP_NAMESPACE_BEGIN
             }
         public:
             RedisRequestHandler(uint32 server_idx) :
-            	server_index(server_idx), m_delete_after_processing(false), pool(NULL)
+            	server_index(server_idx), m_delete_after_processing(false), m_client_tracked(false), pool(NULL), host_bucket(NULL)
             {
                 m_ctx.client = &m_client_ctx;
                 //root_reply.SetPool(&pool);
                 //m_ctx.SetReply(&root_reply);
                 //pool.SetMaxSize(g_db->GetConf().reply_pool_size);
             }
+            ~RedisRequestHandler()
+            {
+                releaseHostBucket();
+            }
             bool IsProcessing()
             {
                 return m_client_ctx.processing;
@@ -260,7 +364,47 @@ OP_NAMESPACE_BEGIN
             {
                 m_delete_after_processing = true;
             }
+            /*
+             * only connections idle between requests and without thread bound states could leave current io thread
+             */
+            bool MigrateOut()
+            {
+                if (m_client_ctx.processing || m_delete_after_processing || !m_read_cmds.empty()
+                        || NULL == m_client_ctx.client || m_ctx.flags.slave || m_ctx.InTransaction() || m_ctx.IsBlocking()
+                        || m_ctx.IsSubscribed() || m_client_ctx.pause_timer.IsScheduled())
+                {
+                    return false;
+                }
+                m_client_tracked = g_db->DetachClient(m_ctx);
+                return true;
+            }
+            void MigrateIn()
+            {
+                /*
+                 * reply pool is thread local
+                 */
+                pool = NULL;
+                if (m_client_tracked)
+                {
+                    g_db->AttachClient(m_ctx);
+                }
+            }
     };
+
+    bool ServerLifecycleHandler::OnChannelMigrateOut(ChannelService* serv, Channel* ch)
+    {
+        RedisRequestHandler* handler = (RedisRequestHandler*) ch->GetPipeline().Get("handler");
+        return NULL != handler && handler->MigrateOut();
+    }
+    void ServerLifecycleHandler::OnChannelMigrateIn(ChannelService* serv, Channel* ch)
+    {
+        RedisRequestHandler* handler = (RedisRequestHandler*) ch->GetPipeline().Get("handler");
+        if (NULL != handler)
+        {
+            handler->MigrateIn();
+        }
+        g_migrated_connections.Add(1);
+    }
     static void pipelineInit(ChannelPipeline* pipeline, void* data)
     {
     	uint64 idx = (uint64)data;
@@ -295,6 +439,8 @@ OP_NAMESPACE_BEGIN
         Statistics::GetSingleton().AddTrack(&g_total_connections_received);
         g_rejected_connections.name = "rejected_connections";
         Statistics::GetSingleton().AddTrack(&g_rejected_connections);
+        g_migrated_connections.name = "migrated_connections";
+        Statistics::GetSingleton().AddTrack(&g_migrated_connections);
     }
 
     Server::Server() :
@@ -304,6 +450,14 @@ OP_NAMESPACE_BEGIN
     }
     int Server::Start()
     {
+        if (g_db->GetConf().io_backend == "io_uring")
+        {
+            uring_enable(1);
+            if (!uring_enabled())
+            {
+                WARN_LOG("io_uring is not supported by current system, fall back to epoll.");
+            }
+        }
         if (0 != g_repl->Init())
         {
             ERROR_LOG("Failed to init replication service.");
@@ -311,6 +465,7 @@ OP_NAMESPACE_BEGIN
         }
         m_service = new ChannelService(g_db->MaxOpenFiles());
         m_service->SetThreadPoolSize(g_db->GetConf().thread_pool_size);
+        m_service->SetRebalanceThreshold(g_db->GetConf().io_thread_rebalance_threshold);
         ServerLifecycleHandler lifecycle;
         m_service->RegisterLifecycleCallback(&lifecycle);
 
@@ -346,6 +501,10 @@ OP_NAMESPACE_BEGIN
             {
                 SocketHostAddress socket_address(host, g_db->GetConf().servers[i].port);
                 server = m_service->NewServerSocketChannel();
+                if (g_db->GetConf().reuse_port && g_db->GetConf().thread_pool_size > 1)
+                {
+                    server->EnableReusePort();
+                }
                 if (!server->Bind(&socket_address))
                 {
                     ERROR_LOG("Failed to bind on %s:%u", host.c_str(), g_db->GetConf().servers[i].port);
@@ -0,0 +1,180 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+#include "rate_limiter.hpp"
+#include "thread/lock_guard.hpp"
+#include "util/atomic.hpp"
+#include "util/murmur3.h"
+#include "util/string_helper.hpp"
+
+OP_NAMESPACE_BEGIN
+
+    static const uint64_t kOneSecondMicros = 1000000;
+
+    uint64_t TokenBucket::Take(uint64_t now, uint64_t rate, uint64_t burst)
+    {
+        if (0 == rate)
+        {
+            return 0;
+        }
+        uint64_t interval = kOneSecondMicros / rate;
+        if (0 == interval)
+        {
+            interval = 1;
+        }
+        uint64_t tolerance = interval * burst;
+        uint64_t old_tat, new_tat;
+        do
+        {
+            old_tat = tat;
+            new_tat = (old_tat > now ? old_tat : now) + interval;
+        }
+        while (!atomic_cmp_set_uint64(&tat, old_tat, new_tat));
+        if (new_tat > now + tolerance)
+        {
+            atomic_add_uint64(&throttled, 1);
+            return new_tat - now - tolerance;
+        }
+        return 0;
+    }
+
+    uint64_t TokenBucket::Wait(uint64_t now, uint64_t rate, uint64_t burst) const
+    {
+        if (0 == rate)
+        {
+            return 0;
+        }
+        uint64_t interval = kOneSecondMicros / rate;
+        if (0 == interval)
+        {
+            interval = 1;
+        }
+        uint64_t tolerance = interval * burst;
+        uint64_t t = tat;
+        return t > now + tolerance ? t - now - tolerance : 0;
+    }
+
+    uint64_t TokenBucket::Tokens(uint64_t now, uint64_t rate, uint64_t burst) const
+    {
+        if (0 == rate)
+        {
+            return 0;
+        }
+        uint64_t interval = kOneSecondMicros / rate;
+        if (0 == interval)
+        {
+            interval = 1;
+        }
+        uint64_t t = tat;
+        uint64_t used = t > now ? (t - now + interval - 1) / interval : 0;
+        return used >= burst ? 0 : burst - used;
+    }
+
+    HostRateLimiter& HostRateLimiter::GetSingleton()
+    {
+        static HostRateLimiter singleton;
+        return singleton;
+    }
+
+    uint64_t HostRateLimiter::BurstOf(uint64_t rate)
+    {
+        /*
+         * keep 100ms worth of tokens, so that a throttled host waits for the next token instead of next second
+         */
+        uint64_t burst = rate / 10;
+        return burst > 0 ? burst : 1;
+    }
+
+    HostRateLimiter::Shard& HostRateLimiter::GetShard(const std::string& host)
+    {
+        uint32 hash = 0;
+        MurmurHash3_x86_32(host.data(), host.size(), 0, &hash);
+        return m_shards[hash & (HOST_LIMITER_SHARDS - 1)];
+    }
+
+    TokenBucket* HostRateLimiter::Acquire(const std::string& host)
+    {
+        Shard& shard = GetShard(host);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        HostBucket*& hb = shard.buckets[host];
+        if (NULL == hb)
+        {
+            hb = new HostBucket;
+        }
+        hb->connections++;
+        return &(hb->bucket);
+    }
+
+    void HostRateLimiter::Release(const std::string& host)
+    {
+        Shard& shard = GetShard(host);
+        LockGuard<SpinMutexLock> guard(shard.lock);
+        HostBucketTable::iterator found = shard.buckets.find(host);
+        if (found == shard.buckets.end())
+        {
+            return;
+        }
+        HostBucket* hb = found->second;
+        hb->connections--;
+        if (0 == hb->connections)
+        {
+            shard.buckets.erase(found);
+            delete hb;
+        }
+    }
+
+    void HostRateLimiter::Dump(std::string& info, const std::string& pattern, uint64_t now, uint64_t rate)
+    {
+        uint64_t burst = BurstOf(rate);
+        for (uint32 i = 0; i < HOST_LIMITER_SHARDS; i++)
+        {
+            LockGuard<SpinMutexLock> guard(m_shards[i].lock);
+            HostBucketTable::iterator it = m_shards[i].buckets.begin();
+            while (it != m_shards[i].buckets.end())
+            {
+                const std::string& host = it->first;
+                const HostBucket* hb = it->second;
+                it++;
+                if (!pattern.empty() && stringmatchlen(pattern.data(), pattern.size(), host.data(), host.size(), 0) != 1)
+                {
+                    continue;
+                }
+                uint64_t wait = hb->bucket.Wait(now, rate, burst);
+                info.append("host=").append(host);
+                info.append(" connections=").append(stringfromll(hb->connections));
+                info.append(" rate=").append(stringfromll(rate));
+                info.append(" burst=").append(stringfromll(burst));
+                info.append(" tokens=").append(stringfromll(hb->bucket.Tokens(now, rate, burst)));
+                info.append(" throttled=").append(wait > 0 ? "1" : "0");
+                info.append(" wait_us=").append(stringfromll(wait));
+                info.append(" throttled_count=").append(stringfromll(hb->bucket.throttled)).append("\n");
+            }
+        }
+    }
+
+OP_NAMESPACE_END
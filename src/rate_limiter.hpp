@@ -0,0 +1,98 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifndef RATE_LIMITER_HPP_
+#define RATE_LIMITER_HPP_
+
+#include "common/common.hpp"
+#include "thread/spin_mutex_lock.hpp"
+#include <string>
+
+#define HOST_LIMITER_SHARDS 16
+
+OP_NAMESPACE_BEGIN
+
+    /*
+     * Token bucket kept as the theoretical arrival time(GCRA) of the next request in one atomic word,
+     * so refill & take need no lock. 'rate' tokens are refilled per second, at most 'burst' tokens are kept.
+     */
+    struct TokenBucket
+    {
+            volatile uint64_t tat;
+            volatile uint64_t throttled;
+            TokenBucket()
+                    : tat(0), throttled(0)
+            {
+            }
+            /*
+             * take one token, return the micros to wait before next request, 0 if not throttled
+             */
+            uint64_t Take(uint64_t now, uint64_t rate, uint64_t burst);
+            uint64_t Tokens(uint64_t now, uint64_t rate, uint64_t burst) const;
+            uint64_t Wait(uint64_t now, uint64_t rate, uint64_t burst) const;
+    };
+
+    /*
+     * Token buckets shared by all the connections from same host, hosts are hashed into shards which are only
+     * locked while a connection acquires/releases its bucket, taking tokens is lock free.
+     */
+    class HostRateLimiter
+    {
+        private:
+            struct HostBucket
+            {
+                    TokenBucket bucket;
+                    uint32 connections;
+                    HostBucket()
+                            : connections(0)
+                    {
+                    }
+            };
+            typedef TreeMap<std::string, HostBucket*>::Type HostBucketTable;
+            struct Shard
+            {
+                    SpinMutexLock lock;
+                    HostBucketTable buckets;
+            };
+            Shard m_shards[HOST_LIMITER_SHARDS];
+            Shard& GetShard(const std::string& host);
+        public:
+            static HostRateLimiter& GetSingleton();
+            static uint64_t BurstOf(uint64_t rate);
+            TokenBucket* Acquire(const std::string& host);
+            void Release(const std::string& host);
+            /*
+             * one line per host matching the pattern(empty matches all)
+             */
+            void Dump(std::string& info, const std::string& pattern, uint64_t now, uint64_t rate);
+    };
+
+OP_NAMESPACE_END
+
+#endif /* RATE_LIMITER_HPP_ */
@@ -31,8 +31,21 @@
 #include <sys/stat.h>
 #include "db/db.hpp"
 #include "util/file_helper.hpp"
+#include "thread/lock_guard.hpp"
+#include <snappy.h>
+#include <algorithm>
 
 #define MAX_SEND_CACHE_SIZE 8192
+#define MAX_SEND_WAL_FILE_SIZE 1024*1024
+#define MAX_SEND_WAL_BLOCK_SIZE 64*1024
+/*
+ * headroom kept between a wal range sent from the backlog file and the wal end minus backlog size, for the wal written
+ * while a partial sendfile is in progress.
+ */
+#define WAL_SENDFILE_GUARD_SIZE 4*1024*1024
+#define MAX_DISKLESS_CHUNK_SIZE 1024*1024
+#define MAX_DISKLESS_PENDING_SIZE 4*1024*1024
+#define MAX_DISKLESS_SLAVE_BUFFER_SIZE 8*1024*1024
 
 OP_NAMESPACE_BEGIN
     enum SyncState
@@ -56,8 +69,14 @@ OP_NAMESPACE_BEGIN
             uint32 port;
             bool isRedisSlave;
             uint8 state;
+            bool wal_sending;
+            size_t wal_sending_len;
+            bool wal_compress;
+            bool diskless_capa;
+            DisklessSyncStream* diskless_stream;
             SlaveSyncContext() :
-                    snapshot(NULL), conn(NULL), sync_offset(0), ack_offset(0), sync_cksm(0), acktime(0), port(0), isRedisSlave(false), state(SYNC_STATE_INVALID)
+                    snapshot(NULL), conn(NULL), sync_offset(0), ack_offset(0), sync_cksm(0), acktime(0), port(0), isRedisSlave(false), state(SYNC_STATE_INVALID), wal_sending(
+                            false), wal_sending_len(0), wal_compress(false), diskless_capa(false), diskless_stream(NULL)
             {
             }
             std::string GetAddress()
@@ -79,9 +98,29 @@ OP_NAMESPACE_BEGIN
             }
     };
 
+    /*
+     * Diskless full resync streams one engine snapshot to all attached slaves. The dump thread appends the encoded
+     * snapshot to 'pending' and blocks while it's full, the io thread moves 'pending' into the output buffer of
+     * every slave only when no slave's output buffer is full, so the slowest slave throttles the dump.
+     */
+    struct DisklessSyncStream
+    {
+            Snapshot snapshot;
+            std::vector<SlaveSyncContext*> slaves;
+            ThreadMutexLock lock;
+            Buffer pending;
+            bool flush_scheduled;
+            bool aborted;
+            time_t create_time;
+            DisklessSyncStream() :
+                    flush_scheduled(false), aborted(false), create_time(time(NULL))
+            {
+            }
+    };
+
     Master::Master() :
             m_repl_noslaves_since(0), m_repl_nolag_since(0), m_repl_good_slaves_count(0), m_slaves_count(0), m_sync_full_count(0), m_sync_partial_ok_count(0), m_sync_partial_err_count(
-                    0)
+                    0), m_diskless_stream(NULL)
     {
     }
 
@@ -135,6 +174,225 @@ OP_NAMESPACE_BEGIN
         return 0;
     }
 
+    /*
+     * move the pending snapshot stream into the output buffer of all slaves as 'snapshotchunk <data>' frames,
+     * nothing is moved if some slave is still busy unless 'force' is set.
+     */
+    static void flush_diskless_stream(DisklessSyncStream* stream, bool force)
+    {
+        if (!force)
+        {
+            for (size_t i = 0; i < stream->slaves.size(); i++)
+            {
+                if (stream->slaves[i]->conn->WritableBytes() >= MAX_DISKLESS_SLAVE_BUFFER_SIZE)
+                {
+                    LockGuard<ThreadMutexLock> guard(stream->lock);
+                    stream->flush_scheduled = false;
+                    return;
+                }
+            }
+        }
+        Buffer frames;
+        {
+            LockGuard<ThreadMutexLock> guard(stream->lock);
+            stream->flush_scheduled = false;
+            while (stream->pending.Readable())
+            {
+                size_t len = stream->pending.ReadableBytes();
+                if (len > MAX_DISKLESS_CHUNK_SIZE)
+                {
+                    len = MAX_DISKLESS_CHUNK_SIZE;
+                }
+                frames.Printf("*2\r\n$13\r\nsnapshotchunk\r\n$%zu\r\n", len);
+                frames.Write(stream->pending.GetRawReadBuffer(), len);
+                frames.Write("\r\n", 2);
+                stream->pending.AdvanceReadIndex(len);
+            }
+            stream->pending.Clear();
+            stream->lock.NotifyAll();
+        }
+        if (!frames.Readable())
+        {
+            return;
+        }
+        for (size_t i = 0; i < stream->slaves.size(); i++)
+        {
+            SlaveSyncContext* slave = stream->slaves[i];
+            slave->conn->GetOutputBuffer().Write(frames.GetRawReadBuffer(), frames.ReadableBytes());
+            slave->conn->GetWritableOptions().auto_disable_writing = true;
+            slave->conn->EnableWriting();
+        }
+    }
+
+    static void diskless_stream_flush(Channel* ch, void* data)
+    {
+        flush_diskless_stream((DisklessSyncStream*) data, false);
+    }
+
+    static void diskless_stream_complete(Channel* ch, void* data)
+    {
+        DisklessSyncStream* stream = (DisklessSyncStream*) data;
+        bool success = stream->snapshot.IsReady() && !stream->aborted;
+        if (success)
+        {
+            flush_diskless_stream(stream, true);
+        }
+        std::vector<SlaveSyncContext*> slaves;
+        slaves.swap(stream->slaves);
+        for (size_t i = 0; i < slaves.size(); i++)
+        {
+            slaves[i]->diskless_stream = NULL;
+        }
+        DELETE(stream);
+        for (size_t i = 0; i < slaves.size(); i++)
+        {
+            SlaveSyncContext* slave = slaves[i];
+            if (success)
+            {
+                slave->state = SYNC_STATE_SYNCED;
+                INFO_LOG("Stream snapshot to slave:%s success.", slave->GetAddress().c_str());
+                g_repl->GetMaster().SyncWAL(slave);
+            }
+            else
+            {
+                WARN_LOG("Stream snapshot to slave:%s failed.", slave->GetAddress().c_str());
+                g_repl->GetMaster().CloseSlave(slave);
+            }
+        }
+    }
+
+    static int diskless_stream_sink(const void* buf, size_t buflen, void* data)
+    {
+        DisklessSyncStream* stream = (DisklessSyncStream*) data;
+        if (NULL == buf)
+        {
+            g_repl->GetIOService().AsyncIO(0, diskless_stream_complete, stream);
+            return 0;
+        }
+        LockGuard<ThreadMutexLock> guard(stream->lock);
+        while (!stream->aborted && stream->pending.ReadableBytes() >= MAX_DISKLESS_PENDING_SIZE)
+        {
+            stream->lock.Wait(10);
+        }
+        if (stream->aborted)
+        {
+            return -1;
+        }
+        stream->pending.Write(buf, buflen);
+        if (!stream->flush_scheduled && stream->pending.ReadableBytes() >= MAX_DISKLESS_CHUNK_SIZE)
+        {
+            stream->flush_scheduled = true;
+            g_repl->GetIOService().AsyncIO(0, diskless_stream_flush, stream);
+        }
+        return 0;
+    }
+
+    static int diskless_dump_routine(SnapshotState state, Snapshot* snapshot, void* cb)
+    {
+        DisklessSyncStream* stream = (DisklessSyncStream*) cb;
+        if (state == DUMPING)
+        {
+            LockGuard<ThreadMutexLock> guard(stream->lock);
+            if (stream->aborted)
+            {
+                return -1;
+            }
+        }
+        return 0;
+    }
+
+    int Master::DisklessResyncSlave(SlaveSyncContext* slave)
+    {
+        DisklessSyncStream* stream = m_diskless_stream;
+        if (NULL == stream)
+        {
+            NEW(stream, DisklessSyncStream);
+            if (0 != stream->snapshot.PrepareStreamSave(ARDB_DUMP, diskless_stream_sink, stream, diskless_dump_routine, stream))
+            {
+                DELETE(stream);
+                return -1;
+            }
+            m_diskless_stream = stream;
+        }
+        stream->slaves.push_back(slave);
+        slave->diskless_stream = stream;
+        slave->state = SYNC_STATE_SYNCING_SNAPSHOT;
+        g_repl->GetReplLog().ClearCurrentNamespace();
+        slave->sync_offset = stream->snapshot.CachedReplOffset();
+        slave->sync_cksm = stream->snapshot.CachedReplCksm();
+        Buffer msg;
+        msg.Printf("+FULLRESYNC %s %lld %llu diskless\r\n", g_repl->GetReplLog().GetReplKey().c_str(), slave->sync_offset, slave->sync_cksm);
+        slave->conn->Write(msg);
+        m_sync_full_count++;
+        INFO_LOG("[Master]Slave %s attached to diskless sync with %u slaves.", slave->GetAddress().c_str(), stream->slaves.size());
+        if (g_db->GetConf().repl_diskless_sync_delay <= 0)
+        {
+            StartDisklessSync();
+        }
+        return 0;
+    }
+
+    /*
+     * slaves requesting full resync in 'repl-diskless-sync-delay' seconds share the same stream.
+     */
+    void Master::StartDisklessSync()
+    {
+        DisklessSyncStream* stream = m_diskless_stream;
+        if (NULL == stream)
+        {
+            return;
+        }
+        m_diskless_stream = NULL;
+        INFO_LOG("[Master]Start diskless sync for %u slaves.", stream->slaves.size());
+        if (0 != stream->snapshot.BGStreamSave())
+        {
+            ERROR_LOG("Failed to start diskless sync.");
+            std::vector<SlaveSyncContext*> slaves;
+            slaves.swap(stream->slaves);
+            for (size_t i = 0; i < slaves.size(); i++)
+            {
+                slaves[i]->diskless_stream = NULL;
+            }
+            DELETE(stream);
+            for (size_t i = 0; i < slaves.size(); i++)
+            {
+                CloseSlave(slaves[i]);
+            }
+        }
+    }
+
+    void Master::RemoveDisklessSlave(SlaveSyncContext* slave)
+    {
+        DisklessSyncStream* stream = slave->diskless_stream;
+        slave->diskless_stream = NULL;
+        std::vector<SlaveSyncContext*>::iterator it = std::find(stream->slaves.begin(), stream->slaves.end(), slave);
+        if (it != stream->slaves.end())
+        {
+            stream->slaves.erase(it);
+        }
+        if (!stream->slaves.empty())
+        {
+            return;
+        }
+        if (stream == m_diskless_stream)
+        {
+            /*
+             * not started yet, just release the engine snapshot
+             */
+            m_diskless_stream = NULL;
+            DELETE(stream);
+        }
+        else
+        {
+            /*
+             * stop the dump thread, the stream is destroyed when the dump thread exits
+             */
+            LockGuard<ThreadMutexLock> guard(stream->lock);
+            stream->aborted = true;
+            stream->lock.NotifyAll();
+        }
+    }
+
     int Master::Routine()
     {
         m_repl_good_slaves_count = 0;
@@ -147,6 +405,10 @@ OP_NAMESPACE_BEGIN
             return 0;
         }
         m_repl_noslaves_since = 0;
+        if (NULL != m_diskless_stream && time(NULL) - m_diskless_stream->create_time >= g_db->GetConf().repl_diskless_sync_delay)
+        {
+            StartDisklessSync();
+        }
         std::vector<SlaveSyncContext*> to_close;
         SlaveSyncContextSet::iterator fit = m_slaves.begin();
         bool wal_ping_saved = false;
@@ -391,8 +653,137 @@ OP_NAMESPACE_BEGIN
         return loglen;
     }
 
+    static void OnWALFileSendComplete(void* data)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        slave->wal_sending = false;
+        if ((uint64_t) slave->sync_offset < g_repl->GetReplLog().WALStartOffset())
+        {
+            /*
+             * the sent part of backlog file was overwritten by new wal while sending
+             */
+            WARN_LOG("Slave:%s is too slow to send wal from backlog file.", slave->GetAddress().c_str());
+            slave->conn->Close();
+            return;
+        }
+        slave->sync_offset += slave->wal_sending_len;
+        slave->conn->GetWritableOptions().auto_disable_writing = (uint64_t) slave->sync_offset == g_repl->GetReplLog().WALEndOffset();
+        g_repl->GetMaster().SyncWAL(slave);
+    }
+
+    /*
+     * the backlog file is circular, the wal at 'offset' is overwritten once the wal end grows a backlog size past it
+     */
+    static bool wal_file_range_safe(uint64_t offset)
+    {
+        uint64_t end = g_repl->GetReplLog().WALEndOffset();
+        return offset >= g_repl->GetReplLog().WALStartOffset()
+                && end - offset + WAL_SENDFILE_GUARD_SIZE <= (uint64_t) g_db->GetConf().repl_backlog_size;
+    }
+
+    static bool OnWALFileSending(void* data, off_t file_rest_len)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        if (!wal_file_range_safe(slave->sync_offset + slave->wal_sending_len - file_rest_len))
+        {
+            WARN_LOG("Slave:%s is too slow to send wal from backlog file.", slave->GetAddress().c_str());
+            return false;
+        }
+        return true;
+    }
+
+    static void OnWALFileSendFailure(void* data)
+    {
+        SlaveSyncContext* slave = (SlaveSyncContext*) data;
+        slave->wal_sending = false;
+        WARN_LOG("Send wal to slave:%s failed.", slave->GetAddress().c_str());
+    }
+
+    /*
+     * send wal to slave from the backlog file by sendfile, the slaves share the page cache of backlog file,
+     * no copy into the output buffer of every slave.
+     */
+    static int send_wal_file_toslave(SlaveSyncContext* slave)
+    {
+        int fd = -1;
+        size_t file_pos = 0, len = 0;
+        /*
+         * a slave lagging near the backlog size is served by the copy path, which reads the wal under lock
+         */
+        if (!wal_file_range_safe(slave->sync_offset))
+        {
+            return -1;
+        }
+        if (0 != g_repl->GetReplLog().WALFileSegment(slave->sync_offset, fd, file_pos, len) || 0 == len)
+        {
+            return -1;
+        }
+        if (len > MAX_SEND_WAL_FILE_SIZE)
+        {
+            len = MAX_SEND_WAL_FILE_SIZE;
+        }
+        SendFileSetting setting;
+        setting.fd = fd;
+        setting.close_fd = false;
+        setting.file_offset = file_pos;
+        setting.file_rest_len = len;
+        setting.on_complete = OnWALFileSendComplete;
+        setting.on_failure = OnWALFileSendFailure;
+        setting.guard = OnWALFileSending;
+        setting.data = slave;
+        slave->wal_sending = true;
+        slave->wal_sending_len = len;
+        slave->conn->GetWritableOptions().auto_disable_writing = false;
+        slave->conn->SendFile(setting);
+        return 0;
+    }
+
+    static size_t collect_wal_block(const void* log, size_t loglen, void* data)
+    {
+        Buffer* block = (Buffer*) data;
+        block->Write(log, loglen);
+        return loglen;
+    }
+
+    /*
+     * send wal to slave as 'walblock <offset> <rawlen> <codec> <data>' frames, the slave unwraps the frames before writing
+     * its own wal, so the sync offset & cksm are still defined on the uncompressed wal.
+     */
+    static void send_wal_block_toslave(SlaveSyncContext* slave)
+    {
+        Buffer raw;
+        g_repl->GetReplLog().Replay(slave->sync_offset, MAX_SEND_WAL_BLOCK_SIZE, collect_wal_block, &raw);
+        if (!raw.Readable())
+        {
+            return;
+        }
+        std::string compressed;
+        snappy::Compress(raw.GetRawReadBuffer(), raw.ReadableBytes(), &compressed);
+        RedisCommandFrame block("walblock");
+        block.AddArg(stringfromll(slave->sync_offset));
+        block.AddArg(stringfromll(raw.ReadableBytes()));
+        if (compressed.size() < raw.ReadableBytes())
+        {
+            block.AddArg("snappy");
+            block.AddArg(compressed);
+        }
+        else
+        {
+            block.AddArg("raw");
+            block.AddArg(raw.AsString());
+        }
+        RedisCommandEncoder::Encode(slave->conn->GetOutputBuffer(), block);
+        slave->sync_offset += raw.ReadableBytes();
+        slave->conn->GetWritableOptions().auto_disable_writing = (uint64_t) slave->sync_offset == g_repl->GetReplLog().WALEndOffset();
+        slave->conn->EnableWriting();
+    }
+
     void Master::SyncWAL(SlaveSyncContext* slave)
     {
+        if (slave->wal_sending)
+        {
+            return;
+        }
         if ((uint64_t)slave->sync_offset < g_repl->GetReplLog().WALStartOffset() || (uint64_t)slave->sync_offset > g_repl->GetReplLog().WALEndOffset())
         {
             WARN_LOG("Slave synced offset:%llu is invalid in offset range[%llu-%llu] for wal.", slave->sync_offset, g_repl->GetReplLog().WALStartOffset(),
@@ -409,6 +800,24 @@ OP_NAMESPACE_BEGIN
         }
         if ((uint64_t)slave->sync_offset < g_repl->GetReplLog().WALEndOffset())
         {
+            if (slave->wal_compress)
+            {
+                /*
+                 * accumulate small writes into one block while the previous block is still being flushed,
+                 * the next block is sent when the channel becomes writable again.
+                 */
+                if (slave->conn->WritableBytes() > 0
+                        && g_repl->GetReplLog().WALEndOffset() - slave->sync_offset < MAX_SEND_WAL_BLOCK_SIZE)
+                {
+                    return;
+                }
+                send_wal_block_toslave(slave);
+                return;
+            }
+            if (g_db->GetConf().repl_wal_sendfile && 0 == send_wal_file_toslave(slave))
+            {
+                return;
+            }
             g_repl->GetReplLog().Replay(slave->sync_offset, MAX_SEND_CACHE_SIZE, send_wal_toslave, slave);
         }
     }
@@ -491,6 +900,14 @@ OP_NAMESPACE_BEGIN
                 WARN_LOG("Create snapshot for full resync for slave replid:%s offset:%llu cksm:%llu, while current WAL runid:%s offset:%llu cksm:%llu",
                         slave->repl_key.c_str(), slave->sync_offset, slave->sync_cksm, g_repl->GetReplLog().GetReplKey().c_str(),
                         g_repl->GetReplLog().WALEndOffset(), g_repl->GetReplLog().WALCksm());
+                if (!slave->isRedisSlave && slave->diskless_capa && g_db->GetConf().repl_diskless_sync)
+                {
+                    if (0 == DisklessResyncSlave(slave))
+                    {
+                        return;
+                    }
+                    WARN_LOG("Failed to create diskless sync for slave:%s, fallback to disk snapshot.", slave->GetAddress().c_str());
+                }
                 slave->state = SYNC_STATE_WAITING_SNAPSHOT;
                 SnapshotType snapshot_type = slave->isRedisSlave ? REDIS_DUMP : ARDB_DUMP;
                 if (slave->engine == g_engine_name && g_engine->GetFeatureSet().support_backup)
@@ -539,6 +956,10 @@ OP_NAMESPACE_BEGIN
         if (NULL != slave)
         {
             WARN_LOG("Slave %s closed.", slave->GetAddress().c_str());
+            if (NULL != slave->diskless_stream)
+            {
+                RemoveDisklessSlave(slave);
+            }
             m_slaves.erase(slave);
             m_slaves_count = m_slaves.size();
         }
@@ -554,6 +975,10 @@ OP_NAMESPACE_BEGIN
                 DEBUG_LOG("[Master]Slave sync from %lld to %llu at state:%u", slave->sync_offset, g_repl->GetReplLog().WALEndOffset(), slave->state);
                 SyncWAL(slave);
             }
+            else if (NULL != slave->diskless_stream && slave->diskless_stream != m_diskless_stream)
+            {
+                flush_diskless_stream(slave->diskless_stream, false);
+            }
         }
         else
         {
@@ -772,6 +1197,18 @@ OP_NAMESPACE_BEGIN
         getSlaveContext(slave).port = port;
     }
 
+    void Master::SetSlaveCapa(Channel* slave, const std::string& capa)
+    {
+        if (!strcasecmp(capa.c_str(), "wal-snappy") && !strcasecmp(g_db->GetConf().repl_wal_compression.c_str(), "snappy"))
+        {
+            getSlaveContext(slave).wal_compress = true;
+        }
+        else if (!strcasecmp(capa.c_str(), "diskless"))
+        {
+            getSlaveContext(slave).diskless_capa = true;
+        }
+    }
+
     Master::~Master()
     {
     }
@@ -29,8 +29,10 @@
 #include "repl.hpp"
 #include "redis/crc64.h"
 #include "db/db.hpp"
+#include "util/uring.h"
 
 #define SERVER_KEY_SIZE 40
+#define CKSM_CHECKPOINT_INTERVAL 1024*1024
 #define RUN_PERIOD(name, ms) static uint64_t name##_exec_ms = 0;  \
     if(ms > 0 && (now - name##_exec_ms >= ms) && (name##_exec_ms = now))
 OP_NAMESPACE_BEGIN
@@ -75,7 +77,9 @@ OP_NAMESPACE_BEGIN
         options->max_file_size = g_db->GetConf().repl_backlog_size;
         options->ring_cache_size = g_db->GetConf().repl_backlog_cache_size;
         options->cksm_func = crc64;
+        options->cksm_checkpoint_interval = CKSM_CHECKPOINT_INTERVAL;
         options->log_prefix = "ardb";
+        options->async_sync = uring_enabled();
         int err = swal_open(g_db->GetConf().repl_data_dir.c_str(), options, &m_wal);
         swal_options_destroy(options);
         if (0 != err)
@@ -223,6 +227,15 @@ OP_NAMESPACE_BEGIN
         swal_replay(m_wal, offset, limit_len, func, data);
     }
 
+    int ReplicationBacklog::WALFileSegment(size_t offset, int& fd, size_t& file_pos, size_t& len)
+    {
+        if (!g_repl->IsInited())
+        {
+            return -1;
+        }
+        return swal_file_segment(m_wal, offset, &fd, &file_pos, &len);
+    }
+
     int ReplicationBacklog::WriteWAL(const Data& ns, RedisCommandFrame& cmd)
     {
         if (!g_repl->IsInited())
@@ -273,10 +286,27 @@ OP_NAMESPACE_BEGIN
             //DO not check cksm when it's 0
             return true;
         }
-        uint64_t dest_cksm = swal_cksm(m_wal);
-        uint64_t end_offset = swal_end_offset(m_wal);
-        swal_replay(m_wal, offset, end_offset - offset, cksm_callback, &cksm);
-        return cksm == dest_cksm;
+        /*
+         * only compute cksm of the log between the offset and its nearest checkpoint
+         */
+        size_t before_offset = 0, after_offset = 0;
+        uint64_t before_cksm = 0, after_cksm = 0;
+        bool has_before = 0 == swal_cksm_checkpoint(m_wal, offset, 0, &before_offset, &before_cksm);
+        swal_cksm_checkpoint(m_wal, offset, 1, &after_offset, &after_cksm);
+        if (has_before && (size_t) offset - before_offset <= after_offset - (size_t) offset)
+        {
+            if ((size_t) offset > before_offset)
+            {
+                swal_replay(m_wal, before_offset, offset - before_offset, cksm_callback, &before_cksm);
+            }
+            return cksm == before_cksm;
+        }
+        uint64_t log_cksm = 0;
+        if (after_offset > (size_t) offset)
+        {
+            swal_replay(m_wal, offset, after_offset - offset, cksm_callback, &log_cksm);
+        }
+        return crc64_combine(cksm, log_cksm, after_offset - offset) == after_cksm;
     }
     void ReplicationBacklog::SetCurrentNamespace(const std::string& ns)
     {
@@ -73,6 +73,7 @@ OP_NAMESPACE_BEGIN
             void SetReplKey(const std::string& str);
             int WriteWAL(const Data& ns, RedisCommandFrame& cmd);
             void Replay(size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data);
+            int WALFileSegment(size_t offset, int& fd, size_t& file_pos, size_t& len);
             bool IsValidOffsetCksm(int64_t offset, uint64_t cksm);
             uint64_t WALStartOffset(bool lock = true);
             uint64_t WALEndOffset(bool lock = true);
@@ -105,12 +106,14 @@ OP_NAMESPACE_BEGIN
             time_t master_last_interaction_time;
             Snapshot snapshot;
             std::string snapshot_path;
+            Buffer wal_block_rest;
+            SnapshotStreamLoader* stream_loader;
             void UpdateSyncOffsetCksm(const Buffer& buffer);
             void Clear();
             void ResetCallFlags();
             SlaveContext() :
                     server_is_redis(false), server_support_psync(false), state(0), cached_master_repl_offset(0), cached_master_repl_cksm(0), sync_repl_offset(
-                            0), sync_repl_cksm(0), cmd_recved_time(0), master_link_down_time(0), master_last_interaction_time(0)
+                            0), sync_repl_cksm(0), cmd_recved_time(0), master_link_down_time(0), master_last_interaction_time(0), stream_loader(NULL)
             {
             }
     };
@@ -126,6 +129,8 @@ OP_NAMESPACE_BEGIN
             ClientContext m_client_ctx;
             DBWriter m_db_writer;
             void HandleRedisCommand(Channel* ch, RedisCommandFrame& cmd);
+            void HandleWALBlock(Channel* ch, RedisCommandFrame& cmd);
+            void HandleSnapshotChunk(Channel* ch, RedisCommandFrame& cmd);
             void HandleRedisReply(Channel* ch, RedisReply& reply);
             void HandleRedisDumpChunk(Channel* ch, RedisDumpFileChunk& chunk);
             void HandleBackupSync(Channel* ch, DirSyncStatus& cmd);
@@ -135,6 +140,7 @@ OP_NAMESPACE_BEGIN
             void Timeout();
 
             void LoadSyncedSnapshot();
+            void StartDisklessLoad();
             void ReportACK();
             void InfoMaster();
             int ConnectMaster();
@@ -158,11 +164,13 @@ OP_NAMESPACE_BEGIN
             int64 LoadLeftBytes();
             int64 SyncOffset();
             int64 SyncQueueSize();
+            void PrintSyncWorkers(std::string& str);
             void SendACK();
 
     };
 
     struct SlaveSyncContext;
+    struct DisklessSyncStream;
     typedef TreeSet<SlaveSyncContext*>::Type SlaveSyncContextSet;
     typedef TreeSet<Snapshot*>::Type DataDumpFileSet;
     class Master: public ChannelUpstreamHandler<RedisCommandFrame>
@@ -177,6 +185,7 @@ OP_NAMESPACE_BEGIN
             int64 m_sync_full_count;
             int64 m_sync_partial_ok_count;
             int64 m_sync_partial_err_count;
+            DisklessSyncStream* m_diskless_stream;
 
             void ChannelClosed(ChannelHandlerContext& ctx, ChannelStateEvent& e);
             void ChannelWritable(ChannelHandlerContext& ctx, ChannelStateEvent& e);
@@ -185,6 +194,9 @@ OP_NAMESPACE_BEGIN
             void SyncSlave(SlaveSyncContext* slave);
             int SendBackupToSlave(SlaveSyncContext* slave);
             int SendSnapshotToSlave(SlaveSyncContext* slave);
+            int DisklessResyncSlave(SlaveSyncContext* slave);
+            void StartDisklessSync();
+            void RemoveDisklessSlave(SlaveSyncContext* slave);
             bool IsAllSlaveSyncingCache();
             static void OnSnapshotBackupSendComplete(void* data);
             friend class ReplicationService;
@@ -199,6 +211,7 @@ OP_NAMESPACE_BEGIN
             void AddSlave(SlaveSyncContext* slave);
             void AddSlave(Channel* slave, RedisCommandFrame& cmd);
             void SetSlavePort(Channel* slave, uint32 port);
+            void SetSlaveCapa(Channel* slave, const std::string& capa);
             void SyncWAL(SlaveSyncContext* slave);
             size_t ConnectedSlaves();
             int64 FullSyncCount()
@@ -38,6 +38,7 @@
 #include "redis/crc64.h"
 #include "db/db.hpp"
 #include "util/concurrent_queue.hpp"
+#include <snappy.h>
 
 #define MAX_REPLAY_CACHE_SIZE 1024*1024
 
@@ -129,6 +130,8 @@ OP_NAMESPACE_BEGIN
         sync_repl_offset = 0;
         sync_repl_cksm = 0;
         snapshot_path.clear();
+        wal_block_rest.Clear();
+        DELETE(stream_loader);
         if(snapshot.IsReady())
         {
             snapshot.Close();
@@ -151,10 +154,7 @@ OP_NAMESPACE_BEGIN
         g_slave_sync_qps.name = "slave_sync_total_commands_processed";
         g_slave_sync_qps.qpsName = "slave_sync_instantaneous_ops_per_sec";
         Statistics::GetSingleton().AddTrack(&g_slave_sync_qps);
-        /*
-         * use same thread pool size with network server
-         */
-        m_db_writer.Init(g_db->GetConf().thread_pool_size);
+        m_db_writer.Init(g_db->GetConf().slave_workers);
         return 0;
     }
 
@@ -286,9 +286,75 @@ OP_NAMESPACE_BEGIN
         InfoMaster();
     }
 
+    /*
+     * unwrap the wal block sent by ardb master, the uncompressed commands are handled as normal synced commands,
+     * a command split by block boundary is kept until the next block arrives.
+     */
+    void Slave::HandleWALBlock(Channel* ch, RedisCommandFrame& cmd)
+    {
+        int64 offset = 0;
+        uint32 rawlen = 0;
+        if (cmd.GetArguments().size() != 4 || !string_toint64(cmd.GetArguments()[0], offset) || !string_touint32(cmd.GetArguments()[1], rawlen))
+        {
+            ERROR_LOG("Invalid wal block from master.");
+            ch->Close();
+            return;
+        }
+        uint64_t expected_offset = g_repl->GetReplLog().WALEndOffset() + m_ctx.wal_block_rest.ReadableBytes();
+        if ((uint64_t) offset != expected_offset)
+        {
+            ERROR_LOG("Invalid wal block offset:%lld while expected offset:%llu", offset, expected_offset);
+            ch->Close();
+            return;
+        }
+        const std::string& codec = cmd.GetArguments()[2];
+        const std::string& data = cmd.GetArguments()[3];
+        if (!strcasecmp(codec.c_str(), "snappy"))
+        {
+            std::string origin;
+            if (!snappy::Uncompress(data.data(), data.size(), &origin) || origin.size() != rawlen)
+            {
+                ERROR_LOG("Failed to decompress snappy wal block at offset:%lld", offset);
+                ch->Close();
+                return;
+            }
+            m_ctx.wal_block_rest.Write(origin.data(), origin.size());
+        }
+        else if (!strcasecmp(codec.c_str(), "raw") && data.size() == rawlen)
+        {
+            m_ctx.wal_block_rest.Write(data.data(), data.size());
+        }
+        else
+        {
+            ERROR_LOG("Invalid wal block with codec:%s at offset:%lld", codec.c_str(), offset);
+            ch->Close();
+            return;
+        }
+        while (m_ctx.wal_block_rest.Readable())
+        {
+            RedisCommandFrame msg;
+            if (!RedisCommandDecoder::Decode(NULL, m_ctx.wal_block_rest, msg))
+            {
+                break;
+            }
+            HandleRedisCommand(ch, msg);
+        }
+        m_ctx.wal_block_rest.DiscardReadedBytes();
+    }
+
     void Slave::HandleRedisCommand(Channel* ch, RedisCommandFrame& cmd)
     {
         m_ctx.cmd_recved_time = time(NULL);
+        if (!m_ctx.server_is_redis && !strcasecmp(cmd.GetCommand().c_str(), "walblock"))
+        {
+            HandleWALBlock(ch, cmd);
+            return;
+        }
+        if (!m_ctx.server_is_redis && !strcasecmp(cmd.GetCommand().c_str(), "snapshotchunk"))
+        {
+            HandleSnapshotChunk(ch, cmd);
+            return;
+        }
         int len = g_repl->GetReplLog().DirectWriteWAL(cmd);
         DEBUG_LOG("Recv master inline:%d cmd %s with type:%d at %lld %lld at state:%s", cmd.IsInLine(), cmd.ToString().c_str(), len, m_ctx.sync_repl_offset,
                 g_repl->GetReplLog().WALEndOffset(), state2String(m_ctx.state));
@@ -300,14 +366,8 @@ OP_NAMESPACE_BEGIN
         {
             m_ctx.ResetCallFlags();
             /*
-             * todo:
-             * call db may block current sync thread, maybe use more threads to exec command better.
-             * If use more threads to handle sync commands, there are several new problems:
-             * 1. Keep the commands exec order for same key
-             *    eg: lpush list a  & lpush list b must be executed in same thread  to keep exec order
-             * 2. ?
+             * db writer dispatches commands to its workers by key, commands on same key are executed in order
              */
-            //g_db->Call(m_ctx.ctx, cmd);
             m_db_writer.Put(m_ctx.ctx, cmd);
             m_ctx.UpdateSyncOffsetCksm(cmd.GetRawProtocolData());
         }
@@ -437,7 +497,19 @@ OP_NAMESPACE_BEGIN
                     m_ctx.server_support_psync = true;
                 }
                 Buffer replconf;
-                replconf.Printf("replconf listening-port %u\r\n", g_db->GetConf().PrimaryPort());
+                replconf.Printf("replconf listening-port %u", g_db->GetConf().PrimaryPort());
+                /*
+                 * only ardb master sends the wal in compressed blocks or streams snapshot, old redis master rejects unknown capa
+                 */
+                if (!m_ctx.server_is_redis)
+                {
+                    if (!strcasecmp(g_db->GetConf().repl_wal_compression.c_str(), "snappy"))
+                    {
+                        replconf.Printf(" capa wal-snappy");
+                    }
+                    replconf.Printf(" capa diskless");
+                }
+                replconf.Printf("\r\n");
                 m_ctx.state = SLAVE_STATE_WAITING_REPLCONF_REPLY;
                 ch->Write(replconf);
                 break;
@@ -514,6 +586,11 @@ OP_NAMESPACE_BEGIN
                         }
                         m_ctx.cached_master_repl_cksm = cksm;
                     }
+                    if (ss.size() > 4 && !strcasecmp(ss[4].c_str(), "diskless"))
+                    {
+                        StartDisklessLoad();
+                        break;
+                    }
 
                     m_ctx.state = SLAVE_STATE_WAITING_SNAPSHOT;
                     m_decoder.SwitchToDumpFileDecoder();
@@ -602,6 +679,52 @@ OP_NAMESPACE_BEGIN
         g_snapshot_manager->AddSnapshot(m_ctx.snapshot.GetPath());
     }
 
+    /*
+     * diskless full resync, the snapshot stream is loaded while it's still arriving, no snapshot file is created.
+     */
+    void Slave::StartDisklessLoad()
+    {
+        m_decoder.SwitchToCommandDecoder();
+        m_ctx.state = SLAVE_STATE_LOADING_SNAPSHOT;
+        g_repl->GetReplLog().SetReplKey(random_hex_string(40));
+        g_repl->GetReplLog().ResetWALOffsetCksm(m_ctx.cached_master_repl_offset, m_ctx.cached_master_repl_cksm);
+        if (g_db->GetConf().slave_cleardb_before_fullresync)
+        {
+            g_db->FlushAll(m_ctx.ctx);
+        }
+        INFO_LOG("Start loading snapshot stream from master.");
+        m_ctx.cmd_recved_time = time(NULL);
+        DELETE(m_ctx.stream_loader);
+        NEW(m_ctx.stream_loader, SnapshotStreamLoader);
+        m_ctx.stream_loader->Begin();
+    }
+
+    void Slave::HandleSnapshotChunk(Channel* ch, RedisCommandFrame& cmd)
+    {
+        if (m_ctx.state != SLAVE_STATE_LOADING_SNAPSHOT || NULL == m_ctx.stream_loader || cmd.GetArguments().size() != 1)
+        {
+            ERROR_LOG("Invalid snapshot chunk at state:%s", state2String(m_ctx.state));
+            ch->Close();
+            return;
+        }
+        const std::string& data = cmd.GetArguments()[0];
+        if (0 != m_ctx.stream_loader->Feed(data.data(), data.size()))
+        {
+            ERROR_LOG("Failed to load snapshot stream from master.");
+            ch->Close();
+            return;
+        }
+        if (m_ctx.stream_loader->IsComplete())
+        {
+            DELETE(m_ctx.stream_loader);
+            g_repl->GetReplLog().SetReplKey(m_ctx.cached_master_runid);
+            m_ctx.sync_repl_offset = m_ctx.cached_master_repl_offset;
+            m_ctx.sync_repl_cksm = m_ctx.cached_master_repl_cksm;
+            m_ctx.state = SLAVE_STATE_REPLAYING_WAL;
+            ReplayWAL();
+        }
+    }
+
     void Slave::HandleBackupSync(Channel* ch, DirSyncStatus& status)
     {
         if (m_ctx.state != SLAVE_STATE_WAITING_SNAPSHOT)
@@ -740,6 +863,16 @@ OP_NAMESPACE_BEGIN
     {
         return m_db_writer.QueueSize();
     }
+    void Slave::PrintSyncWorkers(std::string& str)
+    {
+        char buffer[256];
+        for (size_t i = 0; i < m_db_writer.WorkerCount(); i++)
+        {
+            sprintf(buffer, "slave_sync_worker%zu:queue=%" PRId64 ",lag_ms=%" PRId64 ",executed=%" PRId64 "\r\n", i,
+                    m_db_writer.WorkerQueueSize(i), m_db_writer.WorkerLag(i), m_db_writer.WorkerExecutedCount(i));
+            str.append(buffer);
+        }
+    }
     int64 Slave::SyncLeftBytes()
     {
         return m_ctx.snapshot.DumpLeftDataSize();
@@ -484,6 +484,41 @@ namespace ardb
         }
     }
 
+    /*
+     * write all elements of a compact hash/set/zset in redis rdb layout, return the number of written entries
+     */
+    int64 ObjectIO::WriteCompactElements(const ValueObject& meta)
+    {
+        DataArray elements;
+        if (!meta.GetCompactElements(elements))
+        {
+            return -1;
+        }
+        size_t step = meta.GetType() == KEY_SET ? 1 : 2;
+        for (size_t i = 0; i + step <= elements.size(); i += step)
+        {
+            if (WriteStringObject(elements[i]) < 0)
+            {
+                return -1;
+            }
+            if (meta.GetType() == KEY_HASH)
+            {
+                if (WriteStringObject(elements[i + 1]) < 0)
+                {
+                    return -1;
+                }
+            }
+            else if (meta.GetType() == KEY_ZSET)
+            {
+                if (WriteDouble(elements[i + 1].GetFloat64()) < 0)
+                {
+                    return -1;
+                }
+            }
+        }
+        return elements.size() / step;
+    }
+
     int ObjectIO::WriteRawString(const std::string& str)
     {
         return WriteRawString(str.data(), str.size());
@@ -669,6 +704,7 @@ namespace ardb
             }
             case KEY_LIST:
             case KEY_LIST_ELEMENT:
+            case KEY_LIST_CHUNK:
             {
                 return WriteType(REDIS_RDB_TYPE_LIST);
             }
@@ -1244,10 +1280,7 @@ namespace ardb
         if (expiretime > 0)
         {
             meta_value.SetTTL(expiretime);
-            if (!g_db->GetEngine()->GetFeatureSet().support_compactfilter)
-            {
-                g_db->SaveTTL(ctx, meta_key.GetNameSpace(), meta_key.GetKey().AsString(), 0, expiretime);
-            }
+            g_db->SaveTTL(ctx, meta_key.GetNameSpace(), meta_key.GetKey().AsString(), 0, expiretime);
         }
         //g_db->SetKeyValue(ctx, meta_key, meta_value);
         GetDBWriter().Put(ctx, meta_key, meta_value);
@@ -1327,17 +1360,33 @@ namespace ardb
                 ERROR_LOG("Failed to read value in kv pair.");
                 return -1;
             }
-            //g_db->GetEngine()->PutRaw(ctx, ctx.ns, key, value);
-            GetDBWriter().Put(ctx, ctx.ns, key, value);
-            if (ttl > 0 && !g_db->GetEngine()->GetFeatureSet().support_compactfilter)
+            bool transcode = m_ardb_key_format != get_key_encode_format();
+            KeyObject kk;
+            if (transcode || (ttl > 0 && !g_db->GetEngine()->GetFeatureSet().support_compactfilter))
             {
                 Buffer keybuf((char*) key.data(), 0, key.size());
-                KeyObject kk;
-                if (!kk.Decode(keybuf, false, false))
+                if (!kk.DecodeAs(m_ardb_key_format, keybuf, false, false))
                 {
                     ERROR_LOG("Failed to decode key object.");
                     return -1;
                 }
+            }
+            if (transcode)
+            {
+                /*
+                 * raw data saved in another key format, re-encode the key in current format.
+                 */
+                Buffer keybuf;
+                Slice transcoded = kk.Encode(keybuf, false);
+                GetDBWriter().Put(ctx, ctx.ns, transcoded, value);
+            }
+            else
+            {
+                //g_db->GetEngine()->PutRaw(ctx, ctx.ns, key, value);
+                GetDBWriter().Put(ctx, ctx.ns, key, value);
+            }
+            if (ttl > 0)
+            {
                 g_db->SaveTTL(ctx, ctx.ns, kk.GetKey().AsString(), 0, ttl);
             }
         }
@@ -2156,7 +2205,16 @@ namespace ardb
                     {
                         case KEY_STRING:
                         {
-                            WriteStringObject(v.GetStringValue());
+                            if (v.IsStringSegmented())
+                            {
+                                std::string str;
+                                g_db->StringSegmentsRead(ctx, k, v, 0, v.GetObjectLen() - 1, str);
+                                WriteRawString(str.data(), str.size());
+                            }
+                            else
+                            {
+                                WriteStringObject(v.GetStringValue());
+                            }
                             iter_continue = false;
                             break;
                         }
@@ -2168,6 +2226,10 @@ namespace ardb
                             g_db->ObjectLen(ctx, current_keytype, k.GetKey().AsString());
                             objectlen = ctx.GetReply().GetInteger();
                             WriteLen(objectlen);
+                            if (v.IsCompact())
+                            {
+                                objectlen -= WriteCompactElements(v);
+                            }
                             //DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
                             break;
                         }
@@ -2195,6 +2257,21 @@ namespace ardb
                     objectlen--;
                     break;
                 }
+                case KEY_LIST_CHUNK:
+                {
+                    if (current_keytype != KEY_LIST || objectlen <= 0)
+                    {
+                        iter_continue = false;
+                        break;
+                    }
+                    DataArray& elements = v.GetListChunkElements();
+                    for (size_t i = 0; i < elements.size(); i++)
+                    {
+                        WriteStringObject(elements[i]);
+                    }
+                    objectlen -= elements.size();
+                    break;
+                }
                 case KEY_SET_MEMBER:
                 {
                     if (current_keytype != KEY_SET || objectlen <= 0)
@@ -2270,12 +2347,12 @@ namespace ardb
     }
 
     Snapshot::Snapshot()
-            : m_read_fp(NULL), m_write_fp(NULL), m_cksm(0), m_routine_cb(
+            : m_read_fp(NULL), m_write_fp(NULL), m_write_ring(NULL), m_cksm(0), m_routine_cb(
             NULL), m_routine_cbdata(
             NULL), m_processed_bytes(0), m_file_size(0), m_state(SNAPSHOT_INVALID), m_routinetime(0), m_read_buf(
             NULL), m_expected_data_size(0), m_writed_data_size(0), m_cached_repl_offset(0), m_cached_repl_cksm(0), m_save_time(
                     0), m_type((SnapshotType) 0), m_engine_snapshot(
-            NULL)
+            NULL), m_stream_sink(NULL), m_stream_sink_data(NULL)
     {
 
     }
@@ -2302,6 +2379,10 @@ namespace ardb
 
     void Snapshot::Flush()
     {
+        if (NULL != m_write_ring)
+        {
+            uring_writer_flush(m_write_ring);
+        }
         if (NULL != m_write_fp)
         {
             fflush(m_write_fp);
@@ -2346,6 +2427,14 @@ namespace ardb
             fclose(m_read_fp);
             m_read_fp = NULL;
         }
+        if (NULL != m_write_ring)
+        {
+            if (0 != uring_writer_close(m_write_ring))
+            {
+                ERROR_LOG("Failed to write snapshot file:%s by io_uring", m_file_path.c_str());
+            }
+            m_write_ring = NULL;
+        }
         if (NULL != m_write_fp)
         {
             fclose(m_write_fp);
@@ -2378,6 +2467,10 @@ namespace ardb
             ERROR_LOG("Failed to open ardb dump file:%s to write", m_file_path.c_str());
             return -1;
         }
+        /*
+         * all writes go through io_uring(bypass stdio) if enabled
+         */
+        m_write_ring = uring_writer_open(fileno(m_write_fp), 0);
         m_writed_data_size = 0;
         return 0;
     }
@@ -2475,18 +2568,27 @@ namespace ardb
 
     int64_t Snapshot::WriteSeek(int64_t pos)
     {
-        fseeko(m_write_fp, SEEK_SET, pos);
+        if (NULL != m_write_ring)
+        {
+            uring_writer_seek(m_write_ring, pos);
+            return uring_writer_tell(m_write_ring);
+        }
+        fseeko(m_write_fp, pos, SEEK_SET);
         return ftello(m_write_fp);
     }
     int64_t Snapshot::GetWritePos()
     {
+        if (NULL != m_write_ring)
+        {
+            return uring_writer_tell(m_write_ring);
+        }
         return ftello(m_write_fp);
     }
 
     int Snapshot::Write(const void* buf, size_t buflen)
     {
 
-        if (NULL == m_write_fp)
+        if (NULL == m_write_fp && NULL == m_stream_sink)
         {
             /*
              * maybe closed while writing
@@ -2508,6 +2610,13 @@ namespace ardb
             m_routinetime = get_current_epoch_millis();
         }
 
+        if (NULL != m_stream_sink)
+        {
+            m_writed_data_size += buflen;
+            m_cksm = crc64(m_cksm, (const unsigned char *) buf, buflen);
+            return m_stream_sink(buf, buflen, m_stream_sink_data);
+        }
+
         if (NULL == m_write_fp)
         {
             ERROR_LOG("Failed to open snapshot file:%s to write", m_file_path.c_str());
@@ -2519,7 +2628,9 @@ namespace ardb
         while (buflen)
         {
             size_t bytes_to_write = (max_write_bytes < buflen) ? max_write_bytes : buflen;
-            if (fwrite(data, bytes_to_write, 1, m_write_fp) == 0)
+            if (NULL != m_write_ring ?
+                    0 != uring_writer_write(m_write_ring, data, bytes_to_write) :
+                    fwrite(data, bytes_to_write, 1, m_write_fp) == 0)
             {
                 ERROR_LOG("Failed to write %u bytes to snapshot file:%s to write", bytes_to_write, m_file_path.c_str());
                 return -1;
@@ -2581,7 +2692,7 @@ namespace ardb
 
     void Snapshot::VerifyState()
     {
-        if (m_state != SNAPSHOT_INVALID)
+        if (m_state != SNAPSHOT_INVALID && NULL == m_stream_sink)
         {
             if (!is_file_exist(m_file_path))
             {
@@ -2593,7 +2704,11 @@ namespace ardb
     int Snapshot::PrepareSave(SnapshotType type, const std::string& file, SnapshotRoutine* cb, void *data)
     {
         int err = 0;
-        if (type != BACKUP_DUMP)
+        if (NULL != m_stream_sink)
+        {
+            m_writed_data_size = 0;
+        }
+        else if (type != BACKUP_DUMP)
         {
             err = OpenWriteFile(file);
         }
@@ -2780,6 +2895,49 @@ namespace ardb
         return 0;
     }
 
+    int Snapshot::PrepareStreamSave(SnapshotType type, SnapshotStreamSink* sink, void* sink_data, SnapshotRoutine* cb, void *data)
+    {
+        if (type != ARDB_DUMP)
+        {
+            return ERR_NOTSUPPORTED;
+        }
+        if (IsSaving())
+        {
+            return -1;
+        }
+        m_stream_sink = sink;
+        m_stream_sink_data = sink_data;
+        return PrepareSave(type, "", cb, data);
+    }
+
+    int Snapshot::BGStreamSave()
+    {
+        if (NULL == m_stream_sink || m_state != DUMPING)
+        {
+            return -1;
+        }
+        struct BGTask: public Thread
+        {
+                Snapshot* snapshot;
+                BGTask(Snapshot* s)
+                        : snapshot(s)
+                {
+                }
+                void Run()
+                {
+                    snapshot->DoSave();
+                    /*
+                     * notify the end of stream at last, the snapshot may be destroyed by the sink owner then.
+                     */
+                    snapshot->m_stream_sink(NULL, 0, snapshot->m_stream_sink_data);
+                    delete this;
+                }
+        };
+        BGTask* task = new BGTask(this);
+        task->Start();
+        return 0;
+    }
+
     std::string Snapshot::GetSyncSnapshotPath(SnapshotType type, uint64 offset, uint64 cksm)
     {
         char tmp[g_db->GetConf().backup_dir.size() + 100];
@@ -2874,6 +3032,10 @@ namespace ardb
             return -1;
         }
         INFO_LOG("Start loading RDB file with format version:%d", rdbver);
+        /*
+         * snapshot without 'key_format' aux info is saved by older version in legacy key format
+         */
+        m_ardb_key_format = KEY_FORMAT_LEGACY;
         g_engine->BeginBulkLoad(loadctx);
         while (true)
         {
@@ -3099,7 +3261,16 @@ namespace ardb
                         {
                             case KEY_STRING:
                             {
-                                DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
+                                if (v.IsStringSegmented())
+                                {
+                                    std::string str;
+                                    g_db->StringSegmentsRead(dumpctx, k, v, 0, v.GetObjectLen() - 1, str);
+                                    DUMP_CHECK_WRITE(WriteRawString(str.data(), str.size()));
+                                }
+                                else
+                                {
+                                    DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
+                                }
                                 break;
                             }
                             case KEY_LIST:
@@ -3112,6 +3283,12 @@ namespace ardb
                                 objectlen = dumpctx.GetReply().GetInteger();
                                 object_totallen = objectlen;
                                 DUMP_CHECK_WRITE(WriteLen(objectlen));
+                                if (v.IsCompact())
+                                {
+                                    int64 written = WriteCompactElements(v);
+                                    DUMP_CHECK_WRITE(written);
+                                    objectlen -= written;
+                                }
                                 //DUMP_CHECK_WRITE(WriteStringObject(v.GetStringValue()));
                                 break;
                             }
@@ -3132,6 +3309,20 @@ namespace ardb
                         objectlen--;
                         break;
                     }
+                    case KEY_LIST_CHUNK:
+                    {
+                        if (current_key != k.GetKey() || current_keytype != KEY_LIST || objectlen <= 0)
+                        {
+                            break;
+                        }
+                        DataArray& elements = v.GetListChunkElements();
+                        for (size_t i = 0; i < elements.size(); i++)
+                        {
+                            DUMP_CHECK_WRITE(WriteStringObject(elements[i]));
+                        }
+                        objectlen -= elements.size();
+                        break;
+                    }
                     case KEY_SET_MEMBER:
                     {
                         if (current_key != k.GetKey() || current_keytype != KEY_SET || objectlen <= 0)
@@ -3234,6 +3425,9 @@ namespace ardb
         RETURN_NEGATIVE_EXPR(WriteType(ARDB_OPCODE_AUX));
         RETURN_NEGATIVE_EXPR(WriteRawString("create_time"));
         RETURN_NEGATIVE_EXPR(WriteRawString(stringfromll(time(NULL))));
+        RETURN_NEGATIVE_EXPR(WriteType(ARDB_OPCODE_AUX));
+        RETURN_NEGATIVE_EXPR(WriteRawString("key_format"));
+        RETURN_NEGATIVE_EXPR(WriteRawString(key_encode_format_name(get_key_encode_format())));
 
         DataArray nss;
         g_db->GetEngine()->ListNameSpaces(dumpctx, nss);
@@ -3270,17 +3464,23 @@ namespace ardb
                 }
                 if (m_write_buffer.ReadableBytes() >= 1024 * 1024)
                 {
-                    ArdbFlushWriteBuffer(m_write_buffer);
+                    ret = ArdbFlushWriteBuffer(m_write_buffer);
+                    if (0 != ret)
+                    {
+                        DELETE(iter);
+                        Close();
+                        return ret;
+                    }
                 }
                 iter->Next();
             }
-            ArdbFlushWriteBuffer(m_write_buffer);
             DELETE(iter);
+            RETURN_NEGATIVE_EXPR(ArdbFlushWriteBuffer(m_write_buffer));
         }
-        WriteType(REDIS_RDB_OPCODE_EOF);
+        RETURN_NEGATIVE_EXPR(WriteType(REDIS_RDB_OPCODE_EOF));
         uint64 cksm = m_cksm;
         memrev64ifbe(&cksm);
-        Write(&cksm, sizeof(cksm));
+        RETURN_NEGATIVE_EXPR(Write(&cksm, sizeof(cksm)));
         return 0;
     }
 
@@ -3339,6 +3539,11 @@ namespace ardb
                     goto eoferr;
                 }
                 INFO_LOG("Snapshot aux info: %s=%s", aux_key.c_str(), aux_val.c_str());
+                if (aux_key == "key_format" && !parse_key_encode_format(aux_val, m_ardb_key_format))
+                {
+                    ERROR_LOG("Unsupported key format:%s in snapshot.", aux_val.c_str());
+                    goto eoferr;
+                }
             }
             else if (type == ARDB_RDB_TYPE_CHUNK || type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
             {
@@ -3390,6 +3595,241 @@ namespace ardb
         return -1;
     }
 
+    enum SnapshotStreamLoadState
+    {
+        STREAM_LOAD_INIT = 0, STREAM_LOAD_HEADER, STREAM_LOAD_RECORDS, STREAM_LOAD_CKSM, STREAM_LOAD_DONE, STREAM_LOAD_FAIL
+    };
+
+    SnapshotStreamLoader::SnapshotStreamLoader()
+            : m_cksm(0), m_loaded_bytes(0), m_state(STREAM_LOAD_INIT), m_short_read(false)
+    {
+        m_loadctx.flags.no_fill_reply = 1;
+        m_loadctx.flags.no_wal = 1;
+        m_loadctx.flags.create_if_notexist = 1;
+        m_loadctx.flags.bulk_loading = 1;
+    }
+
+    bool SnapshotStreamLoader::Read(void* buf, size_t buflen, bool cksm)
+    {
+        if (m_buffer.ReadableBytes() < buflen)
+        {
+            m_short_read = true;
+            return false;
+        }
+        m_buffer.Read(buf, buflen);
+        return true;
+    }
+    int SnapshotStreamLoader::Write(const void* buf, size_t buflen)
+    {
+        return -1;
+    }
+    int64_t SnapshotStreamLoader::WriteSeek(int64_t pos)
+    {
+        return -1;
+    }
+    int64_t SnapshotStreamLoader::GetWritePos()
+    {
+        return -1;
+    }
+
+    int SnapshotStreamLoader::Begin()
+    {
+        if (m_state != STREAM_LOAD_INIT)
+        {
+            return -1;
+        }
+        g_engine->BeginBulkLoad(m_loadctx);
+        m_state = STREAM_LOAD_HEADER;
+        return 0;
+    }
+
+    int SnapshotStreamLoader::LoadChunk(int type)
+    {
+        uint32 rawlen = ReadLen(NULL);
+        if (m_short_read)
+        {
+            return 0;
+        }
+        if (type == ARDB_RDB_TYPE_CHUNK)
+        {
+            if (m_buffer.ReadableBytes() < rawlen)
+            {
+                return 0;
+            }
+            Buffer chunk(const_cast<char*>(m_buffer.GetRawReadBuffer()), 0, rawlen);
+            m_buffer.AdvanceReadIndex(rawlen);
+            return 0 == ArdbLoadBuffer(m_loadctx, chunk) ? 1 : -1;
+        }
+        uint32 compressedlen = ReadLen(NULL);
+        if (m_short_read || m_buffer.ReadableBytes() < compressedlen)
+        {
+            return 0;
+        }
+        std::string origin;
+        origin.reserve(rawlen);
+        if (!snappy::Uncompress(m_buffer.GetRawReadBuffer(), compressedlen, &origin))
+        {
+            ERROR_LOG("Failed to decompress snappy chunk.");
+            return -1;
+        }
+        m_buffer.AdvanceReadIndex(compressedlen);
+        Buffer chunk(const_cast<char*>(origin.data()), 0, origin.size());
+        return 0 == ArdbLoadBuffer(m_loadctx, chunk) ? 1 : -1;
+    }
+
+    /*
+     * return 1 if a whole record loaded, 0 if the record is not complete yet.
+     */
+    int SnapshotStreamLoader::LoadRecord()
+    {
+        if (m_state == STREAM_LOAD_HEADER)
+        {
+            char buf[9];
+            if (!Read(buf, 8, true))
+            {
+                return 0;
+            }
+            buf[8] = '\0';
+            if (memcmp(buf, "ARDB", 4) != 0)
+            {
+                WARN_LOG("Wrong signature:%s trying to load snapshot stream", buf);
+                return -1;
+            }
+            int rdbver = atoi(buf + 4);
+            if (rdbver < 1 || rdbver > ARDB_RDB_VERSION)
+            {
+                WARN_LOG("Can't handle ARDB format version %d", rdbver);
+                return -1;
+            }
+            m_state = STREAM_LOAD_RECORDS;
+            return 1;
+        }
+        if (m_state == STREAM_LOAD_CKSM)
+        {
+            uint64_t cksum;
+            if (!Read(&cksum, 8, true))
+            {
+                return 0;
+            }
+            memrev64ifbe(&cksum);
+            if (cksum != 0 && cksum != m_cksm)
+            {
+                ERROR_LOG("Wrong snapshot stream checksum.(%llu-%llu)", cksum, m_cksm);
+                return -1;
+            }
+            m_state = STREAM_LOAD_DONE;
+            return 1;
+        }
+        int type = ReadType();
+        if (m_short_read)
+        {
+            return 0;
+        }
+        if (type == ARDB_RDB_TYPE_EOF)
+        {
+            m_state = STREAM_LOAD_CKSM;
+            return 1;
+        }
+        else if (type == ARDB_RDB_OPCODE_SELECTDB)
+        {
+            std::string ns;
+            if (!ReadString(ns) || m_short_read)
+            {
+                return m_short_read ? 0 : -1;
+            }
+            m_loadctx.ns.SetString(ns, false);
+            return 1;
+        }
+        else if (type == ARDB_OPCODE_AUX)
+        {
+            std::string aux_key, aux_val;
+            if (!ReadString(aux_key) || !ReadString(aux_val) || m_short_read)
+            {
+                return m_short_read ? 0 : -1;
+            }
+            INFO_LOG("Snapshot aux info: %s=%s", aux_key.c_str(), aux_val.c_str());
+            if (aux_key == "key_format" && !parse_key_encode_format(aux_val, m_ardb_key_format))
+            {
+                ERROR_LOG("Unsupported key format:%s in snapshot.", aux_val.c_str());
+                return -1;
+            }
+            return 1;
+        }
+        else if (type == ARDB_RDB_TYPE_CHUNK || type == ARDB_RDB_TYPE_SNAPPY_CHUNK)
+        {
+            return LoadChunk(type);
+        }
+        ERROR_LOG("Invalid type:%d.", type);
+        return -1;
+    }
+
+    int SnapshotStreamLoader::Feed(const void* data, size_t len)
+    {
+        if (m_state == STREAM_LOAD_INIT || m_state >= STREAM_LOAD_DONE)
+        {
+            return -1;
+        }
+        m_buffer.Write(data, len);
+        while (m_state != STREAM_LOAD_DONE && m_buffer.Readable())
+        {
+            size_t mark = m_buffer.GetReadIndex();
+            uint8 state = m_state;
+            m_short_read = false;
+            int ret = LoadRecord();
+            if (ret < 0)
+            {
+                Abort();
+                return -1;
+            }
+            if (0 == ret)
+            {
+                m_buffer.SetReadIndex(mark);
+                break;
+            }
+            size_t record_len = m_buffer.GetReadIndex() - mark;
+            if (state != STREAM_LOAD_CKSM)
+            {
+                m_cksm = crc64(m_cksm, (const unsigned char *) m_buffer.GetRawBuffer() + mark, record_len);
+            }
+            m_loaded_bytes += record_len;
+        }
+        m_buffer.DiscardReadedBytes();
+        if (m_state == STREAM_LOAD_DONE)
+        {
+            g_engine->FlushAll(m_loadctx);
+            g_engine->EndBulkLoad(m_loadctx);
+            INFO_LOG("All data load successfully from ardb snapshot stream with %llu bytes.", m_loaded_bytes);
+            if (g_db->GetConf().compact_after_snapshot_load)
+            {
+                g_db->CompactAll(m_loadctx);
+            }
+        }
+        return 0;
+    }
+
+    bool SnapshotStreamLoader::IsComplete() const
+    {
+        return m_state == STREAM_LOAD_DONE;
+    }
+
+    void SnapshotStreamLoader::Abort()
+    {
+        if (m_state > STREAM_LOAD_INIT && m_state < STREAM_LOAD_DONE)
+        {
+            g_engine->EndBulkLoad(m_loadctx);
+        }
+        if (m_state != STREAM_LOAD_DONE)
+        {
+            m_state = STREAM_LOAD_FAIL;
+        }
+        m_buffer.Clear();
+    }
+
+    SnapshotStreamLoader::~SnapshotStreamLoader()
+    {
+        Abort();
+    }
+
     int Snapshot::BackupSave()
     {
         struct BGTask: public Thread
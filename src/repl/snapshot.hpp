@@ -37,6 +37,7 @@
 #include "db/codec.hpp"
 #include "db/db_utils.hpp"
 #include "thread/thread_mutex_lock.hpp"
+#include "util/uring.h"
 
 namespace ardb
 {
@@ -51,6 +52,7 @@ namespace ardb
     };
     class Snapshot;
     typedef int SnapshotRoutine(SnapshotState state, Snapshot* snapshot, void* cb);
+    typedef int SnapshotStreamSink(const void* buf, size_t buflen, void* data);
 
     class ObjectIO
     {
@@ -58,6 +60,7 @@ namespace ardb
 
             typedef TreeMap<StreamID, unsigned char *>::Type ListPackTree;
             DBWriter* m_dbwriter;
+            uint8 m_ardb_key_format;  //key format of loading ardb raw data
             virtual bool Read(void* buf, size_t buflen, bool cksm = true) = 0;
             virtual int Write(const void* buf, size_t buflen) = 0;
             virtual int64_t WriteSeek(int64_t pos) = 0;
@@ -73,6 +76,7 @@ namespace ardb
             int WriteLzfStringObject(const char *s, size_t len);
             int WriteTime(time_t t);
             int WriteStringObject(const Data& o);
+            int64 WriteCompactElements(const ValueObject& meta);
 
             int ReadType();
             time_t ReadTime();
@@ -104,13 +108,17 @@ namespace ardb
             DBWriter& GetDBWriter();
         public:
             ObjectIO() :
-                    m_dbwriter(NULL)
+                    m_dbwriter(NULL), m_ardb_key_format(KEY_FORMAT_LEGACY)
             {
             }
             void SetDBWriter(DBWriter* writer)
             {
                 m_dbwriter = writer;
             }
+            void SetArdbKeyFormat(uint8 format)
+            {
+                m_ardb_key_format = format;
+            }
             int ArdbSaveRawKeyValue(const Slice& key, const Slice& value, Buffer& buffer, int64 ttl);
             int ArdbFlushWriteBuffer(Buffer& buffer);
             virtual ~ObjectIO()
@@ -151,6 +159,7 @@ namespace ardb
         protected:
             FILE* m_read_fp;
             FILE* m_write_fp;
+            uring_writer_t* m_write_ring;
             std::string m_file_path;
             uint64 m_cksm;
             SnapshotRoutine* m_routine_cb;
@@ -171,6 +180,8 @@ namespace ardb
             SnapshotType m_type;
 
             const void* m_engine_snapshot;
+            SnapshotStreamSink* m_stream_sink;
+            void* m_stream_sink_data;
             bool Read(void* buf, size_t buflen, bool cksm);
 
             int RedisLoad();
@@ -228,6 +239,12 @@ namespace ardb
             int Reload(SnapshotRoutine* cb, void *data);
             int Save(SnapshotType type, const std::string& file, SnapshotRoutine* cb, void *data);
             int BGSave(SnapshotType type, const std::string& file, SnapshotRoutine* cb = NULL, void *data = NULL);
+            /*
+             * diskless save, the dump content is written to 'sink' instead of a file, the sink is called
+             * with NULL buf once the background save is finished.
+             */
+            int PrepareStreamSave(SnapshotType type, SnapshotStreamSink* sink, void* sink_data, SnapshotRoutine* cb, void *data);
+            int BGStreamSave();
 
             void Flush();
             void Remove();
@@ -242,6 +259,38 @@ namespace ardb
             static std::string GetSyncSnapshotPath(SnapshotType type, uint64 offset, uint64 cksm);
     };
 
+    /*
+     * Load an ardb snapshot stream record by record while it is still arriving, records split
+     * by the feeding boundary are kept until the rest is fed.
+     */
+    class SnapshotStreamLoader: public ObjectIO
+    {
+        private:
+            Buffer m_buffer;
+            Context m_loadctx;
+            uint64 m_cksm;
+            uint64 m_loaded_bytes;
+            uint8 m_state;
+            bool m_short_read;
+            bool Read(void* buf, size_t buflen, bool cksm);
+            int Write(const void* buf, size_t buflen);
+            int64_t WriteSeek(int64_t pos);
+            int64_t GetWritePos();
+            int LoadRecord();
+            int LoadChunk(int type);
+        public:
+            SnapshotStreamLoader();
+            int Begin();
+            int Feed(const void* data, size_t len);
+            bool IsComplete() const;
+            uint64 LoadedBytes() const
+            {
+                return m_loaded_bytes;
+            }
+            void Abort();
+            ~SnapshotStreamLoader();
+    };
+
     class SnapshotManager
     {
         private:
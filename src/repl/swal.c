@@ -36,6 +36,7 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include "swal.h"
+#include "util/uring.h"
 
 #define SWAL_META_SIZE 1024
 
@@ -47,10 +48,29 @@ typedef struct swal_meta_t
     uint64_t cksm;
 } swal_meta_t;
 
+/*
+ * cksm checkpoints are stored after the user meta, slot 'i' holds the checkpoint at offset
+ * (k * interval) with (k % count == i), the slots cover more than 'max_file_size' bytes of log.
+ */
+typedef struct swal_cksm_ckpt_t
+{
+    size_t offset;
+    uint64_t cksm;
+} swal_cksm_ckpt_t;
+
+typedef struct swal_cksm_ckpt_table_t
+{
+    size_t interval;
+    size_t count;
+    swal_cksm_ckpt_t ckpts[];
+} swal_cksm_ckpt_table_t;
+
 struct swal_t
 {
     char* dir;
     swal_meta_t* meta;
+    swal_cksm_ckpt_table_t* ckpt_table;
+    size_t meta_size;
     swal_options_t options;
     int fd;
     void* mmap_buf;
@@ -59,6 +79,10 @@ struct swal_t
     //size_t ring_cache_end_offset;
     size_t ring_cache_idx;
     time_t last_replay_time;
+#ifdef HAVE_IO_URING
+    uring_t* ring;
+#endif
+    int sync_inflight;
 };
 
 swal_options_t* swal_options_create()
@@ -159,14 +183,41 @@ int swal_open(const char* dir, const swal_options_t* options, swal_t** wal)
         swal_close(wal_log);
         return SWAL_ERR_META_OPEN_FAIL;
     }
-    if (-1 == ftruncate(meta_fd, options->user_meta_size + SWAL_META_SIZE))
+    size_t ckpt_count = 0;
+    wal_log->meta_size = options->user_meta_size + SWAL_META_SIZE;
+    if (options->cksm_checkpoint_interval > 0)
+    {
+        ckpt_count = options->max_file_size / options->cksm_checkpoint_interval + 2;
+        wal_log->meta_size += sizeof(swal_cksm_ckpt_table_t) + ckpt_count * sizeof(swal_cksm_ckpt_t);
+    }
+    if (-1 == ftruncate(meta_fd, wal_log->meta_size))
+    {
+        close(meta_fd);
+        swal_close(wal_log);
+        return SWAL_ERR_META_OPEN_FAIL;
+    }
+    swal_meta_t* meta = (swal_meta_t*) mmap(NULL, wal_log->meta_size, mmap_mode, MAP_SHARED, meta_fd, 0);
+    close(meta_fd);
+    if (MAP_FAILED == meta)
     {
         swal_close(wal_log);
         return SWAL_ERR_META_OPEN_FAIL;
     }
-    swal_meta_t* meta = (swal_meta_t*) mmap(NULL, options->user_meta_size + SWAL_META_SIZE, mmap_mode, MAP_SHARED, meta_fd, 0);
     wal_log->meta = meta;
     wal_log->options = *options;
+    if (ckpt_count > 0)
+    {
+        wal_log->ckpt_table = (swal_cksm_ckpt_table_t*) ((char*) meta + SWAL_META_SIZE + options->user_meta_size);
+        if (wal_log->ckpt_table->interval != options->cksm_checkpoint_interval || wal_log->ckpt_table->count != ckpt_count)
+        {
+            /*
+             * created by old version or with different interval, checkpoints are rebuilt as the log grows
+             */
+            memset(wal_log->ckpt_table->ckpts, 0, ckpt_count * sizeof(swal_cksm_ckpt_t));
+            wal_log->ckpt_table->interval = options->cksm_checkpoint_interval;
+            wal_log->ckpt_table->count = ckpt_count;
+        }
+    }
     int err = open_wal_logfile(wal_log);
     if (0 != err)
     {
@@ -198,6 +249,68 @@ void* swal_user_meta(swal_t* wal)
     return meta + SWAL_META_SIZE;
 }
 
+static void swal_update_cksm(swal_t* wal, size_t offset, const unsigned char* log, size_t loglen)
+{
+    swal_cksm_ckpt_table_t* table = wal->ckpt_table;
+    if (NULL == table)
+    {
+        wal->meta->cksm = wal->options.cksm_func(wal->meta->cksm, log, loglen);
+        return;
+    }
+    while (loglen)
+    {
+        /*
+         * split the log at checkpoint boundaries to record the cksm there
+         */
+        size_t next = (offset / table->interval + 1) * table->interval;
+        size_t thislen = next - offset;
+        if (thislen > loglen)
+            thislen = loglen;
+        wal->meta->cksm = wal->options.cksm_func(wal->meta->cksm, log, thislen);
+        offset += thislen;
+        log += thislen;
+        loglen -= thislen;
+        if (offset == next)
+        {
+            swal_cksm_ckpt_t* ckpt = &table->ckpts[(next / table->interval) % table->count];
+            ckpt->offset = next;
+            ckpt->cksm = wal->meta->cksm;
+        }
+    }
+}
+
+int swal_cksm_checkpoint(swal_t* wal, size_t offset, int forward, size_t* ckpt_offset, uint64_t* ckpt_cksm)
+{
+    if (offset < wal->meta->log_start_offset || offset > wal->meta->log_end_offset)
+    {
+        return SWAL_ERR_INVALID_OFFSET;
+    }
+    swal_cksm_ckpt_table_t* table = wal->ckpt_table;
+    if (NULL != table)
+    {
+        size_t k = offset / table->interval;
+        if (forward && k * table->interval < offset)
+        {
+            k++;
+        }
+        size_t pos = k * table->interval;
+        swal_cksm_ckpt_t* ckpt = &table->ckpts[k % table->count];
+        if (pos >= wal->meta->log_start_offset && pos <= wal->meta->log_end_offset && ckpt->offset == pos)
+        {
+            *ckpt_offset = ckpt->offset;
+            *ckpt_cksm = ckpt->cksm;
+            return 0;
+        }
+    }
+    if (forward)
+    {
+        *ckpt_offset = wal->meta->log_end_offset;
+        *ckpt_cksm = wal->meta->cksm;
+        return 0;
+    }
+    return -1;
+}
+
 int swal_append(swal_t* wal, const void* log, size_t loglen)
 {
     if (NULL == wal)
@@ -232,7 +345,7 @@ int swal_append(swal_t* wal, const void* log, size_t loglen)
     }
     if (NULL != wal->options.cksm_func)
     {
-        wal->meta->cksm = wal->options.cksm_func(wal->meta->cksm, (const unsigned char*) log, loglen);
+        swal_update_cksm(wal, wal->meta->log_end_offset - loglen, (const unsigned char*) log, loglen);
     }
     if (NULL != wal->ring_cache)
     {
@@ -260,12 +373,82 @@ int swal_append(swal_t* wal, const void* log, size_t loglen)
     }
     return 0;
 }
+#ifdef HAVE_IO_URING
+static int swal_reap_sync(swal_t* wal, int wait)
+{
+    while (wal->sync_inflight > 0)
+    {
+        struct io_uring_cqe* cqe = NULL;
+        if (wait)
+        {
+            if (uring_wait_cqe(wal->ring, &cqe) < 0)
+            {
+                return -1;
+            }
+        }
+        else
+        {
+            cqe = uring_peek_cqe(wal->ring);
+            if (NULL == cqe)
+            {
+                return 0;
+            }
+        }
+        uring_cqe_seen(wal->ring);
+        wal->sync_inflight--;
+    }
+    return 0;
+}
+
+static int swal_async_sync(swal_t* wal)
+{
+    if (NULL == wal->ring)
+    {
+        wal->ring = uring_create(4);
+        if (NULL == wal->ring)
+        {
+            wal->options.async_sync = 0;
+            return -1;
+        }
+    }
+    swal_reap_sync(wal, 0);
+    if (wal->sync_inflight > 0)
+    {
+        /*
+         * previous sync still running, the data appended since then would be synced by next call
+         */
+        return 0;
+    }
+    struct io_uring_sqe* sqe = uring_get_sqe(wal->ring);
+    if (NULL == sqe)
+    {
+        return -1;
+    }
+    sqe->opcode = IORING_OP_FSYNC;
+    sqe->fd = wal->fd;
+    sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+    if (uring_submit(wal->ring, 0) < 0)
+    {
+        return -1;
+    }
+    wal->sync_inflight++;
+    return 0;
+}
+#endif
+
 int swal_sync(swal_t* wal)
 {
     if (NULL == wal)
     {
         return -1;
     }
+#ifdef HAVE_IO_URING
+    if (wal->options.async_sync && uring_enabled() && 0 == swal_async_sync(wal))
+    {
+        return 0;
+    }
+    swal_reap_sync(wal, 1);
+#endif
     fdatasync(wal->fd);
     return 0;
 }
@@ -275,7 +458,7 @@ int swal_sync_meta(swal_t* wal)
     {
         return -1;
     }
-    msync(wal->meta, wal->options.user_meta_size + SWAL_META_SIZE, 0);
+    msync(wal->meta, wal->meta_size, 0);
     return 0;
 }
 
@@ -368,6 +551,31 @@ int swal_replay(swal_t* wal, size_t offset, int64_t limit_len, swal_replay_logfu
     }
     return 0;
 }
+int swal_file_segment(swal_t* wal, size_t offset, int* fd, size_t* file_pos, size_t* len)
+{
+    if (offset < wal->meta->log_start_offset || offset > wal->meta->log_end_offset)
+    {
+        return SWAL_ERR_INVALID_OFFSET;
+    }
+    size_t data_len = wal->meta->log_end_offset - offset;
+    size_t start_pos;
+    if (wal->meta->log_file_pos >= data_len)
+    {
+        start_pos = wal->meta->log_file_pos - data_len;
+    }
+    else
+    {
+        start_pos = wal->options.max_file_size - data_len + wal->meta->log_file_pos;
+    }
+    *fd = wal->fd;
+    *file_pos = start_pos;
+    *len = data_len;
+    if (start_pos + data_len > wal->options.max_file_size)
+    {
+        *len = wal->options.max_file_size - start_pos;
+    }
+    return 0;
+}
 int swal_clear_replay_cache(swal_t* wal)
 {
     if (NULL != wal->mmap_buf)
@@ -385,6 +593,10 @@ int swal_reset(swal_t* wal, size_t offset, uint64_t cksm)
     wal->meta->log_end_offset = offset;
     wal->meta->log_file_pos = 0;
     wal->meta->cksm = cksm;
+    if (NULL != wal->ckpt_table)
+    {
+        memset(wal->ckpt_table->ckpts, 0, wal->ckpt_table->count * sizeof(swal_cksm_ckpt_t));
+    }
     if (NULL != wal->ring_cache)
     {
         wal->ring_cache_start_offset = offset;
@@ -414,6 +626,14 @@ int swal_close(swal_t* wal)
     {
         return -1;
     }
+#ifdef HAVE_IO_URING
+    if (NULL != wal->ring)
+    {
+        swal_reap_sync(wal, 1);
+        uring_destroy(wal->ring);
+        wal->ring = NULL;
+    }
+#endif
     if (-1 != wal->fd)
     {
         close(wal->fd);
@@ -425,7 +645,7 @@ int swal_close(swal_t* wal)
     }
     if (NULL != wal->meta)
     {
-        munmap(wal->meta, wal->options.user_meta_size + SWAL_META_SIZE);
+        munmap(wal->meta, wal->meta_size);
     }
     swal_clear_replay_cache(wal);
     free(wal->dir);
@@ -53,6 +53,8 @@ extern "C"
             size_t ring_cache_size;
             swal_cksm_func* cksm_func;
             const char* log_prefix;
+            int async_sync; /* issue fdatasync through io_uring without blocking the caller if available */
+            size_t cksm_checkpoint_interval; /* record the cksm at every N bytes of log in meta, 0 to disable */
     } swal_options_t;
     swal_options_t* swal_options_create();
     void swal_options_destroy(swal_options_t* options);
@@ -67,8 +69,18 @@ extern "C"
     typedef size_t swal_replay_logfunc(const void* log, size_t loglen, void* data);
     int swal_replay(swal_t* wal, size_t offset, int64_t limit_len, swal_replay_logfunc func, void* data);
     int swal_clear_replay_cache(swal_t* wal);
+    /*
+     * locate the log at 'offset' in the log file, 'len' is the contiguous bytes from 'file_pos' to the log end
+     * or the end of the file, the file content could be sent directly by sendfile.
+     */
+    int swal_file_segment(swal_t* wal, size_t offset, int* fd, size_t* file_pos, size_t* len);
     int swal_reset(swal_t* wal, size_t offset, uint64_t cksm);
     uint64_t swal_cksm(swal_t* wal);
+    /*
+     * find the nearest cksm checkpoint before(forward == 0) or after(forward != 0) the offset inside the log,
+     * the log end is always a checkpoint after any valid offset.
+     */
+    int swal_cksm_checkpoint(swal_t* wal, size_t offset, int forward, size_t* ckpt_offset, uint64_t* ckpt_cksm);
     size_t swal_start_offset(swal_t* wal);
     size_t swal_end_offset(swal_t* wal);
     int swal_close(swal_t* wal);
@@ -0,0 +1,186 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Micro benchmark of the event loop backends: ping-pong over socket pairs served by one loop,
+ * every backend supported by the running kernel reports round trips & loop iterations per second.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/socket.h>
+#include <vector>
+#include "channel/redis/ae.h"
+#include "util/uring.h"
+#include "util/time_helper.hpp"
+
+using namespace ardb;
+
+struct BenchState
+{
+        std::vector<int> peers;
+        std::vector<bool> clients;
+        uint64 round_trips;
+        uint64 limit;
+        uint64 iterations;
+        BenchState() :
+                round_trips(0), limit(0), iterations(0)
+        {
+        }
+};
+
+static void on_readable(aeEventLoop* el, int fd, void* data, int mask)
+{
+    BenchState* state = (BenchState*) data;
+    char buf[64];
+    ssize_t n = read(fd, buf, sizeof(buf));
+    if (n <= 0)
+    {
+        return;
+    }
+    /*
+     * a round trip completes when the echo comes back to the client side
+     */
+    if (state->clients[fd] && ++state->round_trips >= state->limit)
+    {
+        aeStop(el);
+        return;
+    }
+    if (write(fd, buf, n) != n)
+    {
+        aeStop(el);
+    }
+}
+
+static BenchState* g_state = NULL;
+
+static void before_sleep(aeEventLoop* el)
+{
+    g_state->iterations++;
+}
+
+static bool bench_backend(bool uring, int conns, uint64 round_trips)
+{
+    uring_enable(uring ? 1 : 0);
+    aeEventLoop* el = aeCreateEventLoop(conns * 2 + 64);
+    if (NULL == el)
+    {
+        return false;
+    }
+    if (uring && !el->apiuring)
+    {
+        printf("    %-10s not supported by current system\n", "io_uring");
+        aeDeleteEventLoop(el);
+        return true;
+    }
+    BenchState state;
+    state.limit = round_trips;
+    state.peers.resize(el->setsize, -1);
+    state.clients.resize(el->setsize, false);
+    std::vector<int> clients;
+    for (int i = 0; i < conns; i++)
+    {
+        int pair[2];
+        if (0 != socketpair(AF_UNIX, SOCK_STREAM, 0, pair))
+        {
+            break;
+        }
+        for (int k = 0; k < 2; k++)
+        {
+            fcntl(pair[k], F_SETFL, fcntl(pair[k], F_GETFL) | O_NONBLOCK);
+            aeCreateFileEvent(el, pair[k], AE_READABLE, on_readable, &state);
+        }
+        state.peers[pair[0]] = pair[1];
+        state.peers[pair[1]] = pair[0];
+        state.clients[pair[1]] = true;
+        clients.push_back(pair[1]);
+    }
+    g_state = &state;
+    aeSetBeforeSleepProc(el, before_sleep);
+    uint64 start = get_current_epoch_micros();
+    for (size_t i = 0; i < clients.size(); i++)
+    {
+        if (write(clients[i], "p", 1) != 1)
+        {
+            break;
+        }
+    }
+    aeMain(el);
+    uint64 cost = get_current_epoch_micros() - start;
+    if (0 == cost)
+    {
+        cost = 1;
+    }
+    printf("    %-10s %12.0f round trips/s %12.0f iterations/s\n", uring ? "io_uring" : "epoll",
+            (double) state.round_trips * 1000000 / cost, (double) state.iterations * 1000000 / cost);
+    for (size_t fd = 0; fd < state.peers.size(); fd++)
+    {
+        if (state.peers[fd] >= 0)
+        {
+            aeDeleteFileEvent(el, fd, AE_READABLE);
+            close(fd);
+        }
+    }
+    aeDeleteEventLoop(el);
+    return state.round_trips >= round_trips;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<int> conns;
+    for (int i = 1; i < argc; i++)
+    {
+        long n = strtol(argv[i], NULL, 10);
+        if (n <= 0 || n > 4096)
+        {
+            fprintf(stderr, "Usage: ./ardb-ae-bench [connections ...]\n");
+            return 1;
+        }
+        conns.push_back(n);
+    }
+    if (conns.empty())
+    {
+        conns.push_back(1);
+        conns.push_back(64);
+        conns.push_back(1024);
+    }
+    int failed = 0;
+    for (size_t k = 0; k < conns.size(); k++)
+    {
+        printf("Connections:%d\n", conns[k]);
+        for (int uring = 0; uring < 2; uring++)
+        {
+            if (!bench_backend(uring != 0, conns[k], 1000000))
+            {
+                failed++;
+            }
+        }
+    }
+    return failed > 0 ? 1 : 0;
+}
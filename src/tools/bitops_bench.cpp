@@ -0,0 +1,184 @@
+/*
+ *Copyright (c) 2013-2016, yinqiwen <yinqiwen@gmail.com>
+ *All rights reserved.
+ *
+ *Redistribution and use in source and binary forms, with or without
+ *modification, are permitted provided that the following conditions are met:
+ *
+ *  * Redistributions of source code must retain the above copyright notice,
+ *    this list of conditions and the following disclaimer.
+ *  * Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ *  * Neither the name of Redis nor the names of its contributors may be used
+ *    to endorse or promote products derived from this software without
+ *    specific prior written permission.
+ *
+ *THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ *AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ *IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ *ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT OWNER OR CONTRIBUTORS
+ *BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+ *CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+ *SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+ *INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+ *CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+ *ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+ *THE POSSIBILITY OF SUCH DAMAGE.
+ */
+/*
+ * Micro benchmark of the BITCOUNT/BITOP/BITPOS kernels, every kernel supported by the
+ * current cpu is verified against the scalar one and reported in MB/s.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <string>
+#include <vector>
+#include "util/bit_helper.hpp"
+#include "util/time_helper.hpp"
+
+using namespace ardb;
+
+static volatile uint64 g_sink = 0;
+
+static void fill_random(std::string& buf)
+{
+    for (size_t i = 0; i < buf.size(); i++)
+    {
+        buf[i] = (char) (random() & 0xFF);
+    }
+}
+
+static double mbps(size_t bytes, uint64 loops, uint64 cost_micros)
+{
+    if (0 == cost_micros)
+    {
+        cost_micros = 1;
+    }
+    return (double) bytes * loops / cost_micros;
+}
+
+static uint64 loops_for(size_t bytes)
+{
+    uint64 loops = (256 * 1024 * 1024) / bytes;
+    return loops > 0 ? loops : 1;
+}
+
+static bool bench_popcount(const std::string& src, uint64 expected)
+{
+    uint64 loops = loops_for(src.size());
+    uint64 start = get_current_epoch_micros();
+    uint64 bits = 0;
+    for (uint64 i = 0; i < loops; i++)
+    {
+        bits = bit_popcount(src.data(), src.size());
+        g_sink += bits;
+    }
+    uint64 cost = get_current_epoch_micros() - start;
+    printf("    %-10s %10.1f MB/s\n", "bitcount", mbps(src.size(), loops, cost));
+    return bits == expected;
+}
+
+static bool bench_operate(int op, const char* name, const std::string& a, const std::string& b, const std::string& expected)
+{
+    uint64 loops = loops_for(a.size());
+    std::string dst = a;
+    uint64 start = get_current_epoch_micros();
+    for (uint64 i = 0; i < loops; i++)
+    {
+        bit_operate(op, &dst[0], b.data(), dst.size());
+    }
+    uint64 cost = get_current_epoch_micros() - start;
+    printf("    %-10s %10.1f MB/s\n", name, mbps(a.size(), loops, cost));
+    dst = a;
+    bit_operate(op, &dst[0], b.data(), dst.size());
+    return dst == expected;
+}
+
+static bool bench_skip(const std::string& zeros, size_t expected)
+{
+    uint64 loops = loops_for(zeros.size());
+    size_t skipped = 0;
+    uint64 start = get_current_epoch_micros();
+    for (uint64 i = 0; i < loops; i++)
+    {
+        skipped = bit_skip_bytes(zeros.data(), zeros.size(), 0);
+        g_sink += skipped;
+    }
+    uint64 cost = get_current_epoch_micros() - start;
+    printf("    %-10s %10.1f MB/s\n", "bitpos", mbps(zeros.size(), loops, cost));
+    return skipped == expected;
+}
+
+int main(int argc, char** argv)
+{
+    std::vector<size_t> sizes;
+    for (int i = 1; i < argc; i++)
+    {
+        long size = strtol(argv[i], NULL, 10);
+        if (size <= 0)
+        {
+            fprintf(stderr, "Usage: ./ardb-bitops-bench [bytes ...]\n");
+            return 1;
+        }
+        sizes.push_back(size);
+    }
+    if (sizes.empty())
+    {
+        sizes.push_back(4096 + 3);
+        sizes.push_back(1024 * 1024);
+        sizes.push_back(16 * 1024 * 1024);
+    }
+    printf("Detected kernel:%s\n", bit_kernel_name(bit_kernel_current()));
+    int detected = bit_kernel_current();
+    int failed = 0;
+    static const char* op_names[] = { "and", "or", "xor", "not" };
+    for (size_t k = 0; k < sizes.size(); k++)
+    {
+        std::string a(sizes[k], 0), b(sizes[k], 0), zeros(sizes[k], 0);
+        fill_random(a);
+        fill_random(b);
+        zeros[zeros.size() - 1] = 1;
+
+        /*
+         * scalar results are the reference of other kernels
+         */
+        bit_kernel_select(BIT_KERNEL_SCALAR);
+        uint64 expected_bits = bit_popcount(a.data(), a.size());
+        std::string expected_ops[4];
+        for (int op = BIT_OP_AND; op <= BIT_OP_NOT; op++)
+        {
+            expected_ops[op] = a;
+            bit_operate(op, &expected_ops[op][0], b.data(), a.size());
+        }
+        for (int kernel = BIT_KERNEL_SCALAR; kernel < BIT_KERNEL_MAX; kernel++)
+        {
+            if (!bit_kernel_select(kernel))
+            {
+                continue;
+            }
+            printf("%s kernel with %lu bytes:\n", bit_kernel_name(kernel), (unsigned long) sizes[k]);
+            if (!bench_popcount(a, expected_bits))
+            {
+                printf("    bitcount result mismatch\n");
+                failed++;
+            }
+            for (int op = BIT_OP_AND; op <= BIT_OP_NOT; op++)
+            {
+                if (!bench_operate(op, op_names[op], a, b, expected_ops[op]))
+                {
+                    printf("    %s result mismatch\n", op_names[op]);
+                    failed++;
+                }
+            }
+            if (!bench_skip(zeros, zeros.size() - 1))
+            {
+                printf("    bitpos result mismatch\n");
+                failed++;
+            }
+        }
+    }
+    bit_kernel_select(detected);
+    return failed > 0 ? 1 : 0;
+}
@@ -249,6 +249,28 @@ OP_NAMESPACE_BEGIN
         return v;
     }
 
+    int64 Data::GetIntegerPart() const
+    {
+        if (IsInteger())
+        {
+            return GetInt64();
+        }
+        double v = GetFloat64();
+        if (v >= 9223372036854775807.0)
+        {
+            return INT64_MAX;
+        }
+        if (v <= -9223372036854775808.0)
+        {
+            return INT64_MIN;
+        }
+        if (std::isnan(v))
+        {
+            return 0;
+        }
+        return (int64) v;
+    }
+
     void Data::Clone(const Data& other)
     {
         Clear();
@@ -276,15 +298,23 @@ OP_NAMESPACE_BEGIN
         {
             if (IsInteger() && right.IsInteger())
             {
-                int64_t cmp = GetInt64() - right.GetInt64();
-                return cmp > 0 ? 1 : (cmp < 0 ? -1 : 0);
+                int64_t v1 = GetInt64(), v2 = right.GetInt64();
+                return v1 < v2 ? -1 : (v1 > v2 ? 1 : 0);
             }
             if (IsNumber() && right.IsNumber())
             {
                 double v1, v2;
                 v1 = GetFloat64();
                 v2 = right.GetFloat64();
-                return v1 > v2 ? 1 : (v1 < v2 ? -1 : 0);
+                if (v1 != v2)
+                {
+                    return v1 > v2 ? 1 : -1;
+                }
+                /*
+                 * integers beyond 2^53 may be equal as double, compare the integer parts as the comparable key does
+                 */
+                int64_t i1 = GetIntegerPart(), i2 = right.GetIntegerPart();
+                return i1 < i2 ? -1 : (i1 > i2 ? 1 : 0);
             }
             //number is always less than text value in non alpha comparator
             if (IsNumber())
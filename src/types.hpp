@@ -195,6 +195,10 @@ OP_NAMESPACE_BEGIN
             void SetFloat64(double v);
             int64 GetInt64() const;
             double GetFloat64() const;
+            /*
+             * integer part of a number, clamped to int64 range
+             */
+            int64 GetIntegerPart() const;
 
             void Clone(const Data& data);
             int Compare(const Data& other, bool alpha_cmp = false) const;
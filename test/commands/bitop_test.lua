@@ -10,4 +10,66 @@ ardb.assert2(s == 0, s)
 s = ardb.call("getbit", "mykey", "7")
 ardb.assert2(s == 1, s)
 s = ardb.call("setbit", "mykey", "7", "0")
-ardb.assert2(s == 1, s)
\ No newline at end of file
+ardb.assert2(s == 1, s)
+
+--[[  segmented bitmap test  --]]
+ardb.call("del", "bigbits")
+s = ardb.call("setbit", "bigbits", "1000000", "1")
+ardb.assert2(s == 0, s)
+s = ardb.call("setbit", "bigbits", "7", "1")
+ardb.assert2(s == 0, s)
+s = ardb.call("setbit", "bigbits", "1000000", "1")
+ardb.assert2(s == 1, s)
+s = ardb.call("strlen", "bigbits")
+ardb.assert2(s == 125001, s)
+s = ardb.call("getbit", "bigbits", "1000000")
+ardb.assert2(s == 1, s)
+s = ardb.call("getbit", "bigbits", "999999")
+ardb.assert2(s == 0, s)
+s = ardb.call("bitcount", "bigbits")
+ardb.assert2(s == 2, s)
+s = ardb.call("bitcount", "bigbits", "1", "-1")
+ardb.assert2(s == 1, s)
+s = ardb.call("bitpos", "bigbits", "1", "1")
+ardb.assert2(s == 1000000, s)
+s = ardb.call("bitpos", "bigbits", "0")
+ardb.assert2(s == 0, s)
+s = ardb.call("setbit", "bigbits", "1000000", "0")
+ardb.assert2(s == 1, s)
+s = ardb.call("bitpos", "bigbits", "1", "1")
+ardb.assert2(s == -1, s)
+s = ardb.call("bitop", "or", "bigdest", "bigbits", "key1")
+ardb.assert2(s == 125001, s)
+s = ardb.call("getrange", "bigdest", "1", "5")
+ardb.assert2(s == "oobar", s)
+s = ardb.call("bitcount", "bigdest")
+ardb.assert2(s == 27, s)
+ardb.call("del", "bigbits", "bigdest")
+s = ardb.call("exists", "bigbits")
+ardb.assert2(s == 0, s)
+
+--[[  long bitmap test, covers vector kernels and the zero padded tails  --]]
+ardb.call("set", "vecbits1", string.rep("\255", 100))
+ardb.call("set", "vecbits2", string.rep("\15", 37))
+ardb.call("set", "vecbits3", string.rep("\0", 99) .. "\1")
+s = ardb.call("bitop", "and", "vecdest", "vecbits1", "vecbits2")
+ardb.assert2(s == 100, s)
+s = ardb.call("bitcount", "vecdest")
+ardb.assert2(s == 148, s)
+s = ardb.call("bitop", "xor", "vecdest", "vecbits1", "vecbits2")
+ardb.assert2(s == 100, s)
+s = ardb.call("bitcount", "vecdest")
+ardb.assert2(s == 652, s)
+s = ardb.call("bitop", "or", "vecdest", "vecbits2", "vecbits3", "vecbits2")
+ardb.assert2(s == 100, s)
+s = ardb.call("bitcount", "vecdest")
+ardb.assert2(s == 149, s)
+s = ardb.call("bitop", "not", "vecdest", "vecbits2")
+ardb.assert2(s == 37, s)
+s = ardb.call("bitcount", "vecdest")
+ardb.assert2(s == 148, s)
+s = ardb.call("bitpos", "vecbits3", "1")
+ardb.assert2(s == 799, s)
+s = ardb.call("bitpos", "vecbits1", "0")
+ardb.assert2(s == 800, s)
+ardb.call("del", "vecbits1", "vecbits2", "vecbits3", "vecdest")
@@ -96,3 +96,29 @@ if ardb.is_merge_supported() then
     s = ardb.call("hget", "myhash", "f1")
     ardb.assert2(s == "32", s)
 end
+
+-- small hashes are kept compact and expand once a value gets too long or fields grow
+ardb.call("del", "myhash")
+s = ardb.call("hmset", "myhash", "f0", "v0", "f1", "v1", "f2", "3")
+ardb.assert2(s["ok"] == "OK", s)
+s = ardb.call("hincrby", "myhash", "f2", "4")
+ardb.assert2(s == 7, s)
+s = ardb.call("hdel", "myhash", "f0", "fx")
+ardb.assert2(s == 1, s)
+s = ardb.call("hset", "myhash", "f3", string.rep("x", 100))
+ardb.assert2(s == 1, s)
+s = ardb.call("hlen", "myhash")
+ardb.assert2(s == 3, s)
+s = ardb.call("hget", "myhash", "f1")
+ardb.assert2(s == "v1", s)
+s = ardb.call("hget", "myhash", "f3")
+ardb.assert2(string.len(s) == 100, s)
+ardb.call("del", "myhash")
+for i = 0, 199 do
+    ardb.call("hset", "myhash", "field" .. i, "value" .. i)
+end
+s = ardb.call("hlen", "myhash")
+ardb.assert2(s == 200, s)
+s = ardb.call("hget", "myhash", "field150")
+ardb.assert2(s == "value150", s)
+ardb.call("del", "myhash")
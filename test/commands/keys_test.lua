@@ -1,3 +1,61 @@
 --[[   --]]
 local s = ardb.call("echo", "hello,world")
-ardb.assert2(s == "hello,world", s)
\ No newline at end of file
+ardb.assert2(s == "hello,world", s)
+
+--[[  expire index test  --]]
+local function expire_index_keys()
+    local info = ardb.call("info", "stats")
+    return tonumber(string.match(info, "expire_index_keys:(%d+)"))
+end
+ardb.call("del", "expkey")
+local n = expire_index_keys()
+ardb.call("set", "expkey", "v", "ex", "1000")
+s = expire_index_keys()
+ardb.assert2(s == n + 1, s)
+ardb.call("pexpire", "expkey", "2000000")
+s = expire_index_keys()
+ardb.assert2(s == n + 1, s)
+s = ardb.call("persist", "expkey")
+s = expire_index_keys()
+ardb.assert2(s == n, s)
+ardb.call("expire", "expkey", "1000")
+ardb.call("del", "expkey")
+s = expire_index_keys()
+ardb.assert2(s == n, s)
+
+--[[  key encoding order & round trip test, collections are larger than the compact limit to be stored in keys  --]]
+local codec_fillers = 200
+ardb.call("del", "codecset")
+ardb.call("sadd", "codecset", "abc", "ab\0c", "ab", "1.5", "10", "9", "-3", "9223372036854775807", "-9223372036854775808", "9007199254740993", "9007199254740992")
+for i = 1, codec_fillers do
+    ardb.call("sadd", "codecset", string.format("zz%03d", i))
+end
+s = ardb.call("smembers", "codecset")
+local expected = {"-9223372036854775808", "-3", "9", "10", "9007199254740992", "9007199254740993", "9223372036854775807", "1.5", "ab", "ab\0c", "abc"}
+ardb.assert2(#s == #expected + codec_fillers, #s)
+for i = 1, #expected do
+    ardb.assert2(s[i] == expected[i], s[i])
+end
+ardb.call("del", "codecset")
+
+ardb.call("del", "codechash")
+ardb.call("hset", "codechash", "f\0\0x", "v2")
+ardb.call("hset", "codechash", "f", "v1")
+for i = 1, codec_fillers do
+    ardb.call("hset", "codechash", string.format("zz%03d", i), "v")
+end
+s = ardb.call("hgetall", "codechash")
+ardb.assert2(#s == 4 + 2 * codec_fillers and s[1] == "f" and s[2] == "v1" and s[3] == "f\0\0x" and s[4] == "v2", s)
+s = ardb.call("hget", "codechash", "f\0\0x")
+ardb.assert2(s == "v2", s)
+ardb.call("del", "codechash")
+
+ardb.call("del", "codeckey", "codeckey\0", "codeckeya")
+ardb.call("set", "codeckeya", "v3")
+ardb.call("set", "codeckey\0", "v2")
+ardb.call("set", "codeckey", "v1")
+s = ardb.call("keys", "codeckey*")
+ardb.assert2(#s == 3 and s[1] == "codeckey" and s[2] == "codeckey\0" and s[3] == "codeckeya", s)
+s = ardb.call("get", "codeckey\0")
+ardb.assert2(s == "v2", s)
+ardb.call("del", "codeckey", "codeckey\0", "codeckeya")
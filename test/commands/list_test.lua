@@ -124,3 +124,38 @@ vs = ardb.call("lrange", "destlist", "0", "-1")
 ardb.assert2(table.getn(vs) == 1, vs)
 ardb.assert2(vs[1] == "three", vs)
 
+
+--[[  list spanning several chunks --]]
+ardb.call("del", "biglist")
+for i = 1, 300 do
+    ardb.call("rpush", "biglist", "v" .. i)
+end
+ardb.call("lpush", "biglist", "v0")
+s = ardb.call("lindex", "biglist", "200")
+ardb.assert2(s == "v200", s)
+ardb.call("lset", "biglist", "150", "x")
+s = ardb.call("lindex", "biglist", "150")
+ardb.assert2(s == "x", s)
+s = ardb.call("linsert", "biglist", "before", "v100", "ins")
+ardb.assert2(s == 302, s)
+s = ardb.call("lindex", "biglist", "101")
+ardb.assert2(s == "v100", s)
+vs = ardb.call("lrange", "biglist", "127", "129")
+ardb.assert2(table.getn(vs) == 3, vs)
+ardb.assert2(vs[1] == "v126", vs)
+ardb.assert2(vs[3] == "v128", vs)
+s = ardb.call("lrem", "biglist", "0", "x")
+ardb.assert2(s == 1, s)
+ardb.call("ltrim", "biglist", "10", "-11")
+s = ardb.call("llen", "biglist")
+ardb.assert2(s == 281, s)
+s = ardb.call("lindex", "biglist", "-1")
+ardb.assert2(s == "v290", s)
+s = ardb.call("lpop", "biglist")
+ardb.assert2(s == "v10", s)
+s = ardb.call("rpop", "biglist")
+ardb.assert2(s == "v290", s)
+vs = ardb.call("lrange", "biglist", "0", "-1")
+ardb.assert2(table.getn(vs) == 279, vs)
+ardb.assert2(vs[90] == "ins", vs)
+ardb.call("del", "biglist")
@@ -101,3 +101,26 @@ ardb.assert2(table.getn(vs) == 1, vs)
 ardb.assert2(vs[1] == "c", vs)
 
 
+
+-- small sets are kept compact and expand once they grow
+ardb.call("del", "myset1", "myset2")
+s = ardb.call("sadd", "myset1", "a", "b", "c")
+ardb.assert2(s == 3, s)
+s = ardb.call("smove", "myset1", "myset2", "b")
+ardb.assert2(s == 1, s)
+s = ardb.call("sismember", "myset2", "b")
+ardb.assert2(s == 1, s)
+s = ardb.call("sismember", "myset1", "b")
+ardb.assert2(s == 0, s)
+s = ardb.call("srem", "myset1", "a", "x")
+ardb.assert2(s == 1, s)
+for i = 0, 199 do
+    ardb.call("sadd", "myset1", "member" .. i)
+end
+s = ardb.call("scard", "myset1")
+ardb.assert2(s == 201, s)
+s = ardb.call("sismember", "myset1", "member150")
+ardb.assert2(s == 1, s)
+s = ardb.call("sunionstore", "myset2", "myset1", "myset2")
+ardb.assert2(s == 202, s)
+ardb.call("del", "myset1", "myset2")
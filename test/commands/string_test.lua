@@ -186,3 +186,27 @@ v = ardb.call("get", "fkey")
 ardb.assert2(tonumber(v) == 1.1, v)
 
 
+
+--[[  segmented string test  --]]
+ardb.call("del", "bigstr")
+local chunk = string.rep("a", 50000)
+s = ardb.call("append", "bigstr", chunk)
+ardb.assert2(s == 50000, s)
+s = ardb.call("append", "bigstr", chunk)
+ardb.assert2(s == 100000, s)
+s = ardb.call("setrange", "bigstr", "65530", "0123456789")
+ardb.assert2(s == 100000, s)
+s = ardb.call("getrange", "bigstr", "65528", "65541")
+ardb.assert2(s == "aa0123456789aa", s)
+s = ardb.call("setrange", "bigstr", "200000", "end")
+ardb.assert2(s == 200003, s)
+s = ardb.call("getrange", "bigstr", "-4", "-1")
+ardb.assert2(s == "\0end", s)
+v = ardb.call("get", "bigstr")
+ardb.assert2(string.len(v) == 200003 and string.sub(v, 65531, 65540) == "0123456789", string.len(v))
+ardb.call("set", "bigstr", "small")
+v = ardb.call("get", "bigstr")
+ardb.assert2(v == "small", v)
+s = ardb.call("getrange", "bigstr", "0", "-1")
+ardb.assert2(s == "small", s)
+ardb.call("del", "bigstr")
@@ -221,3 +221,68 @@ ardb.assert2(vs[1] == "3", vs)
 ardb.assert2(vs[2] == "three", vs)
 
 
+--[[  zset with rank index --]]
+ardb.call("del", "test-zset-key")
+for i = 0, 299 do
+    ardb.call("zadd", "test-zset-key", tostring(math.floor(i / 3)), string.format("long-member-%04d", i))
+end
+s = ardb.call("zrank", "test-zset-key", "long-member-0157")
+ardb.assert2(s == 157, s)
+s = ardb.call("zrevrank", "test-zset-key", "long-member-0157")
+ardb.assert2(s == 142, s)
+vs = ardb.call("zrange", "test-zset-key", "100", "102")
+ardb.assert2(table.getn(vs) == 3, vs)
+ardb.assert2(vs[1] == "long-member-0100", vs)
+ardb.assert2(vs[3] == "long-member-0102", vs)
+vs = ardb.call("zrevrange", "test-zset-key", "10", "11")
+ardb.assert2(vs[1] == "long-member-0289", vs)
+ardb.assert2(vs[2] == "long-member-0288", vs)
+s = ardb.call("zcount", "test-zset-key", "10", "20")
+ardb.assert2(s == 33, s)
+s = ardb.call("zcount", "test-zset-key", "(10", "(20")
+ardb.assert2(s == 27, s)
+vs = ardb.call("zrangebyscore", "test-zset-key", "10", "20", "limit", "5", "2")
+ardb.assert2(vs[1] == "long-member-0035", vs)
+ardb.assert2(vs[2] == "long-member-0036", vs)
+vs = ardb.call("zrevrangebyscore", "test-zset-key", "20", "10", "limit", "5", "2")
+ardb.assert2(vs[1] == "long-member-0057", vs)
+ardb.assert2(vs[2] == "long-member-0056", vs)
+ardb.call("zrem", "test-zset-key", "long-member-0100")
+s = ardb.call("zrank", "test-zset-key", "long-member-0101")
+ardb.assert2(s == 100, s)
+s = ardb.call("zremrangebyrank", "test-zset-key", "0", "9")
+ardb.assert2(s == 10, s)
+s = ardb.call("zrank", "test-zset-key", "long-member-0150")
+ardb.assert2(s == 139, s)
+ardb.call("zincrby", "test-zset-key", "1000", "long-member-0200")
+s = ardb.call("zrank", "test-zset-key", "long-member-0200")
+ardb.assert2(s == 288, s)
+s = ardb.call("zcount", "test-zset-key", "-inf", "+inf")
+ardb.assert2(s == 289, s)
+ardb.call("del", "test-zset-key")
+
+-- small sorted sets are kept compact and expand once they grow
+ardb.call("del", "test-zset-key")
+s = ardb.call("zadd", "test-zset-key", "3", "c", "1", "a", "2", "b")
+ardb.assert2(s == 3, s)
+s = ardb.call("zincrby", "test-zset-key", "10", "a")
+ardb.assert2(s == "11", s)
+s = ardb.call("zrank", "test-zset-key", "a")
+ardb.assert2(s == 2, s)
+vs = ardb.call("zrangebyscore", "test-zset-key", "2", "3")
+ardb.assert2(vs[1] == "b", vs)
+ardb.assert2(vs[2] == "c", vs)
+s = ardb.call("zremrangebyscore", "test-zset-key", "2", "2")
+ardb.assert2(s == 1, s)
+s = ardb.call("zrem", "test-zset-key", "c")
+ardb.assert2(s == 1, s)
+for i = 0, 199 do
+    ardb.call("zadd", "test-zset-key", i, "member" .. i)
+end
+s = ardb.call("zcard", "test-zset-key")
+ardb.assert2(s == 201, s)
+s = ardb.call("zscore", "test-zset-key", "member150")
+ardb.assert2(s == "150", s)
+s = ardb.call("zrank", "test-zset-key", "a")
+ardb.assert2(s == 11, s)
+ardb.call("del", "test-zset-key")
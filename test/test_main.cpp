@@ -37,9 +37,71 @@
 
 using namespace ardb;
 
+/*
+ * set member keys encoded in comparable format must be ordered by memcmp as 'Data::Compare' orders the members,
+ * and decoded back unchanged.
+ */
+static int test_comparable_key_codec()
+{
+    DataArray members;
+    const char* strs[] = { "", "a", "ab", "abc", "ab\0c", "ab\0\0", "\xff", "10", "9223372036854775807",
+            "-9223372036854775808", "9007199254740992", "9007199254740993", "-3", "0" };
+    size_t lens[] = { 0, 1, 2, 3, 4, 4, 1, 2, 19, 20, 16, 16, 2, 1 };
+    for (size_t i = 0; i < arraysize(strs); i++)
+    {
+        Data member;
+        member.SetString(std::string(strs[i], lens[i]), true);
+        members.push_back(member);
+    }
+    double floats[] = { 1.5, -2.5, 9007199254740992.0, 1e300, -1e300, 0.25 };
+    for (size_t i = 0; i < arraysize(floats); i++)
+    {
+        members.push_back(Data(floats[i]));
+    }
+    Data ns;
+    ns.SetString("0", false);
+    std::vector<std::string> encoded;
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        KeyObject key(ns, KEY_SET_MEMBER, "codec");
+        key.SetSetMember(members[i]);
+        Buffer buffer;
+        key.EncodeAs(KEY_FORMAT_COMPARABLE, buffer, true, true);
+        encoded.push_back(std::string(buffer.GetRawReadBuffer(), buffer.ReadableBytes()));
+    }
+    for (size_t i = 0; i < members.size(); i++)
+    {
+        KeyObject decoded;
+        Buffer content(const_cast<char*>(encoded[i].data()), 0, encoded[i].size());
+        if (!decoded.DecodeAs(KEY_FORMAT_COMPARABLE, content, true, true) || content.Readable()
+                || decoded.GetType() != KEY_SET_MEMBER || decoded.GetNameSpace() != ns
+                || decoded.GetKey().AsString() != "codec" || decoded.GetSetMember().Compare(members[i]) != 0)
+        {
+            printf("Failed to decode comparable key of member:%s\n", members[i].AsString().c_str());
+            return -1;
+        }
+        for (size_t j = 0; j < members.size(); j++)
+        {
+            int cmp = members[i].Compare(members[j]);
+            int encoded_cmp = encoded[i].compare(encoded[j]);
+            if ((cmp > 0) != (encoded_cmp > 0) || (cmp < 0) != (encoded_cmp < 0))
+            {
+                printf("Comparable key order of %s & %s is not the member order\n", members[i].AsString().c_str(),
+                        members[j].AsString().c_str());
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
 
 int main()
 {
+    if (test_comparable_key_codec() != 0)
+    {
+        return -1;
+    }
     Ardb db;
     if (db.Init("../test/ardb-test.conf") != 0)
     {